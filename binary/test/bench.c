@@ -0,0 +1,638 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <file.h>
+#include <ioctl.h>
+#include <pthread.h>
+#include <mman.h>
+
+#include "bench.h"
+
+#define BENCH_PAGE_SIZE 4096
+
+#define BENCH_SECTOR_SIZE   512
+#define BENCH_DISK_SECTORS  128     /* 每次读取的扇区数（64KB） */
+
+#define BENCH_PIPE_CHUNK    65536   /* 管道测试的缓冲区，不小于最大的写入大小 */
+
+#define BENCH_SHM_NAME      "bench_shm"
+
+/**
+ * fork_round - 执行一轮fork+exit+wait
+ * @buf: 父进程的堆内存
+ * @size: 堆内存大小
+ * @touch: 子进程是否写入每一页（触发写时复制）
+ * 
+ * 返回0表示成功，-1表示失败
+ */
+static int fork_round(char *buf, int size, int touch)
+{
+    int pid = fork();
+    if (pid < 0) {
+        printf("fork failed!\n");
+        return -1;
+    }
+    if (!pid) {
+        if (touch) {
+            int i;
+            for (i = 0; i < size; i += BENCH_PAGE_SIZE)
+                buf[i] = 1;
+        }
+        exit(0);
+    }
+    _wait(NULL);
+    return 0;
+}
+
+/**
+ * fork_bench - 测试不同堆大小下fork的耗时
+ * @rounds: 每种大小执行的次数
+ * 
+ * 写时复制后，fork的耗时应该基本不随堆大小增长，
+ * 只有子进程写入页面时才会产生复制的开销。
+ */
+int fork_bench(int rounds)
+{
+    static const int sizes[] = {0, 256 * 1024, 1024 * 1024, 4 * 1024 * 1024};
+    int i, j, touch;
+    
+    if (rounds <= 0)
+        rounds = 100;
+
+    printf("fork bench: %d rounds per size\n", rounds);
+    printf("    HEAP(KB)    TICKS  TICKS(TOUCH)\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        char *buf = NULL;
+        unsigned int ticks[2];
+        
+        if (sizes[i]) {
+            buf = malloc(sizes[i]);
+            if (buf == NULL) {
+                printf("malloc %d bytes failed!\n", sizes[i]);
+                return -1;
+            }
+            /* 先写入所有页，确保父进程已经映射了物理页 */
+            memset(buf, 0, sizes[i]);
+        }
+        
+        for (touch = 0; touch < 2; touch++) {
+            unsigned int start = time(NULL);
+            for (j = 0; j < rounds; j++) {
+                if (fork_round(buf, sizes[i], touch)) {
+                    free(buf);
+                    return -1;
+                }
+            }
+            ticks[touch] = time(NULL) - start;
+        }
+        printf("%12d %8d %13d\n", sizes[i] / 1024, ticks[0], ticks[1]);
+        free(buf);
+    }
+    return 0;
+}
+
+/**
+ * exec_bench - 测试程序的启动耗时
+ * @path: 要执行的程序，会带上参数"quit"
+ * @rounds: 执行的次数
+ * 
+ * 每一轮执行fork+execv+exit+wait，目标程序需要在收到"quit"参数后
+ * 立即退出（test程序自己就是这样）。程序段按需加载后，启动耗时
+ * 只和实际访问到的页有关，而不再和程序文件的大小成正比。
+ */
+int exec_bench(const char *path, int rounds)
+{
+    const char *argv[3] = {path, "quit", NULL};
+    int i;
+    
+    if (rounds <= 0)
+        rounds = 100;
+
+    printf("exec bench: %s, %d rounds\n", path, rounds);
+    
+    unsigned int start = time(NULL);
+    for (i = 0; i < rounds; i++) {
+        int pid = fork();
+        if (pid < 0) {
+            printf("fork failed!\n");
+            return -1;
+        }
+        if (!pid) {
+            execv(path, argv);
+            printf("execv %s failed!\n", path);
+            exit(-1);
+        }
+        _wait(NULL);
+    }
+    unsigned int ticks = time(NULL) - start;
+    printf("    TICKS  TICKS(PER 100)\n");
+    printf(" %8d %15d\n", ticks, ticks * 100 / rounds);
+    return 0;
+}
+
+/**
+ * disk_bench - 测试磁盘在PIO和DMA两种模式下的顺序读取速度
+ * @path: 块设备文件
+ * @mb: 每种模式读取的数据量（MB）
+ * 
+ * 块设备文件的位置和读取的数量都是以扇区为单位的。
+ * 只读取，不会写入磁盘。
+ */
+int disk_bench(const char *path, int mb)
+{
+    static const char *modes[] = {"PIO", "DMA"};
+    int fd, mode, i, chunks;
+    char *buf;
+    
+    if (mb <= 0)
+        mb = 4;
+    chunks = mb * 1024 * 1024 / (BENCH_DISK_SECTORS * BENCH_SECTOR_SIZE);
+    
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+        printf("open %s failed!\n", path);
+        return -1;
+    }
+    buf = malloc(BENCH_DISK_SECTORS * BENCH_SECTOR_SIZE);
+    if (buf == NULL) {
+        printf("malloc failed!\n");
+        close(fd);
+        return -1;
+    }
+
+    printf("disk bench: %s, %d MB per mode\n", path, mb);
+    printf("    MODE    TICKS  KB/TICK\n");
+    for (mode = 0; mode < 2; mode++) {
+        if (ioctl(fd, IDE_IOCTL_DMA, mode)) {
+            printf("%8s not supported\n", modes[mode]);
+            continue;
+        }
+        unsigned int start = time(NULL);
+        for (i = 0; i < chunks; i++) {
+            lseek(fd, i * BENCH_DISK_SECTORS, SEEK_SET);
+            if (read(fd, buf, BENCH_DISK_SECTORS)) {
+                printf("read sector %d failed!\n", i * BENCH_DISK_SECTORS);
+                break;
+            }
+        }
+        unsigned int ticks = time(NULL) - start;
+        printf("%8s %8d %8d\n", modes[mode], ticks, 
+            ticks ? mb * 1024 / ticks : 0);
+    }
+    free(buf);
+    close(fd);
+    return 0;
+}
+
+/**
+ * smp_spin - 纯计算的负载，不进入内核
+ * @loops: 循环次数（单位为百万次）
+ */
+static void smp_spin(int loops)
+{
+    volatile unsigned int sum = 0;
+    int i, j;
+
+    for (i = 0; i < loops; i++)
+        for (j = 0; j < 1000000; j++)
+            sum += j;
+}
+
+/**
+ * smp_bench - 测试计算密集型进程在多处理器上的扩展性
+ * @procs: 最多同时运行的进程数
+ * @loops: 每个进程的计算量（单位为百万次循环）
+ * 
+ * 依次同时运行1、2、4...个进程，每个进程的计算量相同。
+ * 多处理器下，进程数不超过处理器数时总耗时应该基本不变，
+ * 单处理器下总耗时会随进程数线性增长。
+ */
+int smp_bench(int procs, int loops)
+{
+    int n, i;
+
+    if (procs <= 0)
+        procs = 8;
+    if (loops <= 0)
+        loops = 200;
+
+    printf("smp bench: up to %d procs, %dM loops per proc\n", procs, loops);
+    printf("   PROCS    TICKS\n");
+    for (n = 1; n <= procs; n *= 2) {
+        unsigned int start = time(NULL);
+        for (i = 0; i < n; i++) {
+            int pid = fork();
+            if (pid < 0) {
+                printf("fork failed!\n");
+                return -1;
+            }
+            if (!pid) {
+                smp_spin(loops);
+                exit(0);
+            }
+        }
+        for (i = 0; i < n; i++)
+            _wait(NULL);
+        unsigned int ticks = time(NULL) - start;
+        printf("%8d %8d\n", n, ticks);
+    }
+    return 0;
+}
+
+/**
+ * pipe_wait_byte - 从管道读取一个字节
+ * @fd: 管道读端
+ * @c: 保存读到的字节
+ * 
+ * 管道为空时读取会阻塞，被信号打断时返回失败，所以要重试直到读到数据
+ */
+static void pipe_wait_byte(int fd, char *c)
+{
+    while ((int)read(fd, c, 1) <= 0)
+        ;
+}
+
+/**
+ * pingpong_bench - 通过两个管道来回传递一个字节，测试任务切换的延迟
+ * @rounds: 来回的次数
+ * 
+ * 每个来回至少包含两次任务切换，每个来回的耗时反映了
+ * 一个任务唤醒另一个任务并让它运行起来的延迟。
+ */
+int pingpong_bench(int rounds)
+{
+    int ping[2], pong[2];
+    int i, pid;
+    char c = 0;
+    
+    if (rounds <= 0)
+        rounds = 1000;
+
+    if (pipe(ping) < 0 || pipe(pong) < 0) {
+        printf("make pipe failed!\n");
+        return -1;
+    }
+
+    printf("pingpong bench: %d rounds\n", rounds);
+    
+    pid = fork();
+    if (pid < 0) {
+        printf("fork failed!\n");
+        return -1;
+    }
+    if (!pid) {
+        for (i = 0; i < rounds; i++) {
+            pipe_wait_byte(ping[0], &c);
+            write(pong[1], &c, 1);
+        }
+        exit(0);
+    }
+
+    unsigned int start = time(NULL);
+    for (i = 0; i < rounds; i++) {
+        write(ping[1], &c, 1);
+        pipe_wait_byte(pong[0], &c);
+    }
+    unsigned int ticks = time(NULL) - start;
+    _wait(NULL);
+
+    printf("    TICKS  TICKS(PER 1000)\n");
+    printf(" %8d %16d\n", ticks, ticks * 1000 / rounds);
+    return 0;
+}
+
+/**
+ * bench_usec - 从start到现在经过的微秒数
+ * @start: 开始的时间
+ */
+static unsigned int bench_usec(struct timespec *start)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) * 1000000 +
+        (now.tv_nsec - start->tv_nsec) / 1000;
+}
+
+/**
+ * bench_nsec_per_op - 计算每次操作的纳秒数
+ * @usec: 总的微秒数
+ * @rounds: 操作的次数
+ */
+static unsigned int bench_nsec_per_op(unsigned int usec, int rounds)
+{
+    return (usec / rounds) * 1000 + (usec % rounds) * 1000 / rounds;
+}
+
+/**
+ * futex_bench - 比较futex互斥锁和管道交接的开销
+ * @rounds: 每一项的次数
+ * 
+ * 1.没有竞争的互斥锁，只在用户态做原子操作
+ * 2.没有等待者的FUTEX_WAKE，反映进入内核的开销
+ * 3.两个进程通过管道交接一个字节，每次交接都要唤醒对方并切换任务
+ */
+int futex_bench(int rounds)
+{
+    pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+    struct timespec start;
+    unsigned int usec;
+    int ping[2], pong[2];
+    int i, pid;
+    char c = 0;
+    
+    if (rounds <= 0)
+        rounds = 10000;
+
+    printf("futex bench: %d rounds\n", rounds);
+    printf("    TEST                  USEC   NSEC(PER OP)\n");
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < rounds; i++) {
+        pthread_mutex_lock(&mutex);
+        pthread_mutex_unlock(&mutex);
+    }
+    usec = bench_usec(&start);
+    printf("    mutex lock/unlock %8d %14d\n", usec, bench_nsec_per_op(usec, rounds));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < rounds; i++)
+        futex((int *)&mutex.lock, FUTEX_WAKE, 1);
+    usec = bench_usec(&start);
+    printf("    futex wake        %8d %14d\n", usec, bench_nsec_per_op(usec, rounds));
+
+    if (pipe(ping) < 0 || pipe(pong) < 0) {
+        printf("make pipe failed!\n");
+        return -1;
+    }
+
+    pid = fork();
+    if (pid < 0) {
+        printf("fork failed!\n");
+        return -1;
+    }
+    if (!pid) {
+        for (i = 0; i < rounds; i++) {
+            pipe_wait_byte(ping[0], &c);
+            write(pong[1], &c, 1);
+        }
+        exit(0);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (i = 0; i < rounds; i++) {
+        write(ping[1], &c, 1);
+        pipe_wait_byte(pong[0], &c);
+    }
+    usec = bench_usec(&start);
+    _wait(NULL);
+
+    /* 每个来回有两次交接 */
+    printf("    pipe handoff      %8d %14d\n", usec, bench_nsec_per_op(usec, rounds * 2));
+    return 0;
+}
+
+/**
+ * pipe_bench - 测试管道的吞吐量
+ * @mb: 每种写入大小传输的数据量（单位为MB）
+ * 
+ * 子进程按照不同的大小写入，父进程每次最多读取BENCH_PIPE_CHUNK，
+ * 直到子进程关闭写端读到末尾。小的写入反映每次系统调用的开销，
+ * 大的写入反映复制数据和唤醒对方的开销。
+ */
+int pipe_bench(int mb)
+{
+    static const int sizes[] = {64, 512, 4096, 65536};
+    struct timespec start;
+    unsigned int usec, msec;
+    int fd[2];
+    int i, n, pid, total, bytes;
+    char *buf;
+
+    if (mb <= 0)
+        mb = 4;
+    total = mb * 1024 * 1024;
+
+    buf = malloc(BENCH_PIPE_CHUNK);
+    if (buf == NULL) {
+        printf("malloc failed!\n");
+        return -1;
+    }
+    memset(buf, 0x5a, BENCH_PIPE_CHUNK);
+
+    printf("pipe bench: %d MB per size\n", mb);
+    printf("    SIZE      USEC     KB/S\n");
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        if (pipe(fd) < 0) {
+            printf("make pipe failed!\n");
+            break;
+        }
+
+        pid = fork();
+        if (pid < 0) {
+            printf("fork failed!\n");
+            close(fd[0]);
+            close(fd[1]);
+            break;
+        }
+        if (!pid) {
+            close(fd[0]);
+            for (bytes = 0; bytes < total; bytes += sizes[i])
+                write(fd[1], buf, sizes[i]);
+            close(fd[1]);
+            exit(0);
+        }
+
+        /* 关闭自己的写端，子进程退出后才能读到末尾 */
+        close(fd[1]);
+        bytes = 0;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        while ((n = read(fd[0], buf, BENCH_PIPE_CHUNK)) > 0)
+            bytes += n;
+        usec = bench_usec(&start);
+        close(fd[0]);
+        _wait(NULL);
+
+        if (bytes != total)
+            printf("    short read %d of %d bytes\n", bytes, total);
+
+        msec = usec / 1000;
+        printf("%8d %9d %8d\n", sizes[i], usec,
+            msec ? (bytes / 1024) * 1000 / msec : 0);
+    }
+    free(buf);
+    return 0;
+}
+
+/**
+ * shm_pipe_round - 通过管道传输一次数据
+ * @total: 传输的字节数
+ * @buf: 缓冲区，大小为BENCH_PIPE_CHUNK
+ * 
+ * 子进程写入，父进程读到末尾，返回耗费的微秒数，失败返回-1
+ */
+static int shm_pipe_round(int total, char *buf)
+{
+    struct timespec start;
+    unsigned int usec;
+    int fd[2];
+    int n, pid, bytes;
+
+    if (pipe(fd) < 0) {
+        printf("make pipe failed!\n");
+        return -1;
+    }
+    pid = fork();
+    if (pid < 0) {
+        printf("fork failed!\n");
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (!pid) {
+        close(fd[0]);
+        for (bytes = 0; bytes < total; bytes += BENCH_PIPE_CHUNK)
+            write(fd[1], buf, BENCH_PIPE_CHUNK);
+        close(fd[1]);
+        exit(0);
+    }
+
+    close(fd[1]);
+    bytes = 0;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while ((n = read(fd[0], buf, BENCH_PIPE_CHUNK)) > 0)
+        bytes += n;
+    usec = bench_usec(&start);
+    close(fd[0]);
+    _wait(NULL);
+
+    if (bytes != total)
+        printf("    short read %d of %d bytes\n", bytes, total);
+    return usec;
+}
+
+/**
+ * shm_map_round - 通过共享内存传输一次数据
+ * @total: 传输的字节数
+ * @data: 父进程映射的共享内存
+ * 
+ * 子进程自己打开并映射同一个对象，写满后通过管道发送一个字节通知父进程，
+ * 父进程直接在映射中检查数据，返回耗费的微秒数，失败返回-1
+ */
+static int shm_map_round(int total, unsigned char *data)
+{
+    struct timespec start;
+    unsigned int usec;
+    unsigned char *p;
+    int fd[2];
+    int i, pid, id, bad;
+    char c;
+
+    if (pipe(fd) < 0) {
+        printf("make pipe failed!\n");
+        return -1;
+    }
+    pid = fork();
+    if (pid < 0) {
+        printf("fork failed!\n");
+        close(fd[0]);
+        close(fd[1]);
+        return -1;
+    }
+    if (!pid) {
+        close(fd[0]);
+        id = shm_open(BENCH_SHM_NAME, total, 0);
+        p = id < 0 ? (void *)-1 : shm_map(id, 0, PROT_READ | PROT_WRITE, 0);
+        if (p != (void *)-1) {
+            memset(p, 0x5a, total);
+            munmap((uint32_t)p, total);
+        }
+        write(fd[1], &c, 1);
+        close(fd[1]);
+        exit(0);
+    }
+
+    close(fd[1]);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    bad = read(fd[0], &c, 1) != 1;
+    for (i = 0; i < total; i++)
+        bad += data[i] != 0x5a;
+    usec = bench_usec(&start);
+    close(fd[0]);
+    _wait(NULL);
+
+    if (bad)
+        printf("    %d bad bytes in shared memory\n", bad);
+    memset(data, 0, total);
+    return usec;
+}
+
+/**
+ * shm_bench - 比较共享内存和管道传输数据的开销
+ * @mb: 每次传输的数据量（单位为MB）
+ * @rounds: 每种方式传输的次数
+ * 
+ * 管道的数据要从写者复制到内核再复制到读者，共享内存的数据由子进程直接写到
+ * 父进程也映射了的物理页，只用一个字节的管道消息通知。第一次通过共享内存
+ * 传输时还包括了分配物理页的页故障。
+ */
+int shm_bench(int mb, int rounds)
+{
+    unsigned int pipeUsec = 0, shmUsec = 0;
+    unsigned char *data;
+    char *buf;
+    int i, id, usec, total;
+
+    if (mb <= 0)
+        mb = 1;
+    if (rounds <= 0)
+        rounds = 4;
+    total = mb * 1024 * 1024;
+
+    buf = malloc(BENCH_PIPE_CHUNK);
+    if (buf == NULL) {
+        printf("malloc failed!\n");
+        return -1;
+    }
+    memset(buf, 0x5a, BENCH_PIPE_CHUNK);
+
+    id = shm_open(BENCH_SHM_NAME, total, SHM_CREAT | SHM_EXCL);
+    if (id < 0) {
+        printf("shm_open failed!\n");
+        free(buf);
+        return -1;
+    }
+    data = shm_map(id, 0, PROT_READ | PROT_WRITE, 0);
+    if (data == (void *)-1) {
+        printf("shm_map failed!\n");
+        shm_unlink(BENCH_SHM_NAME);
+        free(buf);
+        return -1;
+    }
+
+    printf("shm bench: %d MB, %d rounds\n", mb, rounds);
+    printf("    ROUND  PIPE USEC   SHM USEC\n");
+    for (i = 0; i < rounds; i++) {
+        usec = shm_pipe_round(total, buf);
+        if (usec < 0)
+            break;
+        pipeUsec += usec;
+        printf("%9d %10d", i, usec);
+
+        usec = shm_map_round(total, data);
+        if (usec < 0) {
+            printf("\n");
+            break;
+        }
+        shmUsec += usec;
+        printf(" %10d\n", usec);
+    }
+    if (i > 0)
+        printf("      avg %10d %10d\n", pipeUsec / i, shmUsec / i);
+
+    munmap((uint32_t)data, total);
+    shm_unlink(BENCH_SHM_NAME);
+    free(buf);
+    return 0;
+}
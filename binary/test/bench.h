@@ -0,0 +1,17 @@
+#ifndef _TEST_BENCH_H
+#define _TEST_BENCH_H
+
+/*
+ * 性能测试：每个测试打印耗费的时钟节拍数
+ */
+
+int fork_bench(int rounds);
+int exec_bench(const char *path, int rounds);
+int disk_bench(const char *path, int mb);
+int smp_bench(int procs, int loops);
+int pingpong_bench(int rounds);
+int futex_bench(int rounds);
+int pipe_bench(int mb);
+int shm_bench(int mb, int rounds);
+
+#endif  /* _TEST_BENCH_H */
@@ -10,6 +10,8 @@
 #include <time.h>
 #include <taskscan.h>
 
+#include "bench.h"
+
 char test[4096];
 
 char test2[4096];
@@ -363,6 +365,33 @@ void taskscan_test()
 
 int main(int argc, char *argv[])
 {
+    if (argc > 1 && !strcmp(argv[1], "fork"))
+        return fork_bench(argc > 2 ? atoi(argv[2]) : 0);
+    /* test exec [path] [rounds]，默认执行自己 */
+    if (argc > 1 && !strcmp(argv[1], "exec"))
+        return exec_bench(argc > 2 ? argv[2] : argv[0], argc > 3 ? atoi(argv[3]) : 0);
+    /* test disk [path] [mb]，默认读取sys:/dev/hda */
+    if (argc > 1 && !strcmp(argv[1], "disk"))
+        return disk_bench(argc > 2 ? argv[2] : "sys:/dev/hda", argc > 3 ? atoi(argv[3]) : 0);
+    /* test smp [procs] [loops]，测试多处理器的扩展性 */
+    if (argc > 1 && !strcmp(argv[1], "smp"))
+        return smp_bench(argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? atoi(argv[3]) : 0);
+    /* test pingpong [rounds]，测试任务切换的延迟 */
+    if (argc > 1 && !strcmp(argv[1], "pingpong"))
+        return pingpong_bench(argc > 2 ? atoi(argv[2]) : 0);
+    /* test futex [rounds]，比较futex互斥锁和管道交接的开销 */
+    if (argc > 1 && !strcmp(argv[1], "futex"))
+        return futex_bench(argc > 2 ? atoi(argv[2]) : 0);
+    /* test pipe [mb]，测试不同写入大小下管道的吞吐量 */
+    if (argc > 1 && !strcmp(argv[1], "pipe"))
+        return pipe_bench(argc > 2 ? atoi(argv[2]) : 0);
+    /* test shm [mb] [rounds]，比较共享内存和管道传输数据的开销 */
+    if (argc > 1 && !strcmp(argv[1], "shm"))
+        return shm_bench(argc > 2 ? atoi(argv[2]) : 0, argc > 3 ? atoi(argv[3]) : 0);
+    /* 被exec测试启动时立即退出 */
+    if (argc > 1 && !strcmp(argv[1], "quit"))
+        return 0;
+
     taskscan_test();
 
     return 0;
@@ -288,6 +288,50 @@ void cmd_free(uint32_t argc, char** argv)
     printf("%14dM%14dM%14dM\n", mi.mi_total / MB, mi.mi_used / MB, mi.mi_free / MB);
 }
 
+void cmd_cache(uint32_t argc, char** argv)
+{
+    if (argc > 1) {
+        printf("cache: no arguments support!\n");
+        return;
+    }
+    cachescan_status_t cs;
+    int num = 0;
+    printf("NAME                 SIZE  OBJS/G GROUPS   INUSE   WASTED  HIT%%  REFILLS  FLUSHES\n");
+    while (!cachescan(&cs, &num)) {
+        /* 没有使用过的cache不显示 */
+        if (!cs.cs_groups && !cs.cs_allocs)
+            continue;
+        printf("%-18s %6d %7d %6d %7d %8d %4d %8d %8d\n", 
+            cs.cs_name, cs.cs_objsize, cs.cs_objnum, cs.cs_groups, cs.cs_inuse,
+            cs.cs_wasted, cs.cs_allocs ? cs.cs_hits * 100 / cs.cs_allocs : 0,
+            cs.cs_refills, cs.cs_flushes);
+    }
+    
+    bufstat_t bs;
+    if (!bufstat(&bs)) {
+        unsigned long reads = bs.bs_hits + bs.bs_misses;
+        printf("\nblock buffer: %d buffers %dKB/%dKB dirty %d hit %d%% evictions %d writebacks %d\n",
+            bs.bs_buffers, bs.bs_size / 1024, bs.bs_maxsize / 1024, bs.bs_dirty,
+            reads ? bs.bs_hits * 100 / reads : 0, bs.bs_evictions, bs.bs_writebacks);
+        printf("writeback: flushed %d throttled %d\n", bs.bs_flushed, bs.bs_throttled);
+    }
+}
+
+void cmd_lock(uint32_t argc, char** argv)
+{
+    if (argc > 1) {
+        printf("lock: no arguments support!\n");
+        return;
+    }
+    lockscan_status_t ls;
+    int num = 0;
+    printf("NAME                  ACQUIRED CONTENDED   WAIT(us) WAITMAX(us)   HOLD(us) HOLDMAX(us)\n");
+    while (!lockscan(&ls, &num)) {
+        printf("%-20s %9d %9d %10d %11d %10d %11d\n",
+            ls.ls_name, ls.ls_acquisitions, ls.ls_contentions,
+            ls.ls_waittime, ls.ls_waitmax, ls.ls_holdtime, ls.ls_holdmax);
+    }
+}
 
 void cmd_exit(uint32_t argc, char** argv)
 {
@@ -828,12 +872,14 @@ void cmd_help(uint32_t argc, char** argv)
 	}
 	printf("  cat         print a file.\n");
 	printf("  cls         clean screen.\n");
+	printf("  cache       print kernel memory caches.\n");
 	printf("  cd          change current work dirctory.\n");
 	printf("  cp          copy a file.\n");
 	printf("  date        get current date.\n");
 	printf("  dir         list files in current dirctory.\n");
 	printf("  exit        exit shell.\n");
 	printf("  kill        close a thread.\n");
+	printf("  lock        print kernel lock contention.\n");
 	printf("  ls          list files in current dirctory.\n");
 	printf("  lsdisk      list disk drives.\n");
 	printf("  mkdir       create a dir.\n");
@@ -1280,6 +1326,10 @@ int buildin_cmd(int cmd_argc, char **cmd_argv)
         cmd_exit(cmd_argc, cmd_argv);
     }else if(!strcmp("free", cmd_argv[0])){
         cmd_free(cmd_argc, cmd_argv);
+    }else if(!strcmp("cache", cmd_argv[0])){
+        cmd_cache(cmd_argc, cmd_argv);
+    }else if(!strcmp("lock", cmd_argv[0])){
+        cmd_lock(cmd_argc, cmd_argv);
     }else if(!strcmp("lsdisk", cmd_argv[0])){
         cmd_lsdisk(cmd_argc, cmd_argv);
     }else if(!strcmp("kill", cmd_argv[0])){
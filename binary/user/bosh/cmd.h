@@ -28,6 +28,8 @@ int cmd_copy(uint32_t argc, char** argv);
 void cmd_reboot(uint32_t argc, char** argv);
 void cmd_exit(uint32_t argc, char** argv);
 void cmd_free(uint32_t argc, char** argv);
+void cmd_cache(uint32_t argc, char** argv);
+void cmd_lock(uint32_t argc, char** argv);
 void cmd_lsdisk(uint32_t argc, char** argv);
 void cmd_ls_sub(char *pathname, int detail);
 int cmd_kill(uint32_t argc, char** argv);
@@ -159,6 +159,7 @@ int main(int argc, char *argv0[])
 
             /* 1.准备管道 */
             int pipe_fd[2] = {-1};  
+            int next_fd[2];
             if (pipe(pipe_fd)) {
                 printf("create pipe failed!\n");
                 continue;
@@ -225,6 +226,21 @@ int main(int argc, char *argv0[])
                 
                     break;
                 }
+                /* 中间命令输出到一个新的管道，关闭上一个管道的写端，
+                这样中间命令读完数据后会读到末尾，而不是一直阻塞 */
+                if (pipe(next_fd)) {
+                    redirect(STDOUT_FILENO, bosh_stdout_backup);
+                    redirect(STDIN_FILENO, bosh_stdin_backup);
+                    close(pipe_fd[0]);
+                    close(pipe_fd[1]);
+                    pipe_flag = 1;
+                    printf("create pipe failed!\n");
+                    break;
+                }
+                redirect(STDOUT_FILENO, next_fd[1]);
+                close(pipe_fd[1]);
+                pipe_fd[1] = next_fd[1];
+
                 /* 执行中间命令：不允许输入输出重定向 */
                 if (execute_cmd(argc, cmd_argv, 0)) {
                     /* 执行失败后，就不往后面运行了 */
@@ -235,12 +251,18 @@ int main(int argc, char *argv0[])
                     /* 关闭管道 */
                     close(pipe_fd[0]);
                     close(pipe_fd[1]);
+                    close(next_fd[0]);
                     pipe_flag = 1;
                     printf("bosh: execute cmd %s falied!\n", cmd_argv[0]);
                     break;
                     
                 }
 
+                /* 下一个命令从新的管道读取 */
+                redirect(STDIN_FILENO, next_fd[0]);
+                close(pipe_fd[0]);
+                pipe_fd[0] = next_fd[0];
+
                 each_cmd = pipe_symbol + 1;
             }
             /* 如果执行失败，就回到最开头 */
@@ -252,6 +274,9 @@ int main(int argc, char *argv0[])
             /* 恢复标准输出重定向 */
             redirect(STDOUT_FILENO, bosh_stdout_backup);
 
+            /* 关闭写端，最后一个命令读完管道中的数据后就会读到末尾 */
+            close(pipe_fd[1]);
+
             argc = -1;
             argc = cmd_parse(each_cmd, cmd_argv, ' ');
             if (argc == -1) {
@@ -260,7 +285,6 @@ int main(int argc, char *argv0[])
                 redirect(STDIN_FILENO, bosh_stdin_backup);
                 /* 关闭管道 */
                 close(pipe_fd[0]);
-                close(pipe_fd[1]);
                 printf("bosh: num of arguments exceed %d\n",MAX_ARG_NR);
                 
                 continue;
@@ -276,7 +300,6 @@ int main(int argc, char *argv0[])
 
             /* 6.关闭管道 */
             close(pipe_fd[0]);
-            close(pipe_fd[1]);
 
         } else {
             /* 解析成参数 */
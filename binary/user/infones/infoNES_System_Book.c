@@ -13,7 +13,13 @@
 //#define CONFIG_SOUND
 
 #ifdef CONFIG_SOUND
+#include <pthread.h>
+
 #define SOUND_DEVICE "sys:/dev/pcspeaker2"
+
+/* 声音线程的帧队列，满了就丢掉新的帧，不让模拟等待声音 */
+#define SOUND_FRAMES    4
+#define SOUND_SAMPLES   735     /* 44100 / 60 */
 #endif /* CONFIG_SOUND */
 
 void start_application( char *filename );
@@ -53,6 +59,21 @@ WORD NesPalette[ 64 ] =
 int soundFd;
 int wavflag;
 
+#ifdef CONFIG_SOUND
+/* 5个声道的波形，由声音线程混合后输出 */
+struct SoundFrame {
+  int samples;
+  BYTE waves[5][SOUND_SAMPLES];
+};
+
+struct SoundFrame soundFrames[SOUND_FRAMES];
+int soundHead, soundCount;
+int soundQuit;
+pthread_mutex_t soundLock = PTHREAD_MUTEX_INITIALIZER;
+pthread_cond_t soundReady = PTHREAD_COND_INITIALIZER;
+pthread_t soundThread;
+#endif /* CONFIG_SOUND */
+
 /* 绘制缓冲区 */
 DWORD graphBuffer[NES_DISP_WIDTH*NES_DISP_HEIGHT];
 
@@ -592,6 +613,73 @@ void InfoNES_SoundInit( void )
     soundFd = 0;
 }
 
+#ifdef CONFIG_SOUND
+/*===================================================================*/
+/*                                                                   */
+/*         SoundPlayFrame() : Mix 5 waves and output a frame         */
+/*                                                                   */
+/*===================================================================*/
+static void SoundPlayFrame( struct SoundFrame *frame )
+{
+  int i;
+  BYTE finalWave;
+
+  wavflag = 1;
+  for (i = 0; i < frame->samples; i++) {
+#if 1
+    finalWave = ( frame->waves[0][i] + frame->waves[1][i] + frame->waves[2][i] +
+        frame->waves[3][i] + frame->waves[4][i] ) / 5;
+#else   
+    /* 读取数据 */
+    finalWave = frame->waves[3][i];
+#endif
+    /* 设置频率 */
+    if (finalWave) {
+      if (wavflag == 1) {
+        ioctl(soundFd, 1, 0);    
+      }
+      wavflag++;
+          
+      ioctl(soundFd, 4, finalWave + 30);
+    } else {
+      wavflag = 0;
+      ioctl(soundFd, 0, 0);
+    }
+  }
+}
+
+/*===================================================================*/
+/*                                                                   */
+/*           SoundThreadMain() : Sound mixing thread                 */
+/*                                                                   */
+/*===================================================================*/
+static void *SoundThreadMain( void *arg )
+{
+  struct SoundFrame *frame;
+
+  while (1) {
+    pthread_mutex_lock(&soundLock);
+    while (!soundCount && !soundQuit)
+      pthread_cond_wait(&soundReady, &soundLock);
+    if (!soundCount) {
+      pthread_mutex_unlock(&soundLock);
+      break;
+    }
+    frame = &soundFrames[soundHead];
+    pthread_mutex_unlock(&soundLock);
+
+    /* 混合和输出的时候不持有锁，模拟线程可以继续放入其它帧 */
+    SoundPlayFrame(frame);
+
+    pthread_mutex_lock(&soundLock);
+    soundHead = (soundHead + 1) % SOUND_FRAMES;
+    soundCount--;
+    pthread_mutex_unlock(&soundLock);
+  }
+  return NULL;
+}
+#endif /* CONFIG_SOUND */
+
 /*===================================================================*/
 /*                                                                   */
 /*        InfoNES_SoundOpen() : Sound Open                           */
@@ -608,6 +696,14 @@ int InfoNES_SoundOpen( int samples_per_sync, int sample_rate )
     }
     /* 开始播放声音 */
     ioctl(soundFd, 0, 0);
+
+    /* 声音的输出很慢，放到单独的线程里面，不拖慢模拟 */
+    soundHead = soundCount = soundQuit = 0;
+    if (pthread_create(&soundThread, NULL, SoundThreadMain, NULL)) {
+        close(soundFd);
+        soundFd = 0;
+        return 0;
+    }
 #endif
   /* Successful */
   return 1;
@@ -623,6 +719,13 @@ void InfoNES_SoundClose( void )
 
 #ifdef CONFIG_SOUND
   if (soundFd) {
+      /* 等声音线程播放完队列里的帧 */
+      pthread_mutex_lock(&soundLock);
+      soundQuit = 1;
+      pthread_cond_signal(&soundReady);
+      pthread_mutex_unlock(&soundLock);
+      pthread_join(soundThread, NULL);
+
       close(soundFd);
     }
 #endif
@@ -637,35 +740,35 @@ void InfoNES_SoundOutput( int samples, BYTE *wave1, BYTE *wave2, BYTE *wave3, BY
 {
 
 #ifdef CONFIG_SOUND
-  int i;
-  BYTE finalWave;
-  wavflag = 1;
-  if (soundFd) {
-      for (i = 0; i < samples; i++) {
-#if 1
-    finalWave = ( wave1[i] + wave2[i] + wave3[i] + wave4[i] + wave5[i] ) / 5;
-#else   
-          /* 读取数据 */
-          finalWave = wave4[i];
-#endif
-        /* 设置频率 */
-        if (finalWave) {
-            if (wavflag == 1) {
-                ioctl(soundFd, 1, 0);    
-            }
-            wavflag++;
-                
-            ioctl(soundFd, 4, finalWave + 30);
-        } else {
-            wavflag = 0;
-            ioctl(soundFd, 0, 0);
-            
-        }
-  
-      }
-      /* 设置频率 */
-      //ioctl(soundFd, 4, finalWave);
+  struct SoundFrame *frame;
+
+  if (!soundFd)
+    return;
+
+  if (samples > SOUND_SAMPLES)
+    samples = SOUND_SAMPLES;
+
+  pthread_mutex_lock(&soundLock);
+  /* 队列满了，声音线程跟不上，丢掉这一帧 */
+  if (soundCount == SOUND_FRAMES) {
+    pthread_mutex_unlock(&soundLock);
+    return;
   }
+  frame = &soundFrames[(soundHead + soundCount) % SOUND_FRAMES];
+  pthread_mutex_unlock(&soundLock);
+
+  /* 这个位置在放入队列之前声音线程不会访问 */
+  frame->samples = samples;
+  memcpy(frame->waves[0], wave1, samples);
+  memcpy(frame->waves[1], wave2, samples);
+  memcpy(frame->waves[2], wave3, samples);
+  memcpy(frame->waves[3], wave4, samples);
+  memcpy(frame->waves[4], wave5, samples);
+
+  pthread_mutex_lock(&soundLock);
+  soundCount++;
+  pthread_cond_signal(&soundReady);
+  pthread_mutex_unlock(&soundLock);
 #endif /* CONFIG_SOUND */
 }
 
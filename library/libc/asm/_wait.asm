@@ -20,4 +20,18 @@ _wait:
 	int INT_VECTOR_SYS_CALL
 	
 	pop ebx
-	ret
\ No newline at end of file
+	ret
+; int waitpid(pid_t pid, int *status);
+global waitpid
+waitpid:
+	push ebx
+	push ecx
+
+	mov eax, SYS_WAITPID
+	mov ebx, [esp + 8 + 4]
+	mov ecx, [esp + 8 + 4 * 2]
+	int INT_VECTOR_SYS_CALL
+
+	pop ecx
+	pop ebx
+	ret
@@ -20,4 +20,40 @@ fork:
 	int INT_VECTOR_SYS_CALL
 	
 	;
-	ret
\ No newline at end of file
+	ret
+extern exit
+
+global clone
+
+; int clone(int (*fn)(void *), void *stack, unsigned long flags, void *arg);
+; 子任务切换到新的栈上调用fn(arg)，返回后用返回值退出
+clone:
+	push ebx
+	push ecx
+	push esi
+	push edi
+
+	mov esi, [esp + 16 + 4]
+	mov ecx, [esp + 16 + 4 * 2]
+	mov ebx, [esp + 16 + 4 * 3]
+	mov edi, [esp + 16 + 4 * 4]
+
+	mov eax, SYS_CLONE
+	int INT_VECTOR_SYS_CALL
+
+	cmp eax, 0
+	je .child
+
+	pop edi
+	pop esi
+	pop ecx
+	pop ebx
+	ret
+
+.child:
+	; 除了eax和esp，子任务的寄存器和父任务一样
+	xor ebp, ebp
+	push edi
+	call esi
+	push eax
+	call exit
@@ -0,0 +1,29 @@
+;----
+;file:		lib/futex.asm
+;auther:	Jason Hu
+;time:		2020/3/14
+;copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+;----
+
+[bits 32]
+[section .text]
+
+%include "sys/syscall.inc"
+
+; int futex(int *uaddr, int op, int val);
+global futex
+futex:
+	push ebx
+	push ecx
+	push esi
+
+	mov eax, SYS_FUTEX
+	mov ebx, [esp + 12 + 4]
+	mov ecx, [esp + 12 + 4 * 2]
+	mov esi, [esp + 12 + 4 * 3]
+	int INT_VECTOR_SYS_CALL
+
+	pop esi
+	pop ecx
+	pop ebx
+	ret
@@ -20,3 +20,31 @@ getmem:
 	int INT_VECTOR_SYS_CALL
 	pop ebx
 	ret
+
+global cachescan
+global bufstat
+
+; int cachescan(cachescan_status_t *cs, int *idx);
+cachescan:
+	push ebx
+    push ecx
+    
+	mov eax, SYS_CACHESCAN
+	mov ebx, [esp + 8 + 4]
+    mov ecx, [esp + 8 + 4 * 2]
+    int INT_VECTOR_SYS_CALL
+	
+    pop ecx
+    pop ebx
+	ret
+
+; int bufstat(bufstat_t *bs);
+bufstat:
+	push ebx
+    
+	mov eax, SYS_BUFSTAT
+	mov ebx, [esp + 4 + 4]
+    int INT_VECTOR_SYS_CALL
+	
+    pop ebx
+	ret
@@ -0,0 +1,83 @@
+;----
+;file:		lib/mqueue.asm
+;auther:	Jason Hu
+;time:		2020/3/17
+;copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+;----
+
+[bits 32]
+[section .text]
+
+%include "sys/syscall.inc"
+
+; mqd_t mq_open(const char *name, int flags, unsigned int maxmsg, unsigned int msgsize);
+global mq_open
+mq_open:
+	push ebx
+	push ecx
+	push esi
+	push edi
+
+	mov eax, SYS_MQOPEN
+	mov ebx, [esp + 16 + 4]
+	mov ecx, [esp + 16 + 4 * 2]
+	mov esi, [esp + 16 + 4 * 3]
+	mov edi, [esp + 16 + 4 * 4]
+	int INT_VECTOR_SYS_CALL
+
+	pop edi
+	pop esi
+	pop ecx
+	pop ebx
+	ret
+
+; int mq_unlink(const char *name);
+global mq_unlink
+mq_unlink:
+	push ebx
+
+	mov eax, SYS_MQUNLINK
+	mov ebx, [esp + 4 + 4]
+	int INT_VECTOR_SYS_CALL
+
+	pop ebx
+	ret
+
+; int mq_sendmsg(mqd_t mqd, const mq_msg_t *msg, int msecs);
+global mq_sendmsg
+mq_sendmsg:
+	push ebx
+	push ecx
+	push esi
+
+	mov eax, SYS_MQSEND
+	mov ebx, [esp + 12 + 4]
+	mov ecx, [esp + 12 + 4 * 2]
+	mov esi, [esp + 12 + 4 * 3]
+	int INT_VECTOR_SYS_CALL
+
+	pop esi
+	pop ecx
+	pop ebx
+	ret
+
+; int mq_receive_many(mqd_t mqd, mq_msg_t *msgs, int count, int msecs);
+global mq_receive_many
+mq_receive_many:
+	push ebx
+	push ecx
+	push esi
+	push edi
+
+	mov eax, SYS_MQRECEIVE
+	mov ebx, [esp + 16 + 4]
+	mov ecx, [esp + 16 + 4 * 2]
+	mov esi, [esp + 16 + 4 * 3]
+	mov edi, [esp + 16 + 4 * 4]
+	int INT_VECTOR_SYS_CALL
+
+	pop edi
+	pop esi
+	pop ecx
+	pop ebx
+	ret
@@ -11,6 +11,7 @@
 %include "sys/syscall.inc"
 
 global msleep
+global usleep
 
 ; void msleep(int msecond);
 msleep:
@@ -21,4 +22,15 @@ msleep:
 	int INT_VECTOR_SYS_CALL
 	
 	pop ebx
-	ret
\ No newline at end of file
+	ret
+
+; void usleep(unsigned int usecond);
+usleep:
+	push ebx
+
+	mov eax, SYS_USLEEP
+	mov ebx, [esp + 4 + 4]
+	int INT_VECTOR_SYS_CALL
+	
+	pop ebx
+	ret
@@ -0,0 +1,62 @@
+;----
+;file:		lib/shm.asm
+;auther:	Jason Hu
+;time:		2020/3/16
+;copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+;----
+
+[bits 32]
+[section .text]
+
+%include "sys/syscall.inc"
+
+; int shm_open(const char *name, unsigned int size, int flags);
+global shm_open
+shm_open:
+	push ebx
+	push ecx
+	push esi
+
+	mov eax, SYS_SHMOPEN
+	mov ebx, [esp + 12 + 4]
+	mov ecx, [esp + 12 + 4 * 2]
+	mov esi, [esp + 12 + 4 * 3]
+	int INT_VECTOR_SYS_CALL
+
+	pop esi
+	pop ecx
+	pop ebx
+	ret
+
+; void *shm_map(int shmid, uint32_t addr, uint32_t prot, uint32_t flags);
+global shm_map
+shm_map:
+	push ebx
+	push ecx
+	push esi
+	push edi
+
+	mov eax, SYS_SHMMAP
+	mov ebx, [esp + 16 + 4]
+	mov ecx, [esp + 16 + 4 * 2]
+	mov esi, [esp + 16 + 4 * 3]
+	mov edi, [esp + 16 + 4 * 4]
+	int INT_VECTOR_SYS_CALL
+
+	pop edi
+	pop esi
+	pop ecx
+	pop ebx
+	ret
+
+; int shm_unlink(const char *name);
+global shm_unlink
+shm_unlink:
+	push ebx
+
+	mov eax, SYS_SHMUNLINK
+	mov ebx, [esp + 4 + 4]
+	int INT_VECTOR_SYS_CALL
+
+	pop ebx
+	ret
@@ -48,4 +48,19 @@ taskscan:
 	
     pop ecx
     pop ebx
-	ret
\ No newline at end of file
+	ret
+
+; int lockscan(lockscan_status_t *ls, int *idx);
+global lockscan
+lockscan:
+	push ebx
+    push ecx
+    
+	mov eax, SYS_LOCKSCAN
+	mov ebx, [esp + 8 + 4]
+    mov ecx, [esp + 8 + 4 * 2]
+    int INT_VECTOR_SYS_CALL
+	
+    pop ecx
+    pop ebx
+	ret
@@ -35,3 +35,18 @@ time:
 	
 	pop ebx
 	ret
+
+global clock_gettime
+; int clock_gettime(clockid_t clockid, struct timespec *ts);
+clock_gettime:
+	push ebx
+	push ecx
+
+	mov eax, SYS_CLOCKGETTIME
+	mov ebx, [esp + 8 + 4]
+	mov ecx, [esp + 8 + 8]
+	int INT_VECTOR_SYS_CALL
+
+	pop ecx
+	pop ebx
+	ret
@@ -272,15 +272,16 @@ int GUI_DrawTextPlus(int x, int y, char *text, unsigned int color)
 }
 
 /**
- * GUI_PollEven - 事件轮训
+ * GUI_GetEven - 获取事件
  * @even: 事件
+ * @operate: KGC_MSG_RECV不等待，KGC_MSG_WAIT睡眠等待
  * 
  * 如果有事件，返回0，没有事件返回-1
  */
-int GUI_PollEven(GUI_Even_t *even)
+static int GUI_GetEven(GUI_Even_t *even, int operate)
 {
     KGC_Message_t msg;
-    if (!kgcmsg(KGC_MSG_RECV, &msg)) {
+    if (!kgcmsg(operate, &msg)) {
         memset(even, 0, sizeof(GUI_Even_t));
         /* 获取到事件并解析之 */
         switch (msg.type) {
@@ -336,3 +337,25 @@ int GUI_PollEven(GUI_Even_t *even)
     /* 获取到事件 */
     return 0;
 }
+
+/**
+ * GUI_PollEven - 事件轮训
+ * @even: 事件
+ * 
+ * 如果有事件，返回0，没有事件返回-1
+ */
+int GUI_PollEven(GUI_Even_t *even)
+{
+    return GUI_GetEven(even, KGC_MSG_RECV);
+}
+
+/**
+ * GUI_WaitEven - 等待事件
+ * @even: 事件
+ * 
+ * 没有事件就睡眠，直到有事件产生，被信号打断返回-1
+ */
+int GUI_WaitEven(GUI_Even_t *even)
+{
+    return GUI_GetEven(even, KGC_MSG_WAIT);
+}
@@ -0,0 +1,68 @@
+/*
+ * file:		mqueue.c
+ * auther:	    Jason Hu
+ * time:		2020/3/17
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <mqueue.h>
+
+/**
+ * mq_timedsend - 发送一条消息，最多等待一段时间
+ * @mqd: 队列
+ * @msg: 消息
+ * @len: 消息的字节数
+ * @prio: 优先级
+ * @msecs: 最多等待的毫秒数
+ * 
+ * 成功返回0，失败返回-1
+ */
+int mq_timedsend(mqd_t mqd, const void *msg, unsigned int len, unsigned int prio, int msecs)
+{
+    mq_msg_t m;
+
+    m.buf = (void *)msg;
+    m.len = len;
+    m.prio = prio;
+    return mq_sendmsg(mqd, &m, msecs);
+}
+
+/**
+ * mq_send - 发送一条消息，队列满了就一直等待
+ */
+int mq_send(mqd_t mqd, const void *msg, unsigned int len, unsigned int prio)
+{
+    return mq_timedsend(mqd, msg, len, prio, -1);
+}
+
+/**
+ * mq_timedreceive - 接收一条消息，最多等待一段时间
+ * @mqd: 队列
+ * @buf: 缓冲区
+ * @len: 缓冲区的大小
+ * @prio: 保存消息的优先级，可以为NULL
+ * @msecs: 最多等待的毫秒数
+ * 
+ * 成功返回消息的字节数，失败返回-1
+ */
+int mq_timedreceive(mqd_t mqd, void *buf, unsigned int len, unsigned int *prio, int msecs)
+{
+    mq_msg_t m;
+
+    m.buf = buf;
+    m.len = len;
+    if (mq_receive_many(mqd, &m, 1, msecs) != 1)
+        return -1;
+
+    if (prio)
+        *prio = m.prio;
+    return m.len;
+}
+
+/**
+ * mq_receive - 接收一条消息，没有消息就一直等待
+ */
+int mq_receive(mqd_t mqd, void *buf, unsigned int len, unsigned int *prio)
+{
+    return mq_timedreceive(mqd, buf, len, prio, -1);
+}
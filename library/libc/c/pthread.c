@@ -0,0 +1,254 @@
+/*
+ * file:		pthread.c
+ * auther:		Jason Hu
+ * time:		2020/3/14
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <pthread.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+
+/* 线程描述符，放在线程栈的最下面 */
+struct pthread {
+    int tid;                            /* 线程的任务id */
+    void *(*start_routine)(void *);     /* 线程函数 */
+    void *arg;                          /* 线程参数 */
+};
+
+/* 比较并交换，返回原来的值 */
+static inline int atomic_cmpxchg(volatile int *ptr, int old, int new)
+{
+    int prev;
+    __asm__ __volatile__("lock; cmpxchgl %2, %1"
+        : "=a" (prev), "+m" (*ptr)
+        : "r" (new), "0" (old)
+        : "memory");
+    return prev;
+}
+
+/* 交换，返回原来的值 */
+static inline int atomic_xchg(volatile int *ptr, int val)
+{
+    __asm__ __volatile__("xchgl %0, %1"
+        : "+r" (val), "+m" (*ptr)
+        :
+        : "memory");
+    return val;
+}
+
+/* 加上一个值，返回原来的值 */
+static inline int atomic_fetch_add(volatile int *ptr, int val)
+{
+    __asm__ __volatile__("lock; xaddl %0, %1"
+        : "+r" (val), "+m" (*ptr)
+        :
+        : "memory");
+    return val;
+}
+
+/**
+ * pthread_start - 线程的入口
+ * @arg: 线程描述符
+ *
+ * 在线程自己的栈上运行，返回值作为退出状态
+ */
+static int pthread_start(void *arg)
+{
+    struct pthread *thread = arg;
+    return (int)thread->start_routine(thread->arg);
+}
+
+/**
+ * pthread_create - 创建线程
+ * @thread: 保存线程描述符
+ * @attr: 属性，没有使用
+ * @start_routine: 线程函数
+ * @arg: 线程参数
+ *
+ * 成功返回0，失败返回EAGAIN
+ */
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+        void *(*start_routine)(void *), void *arg)
+{
+    struct pthread *t = malloc(sizeof(struct pthread) + PTHREAD_STACK_SIZE);
+    if (t == NULL)
+        return EAGAIN;
+
+    t->start_routine = start_routine;
+    t->arg = arg;
+
+    /* 栈从描述符后面开始，栈顶16字节对齐 */
+    unsigned long top = ((unsigned long)(t + 1) + PTHREAD_STACK_SIZE) & ~15UL;
+
+    t->tid = clone(pthread_start, (void *)top, CLONE_THREAD_FLAGS, t);
+    if (t->tid < 0) {
+        free(t);
+        return EAGAIN;
+    }
+    *thread = t;
+    return 0;
+}
+
+/**
+ * pthread_join - 等待线程结束
+ * @thread: 线程
+ * @retval: 保存线程的返回值
+ *
+ * 只有创建者可以等待，返回后线程的栈被释放
+ */
+int pthread_join(pthread_t thread, void **retval)
+{
+    int status;
+
+    if (waitpid(thread->tid, &status) != thread->tid)
+        return ESRCH;
+    if (retval != NULL)
+        *retval = (void *)status;
+    free(thread);
+    return 0;
+}
+
+/**
+ * pthread_exit - 结束当前线程
+ * @retval: 线程的返回值
+ */
+void pthread_exit(void *retval)
+{
+    exit((int)retval);
+}
+
+/**
+ * pthread_mutex_init - 初始化互斥锁
+ * @mutex: 互斥锁
+ * @attr: 属性，没有使用
+ */
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr)
+{
+    mutex->lock = 0;
+    return 0;
+}
+
+/**
+ * pthread_mutex_destroy - 销毁互斥锁
+ * @mutex: 互斥锁
+ */
+int pthread_mutex_destroy(pthread_mutex_t *mutex)
+{
+    if (mutex->lock)
+        return EBUSY;
+    return 0;
+}
+
+/**
+ * pthread_mutex_lock - 获取互斥锁
+ * @mutex: 互斥锁
+ */
+int pthread_mutex_lock(pthread_mutex_t *mutex)
+{
+    int c;
+
+    /* 快速路径：没有人持有锁 */
+    c = atomic_cmpxchg(&mutex->lock, 0, 1);
+    if (!c)
+        return 0;
+
+    /* 慢速路径：标记有等待者，然后睡眠直到抢到锁 */
+    if (c != 2)
+        c = atomic_xchg(&mutex->lock, 2);
+    while (c) {
+        futex((int *)&mutex->lock, FUTEX_WAIT, 2);
+        c = atomic_xchg(&mutex->lock, 2);
+    }
+    return 0;
+}
+
+/**
+ * pthread_mutex_trylock - 尝试获取互斥锁
+ * @mutex: 互斥锁
+ *
+ * 锁被持有时返回EBUSY
+ */
+int pthread_mutex_trylock(pthread_mutex_t *mutex)
+{
+    if (atomic_cmpxchg(&mutex->lock, 0, 1))
+        return EBUSY;
+    return 0;
+}
+
+/**
+ * pthread_mutex_unlock - 释放互斥锁
+ * @mutex: 互斥锁
+ */
+int pthread_mutex_unlock(pthread_mutex_t *mutex)
+{
+    /* 可能有等待者才进入内核 */
+    if (atomic_xchg(&mutex->lock, 0) == 2)
+        futex((int *)&mutex->lock, FUTEX_WAKE, 1);
+    return 0;
+}
+
+/**
+ * pthread_cond_init - 初始化条件变量
+ * @cond: 条件变量
+ * @attr: 属性，没有使用
+ */
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr)
+{
+    cond->seq = 0;
+    return 0;
+}
+
+/**
+ * pthread_cond_destroy - 销毁条件变量
+ * @cond: 条件变量
+ */
+int pthread_cond_destroy(pthread_cond_t *cond)
+{
+    return 0;
+}
+
+/**
+ * pthread_cond_wait - 等待条件变量
+ * @cond: 条件变量
+ * @mutex: 保护条件的互斥锁，调用时必须持有
+ *
+ * 返回时重新持有互斥锁，可能被虚假唤醒，调用者需要在循环中检查条件
+ */
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex)
+{
+    int seq = cond->seq;
+
+    pthread_mutex_unlock(mutex);
+
+    /* 解锁之后序号变了，futex会直接返回 */
+    futex((int *)&cond->seq, FUTEX_WAIT, seq);
+
+    /* 可能还有其它被唤醒的等待者，按有等待者的状态重新上锁 */
+    while (atomic_xchg(&mutex->lock, 2))
+        futex((int *)&mutex->lock, FUTEX_WAIT, 2);
+    return 0;
+}
+
+/**
+ * pthread_cond_signal - 唤醒一个等待者
+ * @cond: 条件变量
+ */
+int pthread_cond_signal(pthread_cond_t *cond)
+{
+    atomic_fetch_add(&cond->seq, 1);
+    futex((int *)&cond->seq, FUTEX_WAKE, 1);
+    return 0;
+}
+
+/**
+ * pthread_cond_broadcast - 唤醒所有等待者
+ * @cond: 条件变量
+ */
+int pthread_cond_broadcast(pthread_cond_t *cond)
+{
+    atomic_fetch_add(&cond->seq, 1);
+    futex((int *)&cond->seq, FUTEX_WAKE, INT_MAX);
+    return 0;
+}
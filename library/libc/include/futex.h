@@ -0,0 +1,16 @@
+/*
+ * file:		include/lib/futex.h
+ * auther:		Jason Hu
+ * time:		2020/3/14
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+#ifndef _LIB_FUTEX_H
+#define _LIB_FUTEX_H
+
+/* futex的操作 */
+#define FUTEX_WAIT      0   /* *uaddr等于val就睡眠，直到被唤醒 */
+#define FUTEX_WAKE      1   /* 最多唤醒val个在uaddr上睡眠的任务 */
+
+int futex(int *uaddr, int op, int val);
+
+#endif  /* _LIB_FUTEX_H */
@@ -12,4 +12,7 @@
 #define GTTY_IOCTL_CLEAR    1       /* 清屏 */
 #define GTTY_IOCTL_HOLD     2       /* 设置持有者 */
 
+/* ide */
+#define IDE_IOCTL_DMA       4       /* 1使用DMA传输，0使用PIO传输 */
+
 #endif  /* _LIB_IOCTL_H */
@@ -0,0 +1,47 @@
+/*
+ * file:		include/lib/mqueue.h
+ * auther:		Jason Hu
+ * time:		2020/3/17
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+#ifndef _LIB_MQUEUE_H
+#define _LIB_MQUEUE_H
+
+/*
+消息队列：
+    队列通过名字打开，返回的id在所有进程中都一样。创建时指定槽的数量和每条消息
+的最大字节数，所有槽一次分配好，队列满了发送者就等待。
+    优先级从0到MQ_PRIO_MAX-1，数值大的先接收，同一个优先级先进先出。
+    超时以毫秒为单位，小于0表示一直等待，0表示不等待。删除队列的名字会同时
+关闭队列，正在等待的进程都会返回失败。
+*/
+
+#define MQ_PRIO_MAX     8       /* 优先级的数量 */
+#define MQ_NAME_LEN     24      /* 名字的最大长度，包括结尾的0 */
+#define MQ_RECV_MAX     16      /* 一次最多接收的消息数 */
+
+/* mq_open的标志 */
+#define MQ_CREAT        0x01    /* 不存在就创建 */
+#define MQ_EXCL         0x02    /* 和MQ_CREAT一起使用，已经存在就失败 */
+
+typedef int mqd_t;
+
+/* 一条消息，接收时len传入缓冲区大小，返回消息大小 */
+typedef struct mq_msg {
+    void *buf;
+    unsigned int len;
+    unsigned int prio;
+} mq_msg_t;
+
+mqd_t mq_open(const char *name, int flags, unsigned int maxmsg, unsigned int msgsize);
+int mq_unlink(const char *name);
+
+int mq_sendmsg(mqd_t mqd, const mq_msg_t *msg, int msecs);
+int mq_receive_many(mqd_t mqd, mq_msg_t *msgs, int count, int msecs);
+
+int mq_send(mqd_t mqd, const void *msg, unsigned int len, unsigned int prio);
+int mq_timedsend(mqd_t mqd, const void *msg, unsigned int len, unsigned int prio, int msecs);
+int mq_receive(mqd_t mqd, void *buf, unsigned int len, unsigned int *prio);
+int mq_timedreceive(mqd_t mqd, void *buf, unsigned int len, unsigned int *prio, int msecs);
+
+#endif  /* _LIB_MQUEUE_H */
@@ -0,0 +1,65 @@
+/*
+ * file:		include/lib/pthread.h
+ * auther:		Jason Hu
+ * time:		2020/3/14
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _LIB_PTHREAD_H
+#define _LIB_PTHREAD_H
+
+#include "futex.h"
+#include "sched.h"
+
+/*
+互斥锁和条件变量：
+    没有竞争时只在用户态做一次原子操作，不进入内核；有竞争时才用futex睡眠。
+互斥锁的状态：0-没有上锁，1-上锁了没有等待者，2-上锁了可能有等待者，解锁的
+时候只有状态是2才需要唤醒。
+    条件变量是一个序号，等待者记下序号后解锁睡眠，通知者增加序号后唤醒，序号变了
+等待者就不会睡下去，所以通知不会丢失。
+    线程用clone创建，和创建者共享地址空间、文件和信号行为。线程的栈从堆中分配，
+只有创建者可以等待线程结束并回收它的栈。malloc和free不是线程安全的，多个线程
+分配内存时需要自己加锁。
+*/
+
+/* 线程栈的大小 */
+#define PTHREAD_STACK_SIZE  (64 * 1024)
+
+struct pthread;
+typedef struct pthread *pthread_t;
+
+typedef struct pthread_mutex {
+    volatile int lock;
+} pthread_mutex_t;
+
+typedef struct pthread_cond {
+    volatile int seq;
+} pthread_cond_t;
+
+/* 属性还没有用到，保留接口 */
+typedef int pthread_attr_t;
+typedef int pthread_mutexattr_t;
+typedef int pthread_condattr_t;
+
+#define PTHREAD_MUTEX_INITIALIZER   { 0 }
+#define PTHREAD_COND_INITIALIZER    { 0 }
+
+int pthread_create(pthread_t *thread, const pthread_attr_t *attr,
+        void *(*start_routine)(void *), void *arg);
+int pthread_join(pthread_t thread, void **retval);
+void pthread_exit(void *retval);
+
+int pthread_mutex_init(pthread_mutex_t *mutex, const pthread_mutexattr_t *attr);
+int pthread_mutex_destroy(pthread_mutex_t *mutex);
+int pthread_mutex_lock(pthread_mutex_t *mutex);
+int pthread_mutex_trylock(pthread_mutex_t *mutex);
+int pthread_mutex_unlock(pthread_mutex_t *mutex);
+
+int pthread_cond_init(pthread_cond_t *cond, const pthread_condattr_t *attr);
+int pthread_cond_destroy(pthread_cond_t *cond);
+int pthread_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex);
+int pthread_cond_signal(pthread_cond_t *cond);
+int pthread_cond_broadcast(pthread_cond_t *cond);
+
+#endif  /* _LIB_PTHREAD_H */
@@ -25,10 +25,12 @@ pid_t getpgid(pid_t pid);
 int execv(const char *path, const char *argv[]);
 
 void msleep(int msecond);
+void usleep(unsigned int usecond);
 unsigned int sleep(unsigned int second);
 
 void exit(int status);
 int _wait(int *status);
+int waitpid(pid_t pid, int *status);
 
 void free(void *ptr);
 void *malloc(size_t size);
@@ -49,5 +51,6 @@ int reboot();
 void getver(char *buf, int buflen);
 
 #include "taskscan.h"
+#include "lockscan.h"
 
 #endif  /* _LIB_STDLIB_H */
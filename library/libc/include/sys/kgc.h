@@ -15,6 +15,7 @@
 /**** 消息部分 *****/
 #define KGC_MSG_SEND 1
 #define KGC_MSG_RECV 2
+#define KGC_MSG_WAIT 3  /* 没有消息时睡眠等待 */
 
 typedef unsigned char KGC_MsgType_t; 
 typedef unsigned int kgcc_t;
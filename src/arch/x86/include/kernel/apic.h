@@ -0,0 +1,87 @@
+/*
+ * file:		arch/x86/include/kernel/apic.h
+ * auther:		Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _X86_APIC_H
+#define _X86_APIC_H
+
+#include <lib/stdint.h>
+#include <lib/types.h>
+
+/* 本地APIC默认的物理地址 */
+#define LAPIC_DEFAULT_ADDR      0xfee00000
+
+/* 本地APIC的寄存器偏移 */
+#define LAPIC_ID                0x020
+#define LAPIC_VERSION           0x030
+#define LAPIC_TPR               0x080
+#define LAPIC_EOI               0x0b0
+#define LAPIC_SVR               0x0f0
+#define LAPIC_ESR               0x280
+#define LAPIC_ICR_LOW           0x300
+#define LAPIC_ICR_HIGH          0x310
+#define LAPIC_LVT_TIMER         0x320
+#define LAPIC_LVT_LINT0         0x350
+#define LAPIC_LVT_LINT1         0x360
+#define LAPIC_LVT_ERROR         0x370
+#define LAPIC_TIMER_INIT        0x380
+#define LAPIC_TIMER_CURRENT     0x390
+#define LAPIC_TIMER_DIVIDE      0x3e0
+
+/* 伪中断寄存器：软件打开APIC */
+#define LAPIC_SVR_ENABLE        (1 << 8)
+
+/* 本地中断向量表 */
+#define LAPIC_LVT_MASKED        (1 << 16)
+#define LAPIC_LVT_NMI           (4 << 8)
+#define LAPIC_LVT_EXTINT        (7 << 8)
+#define LAPIC_TIMER_PERIODIC    (1 << 17)
+#define LAPIC_TIMER_DIV16       0x03
+
+/* 中断命令寄存器 */
+#define LAPIC_ICR_FIXED         (0 << 8)
+#define LAPIC_ICR_INIT          (5 << 8)
+#define LAPIC_ICR_STARTUP       (6 << 8)
+#define LAPIC_ICR_PENDING       (1 << 12)
+#define LAPIC_ICR_ASSERT        (1 << 14)
+#define LAPIC_ICR_LEVEL         (1 << 15)
+
+/* IOAPIC的寄存器 */
+#define IOAPIC_REG_SELECT       0x00
+#define IOAPIC_REG_WINDOW       0x10
+
+#define IOAPIC_VERSION          0x01
+#define IOAPIC_REDIR_TABLE(pin) (0x10 + (pin) * 2)
+
+/* 重定向表项 */
+#define IOAPIC_REDIR_LOW        (1 << 13)   /* 低电平有效 */
+#define IOAPIC_REDIR_LEVEL      (1 << 15)   /* 电平触发 */
+#define IOAPIC_REDIR_MASKED     (1 << 16)
+
+/* 本地APIC产生的中断向量，IRQ占用了0x20~0x2f */
+#define APIC_TIMER_VECTOR       0x30
+#define APIC_RESCHED_VECTOR     0x31
+#define APIC_TLB_VECTOR         0x32    /* 不经过大内核锁 */
+#define APIC_ERROR_VECTOR       0x3e
+#define APIC_SPURIOUS_VECTOR    0x3f
+
+PUBLIC int InitLapic(unsigned long phyAddr);
+PUBLIC void LapicInit(int bsp);
+PUBLIC unsigned int LapicId();
+PUBLIC void LapicEoi();
+PUBLIC void LapicSendIpi(unsigned int apicId, unsigned int icr);
+PUBLIC void LapicTlbFlushHandler();
+
+PUBLIC int LapicTimerCalibrate();
+PUBLIC void LapicClockEventInit(int cpu);
+
+PUBLIC void IoApicSetRoute(unsigned int irq, unsigned int pin, unsigned int redir);
+PUBLIC int InitIoApic(unsigned long phyAddr);
+PUBLIC void IoApicEnable();
+
+PUBLIC void InitApicHandlers();
+
+#endif	/* _X86_APIC_H */
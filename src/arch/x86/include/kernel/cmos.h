@@ -22,9 +22,13 @@
 #define CMOS_MON_DAY	0x7			//CMOS中一月中当前日(BCD)
 #define CMOS_CUR_MON	0x8			//CMOS中当前月?(BCD)
 #define CMOS_CUR_YEAR	0x9			//CMOS中当前年?(BCD)
+#define CMOS_STATUS_A	0xa			//CMOS中状态寄存器A
 #define CMOS_DEV_TYPE	0x12		//CMOS中??器格式
 #define CMOS_CUR_CEN	0x32		//CMOS中当前世?(BCD)
 
+/* 状态寄存器A中表示正在更新时间的位 */
+#define CMOS_UIP        0x80
+
 #define BCD_HEX(n)	((n >> 4) * 10) + (n & 0xf)  //BCD?十六?制
 
 #define BCD_ASCII_FIRST(n)	(((n<<4)>>4)+0x30)  //取BCD的个位并以字符?出,来自UdoOS
@@ -41,6 +45,7 @@ unsigned int CMOS_GetDayOfMonth();
 unsigned int CMOS_GetDayOfWeek();
 unsigned int CMOS_GetMonHex();
 unsigned int CMOS_GetYear();
+void CMOS_WaitUpdate();
 
 #endif  /* _X86_CMOS_H */
 
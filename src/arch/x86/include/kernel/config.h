@@ -10,6 +10,7 @@
 
 //#define CONFIG_ZONE_DEBUG
 //#define CONFIG_PAGE_DEBUG
+//#define CONFIG_BUDDY_SELF_TEST  /* 启动时对伙伴系统进行自检 */
 
 
 
@@ -68,6 +68,10 @@
 //TSS
 #define KERNEL_TSS_SEL ((INDEX_TSS << 3) + (SA_TIG << 2) + SA_RPL0)
 
+/* 其它处理器的tss段放在用户段的后面 */
+#define INDEX_CPU_TSS(cpu) ((cpu) ? (INDEX_USER_RW + (cpu)) : INDEX_TSS)
+#define CPU_TSS_SEL(cpu) ((INDEX_CPU_TSS(cpu) << 3) + (SA_TIG << 2) + SA_RPL0)
+
 /* GDT 的虚拟地址 */
 #define GDT_VADDR			0x80200000
 #define GDT_LIMIT		0x000007ff
@@ -0,0 +1,116 @@
+/*
+ * file:		arch/x86/include/kernel/smp.h
+ * auther:		Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _X86_SMP_H
+#define _X86_SMP_H
+
+#include <lib/stdint.h>
+#include <lib/types.h>
+
+/* 应用处理器启动代码的物理地址，需要4KB对齐并且在1MB以下 */
+#define AP_TRAMPOLINE_ADDR      0x8000
+
+/* 等待应用处理器启动的时钟节拍数 */
+#define AP_START_TIMEOUT        100
+
+/* BIOS的热启动向量 */
+#define WARM_RESET_VECTOR       0x467
+#define CMOS_SHUTDOWN_STATUS    0x0f
+#define CMOS_SHUTDOWN_JMP       0x0a
+
+/* MP浮点结构 */
+struct MpFloatPointer {
+    char signature[4];          /* "_MP_" */
+    uint32_t configTable;       /* MP配置表的物理地址 */
+    uint8_t length;             /* 长度，以16字节为单位 */
+    uint8_t version;
+    uint8_t checksum;
+    uint8_t feature1;           /* 不为0表示使用默认配置，没有配置表 */
+    uint8_t feature2;           /* 第7位表示有IMCR */
+    uint8_t reserved[3];
+} PACKED;
+
+#define MP_FEATURE2_IMCR        0x80
+
+/* MP配置表头 */
+struct MpConfigTable {
+    char signature[4];          /* "PCMP" */
+    uint16_t length;
+    uint8_t version;
+    uint8_t checksum;
+    char oemId[8];
+    char productId[12];
+    uint32_t oemTable;
+    uint16_t oemLength;
+    uint16_t entryCount;
+    uint32_t lapicAddr;         /* 本地APIC的物理地址 */
+    uint16_t extLength;
+    uint8_t extChecksum;
+    uint8_t reserved;
+} PACKED;
+
+/* MP配置表项的类型 */
+enum MpEntryType {
+    MP_ENTRY_PROCESSOR = 0,
+    MP_ENTRY_BUS,
+    MP_ENTRY_IOAPIC,
+    MP_ENTRY_IOINTERRUPT,
+    MP_ENTRY_LOCALINTERRUPT,
+};
+
+struct MpProcessor {
+    uint8_t type;
+    uint8_t apicId;
+    uint8_t apicVersion;
+    uint8_t flags;
+    uint32_t signature;
+    uint32_t features;
+    uint32_t reserved[2];
+} PACKED;
+
+#define MP_PROCESSOR_ENABLED    0x01
+#define MP_PROCESSOR_BSP        0x02
+
+struct MpBus {
+    uint8_t type;
+    uint8_t busId;
+    char busType[6];
+} PACKED;
+
+struct MpIoApic {
+    uint8_t type;
+    uint8_t apicId;
+    uint8_t apicVersion;
+    uint8_t flags;
+    uint32_t addr;
+} PACKED;
+
+struct MpIoInterrupt {
+    uint8_t type;
+    uint8_t intType;            /* 0表示向量中断 */
+    uint16_t flags;             /* 极性和触发方式 */
+    uint8_t srcBus;
+    uint8_t srcIrq;
+    uint8_t dstApic;
+    uint8_t dstPin;
+} PACKED;
+
+/* MP表中中断的极性和触发方式，0表示和总线一致 */
+#define MP_IRQ_POLARITY_MASK    0x03
+#define MP_IRQ_POLARITY_HIGH    0x01
+#define MP_IRQ_POLARITY_LOW     0x03
+#define MP_IRQ_TRIGGER_MASK     0x0c
+#define MP_IRQ_TRIGGER_EDGE     0x04
+#define MP_IRQ_TRIGGER_LEVEL    0x0c
+
+PUBLIC int ArchInitSmp();
+PUBLIC int ArchStartCpu(int cpu, unsigned long stackTop);
+PUBLIC void ArchSendReschedule(int cpu);
+PUBLIC void ArchSendTlbFlush(int cpu);
+PUBLIC void ArchFlushTlb();
+
+#endif	/* _X86_SMP_H */
@@ -0,0 +1,16 @@
+/*
+ * file:		arch/x86/include/kernel/tsc.h
+ * auther:		Jason Hu
+ * time:		2020/3/10
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _X86_TSC_H
+#define _X86_TSC_H
+
+#include <lib/stdint.h>
+#include <lib/types.h>
+
+PUBLIC void InitTsc();
+
+#endif  /* _X86_TSC_H */
@@ -10,6 +10,7 @@
 
 #include <lib/types.h>
 #include <lib/stdint.h>
+#include <book/config.h>
 
 /* 内核栈 */
 #define KERNEL_STATCK_TOP		0x8009f000
@@ -47,9 +48,11 @@ typedef struct Tss
 	uint32_t iobase;
 } Tss_t;
 
-EXTERN Tss_t tss;
+/* 每个处理器都有一个tss */
+EXTERN Tss_t tss[NR_CPUS];
 
 PUBLIC void InitTss();
+PUBLIC void InitCpuTss(int cpu);
 PUBLIC Tss_t *GetTss();
 
 #endif	/*_X86_CPU_H*/
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include <lib/stdint.h>
 #include <lib/types.h>
 
+/* CR0的写保护位，置位后内核写只读页也会产生页故障 */
+#define CR0_WP  (1 << 16)
+
 uint32_t In8(uint32_t port);
 uint32_t In16(uint32_t port);
 uint32_t In32(uint32_t port);
@@ -20,6 +23,7 @@ void Out32(uint32_t port, uint32_t data);
 void DisableInterrupt(void);
 void EnableInterrupt(void);
 void CpuHlt(void);
+void CpuStiHlt(void);
 void LoadTR(uint32_t tr);
 int32_t ReadCR0(void );
 int32_t ReadCR3(void );
@@ -41,6 +45,7 @@ void X86Cpuid(unsigned int id_eax, unsigned int *eax, \
         unsigned int *ebx, unsigned int *ecx, unsigned int *edx);
 
 void CpuNop();
+unsigned long long X86Rdtsc(void);
 
 char Xchg8(char *ptr, char value);
 short Xchg16(short *ptr, short value);
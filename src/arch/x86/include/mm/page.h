@@ -154,6 +154,8 @@ PUBLIC unsigned int AllocPages(unsigned int count);
 PUBLIC int FreePages(unsigned int page);
 #define FreePage(page) FreePages(page)
 
+PUBLIC int SharePages(unsigned int page);
+
 PUBLIC int PageTableAdd(unsigned int virtualAddr,
 		unsigned int physicAddr,
         unsigned int protect);
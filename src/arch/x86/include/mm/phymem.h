@@ -59,9 +59,25 @@ struct MemNode {
     unsigned int reference;     /* 引用次数 */
     struct MemCache *memCache;  /* 内存缓冲 */
     struct MemGroup *group;     /* 内存组 */
+    struct List list;           /* 空闲时挂在伙伴系统的空闲链表上 */
 };
 #define SIZEOF_MEM_NODE sizeof(struct MemNode) 
 
+/* 节点标志 */
+#define MEM_NODE_FREE       0x01    /* 节点是伙伴系统中一个空闲块的头节点 */
+
+/* 
+ * 伙伴系统的阶数，第n阶的块有2^n个页，
+ * 最大的块为2^(MAX_MEM_NODE_ORDER-1)个页，也就是4MB
+ */
+#define MAX_MEM_NODE_ORDER  11
+
+/* FreeArea 伙伴系统中某一阶的空闲区域 */
+struct FreeArea {
+    struct List freeList;       /* 空闲块链表，链接的是块的头节点 */
+    unsigned int blocks;        /* 空闲块的数量 */
+};
+
 /* 转换成物理地址 */
 #define __PA(x) ((unsigned long)(x) - PAGE_OFFSET)
 /* 转换成虚拟地址 */ 
@@ -90,7 +106,8 @@ PUBLIC void *Phy2Vir(unsigned long address);
 PUBLIC struct MemNode *Page2MemNode(unsigned int page);
 PUBLIC unsigned int MemNode2Page(struct MemNode *node);
 
-PUBLIC struct MemNode *GetFreeMemNode();
+PUBLIC struct MemNode *BuddyAllocNodes(unsigned int count);
+PUBLIC int BuddyFreeNodes(struct MemNode *node);
 
 PUBLIC unsigned int GetPhysicMemoryFreeSize();
 PUBLIC unsigned int GetPhysicMemoryTotalSize();
@@ -0,0 +1,439 @@
+/*
+ * file:		arch/x86/kernel/core/apic.c
+ * auther:		Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <kernel/apic.h>
+#include <kernel/x86.h>
+#include <kernel/pic.h>
+#include <kernel/interrupt.h>
+#include <kernel/gate.h>
+#include <mm/page.h>
+#include <book/interrupt.h>
+#include <book/vmarea.h>
+#include <book/debug.h>
+#include <book/smp.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <lib/math.h>
+
+/* 校准APIC定时器时等待的时钟节拍数 */
+#define LAPIC_CALIBRATE_TICKS   10
+
+/* 本地APIC的虚拟地址 */
+PRIVATE volatile uint8_t *lapicBase;
+
+/* IOAPIC的虚拟地址 */
+PRIVATE volatile uint8_t *ioapicBase;
+
+/* 引导处理器的APIC ID，设备中断都发送给它 */
+PRIVATE unsigned int bspApicId;
+
+/* 每个时钟节拍对应的APIC定时器计数 */
+PRIVATE unsigned int lapicTimerCount;
+
+/* 每个处理器的APIC定时器都是一个时钟事件设备 */
+PRIVATE struct ClockEventDevice lapicClockEvents[NR_CPUS];
+
+/* ISA中断对应的IOAPIC引脚和触发方式 */
+PRIVATE struct IoApicRoute {
+    unsigned int pin;
+    unsigned int redir;
+} ioapicRoute[NR_IRQS];
+
+PRIVATE INLINE uint32_t LapicRead(uint32_t reg)
+{
+    return *(volatile uint32_t *)(lapicBase + reg);
+}
+
+PRIVATE INLINE void LapicWrite(uint32_t reg, uint32_t value)
+{
+    *(volatile uint32_t *)(lapicBase + reg) = value;
+    /* 读一次，等待写入完成 */
+    LapicRead(LAPIC_ID);
+}
+
+PRIVATE INLINE uint32_t IoApicRead(uint32_t reg)
+{
+    *(volatile uint32_t *)(ioapicBase + IOAPIC_REG_SELECT) = reg;
+    return *(volatile uint32_t *)(ioapicBase + IOAPIC_REG_WINDOW);
+}
+
+PRIVATE INLINE void IoApicWrite(uint32_t reg, uint32_t value)
+{
+    *(volatile uint32_t *)(ioapicBase + IOAPIC_REG_SELECT) = reg;
+    *(volatile uint32_t *)(ioapicBase + IOAPIC_REG_WINDOW) = value;
+}
+
+/**
+ * LapicId - 获取当前处理器的APIC ID
+ */
+PUBLIC unsigned int LapicId()
+{
+    return LapicRead(LAPIC_ID) >> 24;
+}
+
+/**
+ * LapicEoi - 中断处理结束
+ */
+PUBLIC void LapicEoi()
+{
+    LapicWrite(LAPIC_EOI, 0);
+}
+
+/**
+ * LapicSendIpi - 发送处理器间中断
+ * @apicId: 目标处理器的APIC ID
+ * @icr: 中断命令
+ */
+PUBLIC void LapicSendIpi(unsigned int apicId, unsigned int icr)
+{
+    /* 等待上一个中断发送完成 */
+    while (LapicRead(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+        CpuNop();
+
+    LapicWrite(LAPIC_ICR_HIGH, apicId << 24);
+    LapicWrite(LAPIC_ICR_LOW, icr);
+
+    while (LapicRead(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)
+        CpuNop();
+}
+
+/**
+ * LapicInit - 初始化当前处理器的本地APIC
+ * @bsp: 是否是引导处理器
+ *
+ * 设备中断都通过IOAPIC发送，应用处理器的LINT0都屏蔽掉
+ */
+PUBLIC void LapicInit(int bsp)
+{
+    /* 打开APIC，设置伪中断向量 */
+    LapicWrite(LAPIC_SVR, LAPIC_SVR_ENABLE | APIC_SPURIOUS_VECTOR);
+
+    /* 先屏蔽定时器，需要的时候再打开 */
+    LapicWrite(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    /* 切换到IOAPIC之前，引导处理器还要通过LINT0接收pic的中断 */
+    if (bsp) {
+        LapicWrite(LAPIC_LVT_LINT0, LAPIC_LVT_EXTINT);
+        LapicWrite(LAPIC_LVT_LINT1, LAPIC_LVT_NMI);
+    } else {
+        LapicWrite(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+        LapicWrite(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+    }
+
+    LapicWrite(LAPIC_LVT_ERROR, APIC_ERROR_VECTOR);
+
+    /* 清除错误状态，需要写两次 */
+    LapicWrite(LAPIC_ESR, 0);
+    LapicWrite(LAPIC_ESR, 0);
+
+    /* 清除可能存在的中断 */
+    LapicEoi();
+
+    /* 接收所有中断 */
+    LapicWrite(LAPIC_TPR, 0);
+}
+
+/**
+ * LapicTimerCalibrate - 校准本地APIC定时器
+ *
+ * 在引导处理器上执行，需要打开中断，用pit的时钟节拍来测量定时器的频率
+ * 返回每个时钟节拍对应的计数
+ */
+PUBLIC int LapicTimerCalibrate()
+{
+    clock_t start;
+
+    LapicWrite(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    LapicWrite(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+
+    /* 等待一个新的时钟节拍开始 */
+    start = systicks;
+    while (systicks == start)
+        CpuNop();
+
+    LapicWrite(LAPIC_TIMER_INIT, 0xffffffff);
+
+    start = systicks;
+    while (systicks - start < LAPIC_CALIBRATE_TICKS)
+        CpuNop();
+
+    lapicTimerCount = (0xffffffff - LapicRead(LAPIC_TIMER_CURRENT)) / LAPIC_CALIBRATE_TICKS;
+
+    LapicWrite(LAPIC_TIMER_INIT, 0);
+    return lapicTimerCount;
+}
+
+/**
+ * LapicTimerSetPeriodic - 让本地APIC定时器周期触发
+ * @dev: 设备
+ *
+ * 以和pit相同的频率周期性地产生时钟中断
+ */
+PRIVATE void LapicTimerSetPeriodic(struct ClockEventDevice *dev)
+{
+    LapicWrite(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    LapicWrite(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | APIC_TIMER_VECTOR);
+    LapicWrite(LAPIC_TIMER_INIT, lapicTimerCount);
+}
+
+/**
+ * LapicTimerSetNextEvent - 设置本地APIC定时器的下一次中断
+ * @delta: 经过多少计数后产生中断
+ * @dev: 设备
+ */
+PRIVATE void LapicTimerSetNextEvent(unsigned long delta, struct ClockEventDevice *dev)
+{
+    LapicWrite(LAPIC_TIMER_DIVIDE, LAPIC_TIMER_DIV16);
+    LapicWrite(LAPIC_LVT_TIMER, APIC_TIMER_VECTOR);
+    LapicWrite(LAPIC_TIMER_INIT, delta);
+}
+
+/**
+ * LapicTimerShutdown - 关闭本地APIC定时器
+ * @dev: 设备
+ */
+PRIVATE void LapicTimerShutdown(struct ClockEventDevice *dev)
+{
+    LapicWrite(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    LapicWrite(LAPIC_TIMER_INIT, 0);
+}
+
+/**
+ * LapicClockEventInit - 把本地APIC定时器注册成时钟事件设备
+ * @cpu: 处理器编号
+ *
+ * 需要先校准定时器，在对应的处理器上执行。
+ * 本地APIC定时器比pit更好，而且可以单次触发
+ */
+PUBLIC void LapicClockEventInit(int cpu)
+{
+    struct ClockEventDevice *dev = &lapicClockEvents[cpu];
+    unsigned long long mult;
+
+    if (!lapicTimerCount)
+        return;
+
+    /* 计数 = (纳秒 * mult) >> 32 */
+    mult = (unsigned long long)lapicTimerCount << 32;
+    DivU64(&mult, TICK_NSEC);
+
+    dev->name = "lapic";
+    dev->features = CLOCK_EVT_FEAT_PERIODIC | CLOCK_EVT_FEAT_ONESHOT;
+    dev->rating = 300;
+    dev->mult = mult;
+    dev->minDelta = 1;
+    dev->maxDelta = 0x7fffffff;
+    dev->setPeriodic = LapicTimerSetPeriodic;
+    dev->setNextEvent = LapicTimerSetNextEvent;
+    dev->shutdown = LapicTimerShutdown;
+
+    ClockEventRegister(cpu, dev);
+}
+
+/**
+ * InitLapic - 初始化本地APIC
+ * @phyAddr: 本地APIC的物理地址
+ *
+ * 映射APIC的寄存器，并初始化引导处理器的本地APIC
+ */
+PUBLIC int InitLapic(unsigned long phyAddr)
+{
+    lapicBase = IoRemap(phyAddr, PAGE_SIZE);
+    if (lapicBase == NULL) {
+        printk(PART_ERROR "apic: remap local apic failed!\n");
+        return -1;
+    }
+
+    bspApicId = LapicId();
+    LapicInit(1);
+
+    return 0;
+}
+
+/**
+ * IoApicSetRoute - 设置中断对应的IOAPIC引脚
+ * @irq: 中断号
+ * @pin: IOAPIC的引脚
+ * @redir: 极性和触发方式
+ *
+ * 根据MP表中的中断项来设置，没有设置的中断使用相同号码的引脚
+ */
+PUBLIC void IoApicSetRoute(unsigned int irq, unsigned int pin, unsigned int redir)
+{
+    if (irq >= NR_IRQS)
+        return;
+
+    ioapicRoute[irq].pin = pin;
+    ioapicRoute[irq].redir = redir;
+}
+
+/**
+ * IoApicEnableIrq - 打开中断
+ * irq: 中断irq号
+ *
+ * 中断向量和pic保持一致，发送给引导处理器
+ */
+PRIVATE void IoApicEnableIrq(unsigned int irq)
+{
+    struct IoApicRoute *route = &ioapicRoute[irq];
+
+    IoApicWrite(IOAPIC_REDIR_TABLE(route->pin) + 1, bspApicId << 24);
+    IoApicWrite(IOAPIC_REDIR_TABLE(route->pin), route->redir | (IDT_IRQ_START + irq));
+}
+
+/**
+ * IoApicDisableIrq - 关闭中断
+ * irq: 中断irq号
+ */
+PRIVATE void IoApicDisableIrq(unsigned int irq)
+{
+    struct IoApicRoute *route = &ioapicRoute[irq];
+
+    IoApicWrite(IOAPIC_REDIR_TABLE(route->pin), IOAPIC_REDIR_MASKED);
+}
+
+/**
+ * IoApicInstall - 安装一个中断
+ *
+ * 中断通过DoIRQ处理，不需要额外的操作
+ */
+PRIVATE unsigned int IoApicInstall(unsigned int irq, void * arg)
+{
+	return 1;
+}
+
+PRIVATE void IoApicUninstall(unsigned int irq)
+{
+}
+
+/**
+ * IoApicAck - 应答中断
+ *
+ * 电平触发的中断也是在本地APIC EOI时通知IOAPIC
+ */
+PRIVATE void IoApicAck(unsigned int irq)
+{
+    LapicEoi();
+}
+
+/* ioapic硬件中断控制方法 */
+PRIVATE struct HardwareIntController ioapicHardwareIntContorller = {
+    .install = IoApicInstall,
+	.uninstall = IoApicUninstall,
+	.enable = IoApicEnableIrq,
+	.disable = IoApicDisableIrq,
+	.ack = IoApicAck,
+};
+
+/**
+ * InitIoApic - 初始化IOAPIC
+ * @phyAddr: IOAPIC的物理地址
+ *
+ * 屏蔽所有的引脚，等待切换控制器时再打开
+ */
+PUBLIC int InitIoApic(unsigned long phyAddr)
+{
+    int i, pins;
+
+    ioapicBase = IoRemap(phyAddr, PAGE_SIZE);
+    if (ioapicBase == NULL) {
+        printk(PART_ERROR "apic: remap io apic failed!\n");
+        return -1;
+    }
+
+    /* 最大重定向项在版本寄存器的16~23位 */
+    pins = ((IoApicRead(IOAPIC_VERSION) >> 16) & 0xff) + 1;
+    for (i = 0; i < pins; i++) {
+        IoApicWrite(IOAPIC_REDIR_TABLE(i), IOAPIC_REDIR_MASKED);
+    }
+
+    /* 默认ISA中断对应相同号码的引脚，高电平边沿触发 */
+    for (i = 0; i < NR_IRQS; i++) {
+        ioapicRoute[i].pin = i;
+        ioapicRoute[i].redir = 0;
+    }
+    return 0;
+}
+
+/**
+ * IoApicEnable - 把中断控制器从pic切换到IOAPIC
+ *
+ * 已经注册的中断会迁移到IOAPIC上，然后屏蔽pic的所有中断
+ */
+PUBLIC void IoApicEnable()
+{
+    SetIrqController(&ioapicHardwareIntContorller);
+
+	Out8(PIC0_IMR,  0xff);
+	Out8(PIC1_IMR,  0xff);
+
+    /* 不再从LINT0接收pic的中断 */
+    LapicWrite(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+}
+
+/**
+ * LapicTimerHandler - 本地APIC定时器中断处理
+ *
+ * 交给时钟事件层处理时钟节拍和高精度定时器
+ */
+PRIVATE void LapicTimerHandler(uint32_t esp)
+{
+    struct ClockEventDevice *dev = &lapicClockEvents[CurrentCpuId()];
+
+    LapicEoi();
+    if (dev->eventHandler)
+        dev->eventHandler(dev);
+}
+
+/**
+ * LapicReschedHandler - 调度中断处理
+ *
+ * 其它处理器往自己的就绪队列添加任务后发送过来
+ */
+PRIVATE void LapicReschedHandler(uint32_t esp)
+{
+    LapicEoi();
+    ActiveSoftirq(RESCHED_SOFTIRQ);
+}
+
+/**
+ * LapicTlbFlushHandler - 刷新TLB中断处理
+ *
+ * 由入口直接调用，不获取大内核锁，因为发送者持有锁在等待我们刷新
+ */
+PUBLIC void LapicTlbFlushHandler()
+{
+    SmpTlbFlushPoll();
+    LapicEoi();
+}
+
+PRIVATE void LapicErrorHandler(uint32_t esp)
+{
+    LapicWrite(LAPIC_ESR, 0);
+    printk(PART_WARRING "apic: cpu %d error %x\n", LapicId(), LapicRead(LAPIC_ESR));
+    LapicEoi();
+}
+
+/**
+ * LapicSpuriousHandler - 伪中断处理
+ *
+ * 伪中断不需要EOI
+ */
+PRIVATE void LapicSpuriousHandler(uint32_t esp)
+{
+}
+
+/**
+ * InitApicHandlers - 注册APIC的中断处理
+ */
+PUBLIC void InitApicHandlers()
+{
+    InterruptRegisterHandler(APIC_TIMER_VECTOR, LapicTimerHandler);
+    InterruptRegisterHandler(APIC_RESCHED_VECTOR, LapicReschedHandler);
+    InterruptRegisterHandler(APIC_ERROR_VECTOR, LapicErrorHandler);
+    InterruptRegisterHandler(APIC_SPURIOUS_VECTOR, LapicSpuriousHandler);
+}
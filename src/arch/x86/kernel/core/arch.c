@@ -9,6 +9,7 @@
 #include <kernel/segment.h>
 #include <kernel/gate.h>
 #include <kernel/tss.h>
+#include <kernel/x86.h>
 #include <mm/phymem.h>
 #include <mm/bootmem.h>
 #include <book/debug.h>
@@ -35,6 +36,9 @@ int InitArch()
 
 	// 初始化物理内存管理
 	InitPhysicMemory();
+
+	/* 打开写保护，内核写fork后共享的用户页时也要写时复制 */
+	WriteCR0(ReadCR0() | CR0_WP);
     
 	return 0;
 }
@@ -52,3 +52,14 @@ PUBLIC unsigned int CMOS_GetYear()
 	return (BCD_HEX(ReadCMOS(CMOS_CUR_CEN))*100) + \
 		BCD_HEX(ReadCMOS(CMOS_CUR_YEAR))+1980;
 }
+
+/**
+ * CMOS_WaitUpdate - 等待CMOS的下一次时间更新
+ * 
+ * 状态寄存器A的UIP位从1变成0时，秒数刚刚更新，每秒发生一次
+ */
+PUBLIC void CMOS_WaitUpdate()
+{
+	while (!(ReadCMOS(CMOS_STATUS_A) & CMOS_UIP));
+	while (ReadCMOS(CMOS_STATUS_A) & CMOS_UIP);
+}
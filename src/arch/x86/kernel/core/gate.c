@@ -89,6 +89,12 @@ EXTERN void InterruptEntry0x2d();
 EXTERN void InterruptEntry0x2e();
 EXTERN void InterruptEntry0x2f();
 
+EXTERN void ApicInterruptEntry0x30();
+EXTERN void ApicInterruptEntry0x31();
+EXTERN void ApicInterruptEntry0x32();
+EXTERN void ApicInterruptEntry0x3e();
+EXTERN void ApicInterruptEntry0x3f();
+
 EXTERN void SyscallHandler();
 
 PRIVATE void InitInterruptDescriptor()
@@ -159,6 +165,15 @@ PRIVATE void InitInterruptDescriptor()
 	SetGateDescriptor(&idt[0x2e], InterruptEntry0x2e, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
 	SetGateDescriptor(&idt[0x2f], InterruptEntry0x2f, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
 	
+	/*
+	 本地APIC的中断入口
+	 */
+	SetGateDescriptor(&idt[0x30], ApicInterruptEntry0x30, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
+	SetGateDescriptor(&idt[0x31], ApicInterruptEntry0x31, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
+	SetGateDescriptor(&idt[0x32], ApicInterruptEntry0x32, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
+	SetGateDescriptor(&idt[0x3e], ApicInterruptEntry0x3e, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
+	SetGateDescriptor(&idt[0x3f], ApicInterruptEntry0x3f, KERNEL_CODE_SEL, DA_386IGate, DA_GATE_DPL0); 
+	
 	/*
 	 系统调用的中断入口
 	 */
@@ -11,6 +11,9 @@ extern interruptHandlerTable
 extern DoIRQ		 
 extern DoSoftirq		 
 extern DoSignal
+extern KernelLock
+extern KernelUnlock
+extern LapicTlbFlushHandler
 
 [bits 32]
 [section .text]
@@ -63,6 +66,29 @@ INTERRUPT_ENTRY 0x2c,NO_ERROR_CODE	;ps/2鼠标
 INTERRUPT_ENTRY 0x2d,NO_ERROR_CODE	;fpu浮点单元异常
 INTERRUPT_ENTRY 0x2e,NO_ERROR_CODE	;硬盘
 INTERRUPT_ENTRY 0x2f,NO_ERROR_CODE	;保留
+APIC_INTERRUPT_ENTRY 0x30,NO_ERROR_CODE	;本地APIC定时器
+APIC_INTERRUPT_ENTRY 0x31,NO_ERROR_CODE	;处理器间调度中断
+APIC_INTERRUPT_ENTRY 0x3e,NO_ERROR_CODE	;本地APIC错误
+APIC_INTERRUPT_ENTRY 0x3f,NO_ERROR_CODE	;本地APIC伪中断
+
+;处理器间刷新TLB中断，发送者持有大内核锁在等待应答，所以这里不能获取锁，
+;只刷新TLB，不处理软中断和信号
+global ApicInterruptEntry0x32
+ApicInterruptEntry0x32:
+    push ds
+    push es
+    pushad
+
+    mov dx,ss
+	mov ds, dx
+	mov es, dx
+
+    call LapicTlbFlushHandler
+
+    popad
+    pop es
+    pop ds
+    iretd
 
 
 ;系统调用中断
@@ -88,6 +114,13 @@ SyscallHandler:
 	mov ds, dx
 	mov es, dx
     
+    ; 进入内核，获取大内核锁，保留系统调用号和参数
+    push eax
+    push ecx
+    call KernelLock
+    pop ecx
+    pop eax
+
    	push 0x80			; 此位置压入0x80也是为了保持统一的栈格式
     
     push eax        ; 保存eax
@@ -134,6 +167,7 @@ global InterruptExit
 ;    mov esp, [esp + 4]  ; process stack
 ;    jmp $
 InterruptExit:
+    call KernelUnlock      ; 离开内核，释放大内核锁
 ; 以下是恢复上下文环境
     add esp, 4			   ; 跳过中断号
     popad
@@ -146,6 +180,7 @@ InterruptExit:
     
 SwitchToUser:
     mov esp, [esp + 4]  ; process stack
+    call KernelUnlock   ; 离开内核，释放大内核锁
 ; 以下是恢复上下文环境
     add esp, 4			   ; 跳过中断号
     popad
@@ -28,7 +28,7 @@ PUBLIC void InitSegmentDescriptor()
 	SetSegmentDescriptor(gdt + INDEX_KERNEL_C, 0xffffffff,   0x00000000, DA_CR | DA_DPL0 | DA_32 | DA_G);
 	SetSegmentDescriptor(gdt + INDEX_KERNEL_RW, 0xffffffff,   0x00000000, DA_DRW | DA_DPL0 | DA_32 | DA_G);
 	// tss 段
-	SetSegmentDescriptor(gdt + INDEX_TSS, sizeof(tss) - 1, (uint32_t )&tss, DA_386TSS);
+	SetSegmentDescriptor(gdt + INDEX_TSS, sizeof(Tss_t) - 1, (uint32_t )&tss[0], DA_386TSS);
 	// 用户代码段和数据段
 	SetSegmentDescriptor(gdt + INDEX_USER_C, 0xffffffff, 0x00000000, DA_CR | DA_DPL3 | DA_32 | DA_G);
 	SetSegmentDescriptor(gdt + INDEX_USER_RW, 0xffffffff, 0x00000000, DA_DRW | DA_DPL3 | DA_32 | DA_G);
@@ -0,0 +1,412 @@
+/*
+ * file:		arch/x86/kernel/core/smp.c
+ * auther:		Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <kernel/smp.h>
+#include <kernel/apic.h>
+#include <kernel/x86.h>
+#include <kernel/const.h>
+#include <kernel/gate.h>
+#include <kernel/segment.h>
+#include <kernel/tss.h>
+#include <kernel/cmos.h>
+#include <kernel/interrupt.h>
+#include <mm/page.h>
+#include <mm/phymem.h>
+#include <book/debug.h>
+#include <book/smp.h>
+#include <book/vmarea.h>
+#include <lib/string.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
+
+/* IMCR寄存器的端口 */
+#define IMCR_INDEX      0x22
+#define IMCR_DATA       0x23
+
+/* MP表中总线的类型 */
+#define MP_BUS_UNKNOWN  0
+#define MP_BUS_ISA      1
+#define MP_BUS_PCI      2
+
+/* 应用处理器的启动代码，在trampoline.asm中 */
+EXTERN void ApTrampolineStart();
+EXTERN void ApTrampolineEnd();
+
+/* 应用处理器启动时使用的栈，trampoline.asm中读取 */
+PUBLIC volatile unsigned long apBootStack;
+
+/* 正在启动的应用处理器 */
+PRIVATE volatile int apBootCpu;
+
+/* 应用处理器已经启动 */
+PRIVATE volatile int apStarted;
+
+/* 每个处理器的APIC ID，0是引导处理器 */
+PRIVATE unsigned char cpuApicId[NR_CPUS];
+
+/* MP表中每条总线的类型 */
+PRIVATE unsigned char mpBusType[256];
+
+/**
+ * MpChecksum - 计算校验和
+ * @addr: 地址
+ * @len: 长度
+ *
+ * 所有字节加起来为0才是正确的
+ */
+PRIVATE unsigned char MpChecksum(void *addr, int len)
+{
+    unsigned char *p = (unsigned char *)addr;
+    unsigned char sum = 0;
+
+    while (len--)
+        sum += *p++;
+    return sum;
+}
+
+/**
+ * MpSearch - 在一段物理内存中查找MP浮点结构
+ * @base: 物理地址
+ * @len: 长度
+ */
+PRIVATE struct MpFloatPointer *MpSearch(unsigned long base, unsigned long len)
+{
+    unsigned char *p = __VA(base);
+    unsigned char *end = p + len;
+
+    for (; p < end; p += sizeof(struct MpFloatPointer)) {
+        if (!memcmp(p, "_MP_", 4) && !MpChecksum(p, sizeof(struct MpFloatPointer)))
+            return (struct MpFloatPointer *)p;
+    }
+    return NULL;
+}
+
+/**
+ * MpFindFloatPointer - 查找MP浮点结构
+ *
+ * 依次在EBDA的第一个1KB，基本内存的最后1KB，BIOS ROM中查找
+ */
+PRIVATE struct MpFloatPointer *MpFindFloatPointer()
+{
+    struct MpFloatPointer *mpf;
+    unsigned long addr;
+
+    /* BIOS数据区0x40E中保存了EBDA的段地址 */
+    addr = *(uint16_t *)__VA(0x40e) << 4;
+    if (addr) {
+        if ((mpf = MpSearch(addr, 1024)) != NULL)
+            return mpf;
+    } else {
+        /* BIOS数据区0x413中保存了基本内存的KB数 */
+        addr = *(uint16_t *)__VA(0x413) * 1024;
+        if ((mpf = MpSearch(addr - 1024, 1024)) != NULL)
+            return mpf;
+    }
+    return MpSearch(0xf0000, 0x10000);
+}
+
+/**
+ * MpEntrySize - 获取配置表项的大小
+ * @type: 表项类型
+ */
+PRIVATE int MpEntrySize(unsigned char type)
+{
+    /* 只有处理器表项是20字节，其它都是8字节 */
+    if (type == MP_ENTRY_PROCESSOR)
+        return sizeof(struct MpProcessor);
+    return 8;
+}
+
+/**
+ * MpIrqRedir - 把MP表中中断的标志转换成IOAPIC的重定向标志
+ * @flags: MP表中的标志
+ * @bus: 中断所在的总线类型
+ *
+ * 标志为0时和总线的规范一致：ISA是高电平边沿触发，PCI是低电平电平触发
+ */
+PRIVATE unsigned int MpIrqRedir(unsigned int flags, int bus)
+{
+    unsigned int redir = 0;
+    unsigned int polarity = flags & MP_IRQ_POLARITY_MASK;
+    unsigned int trigger = flags & MP_IRQ_TRIGGER_MASK;
+
+    if (polarity == MP_IRQ_POLARITY_LOW || (!polarity && bus == MP_BUS_PCI))
+        redir |= IOAPIC_REDIR_LOW;
+    if (trigger == MP_IRQ_TRIGGER_LEVEL || (!trigger && bus == MP_BUS_PCI))
+        redir |= IOAPIC_REDIR_LEVEL;
+    return redir;
+}
+
+/**
+ * MpSetupRoutes - 根据MP表设置IOAPIC的中断路由
+ * @mpc: 配置表
+ * @ioapicId: IOAPIC的ID
+ *
+ * ISA的中断按源irq设置，PCI的中断按引脚号设置，和pci配置空间中的中断线一致
+ */
+PRIVATE void MpSetupRoutes(struct MpConfigTable *mpc, unsigned char ioapicId)
+{
+    unsigned char *p = (unsigned char *)(mpc + 1);
+    struct MpIoInterrupt *intr;
+    unsigned int isaRouted = 0;
+    int i;
+
+    for (i = 0; i < mpc->entryCount; i++, p += MpEntrySize(*p)) {
+        if (*p != MP_ENTRY_IOINTERRUPT)
+            continue;
+
+        intr = (struct MpIoInterrupt *)p;
+        /* 只处理发往这个IOAPIC的普通中断 */
+        if (intr->intType != 0 || (intr->dstApic != ioapicId && intr->dstApic != 0xff))
+            continue;
+
+        if (mpBusType[intr->srcBus] == MP_BUS_ISA) {
+            IoApicSetRoute(intr->srcIrq, intr->dstPin, MpIrqRedir(intr->flags, MP_BUS_ISA));
+            isaRouted |= 1 << intr->srcIrq;
+        } else if (mpBusType[intr->srcBus] == MP_BUS_PCI && intr->dstPin < 16) {
+            /* ISA已经使用的irq不能被覆盖 */
+            if (!(isaRouted & (1 << intr->dstPin)))
+                IoApicSetRoute(intr->dstPin, intr->dstPin, MpIrqRedir(intr->flags, MP_BUS_PCI));
+        }
+    }
+}
+
+/**
+ * ArchInitSmp - 初始化多处理器环境
+ *
+ * 通过MP表找到所有的处理器和IOAPIC，初始化本地APIC和IOAPIC，
+ * 把设备中断切换到IOAPIC上。需要在打开中断后调用
+ * 返回处理器的数量
+ */
+PUBLIC int ArchInitSmp()
+{
+    struct MpFloatPointer *mpf;
+    struct MpConfigTable *mpc;
+    struct MpProcessor *proc;
+    struct MpBus *bus;
+    struct MpIoApic *ioapic;
+    unsigned long ioapicAddr = 0;
+    unsigned char ioapicId = 0;
+    unsigned char *p;
+    int cpuNr = 1, cpuTotal = 0;
+    int i;
+
+    mpf = MpFindFloatPointer();
+    if (mpf == NULL) {
+        printk(PART_TIP "smp: no mp table, uniprocessor\n");
+        return 1;
+    }
+    /* 默认配置没有配置表，按照单处理器来运行 */
+    if (mpf->feature1 || !mpf->configTable) {
+        printk(PART_TIP "smp: default mp configuration, uniprocessor\n");
+        return 1;
+    }
+
+    /* 配置表一般在BIOS区域中，高端的需要映射 */
+    if (mpf->configTable < 0x400000)
+        mpc = __VA(mpf->configTable);
+    else
+        mpc = IoRemap(mpf->configTable, PAGE_SIZE);
+
+    if (mpc == NULL || memcmp(mpc->signature, "PCMP", 4) ||
+            MpChecksum(mpc, mpc->length)) {
+        printk(PART_WARRING "smp: bad mp configuration table!\n");
+        return 1;
+    }
+
+    /* 找出处理器，总线和IOAPIC */
+    p = (unsigned char *)(mpc + 1);
+    for (i = 0; i < mpc->entryCount; i++, p += MpEntrySize(*p)) {
+        switch (*p) {
+        case MP_ENTRY_PROCESSOR:
+            proc = (struct MpProcessor *)p;
+            if (!(proc->flags & MP_PROCESSOR_ENABLED))
+                break;
+            cpuTotal++;
+
+            if (proc->flags & MP_PROCESSOR_BSP)
+                cpuApicId[0] = proc->apicId;
+            else if (cpuNr < NR_CPUS)
+                cpuApicId[cpuNr++] = proc->apicId;
+            break;
+        case MP_ENTRY_BUS:
+            bus = (struct MpBus *)p;
+            if (!memcmp(bus->busType, "ISA", 3))
+                mpBusType[bus->busId] = MP_BUS_ISA;
+            else if (!memcmp(bus->busType, "PCI", 3))
+                mpBusType[bus->busId] = MP_BUS_PCI;
+            break;
+        case MP_ENTRY_IOAPIC:
+            ioapic = (struct MpIoApic *)p;
+            /* 只使用第一个IOAPIC */
+            if ((ioapic->flags & 1) && !ioapicAddr) {
+                ioapicAddr = ioapic->addr;
+                ioapicId = ioapic->apicId;
+            }
+            break;
+        default:
+            break;
+        }
+    }
+
+    /* 没有IOAPIC就无法把中断交给APIC，继续使用pic */
+    if (!ioapicAddr) {
+        printk(PART_WARRING "smp: no io apic found, uniprocessor\n");
+        return 1;
+    }
+
+    if (InitIoApic(ioapicAddr))
+        return 1;
+
+    InitApicHandlers();
+
+    if (InitLapic(mpc->lapicAddr ? mpc->lapicAddr : LAPIC_DEFAULT_ADDR))
+        return 1;
+
+    /* 如果有IMCR，需要把中断从pic切换到APIC */
+    if (mpf->feature2 & MP_FEATURE2_IMCR) {
+        Out8(IMCR_INDEX, 0x70);
+        Out8(IMCR_DATA, 0x01);
+    }
+
+    MpSetupRoutes(mpc, ioapicId);
+
+    /* 切换中断控制器 */
+    unsigned long flags = InterruptSave();
+    IoApicEnable();
+    InterruptRestore(flags);
+
+    /* 校准APIC定时器，之后引导处理器的时钟也换成APIC定时器 */
+    LapicTimerCalibrate();
+    LapicClockEventInit(0);
+
+    printk(PART_TIP "smp: %d cpus, io apic at %x\n", cpuTotal, ioapicAddr);
+    return cpuTotal;
+}
+
+/**
+ * SmpDelay - 等待一段时间
+ * @msec: 毫秒数
+ *
+ * 需要打开中断，以时钟节拍为精度
+ */
+PRIVATE void SmpDelay(unsigned int msec)
+{
+    clock_t ticks = msec * HZ / 1000 + 1;
+    clock_t start = systicks;
+
+    while (systicks - start < ticks)
+        CpuNop();
+}
+
+/**
+ * ArchStartCpu - 启动一个应用处理器
+ * @cpu: 处理器编号
+ * @stackTop: 处理器启动时使用的栈顶
+ *
+ * 通过INIT-SIPI-SIPI序列让应用处理器从trampoline开始运行，
+ * 成功返回0，超时返回-1
+ */
+PUBLIC int ArchStartCpu(int cpu, unsigned long stackTop)
+{
+    unsigned int apicId = cpuApicId[cpu];
+    pde_t *pdt = (pde_t *)PAGE_DIR_VIR_ADDR;
+    clock_t start;
+    int i;
+
+    /* 复制启动代码到低端内存 */
+    memcpy(__VA(AP_TRAMPOLINE_ADDR), ApTrampolineStart,
+        (unsigned long)ApTrampolineEnd - (unsigned long)ApTrampolineStart);
+
+    apBootCpu = cpu;
+    apBootStack = stackTop;
+    apStarted = 0;
+
+    /* 设置热启动向量，有的BIOS在INIT后会通过它跳转 */
+    Out8(CMOS_INDEX, CMOS_SHUTDOWN_STATUS);
+    Out8(CMOS_DATA, CMOS_SHUTDOWN_JMP);
+    *(volatile uint16_t *)__VA(WARM_RESET_VECTOR) = 0;
+    *(volatile uint16_t *)__VA(WARM_RESET_VECTOR + 2) = AP_TRAMPOLINE_ADDR >> 4;
+
+    /* 开启分页的时候trampoline还在低端地址运行，临时映射低端内存 */
+    pdt[0] = pdt[PAGE_OFFSET >> 22];
+    WriteCR3(ReadCR3());
+
+    LapicSendIpi(apicId, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    SmpDelay(10);
+    LapicSendIpi(apicId, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+
+    for (i = 0; i < 2 && !apStarted; i++) {
+        LapicSendIpi(apicId, LAPIC_ICR_STARTUP | LAPIC_ICR_ASSERT |
+            (AP_TRAMPOLINE_ADDR >> 12));
+        SmpDelay(1);
+    }
+
+    start = systicks;
+    while (!apStarted && systicks - start < AP_START_TIMEOUT)
+        CpuNop();
+
+    /* 取消低端内存的映射 */
+    pdt[0] = 0;
+    WriteCR3(ReadCR3());
+
+    return apStarted ? 0 : -1;
+}
+
+/**
+ * ArchSendReschedule - 通知处理器进行调度
+ * @cpu: 处理器编号
+ */
+PUBLIC void ArchSendReschedule(int cpu)
+{
+    LapicSendIpi(cpuApicId[cpu], LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | APIC_RESCHED_VECTOR);
+}
+
+/**
+ * ArchSendTlbFlush - 通知处理器刷新TLB
+ * @cpu: 处理器编号
+ */
+PUBLIC void ArchSendTlbFlush(int cpu)
+{
+    LapicSendIpi(cpuApicId[cpu], LAPIC_ICR_FIXED | LAPIC_ICR_ASSERT | APIC_TLB_VECTOR);
+}
+
+/**
+ * ArchFlushTlb - 刷新当前处理器的TLB
+ *
+ * 重新加载页目录，刷新所有非全局页的TLB
+ */
+PUBLIC void ArchFlushTlb()
+{
+    WriteCR3(ReadCR3());
+}
+
+/**
+ * ApMain - 应用处理器的入口
+ *
+ * trampoline开启分页后跳转到这里，此时运行在idle任务的内核栈上
+ */
+PUBLIC void ApMain()
+{
+    int cpu = apBootCpu;
+
+    /* 使用虚拟地址重新加载描述符表 */
+    LoadGDTR(GDT_LIMIT, GDT_VADDR);
+    LoadIDTR(IDT_LIMIT, IDT_VADDR);
+
+    /* 和引导处理器一样打开写保护 */
+    WriteCR0(ReadCR0() | CR0_WP);
+
+    InitCpuTss(cpu);
+
+    LapicInit(0);
+    LapicClockEventInit(cpu);
+
+    apStarted = 1;
+
+    SmpApStart(cpu);
+}
@@ -0,0 +1,72 @@
+;----
+;file:		arch/x86/kernel/core/trampoline.asm
+;auther:	Jason Hu
+;time:		2020/3/2
+;copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+;----
+%include "kernel/const.inc"
+
+; 应用处理器的启动代码，会被复制到AP_TRAMPOLINE_ADDR处运行，
+; 所以只能使用相对于ApTrampolineStart的地址
+%define TRAMPOLINE_ADDR(x) (AP_TRAMPOLINE_ADDR + (x) - ApTrampolineStart)
+
+extern ApMain
+extern apBootStack
+
+global ApTrampolineStart
+global ApTrampolineEnd
+
+[section .text]
+[bits 16]
+ApTrampolineStart:
+    cli
+    cld
+
+    xor ax, ax
+    mov ds, ax
+    mov es, ax
+    mov ss, ax
+
+    ; 加载内核的GDT，使用物理地址
+    o32 lgdt [TRAMPOLINE_ADDR(ApGdtPtr)]
+
+    ; 进入保护模式
+    mov eax, cr0
+    or eax, 0x00000001
+    mov cr0, eax
+
+    jmp dword 0x08:TRAMPOLINE_ADDR(ApProtectMode)
+
+[bits 32]
+ApProtectMode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; 使用内核的页目录表开启分页
+    mov eax, PAGE_DIR_PHY_ADDR
+    mov cr3, eax
+
+    mov eax, cr0
+    or eax, 0x80000000
+    mov cr0, eax
+
+    ; 已经可以访问内核的虚拟地址了，切换到idle任务的栈
+    mov esp, [apBootStack]
+
+    mov eax, ApMain
+    call eax
+
+.Halt:
+    hlt
+    jmp .Halt
+
+align 8
+ApGdtPtr:
+    dw GDT_LIMIT
+    dd GDT_PHY_ADDR
+
+ApTrampolineEnd:
@@ -0,0 +1,169 @@
+/*
+ * file:		arch/x86/kernel/core/tsc.c
+ * auther:		Jason Hu
+ * time:		2020/3/10
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <kernel/tsc.h>
+#include <kernel/x86.h>
+#include <kernel/cmos.h>
+#include <kernel/intel8253.h>
+#include <kernel/intel8255.h>
+#include <book/config.h>
+#include <book/debug.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <clock/clocksource.h>
+#include <lib/math.h>
+
+/* 用pit校准时测量的毫秒数 */
+#define TSC_CALIBRATE_MS        10
+
+/* pit在TSC_CALIBRATE_MS毫秒内的计数 */
+#define TSC_CALIBRATE_LATCH     (TIMER_FREQ / (1000 / TSC_CALIBRATE_MS))
+
+/* 纳秒 = (周期数 * mult) >> TSC_SHIFT */
+#define TSC_SHIFT               22
+
+/* cpuid 1号功能edx中表示支持tsc的位 */
+#define CPUID_FEAT_TSC          (1 << 4)
+
+/* cpuid 0x80000007号功能edx中表示tsc频率不变的位 */
+#define CPUID_FEAT_INVARIANT_TSC    (1 << 8)
+
+/* ppi端口b中控制pit通道2的位 */
+#define PPI_TIMER2_GATE         0x01
+#define PPI_SPEAKER_DATA        0x02
+#define PPI_TIMER2_OUT          0x20
+
+/**
+ * TscRead - 读取tsc
+ */
+PRIVATE unsigned long long TscRead()
+{
+    return X86Rdtsc();
+}
+
+/* tsc时钟源，频率不变时在空闲和变频时也能正确计时 */
+PRIVATE struct ClockSource tscClockSource = {
+    .name = "tsc",
+    .rating = 300,
+    .flags = CLOCK_SOURCE_CONTINUOUS,
+    .read = TscRead,
+    .shift = TSC_SHIFT,
+};
+
+/**
+ * TscInvariant - 检测tsc的频率是否不变
+ */
+PRIVATE int TscInvariant()
+{
+    unsigned int eax, ebx, ecx, edx;
+
+    X86Cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < 0x80000007)
+        return 0;
+
+    X86Cpuid(0x80000007, &eax, &ebx, &ecx, &edx);
+    return edx & CPUID_FEAT_INVARIANT_TSC;
+}
+
+/**
+ * TscCalibratePit - 用pit的通道2校准tsc
+ *
+ * 通道2工作在模式0，计数到0时输出变成高电平，不需要中断。
+ * 返回每毫秒的周期数，失败返回0
+ */
+PRIVATE unsigned long TscCalibratePit()
+{
+    unsigned long long start, cycles;
+    unsigned long loops = 0;
+
+    /* 打开通道2的门，关闭扬声器 */
+    Out8(PPI_OUTPUT, (In8(PPI_OUTPUT) & ~PPI_SPEAKER_DATA) | PPI_TIMER2_GATE);
+
+    Out8(PIT_CTRL, PIT_MODE_COUNTER_2 | PIT_MODE_MSB_LSB | PIT_MODE_0 | PIT_MODE_BINARY);
+    Out8(PIT_COUNTER2, TSC_CALIBRATE_LATCH & 0xff);
+    Out8(PIT_COUNTER2, TSC_CALIBRATE_LATCH >> 8);
+
+    start = X86Rdtsc();
+    while (!(In8(PPI_OUTPUT) & PPI_TIMER2_OUT))
+        loops++;
+    cycles = X86Rdtsc() - start;
+
+    /* 循环太少说明通道2没有工作 */
+    if (loops < 1000 || (cycles >> 32))
+        return 0;
+
+    return (unsigned long)cycles / TSC_CALIBRATE_MS;
+}
+
+/**
+ * TscCalibrateCmos - 用CMOS的秒更新校准tsc
+ *
+ * pit不可用时使用，需要等待1秒多
+ * 返回每毫秒的周期数，失败返回0
+ */
+PRIVATE unsigned long TscCalibrateCmos()
+{
+    unsigned long long start, cycles;
+
+    CMOS_WaitUpdate();
+    start = X86Rdtsc();
+    CMOS_WaitUpdate();
+    cycles = X86Rdtsc() - start;
+
+    DivU64(&cycles, 1000);
+    if (cycles >> 32)
+        return 0;
+    return (unsigned long)cycles;
+}
+
+/**
+ * InitTsc - 初始化tsc时钟源
+ *
+ * 频率不变的tsc才作为时钟源，否则继续用时钟节拍计时。
+ * 先用pit校准，失败了再用CMOS校准
+ */
+PUBLIC void InitTsc()
+{
+    unsigned int eax, ebx, ecx, edx;
+    unsigned long long mult;
+    unsigned long khz;
+
+    X86Cpuid(1, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_FEAT_TSC)) {
+        printk(PART_WARRING "tsc: not supported\n");
+        return;
+    }
+
+#ifndef CONFIG_TSC_RELIABLE
+    if (!TscInvariant()) {
+        printk(PART_WARRING "tsc: not invariant, keep using clock ticks\n");
+        return;
+    }
+#endif  /* CONFIG_TSC_RELIABLE */
+
+    khz = TscCalibratePit();
+    if (!khz)
+        khz = TscCalibrateCmos();
+    if (!khz) {
+        printk(PART_WARRING "tsc: calibrate failed\n");
+        return;
+    }
+
+    /* 1毫秒的纳秒数除以周期数 */
+    mult = (unsigned long long)(NSEC_PER_SEC / 1000) << TSC_SHIFT;
+    DivU64(&mult, khz);
+    if (!mult || (mult >> 32)) {
+        printk(PART_WARRING "tsc: frequency %d khz out of range\n", khz);
+        return;
+    }
+
+    tscClockSource.mult = mult;
+    tscClockSource.khz = khz;
+    printk(PART_TIP "tsc: %d khz\n", khz);
+
+    ClockSourceRegister(&tscClockSource);
+}
@@ -11,33 +11,59 @@
 #include <book/debug.h>
 #include <lib/string.h>
 #include <book/task.h>
+#include <book/smp.h>
 
-/* tss对象 */
-Tss_t tss;
+/* tss对象，每个处理器一个 */
+Tss_t tss[NR_CPUS];
+
+/* 导入全局描述符表 */
+EXTERN struct SegmentDescriptor *gdt;
 
 PUBLIC void InitTss()
 {
 
-	memset(&tss, 0, sizeof(tss));
+	memset(&tss[0], 0, sizeof(Tss_t));
 	// 内核的内核栈
-	tss.esp0 = KERNEL_STATCK_TOP;
+	tss[0].esp0 = KERNEL_STATCK_TOP;
 	// 内核栈选择子
-	tss.ss0 = KERNEL_DATA_SEL;
+	tss[0].ss0 = KERNEL_DATA_SEL;
 
-	tss.iobase = sizeof(tss);
+	tss[0].iobase = sizeof(Tss_t);
 	// 加载tss register
 	LoadTR(KERNEL_TSS_SEL);
 
 }
 
+/**
+ * InitCpuTss - 初始化应用处理器的tss
+ * @cpu: 处理器编号
+ * 
+ * 在应用处理器上执行，设置好tss段描述符后加载到tr中
+ */
+PUBLIC void InitCpuTss(int cpu)
+{
+	Tss_t *cpuTss = &tss[cpu];
+
+	memset(cpuTss, 0, sizeof(Tss_t));
+	/* 进入用户态前会设置成任务的内核栈顶 */
+	cpuTss->esp0 = 0;
+	cpuTss->ss0 = KERNEL_DATA_SEL;
+	cpuTss->iobase = sizeof(Tss_t);
+
+	SetSegmentDescriptor(gdt + INDEX_CPU_TSS(cpu), sizeof(Tss_t) - 1,
+		(uint32_t )cpuTss, DA_386TSS);
+
+	LoadTR(CPU_TSS_SEL(cpu));
+}
+
 PUBLIC Tss_t *GetTss()
 {
-	return &tss;
+	return &tss[CurrentCpuId()];
 }
 
 PUBLIC void UpdateTssInfo(struct Task *task)
 {
-	// 更新tss.esp0的值为任务的内核栈顶
-	tss.esp0 = (unsigned int)((uint32_t)task + TASK_KSTACK_SIZE);
+	// 更新当前处理器tss.esp0的值为任务的内核栈顶
+	tss[CurrentCpuId()].esp0 = (unsigned int)((uint32_t)task + TASK_KSTACK_SIZE);
 	// printk("task %s update tss esp0\n", task->name);
 }
@@ -16,6 +16,7 @@ global 	Out32
 global	DisableInterrupt
 global 	EnableInterrupt
 global 	CpuHlt
+global 	CpuStiHlt
 global 	LoadTR
 global	ReadCR2
 global	ReadCR3
@@ -34,6 +35,7 @@ global 	x86CpuUD2
 global 	X86Invlpg
 global 	X86Cpuid
 global 	CpuNop
+global 	X86Rdtsc
 
 [section .text]
 [bits 32]
@@ -82,6 +84,10 @@ EnableInterrupt:	; void EnableInterrupt(void);
 CpuHlt: ;void CpuHlt(void);
 	hlt
 	ret
+CpuStiHlt: ;void CpuStiHlt(void);
+	sti				; sti后的一条指令执行完才响应中断，所以不会错过唤醒
+	hlt
+	ret
 LoadTR:		; void LoadTR(uint32_t tr);
 	ltr	[esp+4]			; tr
 	ret
@@ -236,3 +242,7 @@ Xchg32:
 
     pop ebx
     ret
+
+X86Rdtsc:	; uint64_t X86Rdtsc(void);
+	rdtsc				; edx:eax就是64位的返回值
+	ret
@@ -12,7 +12,9 @@
 #include <book/debug.h>
 #include <book/vmspace.h>
 #include <book/task.h>
+#include <book/smp.h>
 #include <book/signal.h>
+#include <book/shm.h>
 #include <lib/stdint.h>
 #include <lib/string.h>
 #include <lib/math.h>
@@ -35,28 +37,28 @@ PUBLIC void *Phy2Vir(unsigned long address)
     return __VA(address);
 }
 
+/**
+ * AllocPages - 分配连续的物理页
+ * @count: 页的数量
+ * 
+ * 从伙伴系统中分配，成功返回物理地址，失败返回0
+ */
 PUBLIC unsigned int AllocPages(unsigned int count)
 {
-    struct MemNode *node = GetFreeMemNode();
+    struct MemNode *node = BuddyAllocNodes(count);
     if (node == NULL)
         return 0;
-    
-    int index = node - memNodeTable;
-
-    /* 如果分配的页数超过范围 */
-    if (index + count > memNodeCount)
-        return 0; 
-
-    /* 第一次分配的时候设置引用为1 */
-    node->reference = 1;
-    node->count = count;
-    node->flags = 0;
-    node->memCache = NULL;
-    node->group = NULL;
 
     return MemNode2Page(node);
 }
 
+/**
+ * FreePages - 释放物理页
+ * @page: 分配时返回的物理地址
+ * 
+ * 物理页被共享时只减少引用计数，最后一个使用者释放时才还给伙伴系统。
+ * 如果不是分配块的第一个页，就什么也不做
+ */
 int FreePages(unsigned int page)
 {
     struct MemNode *node = Page2MemNode(page);
@@ -64,14 +66,41 @@ int FreePages(unsigned int page)
     if (node == NULL)
         return -1;
     
-	if (node->reference) {
-		node->reference = 0;
-		node->count = 0;
-		node->flags = 0;
-		node->memCache = NULL;
-		node->group = NULL;
-		//printk("free page at %x\n", page);
-	}
+    unsigned long flags = InterruptSave();
+    
+    if (node->reference > 1) {
+        node->reference--;
+    } else {
+        BuddyFreeNodes(node);
+    }
+
+    InterruptRestore(flags);
+    return 0;
+}
+
+/**
+ * SharePages - 共享物理页
+ * @page: 分配时返回的物理地址
+ * 
+ * 增加物理页的引用计数，每一次共享都需要对应一次FreePages。
+ * 成功返回0，不是已分配块的第一个页就返回-1
+ */
+PUBLIC int SharePages(unsigned int page)
+{
+    struct MemNode *node = Page2MemNode(page);
+
+    if (node == NULL)
+        return -1;
+    
+    unsigned long flags = InterruptSave();
+
+    if (!node->reference || (node->flags & MEM_NODE_FREE)) {
+        InterruptRestore(flags);
+        return -1;
+    }
+    node->reference++;
+
+    InterruptRestore(flags);
     return 0;
 }
 
@@ -97,8 +126,11 @@ PUBLIC int PageTableAdd(unsigned int virtualAddr,
 			printk("alloc page table failed!\n");
 			return -1;
 		}
-		/* 填写页表 */
-		*pde = pageTableAddr | protect | PAGE_P_1;
+		/* 填写页表，页目录项保持可写，由页表项来控制每个页的读写 */
+		*pde = pageTableAddr | protect | PAGE_RW_W | PAGE_P_1;
+
+		/* 新的页表可能是刚释放的页，要清空旧的页表项 */
+		memset(PageGetPte(virtualAddr & 0xffc00000), 0, PAGE_SIZE);
 	}
 	pte_t *pte = PageGetPte(virtualAddr);
 
@@ -116,31 +148,29 @@ PUBLIC int MapPages(unsigned int start,
     // 长度和页对齐
     len = PAGE_ALIGN(len);
 
-	/* 判断长度是否超过剩余内存大小 */
-    
-    //printk("len %d pages %d\n", len, len / PAGE_SIZE);
-
-	/* 分配物理页 */
-	unsigned int paddr = AllocPages(len / PAGE_SIZE);
-
-	if (!paddr) {
-        printk("map pages get bad bpages!\n");
-        return -1;
-    }
-	
-	//printk("map pages:%x->%x len %x\n", start, paddr, len);
-	
     unsigned int end = start + len;
+    unsigned int paddr, count;
 
 	while (start < end)
 	{
-        //printk("map pages:%x->%x\n", start, paddr);
-		// 对单个页进行链接
-		PageTableAdd(start, paddr, protect);
-		//fill_vir_page_talbe(start, paddr, protect);
+		/* 伙伴系统一次最多分配一个最大阶的块，大的映射要分多次分配 */
+		count = MIN((end - start) / PAGE_SIZE, 1 << (MAX_MEM_NODE_ORDER - 1));
+
+		/* 分配物理页 */
+		paddr = AllocPages(count);
+		if (!paddr) {
+			printk("map pages get bad bpages!\n");
+			return -1;
+		}
 		
-		start += PAGE_SIZE;
-        paddr += PAGE_SIZE;
+		//printk("map pages:%x->%x len %x\n", start, paddr, count * PAGE_SIZE);
+		while (count--) {
+			// 对单个页进行链接
+			PageTableAdd(start, paddr, protect);
+			
+			start += PAGE_SIZE;
+			paddr += PAGE_SIZE;
+		}
 	}
 
 	return 0;
@@ -214,29 +244,30 @@ PUBLIC unsigned int RemoveFromPageTable(unsigned int virtualAddr)
 {
 	pde_t *pde = PageGetPde(virtualAddr);
 	
-	if (!(*pde & PAGE_P_1)) {
-		printk("remove page without pde!\n");
+	// 页表都不存在，就没有物理页
+	if (!(*pde & PAGE_P_1))
 		return 0;
-	}
 
 	pte_t *pte = PageGetPte(virtualAddr);
 	unsigned int physicAddr;
 
 	//printk(PART_TIP "virtual %x pte %x\n", virtualAddr, *pte);
 
+	// 页表项不存在物理页，已经取消过了
+	if (!(*pte & PAGE_P_1))
+		return 0;
+
 	// 去掉属性部分获取物理页地址
 	physicAddr = *pte & PAGE_ADDR_MASK;
 
-	// 如果页表项存在物理页
-	if (*pte & PAGE_P_1) {
-		//printk(PART_TIP "move page %x->%x pte %x\n", virtualAddr, physicAddr, *pte);
+	//printk(PART_TIP "move page %x->%x pte %x\n", virtualAddr, physicAddr, *pte);
 
-		// 清除页表项的存在位，相当于删除物理页
-		*pte &= ~PAGE_P_1;
+	// 清除页表项的存在位，相当于删除物理页
+	*pte &= ~PAGE_P_1;
+
+	//更新tlb，把这个虚拟地址从页高速缓存中移除
+	X86Invlpg(virtualAddr);
 
-		//更新tlb，把这个虚拟地址从页高速缓存中移除
-		X86Invlpg(virtualAddr);
-	}
 	// 返回物理页地址
 	return physicAddr;
 }
@@ -257,20 +288,18 @@ PUBLIC int UnmapPages(unsigned int vaddr, unsigned int len)
 	unsigned int end = vaddr + len;
 	unsigned int paddr;
 
-	paddr = Vir2PhyByTable(vaddr);
-
-	// 释放物理页
-	FreePages(paddr);
-
-	//printk("unmap pages:%x->%x len %x\n", vaddr, paddr, len);
+	//printk("unmap pages:%x len %x\n", vaddr, len);
 	while (vaddr < end)
 	{
 		//printk(">>>");
-		RemoveFromPageTable(vaddr);
-       	//clean_vir_page_table(vaddr);
-		
-		//更新tlb，把这个虚拟地址从页高速缓存中移除
-		X86Invlpg(vaddr);
+		paddr = RemoveFromPageTable(vaddr);
+
+		/* 映射时可能分了多次分配，所以每个页都尝试释放，
+		只有分配块的第一个页才会真正释放。其它线程不再使用这个页才能释放 */
+		if (paddr != 0) {
+			SmpFlushTlbOthers(CurrentTask()->mm);
+			FreePages(paddr);
+		}
 
 		vaddr += PAGE_SIZE;
 	}
@@ -342,6 +371,12 @@ PUBLIC int UnmapPagesFragment(unsigned int vaddr, unsigned int len)
 	unsigned int paddr;
 	while (vaddr < end)
 	{
+		/* 没有页表的区域直接跳过整个页表覆盖的范围 */
+		if (!(*PageGetPde(vaddr) & PAGE_P_1)) {
+			vaddr = (vaddr & 0xffc00000) + PAGE_SIZE * PAGE_ENTRY_NR;
+			continue;
+		}
+
 		paddr = RemoveFromPageTable(vaddr);
 
 		/* 检测每一个页的时候，尝试释放页
@@ -387,6 +422,63 @@ PRIVATE int MakePteWrite(unsigned int addr)
 	
 	/* 标记写属性 */
 	*pte |= PAGE_RW_W;
+	X86Invlpg(addr);
+	return 0;
+}
+
+/* 写时复制时中转页数据的缓冲区 */
+PRIVATE unsigned char copyOnWriteBuffer[PAGE_SIZE];
+
+/**
+ * DoCopyOnWrite - 写时复制
+ * @addr: 发生写故障的虚拟地址
+ * 
+ * fork之后父子进程共享只读的物理页，谁先写就给谁复制一份。
+ * 如果物理页只剩自己在使用，就不用复制，直接恢复写属性。
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int DoCopyOnWrite(address_t addr)
+{
+	pde_t *pde = PageGetPde(addr);
+	pte_t *pte = PageGetPte(addr);
+
+	if (!(*pde & PAGE_P_1) || !(*pte & PAGE_P_1))
+		return -1;
+	
+	addr &= PAGE_MASK;
+
+	unsigned int paddr = *pte & PAGE_ADDR_MASK;
+	struct MemNode *node = Page2MemNode(paddr);
+	if (node == NULL)
+		return -1;
+
+	unsigned long flags = InterruptSave();
+
+	/* 只有自己在使用，就不需要复制 */
+	if (node->reference <= 1) {
+		InterruptRestore(flags);
+		return MakePteWrite(addr);
+	}
+
+	unsigned int newPage = AllocPage();
+	if (!newPage) {
+		InterruptRestore(flags);
+		return -1;
+	}
+
+	/* 先把数据读出来，再把虚拟地址链接到新的页，最后写回去 */
+	memcpy(copyOnWriteBuffer, (void *)addr, PAGE_SIZE);
+
+	*pte = newPage | (*pte & ~PAGE_ADDR_MASK) | PAGE_RW_W;
+	X86Invlpg(addr);
+
+	memcpy((void *)addr, copyOnWriteBuffer, PAGE_SIZE);
+
+	/* 不再使用原来的页，减少它的共享计数，其它线程的TLB也要指向新的页 */
+	SmpFlushTlbOthers(CurrentTask()->mm);
+	FreePages(paddr);
+	
+	InterruptRestore(flags);
 	return 0;
 }
 
@@ -405,14 +497,41 @@ PRIVATE int DoVMAreaFault(uint32_t addr)
 	return 0;
 }
 
+/**
+ * DoHandleShmPage - 链接共享内存对象的页
+ * @space: 共享内存空间
+ * @addr: 页地址
+ * 
+ * 不分配新的页，直接链接对象的物理页，没有写保护的空间不能写
+ */
+PRIVATE int DoHandleShmPage(struct VMSpace *space, uint32_t addr)
+{
+	unsigned int paddr = ShmSharePage(space->shm, (addr - space->shmStart) / PAGE_SIZE);
+	if (!paddr)
+		return -1;
+
+	if (PageTableAdd(addr, paddr, PAGE_US_U | 
+			((space->pageProt & PROT_WRITE) ? PAGE_RW_W : PAGE_RW_R))) {
+		printk(PART_TIP "PageTableAdd: vaddr %x paddr %x failed!\n", addr, paddr);
+		FreePages(paddr);
+		return -1;
+	}
+	return 0;
+}
+
 /**
  * DoHandleNoPage - 处理没有物理页
+ * @space: 地址所在的空间
  * @addr: 虚拟地址
  * 
- * 执行完后虚拟地址就可以访问了
+ * 执行完后虚拟地址就可以访问了，有文件映射的空间会从文件读取页的数据
  */
-PRIVATE int DoHandleNoPage(uint32_t addr)
+PRIVATE int DoHandleNoPage(struct VMSpace *space, uint32_t addr)
 {
+	if (space->shm != NULL)
+		return DoHandleShmPage(space, addr & PAGE_MASK);
+
+
 	// 分配一个物理页
 	unsigned int paddr = AllocPage();
 	if (!paddr) {
@@ -427,6 +546,12 @@ PRIVATE int DoHandleNoPage(uint32_t addr)
 		return -1;	
 	}
 	//printk(PART_TIP "alloc and map pages\n");
+
+	/* 按需加载程序段，读取失败的页已经映射，只能结束进程 */
+	if (space->fileMap != NULL && FillVMSpacePage(space, addr)) {
+		ForceSignal(SIGBUS, SysGetPid());
+		return -1;
+	}
 	return 0;
 }
 
@@ -440,25 +565,14 @@ PRIVATE int DoProtectionFault(struct VMSpace* space, address_t addr, uint32_t wr
 {
     //printk(PART_TIP "handle protection fault, addr: %x\n", addr);
 
-	/* 没有写标志，说明该段内存不支持内存写入，就直接返回吧 */
-	if (write) {
-		printk(PART_TIP "have write protection\n");
-		
-		/* 只有设置写属性正确才能返回 */
-		int ret = MakePteWrite(addr);
-		if (ret)
-			return -1;
-		
-		/* 虽然写入的写标志，但是还是会出现缺页故障，在此则处理一下缺页 */
-		if (DoHandleNoPage(addr))
-			return -1; 
-
-		return 0;
-	} else {
-		printk(PART_TIP "no write protection\n");
-		
+	/* 可写空间中写只读的页，是fork后共享的页，进行写时复制。
+	空间本身没有写权限时是非法写入，不能恢复写属性。
+	共享内存的页本来就是共享的，只读的是没有写保护的空间 */
+	if (write && space->shm == NULL && (space->pageProt & PROT_WRITE)) {
+		if (!DoCopyOnWrite(addr))
+			return 0;
 	}
-    printk(PART_ERROR "# protection fault!\n");
+    printk(PART_ERROR "# protection fault, addr: %x!\n", addr);
     ForceSignal(SIGSEGV, SysGetPid());
 	//Panic(PART_ERROR "# protection fault!\n");
     
@@ -573,10 +687,7 @@ PUBLIC int DoPageFault(struct TrapFrame *frame)
 		/* 如果是保护故障 */
 		if (frame->errorCode & PAGE_ERR_PROTECT) {
 			//printk(PART_TIP "it is protection\n");
-
-			printk(PART_TIP "cs %x eip %x esp %x\n", frame->cs, frame->eip, frame->esp);
-			DumpTrapFrame(frame);
-                
+			//printk(PART_TIP "cs %x eip %x esp %x\n", frame->cs, frame->eip, frame->esp);
             //Panic("DoProtectionFault");
 			/* 执行保护故障操作 */
 			return DoProtectionFault(space, addr, (uint32_t)(frame->errorCode & PAGE_ERR_WRITE));
@@ -588,7 +699,7 @@ PUBLIC int DoPageFault(struct TrapFrame *frame)
 		 */
 		//printk(PART_TIP "handle no page, addr: %x\n", addr);
 
-		if (DoHandleNoPage(addr))
+		if (DoHandleNoPage(space, addr))
 			return -1; 
         
     }
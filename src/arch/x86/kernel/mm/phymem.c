@@ -27,6 +27,12 @@ unsigned int memNodeBase;
 
 /* 物理内存总大小 */
 PRIVATE unsigned int totalPhysicMemorySize;
+
+/* 伙伴系统每一阶的空闲区域 */
+PRIVATE struct FreeArea freeAreaTable[MAX_MEM_NODE_ORDER];
+
+/* 伙伴系统中空闲的节点数量 */
+PRIVATE unsigned int freeNodeCount;
     
 
 /*
@@ -119,24 +125,183 @@ PRIVATE int MapDirectMemory(unsigned int start, unsigned int end)
 	return 0;
 }
 
-PUBLIC struct MemNode *GetFreeMemNode()
+/**
+ * BuddyAddBlock - 把一个空闲块挂到空闲区域
+ * @node: 块的头节点
+ * @order: 块的阶
+ */
+PRIVATE INLINE void BuddyAddBlock(struct MemNode *node, unsigned int order)
 {
-    struct MemNode *node = memNodeTable;
-    
-    while (node < memNodeTable + memNodeCount)
-    {
-        /* 没有被分配就是我们需要的 */
-        if (!node->reference) {
-            return node;
-        }
-        /* 指向下一个节点位置 */
-        if (node->count) 
-            node += node->count;
-        else 
-            node++;
+    node->count = 1 << order;
+    node->flags = MEM_NODE_FREE;
+    node->reference = 0;
+    ListAdd(&node->list, &freeAreaTable[order].freeList);
+    freeAreaTable[order].blocks++;
+}
+
+/**
+ * BuddyDelBlock - 把一个空闲块从空闲区域摘下
+ * @node: 块的头节点
+ * @order: 块的阶
+ */
+PRIVATE INLINE void BuddyDelBlock(struct MemNode *node, unsigned int order)
+{
+    ListDel(&node->list);
+    freeAreaTable[order].blocks--;
+    node->count = 0;
+    node->flags = 0;
+}
+
+/**
+ * BuddyFreeBlock - 释放一个块，并尽可能和伙伴合并
+ * @index: 块的第一个节点的索引，必须和2^order对齐
+ * @order: 块的阶
+ * 
+ * 每一次合并后阶数加1，最多合并到最大阶，所以是O(log n)
+ */
+PRIVATE void BuddyFreeBlock(unsigned int index, unsigned int order)
+{
+    struct MemNode *buddy;
+    unsigned int buddyIndex;
+
+    while (order < MAX_MEM_NODE_ORDER - 1) {
+        buddyIndex = index ^ (1 << order);
+        if (buddyIndex >= memNodeCount)
+            break;
+        
+        buddy = memNodeTable + buddyIndex;
+        /* 伙伴必须是同一阶的空闲块才能合并 */
+        if (!(buddy->flags & MEM_NODE_FREE) || buddy->count != (1 << order))
+            break;
+        
+        BuddyDelBlock(buddy, order);
+
+        /* 合并后的块从两者中较小的索引开始 */
+        index &= buddyIndex;
+        order++;
+    }
+    BuddyAddBlock(memNodeTable + index, order);
+}
+
+/**
+ * BuddyFreeRange - 释放一段连续的节点
+ * @index: 第一个节点的索引
+ * @count: 节点数量
+ * 
+ * 把范围拆分成和自身大小对齐的2的幂次块，再逐个释放
+ */
+PRIVATE void BuddyFreeRange(unsigned int index, unsigned int count)
+{
+    unsigned int order;
+
+    freeNodeCount += count;
+    while (count) {
+        /* 找到从index开始，能放下的最大对齐块 */
+        order = 0;
+        while (order < MAX_MEM_NODE_ORDER - 1 && 
+            !(index & (1 << order)) && (2 << order) <= count)
+            order++;
+
+        BuddyFreeBlock(index, order);
         
+        index += 1 << order;
+        count -= 1 << order;
     }
-    return NULL;
+}
+
+/**
+ * BuddyAllocNodes - 从伙伴系统分配连续的节点
+ * @count: 节点数量（页数）
+ * 
+ * 找到满足大小的最小阶的空闲块，把多余的部分还给伙伴系统，
+ * 所以分配出去的正好是count个页。
+ * 成功返回头节点，失败返回NULL
+ */
+PUBLIC struct MemNode *BuddyAllocNodes(unsigned int count)
+{
+    struct MemNode *node;
+    unsigned int order, current, index;
+
+    if (!count)
+        return NULL;
+
+    /* 计算满足大小的阶 */
+    order = 0;
+    while ((1 << order) < count)
+        order++;
+    
+    if (order >= MAX_MEM_NODE_ORDER)
+        return NULL;
+    
+    unsigned long flags = InterruptSave();
+
+    /* 从需要的阶开始往上找一个非空的空闲链表 */
+    current = order;
+    while (current < MAX_MEM_NODE_ORDER && 
+        ListEmpty(&freeAreaTable[current].freeList))
+        current++;
+    
+    if (current >= MAX_MEM_NODE_ORDER) {
+        InterruptRestore(flags);
+        return NULL;
+    }
+    
+    node = ListFirstOwner(&freeAreaTable[current].freeList, struct MemNode, list);
+    BuddyDelBlock(node, current);
+
+    /* 把大块对半拆分，后一半挂回低一阶的空闲链表 */
+    while (current > order) {
+        current--;
+        BuddyAddBlock(node + (1 << current), current);
+    }
+    
+    /* 2^order中多出来的尾部也还回去 */
+    index = node - memNodeTable;
+    if (count < (1 << order)) {
+        BuddyFreeRange(index + count, (1 << order) - count);
+    }
+    freeNodeCount -= 1 << order;
+
+    /* 第一次分配的时候设置引用为1 */
+    node->reference = 1;
+    node->count = count;
+    node->flags = 0;
+    node->memCache = NULL;
+    node->group = NULL;
+
+    InterruptRestore(flags);
+    return node;
+}
+
+/**
+ * BuddyFreeNodes - 把分配的节点还给伙伴系统
+ * @node: 分配时返回的头节点
+ * 
+ * 不是已分配块的头节点就不释放，返回-1，成功返回0
+ */
+PUBLIC int BuddyFreeNodes(struct MemNode *node)
+{
+    unsigned int count;
+
+    unsigned long flags = InterruptSave();
+
+    if (!node->reference || (node->flags & MEM_NODE_FREE)) {
+        InterruptRestore(flags);
+        return -1;
+    }
+    
+    count = node->count;
+
+    node->reference = 0;
+    node->count = 0;
+    node->flags = 0;
+    node->memCache = NULL;
+    node->group = NULL;
+
+    BuddyFreeRange(node - memNodeTable, count);
+
+    InterruptRestore(flags);
+    return 0;
 }
 
 PUBLIC struct MemNode *Page2MemNode(unsigned int page)
@@ -172,18 +337,120 @@ PUBLIC void DumpMemNode(struct MemNode *node)
 }
 
 /* 
- * ZoneCutUesdMemory - 把已经使用的内存剪掉
+ * InitBuddySystem - 初始化伙伴系统
  * 
- * 因为内存管理器本身要占用一定内存，在这里把它从可分配中去掉
+ * 因为内存管理器本身要占用一定内存，在这里把它从可分配中去掉，
+ * 剩下的节点全部作为空闲块交给伙伴系统
  */
-PRIVATE void CutUesdMemory()
+PRIVATE void InitBuddySystem()
 {
+    int i;
+    for (i = 0; i < MAX_MEM_NODE_ORDER; i++) {
+        INIT_LIST_HEAD(&freeAreaTable[i].freeList);
+        freeAreaTable[i].blocks = 0;
+    }
+    freeNodeCount = 0;
+
     /* 剪切掉引导分配的空间 */
     unsigned int usedMem = BootMemSize();
     unsigned int usedPages = DIV_ROUND_UP(usedMem, PAGE_SIZE);
-    AllocPages(usedPages);
+    
+    memNodeTable[0].reference = 1;
+    memNodeTable[0].count = usedPages;
+
+    BuddyFreeRange(usedPages, memNodeCount - usedPages);
 }
 
+#ifdef CONFIG_BUDDY_SELF_TEST
+
+#define BUDDY_TEST_SLOTS    64
+#define BUDDY_TEST_ROUNDS   2048
+
+PRIVATE unsigned int BuddyTestRandom(unsigned int *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (*seed >> 16) & 0x7fff;
+}
+
+/**
+ * BuddySelfTest - 伙伴系统自检
+ * 
+ * 随机地分配和释放不同大小的页，每一步都检查空闲页数和分配的块是否重叠，
+ * 最后全部释放，检查空闲块是否都合并回了原来的样子
+ */
+PRIVATE void BuddySelfTest()
+{
+    unsigned int pages[BUDDY_TEST_SLOTS];
+    unsigned int counts[BUDDY_TEST_SLOTS];
+    unsigned int blocks[MAX_MEM_NODE_ORDER];
+    unsigned int seed = 20191001;
+    unsigned int freeSize, before;
+    int i, j, k;
+
+    freeSize = GetPhysicMemoryFreeSize();
+    for (i = 0; i < MAX_MEM_NODE_ORDER; i++)
+        blocks[i] = freeAreaTable[i].blocks;
+
+    memset(pages, 0, sizeof(pages));
+
+    for (i = 0; i < BUDDY_TEST_ROUNDS; i++) {
+        j = BuddyTestRandom(&seed) % BUDDY_TEST_SLOTS;
+        before = GetPhysicMemoryFreeSize();
+
+        if (pages[j]) {
+            FreePages(pages[j]);
+            if (GetPhysicMemoryFreeSize() != before + counts[j] * PAGE_SIZE)
+                Panic(PART_ERROR "buddy self test: free %d pages at %x bad free size!\n",
+                    counts[j], pages[j]);
+            pages[j] = 0;
+            continue;
+        }
+
+        /* 大部分是小块，偶尔分配大块 */
+        if (BuddyTestRandom(&seed) % 8)
+            counts[j] = BuddyTestRandom(&seed) % 16 + 1;
+        else
+            counts[j] = BuddyTestRandom(&seed) % 512 + 1;
+        
+        pages[j] = AllocPages(counts[j]);
+        if (!pages[j])
+            Panic(PART_ERROR "buddy self test: alloc %d pages failed!\n", counts[j]);
+        
+        if (GetPhysicMemoryFreeSize() != before - counts[j] * PAGE_SIZE)
+            Panic(PART_ERROR "buddy self test: alloc %d pages at %x bad free size!\n",
+                counts[j], pages[j]);
+        
+        /* 新分配的块不能和其它块重叠 */
+        for (k = 0; k < BUDDY_TEST_SLOTS; k++) {
+            if (k == j || !pages[k])
+                continue;
+            if (pages[j] < pages[k] + counts[k] * PAGE_SIZE && 
+                pages[k] < pages[j] + counts[j] * PAGE_SIZE)
+                Panic(PART_ERROR "buddy self test: block %x overlap with %x!\n",
+                    pages[j], pages[k]);
+        }
+    }
+
+    for (j = 0; j < BUDDY_TEST_SLOTS; j++) {
+        if (pages[j])
+            FreePages(pages[j]);
+    }
+
+    if (GetPhysicMemoryFreeSize() != freeSize)
+        Panic(PART_ERROR "buddy self test: free size %x should be %x!\n",
+            GetPhysicMemoryFreeSize(), freeSize);
+    
+    /* 全部释放后，必须能合并回原来的块 */
+    for (i = 0; i < MAX_MEM_NODE_ORDER; i++) {
+        if (freeAreaTable[i].blocks != blocks[i])
+            Panic(PART_ERROR "buddy self test: order %d has %d blocks, should be %d!\n",
+                i, freeAreaTable[i].blocks, blocks[i]);
+    }
+    printk(PART_TIP "buddy self test passed.\n");
+}
+
+#endif /* CONFIG_BUDDY_SELF_TEST */
+
 /** 
  * GetPhysicMemoryFreeSize - 获取物理内存空闲大小
  * 
@@ -191,22 +458,7 @@ PRIVATE void CutUesdMemory()
  */
 PUBLIC unsigned int GetPhysicMemoryFreeSize()
 {
-    struct MemNode *node = memNodeTable;
-    unsigned int freeNodes = 0;
-    while (node < memNodeTable + memNodeCount)
-    {
-        /* 没有被分配就是我们需要的 */
-        if (!node->reference) {
-            freeNodes++;
-        }
-        /* 指向下一个节点位置 */
-        if (node->count) 
-            node += node->count;
-        else 
-            node++;
-    }
-    /* 获取空闲节点数后，进行计算 */
-    return freeNodes * PAGE_SIZE;
+    return freeNodeCount * PAGE_SIZE;
 }
 
 /** 
@@ -270,7 +522,11 @@ PUBLIC int InitPhysicMemory()
     
     memset(memNodeTable, 0, memNodeTableSize);
 
-    CutUesdMemory();
+    InitBuddySystem();
+
+#ifdef CONFIG_BUDDY_SELF_TEST
+    BuddySelfTest();
+#endif
 /*
     unsigned int a = AllocPages(1000);
     unsigned int b = AllocPages(2);
@@ -11,8 +11,6 @@
 #include <block/block.h>
 #include <block/blk-dev.h>
 
-EXTERN struct List allDeviceListHead;
-
 /* 所有块设备的队列 */
 LIST_HEAD(allBlockDeviceList);
 
@@ -147,8 +145,8 @@ PUBLIC void AddBlockDevice(struct BlockDevice *blkdev)
     /* 添加到队列的最后面 */
     ListAddTail(&blkdev->list, &allBlockDeviceList);
 
-    /* 添加到设备队列的最后面 */
-    ListAddTail(&blkdev->super.list, &allDeviceListHead);
+    /* 添加到设备队列和散列表 */
+    RegisterDevice(&blkdev->super);
 
     return;
 }
@@ -169,7 +167,8 @@ PUBLIC void DelBlockDevice(struct BlockDevice *blkdev)
 
     ListDel(&blkdev->list);
 
-    ListDel(&blkdev->super.list);
+    /* 返回后可以释放块设备 */
+    UnregisterDevice(&blkdev->super);
 }
 
 /**
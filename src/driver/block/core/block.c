@@ -36,15 +36,11 @@ EXTERN struct List allBlockDeviceList;
  * BlockDiskSync - 把磁盘数据同步到磁盘上
  * 
  * 这个函数每秒被调用一次，在clock.c中的WorkForPerSecond工作中进行。
+ * 只唤醒写回线程，由它写回过期的脏缓冲，不在这里同步所有缓冲
  */
 PUBLIC void BlockDiskSync()
 {
-    /* 执行块同步操作 */
-    int count = Bsync();
-    if (count) {
-        /* 显示同步信息，有助于调试 */
-        //printk(">>>sync disk for %d count.\n", count);
-    }
+    WakeupBufferWriteback();
 }
 
 void ThreadReadTest(void *arg)
@@ -208,6 +204,11 @@ PUBLIC void InitBlockDevice()
 {
 #ifdef CONFIG_BLOCK_DEVICE
     
+    /* 初始化请求和缓冲的对象缓存 */
+    if (InitBlockRequest() || InitBlockBuffer()) {
+		Panic("init block cache failed!\n");	
+	}
+
     #ifdef CONFIG_DRV_RAMDISK
     /* 初始化ramdisk驱动 */
     if (InitRamdiskDriver()) {
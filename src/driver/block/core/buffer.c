@@ -6,14 +6,22 @@
  */
 
 #include <book/debug.h>
+#include <book/memcache.h>
+#include <book/interrupt.h>
+#include <book/task.h>
+#include <book/waitqueue.h>
+#include <book/lockstat.h>
 #include <lib/string.h>
+#include <lib/math.h>
+#include <clock/clock.h>
 
 #include <block/block.h>
 #include <block/blk-buffer.h>
 #include <block/blk-request.h>
 #include <block/blk-disk.h>
 
-EXTERN struct List allDiskList;
+/* 所有缓冲区的锁属于同一个锁类 */
+PRIVATE DEFINE_LOCK_CLASS(bufferLockClass, "buffer_head");
 
 /**
  * LockBuffer - 锁定缓冲区
@@ -24,17 +32,25 @@ EXTERN struct List allDiskList;
 PUBLIC void LockBuffer(struct BufferHead *bh)
 {
     bh->locked = 1;
+    bh->lockTime = LockStatAcquired(&bufferLockClass);
 }
 
 /**
  * UnlockBuffer - 解除缓冲区的锁
  * @bh: 缓冲头
  * 
- * 解除缓冲区占用
+ * 解除缓冲区占用，唤醒在缓冲区上等待的任务，可以在中断中调用
  */
 PUBLIC void UnlockBuffer(struct BufferHead *bh)
 {
+    struct WaitQueue *waitQueue = AddressWaitQueue(bh);
+
+    LockStatReleased(&bufferLockClass, bh->lockTime);
     bh->locked = 0;
+
+    /* 等待队列是共用的，唤醒所有等待者，让它们自己检测 */
+    if (WaitQueueActive(waitQueue))
+        WaitQueueWakeUpAll(waitQueue);
 }
 
 /**
@@ -44,95 +60,187 @@ PUBLIC void UnlockBuffer(struct BufferHead *bh)
  */
 PUBLIC void WaitOnBuffer(struct BufferHead *bh)
 {
-    while (bh->locked)
-    {
-        /* 让出CPU占用 */
-        TaskYield();
-    }
+    if (!bh->locked)
+        return;
+
+    unsigned long long waitStart = LockStatWaitStart();
+
+    /* 睡眠到解锁时被唤醒 */
+    WAIT_EVENT(AddressWaitQueue(bh), !bh->locked);
+
+    LockStatContended(&bufferLockClass, waitStart);
 }
 
+/* 缓冲头的对象缓存 */
+PRIVATE struct MemCache *bufferHeadCache;
+
+/* 以(devno, lba)为键的缓冲区哈希表 */
+PRIVATE struct List bufferHashTable[BUFFER_HASH_SIZE];
+
+/* 所有缓冲区的LRU链表，最近使用的在末尾 */
+PRIVATE LIST_HEAD(bufferLruList);
+
+/* 缓冲区的统计信息 */
+PRIVATE struct BufferCacheStat bufferStat;
+
+/* 写回脏缓冲的工作队列和工作 */
+PRIVATE struct WorkQueue *writebackQueue;
+PRIVATE Work_t writebackWork;
+
+#define BUFFER_HASH(devno, lba) \
+    ((((unsigned int)(devno) * 31) + (unsigned int)(lba)) & (BUFFER_HASH_SIZE - 1))
+
 /**
- * GetBufferFromDisk - 从磁盘缓冲链表中获取一个缓冲
- * @disk: 要获取的磁盘
+ * LookupBuffer - 在哈希表中查找一个缓冲
+ * @devno: 设备号
  * @lba: 块对应的lba
  * @size: 块的大小
  * 
- * 根据条件返回一个一样的块，没有找到则返回空
+ * 需要在关闭中断的情况下调用，找到返回缓冲头，没有找到则返回空
  */
-PRIVATE struct BufferHead *GetBufferFromDisk(struct Disk *disk, sector_t lba, size_t size)
+PRIVATE struct BufferHead *LookupBuffer(dev_t devno, sector_t lba, size_t size)
 {
-    struct BufferHead *bh = NULL, *tmp;
-
-    /* 在磁盘对应的缓冲头中查找，是否和磁盘的设备号一致 */
-    int devno = MKDEV(disk->major, disk->firstMinor);
-    char flags = 0;
-    ListForEachOwner(tmp , &disk->bufferHeadList, list) {
+    struct BufferHead *bh;
+    struct List *head = &bufferHashTable[BUFFER_HASH(devno, lba)];
+    
+    ListForEachOwner(bh, head, hashList) {
         /* 如果条件满足就找到 */
-        if (tmp->devno == devno &&
-            tmp->lba == lba &&
-            tmp->size == size
+        if (bh->devno == devno &&
+            bh->lba == lba &&
+            bh->size == size
         ) {
-            bh = tmp;
-            GetBH(bh);
-            flags = 1;
-            break;
+            return bh;
         }
     }
-    return bh;
+    return NULL;
+}
 
-    /* 找到了标志才为1，没有则返回空 */
-    if (flags)
-        return bh;
-    else
-        return NULL;
+/**
+ * BufferHeadCtor - 缓冲头的构造函数
+ * @object: 缓冲头
+ * 
+ * 设置缓冲头中不随块变化的状态，释放缓冲头前需要恢复这些状态
+ */
+PRIVATE void BufferHeadCtor(void *object)
+{
+    struct BufferHead *bh = object;
+
+    AtomicSet(&bh->count, 0);
+    bh->private = NULL;
+
+    bh->locked = 0;
+    bh->lockTime = 0;
+    bh->uptodate = 0;
+    bh->dirty = 0;
+    
+    /* 初始化信号量为1 */
+    SemaphoreInit(&bh->sema, 1);
 }
 
 /**
- * CreateBuffers - 创建一个缓冲区
- * @disk: 缓冲区所属的磁盘（每个磁盘一组缓冲区）
+ * CreateBuffer - 创建一个缓冲区
+ * @devno: 缓冲区所属的设备号
  * @lba: 缓冲区的lba
  * @size: 缓冲区的大小
  * 
- * 成功返回0，失败返回-1
+ * 创建的缓冲区还没有加入哈希表，成功返回缓冲头，失败返回NULL
  */
-PRIVATE int CreateBuffers(struct Disk *disk, sector_t lba, size_t size)
+PRIVATE struct BufferHead *CreateBuffer(dev_t devno, sector_t lba, size_t size)
 {
     if (size < SECTOR_SIZE || size > PAGE_SIZE)
         Panic("Bad block size!\n");
 
-    /* 创建并添加到链表 */
     struct BufferHead *bh;
 
     char *data;
 
     data = kmalloc(size, GFP_KERNEL);
     if (data == NULL) {
-        return -1;
+        return NULL;
     }
-    bh = kmalloc(SIZEOF_BUFFER_HEAD, GFP_KERNEL);
+    /* 从缓存中分配的缓冲头已经构造好了 */
+    bh = MemCacheAlloc(bufferHeadCache);
     if (bh == NULL) {
         kfree(data);
-        return -1;
+        return NULL;
     }
 
-    AtomicSet(&bh->count, 0);
-    bh->devno = MKDEV(disk->major, disk->firstMinor);
+    bh->devno = devno;
     bh->lba = lba;
     bh->size = size;
     bh->data = data;
-    bh->private = NULL;
 
-    bh->locked = 0;
+    return bh;
+}
+
+/**
+ * FreeBuffer - 释放一个缓冲区
+ * @bh: 缓冲头
+ * 
+ * 缓冲区已经从哈希表和LRU链表中摘下，恢复构造时的状态后归还缓存
+ */
+PRIVATE void FreeBuffer(struct BufferHead *bh)
+{
+    kfree(bh->data);
+    bh->data = NULL;
+
     bh->uptodate = 0;
     bh->dirty = 0;
-    
-    /* 初始化信号量为1 */
-    SemaphoreInit(&bh->sema, 1);
+    bh->private = NULL;
 
-    /* 添加到buffer list */
-    ListAddTail(&bh->list, &disk->bufferHeadList);
+    MemCacheFree(bufferHeadCache, bh);
+}
 
-    return 0;
+/**
+ * ReclaimBuffers - 回收缓冲区
+ * @size: 即将创建的缓冲区大小
+ * 
+ * 从LRU链表头部（最久没有使用的）开始，回收没有使用者的缓冲区，
+ * 直到能放下新的缓冲区。脏缓冲区先写回磁盘，再在下一轮被回收。
+ */
+PRIVATE void ReclaimBuffers(size_t size)
+{
+    struct BufferHead *bh, *victim;
+    int tries = BUFFER_RECLAIM_TRIES;
+    unsigned long flags;
+
+    while (bufferStat.size + size > BUFFER_CACHE_MAX_SIZE && tries-- > 0) {
+        flags = InterruptSave();
+        
+        victim = NULL;
+        ListForEachOwner(bh, &bufferLruList, list) {
+            if (!AtomicGet(&bh->count) && !bh->locked) {
+                victim = bh;
+                break;
+            }
+        }
+        /* 所有缓冲区都在使用中，只能超出预算 */
+        if (victim == NULL) {
+            InterruptRestore(flags);
+            break;
+        }
+
+        if (victim->dirty) {
+            /* 写回期间持有引用，防止被其它任务回收 */
+            GetBH(victim);
+            InterruptRestore(flags);
+            
+            if (!BsyncOne(victim))
+                bufferStat.writebacks++;
+            PutBH(victim);
+            continue;
+        }
+        
+        ListDel(&victim->list);
+        ListDel(&victim->hashList);
+        bufferStat.buffers--;
+        bufferStat.size -= victim->size;
+        bufferStat.evictions++;
+        
+        InterruptRestore(flags);
+
+        FreeBuffer(victim);
+    }
 }
 
 /**
@@ -140,7 +248,8 @@ PRIVATE int CreateBuffers(struct Disk *disk, sector_t lba, size_t size)
  * @devno: 设备号
  * @lba: 块号
  * 
- * 根据设备号获取一个块（缓冲区）
+ * 根据设备号获取一个块（缓冲区），返回时已经持有一个引用，
+ * 使用完后需要用Brelease释放
  */
 PRIVATE struct BufferHead *GetBlock(dev_t devno, sector_t lba)
 {
@@ -151,44 +260,71 @@ PRIVATE struct BufferHead *GetBlock(dev_t devno, sector_t lba)
     if (blkdev->disk == NULL)
         return NULL; 
 
-    struct Disk *disk = blkdev->disk;
-
-    while (1) {
-        /* 从链表中获取块 */
-        struct BufferHead *bh;
-        bh = GetBufferFromDisk(disk, lba, blkdev->blockSize);
+    size_t size = blkdev->blockSize;
+    struct BufferHead *bh, *new;
+    unsigned long flags;
+
+    flags = InterruptSave();
+    bh = LookupBuffer(devno, lba, size);
+    if (bh != NULL) {
+        GetBH(bh);
+        /* 移动到LRU链表末尾 */
+        ListDel(&bh->list);
+        ListAddTail(&bh->list, &bufferLruList);
+        InterruptRestore(flags);
+        return bh;
+    }
+    InterruptRestore(flags);
+    
+    /* 超过预算就先回收一些缓冲区 */
+    if (bufferStat.size + size > BUFFER_CACHE_MAX_SIZE)
+        ReclaimBuffers(size);
+    
+    /* 没找到，就添加一个新的buffer */
+    new = CreateBuffer(devno, lba, size);
+    if (new == NULL) {
+        Panic("Create block buffer failed!\n");
+    }
+    
+    flags = InterruptSave();
+    /* 回收时可能让出了CPU，需要再查找一次，防止重复添加 */
+    bh = LookupBuffer(devno, lba, size);
+    if (bh != NULL) {
+        GetBH(bh);
+        ListDel(&bh->list);
+        ListAddTail(&bh->list, &bufferLruList);
+        InterruptRestore(flags);
         
-        /* 找到就返回 */
-        if (bh != NULL) {
-            return bh;
-        }
-        //printk("%d", lba);
-        /* 没找到，就添加一个新的buffer */
-        if (CreateBuffers(disk, lba, blkdev->blockSize)) {
-            /* 如果添加新buffer失败，就尝试释放更多内存，再进行添加 */
-            //FreeMoreMemory();
-            Panic("Create block buffer failed!\n");
-        }
+        FreeBuffer(new);
+        return bh;
     }
+    
+    GetBH(new);
+    ListAdd(&new->hashList, &bufferHashTable[BUFFER_HASH(devno, lba)]);
+    ListAddTail(&new->list, &bufferLruList);
+    bufferStat.buffers++;
+    bufferStat.size += size;
+    
+    InterruptRestore(flags);
+    return new;
 }
 
 /**
  * Brelease - 释放一个块
  * @bh: 缓冲头
-*/
-PRIVATE void Brelease(struct BufferHead *bh)
+ * 
+ * 释放GetBlock（Bread/Bwrite）获取的引用，没有使用者的缓冲区才能被回收
+ */
+PUBLIC void Brelease(struct BufferHead *bh)
 {
     if (bh == NULL)
         return;
-    
-    /* 等待上锁的缓冲解锁 */
-    WaitOnBuffer(bh);
 
-    /* 减少引用计数 */
-    PutBH(bh);
     if (!AtomicGet(&bh->count))
         Panic("Brelease: user count error!\n");
 
+    /* 减少引用计数 */
+    PutBH(bh);
 }
 
 /**
@@ -206,6 +342,231 @@ PRIVATE void RW_Block(int rw, struct BufferHead *bh)
     MakeRequest(major, rw, bh);
 }
 
+/**
+ * MarkBufferDirty - 把缓冲标记为脏
+ * @bh: 缓冲头
+ * 
+ * 第一次变脏时记录时间，写回线程根据这个时间判断是否需要写回
+ */
+PRIVATE void MarkBufferDirty(struct BufferHead *bh)
+{
+    unsigned long flags = InterruptSave();
+    if (!bh->dirty) {
+        bh->dirty = 1;
+        bh->dirtyTime = systicks;
+        bufferStat.dirty++;
+        bufferStat.dirtySize += bh->size;
+    }
+    InterruptRestore(flags);
+}
+
+/**
+ * ClearBufferDirty - 清除缓冲的脏位
+ * @bh: 缓冲头
+ * 
+ * 写请求完成后调用
+ */
+PUBLIC void ClearBufferDirty(struct BufferHead *bh)
+{
+    unsigned long flags = InterruptSave();
+    if (bh->dirty) {
+        bh->dirty = 0;
+        bufferStat.dirty--;
+        bufferStat.dirtySize -= bh->size;
+    }
+    InterruptRestore(flags);
+}
+
+/**
+ * SortBuffers - 把缓冲按照(devno, lba)排序
+ * @bhs: 缓冲头数组
+ * @count: 数量
+ * 
+ * 排好序后，块号连续的缓冲可以合并成一个请求。一批的数量不多，使用插入排序
+ */
+PRIVATE void SortBuffers(struct BufferHead **bhs, int count)
+{
+    struct BufferHead *bh;
+    int i, j;
+
+    for (i = 1; i < count; i++) {
+        bh = bhs[i];
+        for (j = i; j > 0; j--) {
+            if (bhs[j - 1]->devno < bh->devno ||
+                (bhs[j - 1]->devno == bh->devno && bhs[j - 1]->lba <= bh->lba))
+                break;
+            bhs[j] = bhs[j - 1];
+        }
+        bhs[j] = bh;
+    }
+}
+
+/* 已经有效或者脏了的缓冲不需要从磁盘读取，必须在持有信号量时检测 */
+#define BUFFER_SKIP_READ(bh) ((bh)->uptodate || (bh)->dirty)
+
+/**
+ * SyncBufferBatch - 读写一批缓冲
+ * @rw: 读/写操作
+ * @bhs: 排好序的缓冲头数组，调用者持有它们的引用
+ * @count: 数量，不超过BUFFER_BATCH_MAX
+ * 
+ * 能立即获取信号量的缓冲一起提交，块号连续的会合并成一个请求。
+ * 信号量被占用的缓冲之后再逐个处理，这样不会在持有信号量的时候
+ * 等待其它信号量，也就不会和其它任务互相等待
+ */
+PRIVATE void SyncBufferBatch(int rw, struct BufferHead **bhs, int count)
+{
+    struct BufferHead *batch[BUFFER_BATCH_MAX];
+    char taken[BUFFER_BATCH_MAX];
+    int n = 0, i;
+
+    for (i = 0; i < count; i++) {
+        taken[i] = !SemaphoreTryDown(&bhs[i]->sema);
+        if (!taken[i])
+            continue;
+        /* 收集之后可能已经被别人读入或者写脏，不能再用磁盘数据覆盖 */
+        if (rw == BLOCK_READ && BUFFER_SKIP_READ(bhs[i])) {
+            SemaphoreUp(&bhs[i]->sema);
+            continue;
+        }
+        batch[n++] = bhs[i];
+    }
+    
+    MakeRequestBatch(rw, batch, n);
+    
+    for (i = 0; i < n; i++) {
+        WaitOnBuffer(batch[i]);
+        SemaphoreUp(&batch[i]->sema);
+    }
+    
+    for (i = 0; i < count; i++) {
+        if (taken[i])
+            continue;
+        if (rw == BLOCK_WRITE) {
+            BsyncOne(bhs[i]);
+        } else {
+            SemaphoreDown(&bhs[i]->sema);
+            /* 等待期间持有者可能已经读完 */
+            if (!BUFFER_SKIP_READ(bhs[i])) {
+                RW_Block(BLOCK_READ, bhs[i]);
+                WaitOnBuffer(bhs[i]);
+            }
+            SemaphoreUp(&bhs[i]->sema);
+        }
+    }
+}
+
+/**
+ * CollectDirtyBuffers - 收集一批需要写回的脏缓冲
+ * @batch: 保存缓冲头的数组
+ * @max: 最多收集的数量
+ * @expire: 只收集脏了expire个ticks以上的缓冲，为0时收集所有脏缓冲
+ * 
+ * 收集到的缓冲都持有一个引用，并且按照(devno, lba)排好序，
+ * 这样提交给电梯算法的请求就是有序的。返回收集的数量
+ */
+PRIVATE int CollectDirtyBuffers(struct BufferHead **batch, int max, clock_t expire)
+{
+    struct BufferHead *bh;
+    int n = 0;
+    
+    unsigned long flags = InterruptSave();
+    ListForEachOwner(bh, &bufferLruList, list) {
+        if (n >= max)
+            break;
+        if (!bh->dirty || bh->locked)
+            continue;
+        if (expire && systicks - bh->dirtyTime < expire)
+            continue;
+        GetBH(bh);
+        batch[n++] = bh;
+    }
+    InterruptRestore(flags);
+
+    SortBuffers(batch, n);
+    return n;
+}
+
+/**
+ * WritebackBuffers - 写回脏缓冲
+ * @expire: 只写回脏了expire个ticks以上的缓冲，为0时写回所有脏缓冲
+ * @limit: 最多写回的批数
+ * 
+ * 每次收集一批按块号排好序的脏缓冲再依次写回，返回写回的缓冲数
+ */
+PRIVATE int WritebackBuffers(clock_t expire, int limit)
+{
+    struct BufferHead *batch[BUFFER_WRITEBACK_BATCH];
+    int n, i, errors;
+    int count = 0;
+
+    do {
+        n = CollectDirtyBuffers(batch, BUFFER_WRITEBACK_BATCH, expire);
+        
+        /* 块号连续的脏缓冲会合并成一个写请求 */
+        SyncBufferBatch(BLOCK_WRITE, batch, n);
+        
+        errors = 0;
+        for (i = 0; i < n; i++) {
+            if (!batch[i]->dirty)
+                count++;
+            else
+                errors++;
+            PutBH(batch[i]);
+        }
+        /* 写入失败后，缓冲还是脏的，停止写回，避免一直重试 */
+    } while (n == BUFFER_WRITEBACK_BATCH && !errors && --limit > 0);
+    
+    return count;
+}
+
+/**
+ * BufferWritebackWork - 写回工作
+ * @work: 工作
+ * 
+ * 写回过期的脏缓冲，脏缓冲超过后台写回的比例时，就写回所有脏缓冲
+ */
+PRIVATE void BufferWritebackWork(Work_t *work)
+{
+    clock_t expire = BUFFER_DIRTY_EXPIRE;
+
+    if (bufferStat.dirtySize > BUFFER_CACHE_MAX_SIZE / 100 * BUFFER_DIRTY_BACKGROUND_RATIO)
+        expire = 0;
+    
+    bufferStat.flushed += WritebackBuffers(expire, BUFFER_WRITEBACK_ROUNDS);
+}
+
+/**
+ * WakeupBufferWriteback - 唤醒写回线程
+ * 
+ * 每秒调用一次，也会在脏缓冲过多时调用
+ */
+PUBLIC void WakeupBufferWriteback()
+{
+    if (writebackQueue == NULL || !bufferStat.dirty)
+        return;
+    QueueScheduleWork(writebackQueue, &writebackWork);
+}
+
+/**
+ * BalanceDirtyBuffers - 限制脏缓冲的数量
+ * 
+ * 脏缓冲超过上限时，写入者自己写回一批，既限制了写入速度，
+ * 也不依赖写回线程能否及时运行
+ */
+PRIVATE void BalanceDirtyBuffers()
+{
+    if (bufferStat.dirtySize <= BUFFER_CACHE_MAX_SIZE / 100 * BUFFER_DIRTY_RATIO) {
+        /* 超过后台写回的比例就提前唤醒写回线程 */
+        if (bufferStat.dirtySize > BUFFER_CACHE_MAX_SIZE / 100 * BUFFER_DIRTY_BACKGROUND_RATIO)
+            WakeupBufferWriteback();
+        return;
+    }
+    
+    bufferStat.throttled++;
+    WritebackBuffers(0, 1);
+}
+
 /**
  * Bread - 读取一个块到缓冲头(Buffer Read)
  * @devno: 设备号
@@ -227,14 +588,17 @@ PUBLIC struct BufferHead *Bread(dev_t devno, sector_t block)
     // 是有效的，直接返回
     if (bh->uptodate) {
         //printk("is a uptodate bh.\n");
+        bufferStat.hits++;
         return bh;
     }
+    bufferStat.misses++;
     SemaphoreDown(&bh->sema);
 
-    /* 没有就从磁盘读取数据到缓冲区 */
-    RW_Block(BLOCK_READ, bh);
-
-    WaitOnBuffer(bh);
+    /* 没有就从磁盘读取数据到缓冲区，等待期间可能已经被别人读入 */
+    if (!BUFFER_SKIP_READ(bh)) {
+        RW_Block(BLOCK_READ, bh);
+        WaitOnBuffer(bh);
+    }
     SemaphoreUp(&bh->sema);
     
     /* 读取数据之后，检测是否有数据 */
@@ -248,6 +612,85 @@ PUBLIC struct BufferHead *Bread(dev_t devno, sector_t block)
     return NULL;
 }
 
+/**
+ * BreadBlocks - 读取多个块(Buffer Read Blocks)
+ * @devno: 设备号
+ * @blocks: 块号数组
+ * @count: 块数，不超过BUFFER_BATCH_MAX
+ * @bhs: 保存读取的缓冲头
+ * 
+ * 不在缓存中的块一起读取，块号连续的会合并成一个请求。
+ * 成功返回0，bhs中的缓冲都需要用Brelease释放；失败返回-1
+ */
+PUBLIC int BreadBlocks(dev_t devno, sector_t *blocks, int count, struct BufferHead **bhs)
+{
+    struct BufferHead *miss[BUFFER_BATCH_MAX];
+    int n = 0, i;
+
+    if (count > BUFFER_BATCH_MAX)
+        return -1;
+
+    for (i = 0; i < count; i++) {
+        if (!(bhs[i] = GetBlock(devno, blocks[i])))
+            Panic("BreadBlocks: Get block failed!\n");
+
+        if (bhs[i]->uptodate) {
+            bufferStat.hits++;
+        } else {
+            bufferStat.misses++;
+            miss[n++] = bhs[i];
+        }
+    }
+    
+    SortBuffers(miss, n);
+    SyncBufferBatch(BLOCK_READ, miss, n);
+
+    for (i = 0; i < count; i++) {
+        if (!bhs[i]->uptodate)
+            break;
+    }
+    if (i == count)
+        return 0;
+    
+    printk("BreadBlocks: read block failed!");
+    for (i = 0; i < count; i++)
+        Brelease(bhs[i]);
+    return -1;
+}
+
+/**
+ * BlockReadBlocks - 块设备读取多个块
+ * @devno: 设备号
+ * @blocks: 块号数组
+ * @count: 块数
+ * @buffer: 读取到缓冲区，为NULL时只把块读入块缓冲（预读）
+ * 
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BlockReadBlocks(dev_t devno, sector_t *blocks, int count, void *buffer)
+{
+    struct BufferHead *bhs[BUFFER_BATCH_MAX];
+    char *p = buffer;
+    int n, i;
+
+    while (count > 0) {
+        n = MIN(count, BUFFER_BATCH_MAX);
+        if (BreadBlocks(devno, blocks, n, bhs))
+            return -1;
+        
+        for (i = 0; i < n; i++) {
+            if (p != NULL) {
+                memcpy(p, bhs[i]->data, bhs[i]->size);
+                p += bhs[i]->size;
+            }
+            Brelease(bhs[i]);
+        }
+        blocks += n;
+        count -= n;
+    }
+    return 0;
+}
+
 /**
  * Bwrite - 写入一个块到缓冲头(Buffer Write)
  * @devno: 设备号
@@ -275,7 +718,7 @@ PUBLIC struct BufferHead *Bwrite(dev_t devno, sector_t block, void *buffer)
     memcpy(bh->data, buffer, BLOCK_SIZE);
 
     /* 标记块为脏 */
-    bh->dirty = 1;
+    MarkBufferDirty(bh);
 
     /* 标记为有效数据
     如果不标记为有效，那么在读取数据的时候，就会到磁盘去读取数据
@@ -285,6 +728,8 @@ PUBLIC struct BufferHead *Bwrite(dev_t devno, sector_t block, void *buffer)
     
     SemaphoreUp(&bh->sema);
     
+    /* 脏缓冲太多了，写入者需要先写回一批 */
+    BalanceDirtyBuffers();
     return bh;
 }
 
@@ -316,8 +761,7 @@ PUBLIC int BsyncOne(struct BufferHead *bh)
         return 0;
     }
     printk("Bwrite: write block failed!");
-    /* 获取读取数据失败，释放掉buffer head */
-    Brelease(bh);
+    /* 引用由调用者持有，这里不释放 */
     return -1;
 }
 
@@ -328,49 +772,80 @@ PUBLIC int BsyncOne(struct BufferHead *bh)
  */
 PUBLIC int Bsync()
 {
-    struct Disk *disk = NULL;
-    struct BufferHead *bh;
-    
     /* 同步成功数 */
-    int count = 0; 
-    /* 获取磁盘 */
-    ListForEachOwner(disk, &allDiskList, list) {
-        bh = NULL;
-        /* 获取磁盘中的的缓冲 */
-        ListForEachOwner(bh ,&disk->bufferHeadList, list) {
-            //printk("%d ", bh->dirty);
-    
-            if (!BsyncOne(bh)) {
-                count++;
-            }
-        }
-    }
-    return count;
+    return WritebackBuffers(0, BUFFER_SYNC_ROUNDS);
 }
 
 /**
- * Bsync - 同步所有脏缓冲(Buffer Sync)
+ * DirtyCheck - 检查脏缓冲
  * 
- * 对所有磁盘中的所有缓冲进行一次同步
+ * 输出所有脏缓冲的块号
  */
 PUBLIC int DirtyCheck()
 {
-    struct Disk *disk = NULL;
     struct BufferHead *bh;
     
-    /* 获取磁盘 */
-    ListForEachOwner(disk, &allDiskList, list) {
-        bh = NULL;
-        /* 获取磁盘中的的缓冲 */
-        ListForEachOwner(bh ,&disk->bufferHeadList, list) {
-            if (bh->dirty) {
-                printk("%d ", bh->lba);
-            }
+    ListForEachOwner(bh, &bufferLruList, list) {
+        if (bh->dirty) {
+            printk("%d ", bh->lba);
         }
     }
     return 0;
 }
 
+/**
+ * SysBufferStat - 获取块缓冲的统计信息
+ * @buf: 保存信息的地址
+ * 
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SysBufferStat(bufstat_t *buf)
+{
+    if (buf == NULL)
+        return -1;
+    
+    unsigned long flags = InterruptSave();
+    
+    buf->bs_buffers = bufferStat.buffers;
+    buf->bs_size = bufferStat.size;
+    buf->bs_maxsize = BUFFER_CACHE_MAX_SIZE;
+    buf->bs_dirty = bufferStat.dirty;
+    buf->bs_hits = bufferStat.hits;
+    buf->bs_misses = bufferStat.misses;
+    buf->bs_evictions = bufferStat.evictions;
+    buf->bs_writebacks = bufferStat.writebacks;
+    buf->bs_flushed = bufferStat.flushed;
+    buf->bs_throttled = bufferStat.throttled;
+
+    InterruptRestore(flags);
+    return 0;
+}
+
+/**
+ * InitBlockBuffer - 初始化块缓冲
+ * 
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int InitBlockBuffer()
+{
+    bufferHeadCache = CreateMemCache("buffer_head", SIZEOF_BUFFER_HEAD, 0, 0, BufferHeadCtor);
+    if (bufferHeadCache == NULL)
+        return -1;
+
+    int i;
+    for (i = 0; i < BUFFER_HASH_SIZE; i++)
+        INIT_LIST_HEAD(&bufferHashTable[i]);
+    
+    memset(&bufferStat, 0, sizeof(bufferStat));
+
+    /* 创建写回线程 */
+    WorkInit(&writebackWork, BufferWritebackWork);
+    writebackQueue = CreateWorkQueue("writeback");
+    if (writebackQueue == NULL)
+        return -1;
+    return 0;
+}
+
 /**
  * DumpBH - 输出块缓冲头信息
  * @bh: 块缓冲头
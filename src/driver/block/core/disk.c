@@ -86,9 +86,6 @@ PUBLIC void AddDisk(struct Disk *disk)
     disk->part0.sectorCounts = disk->capacity;
     AtomicSet(&disk->part0.ref, 0);
     
-    /* 初始化缓冲头链表 */
-    INIT_LIST_HEAD(&disk->bufferHeadList);
-
     /* 添加到系统 */
     ListAddTail(&disk->list, &allDiskList);
 }
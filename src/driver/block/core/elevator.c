@@ -162,3 +162,73 @@ PUBLIC void ElevatorIoSchedule(struct RequestQueue *queue, struct Request *reque
         }
     }
 }
+
+/**
+ * RequestCanMerge - 检测两个请求是否可以合并
+ * @front: 在前面的请求
+ * @back: 在后面的请求
+ * 
+ * 命令和设备相同，扇区连续，并且合并后不超过请求的上限才能合并
+ */
+PRIVATE int RequestCanMerge(struct Request *front, struct Request *back)
+{
+    return front->cmd == back->cmd &&
+        front->devno == back->devno &&
+        front->lba + front->count == back->lba &&
+        front->nrSegments + back->nrSegments <= REQUEST_MAX_SEGMENTS &&
+        front->count + back->count <= REQUEST_MAX_SECTORS;
+}
+
+/**
+ * MergeInList - 在请求链表中合并请求
+ * @list: 请求链表
+ * @request: 新的请求
+ * 
+ * 合并成功返回被合并进去的请求，失败返回NULL
+ */
+PRIVATE struct Request *MergeInList(struct List *list, struct Request *request)
+{
+    struct Request *tmp;
+    int i;
+
+    ListForEachOwner(tmp, list, queueList) {
+        /* 后向合并：新请求接在旧请求后面 */
+        if (RequestCanMerge(tmp, request)) {
+            for (i = 0; i < request->nrSegments; i++)
+                tmp->segments[tmp->nrSegments + i] = request->segments[i];
+            tmp->nrSegments += request->nrSegments;
+            tmp->count += request->count;
+            return tmp;
+        }
+        /* 前向合并：新请求放在旧请求前面 */
+        if (RequestCanMerge(request, tmp)) {
+            for (i = tmp->nrSegments - 1; i >= 0; i--)
+                tmp->segments[i + request->nrSegments] = tmp->segments[i];
+            for (i = 0; i < request->nrSegments; i++)
+                tmp->segments[i] = request->segments[i];
+            tmp->nrSegments += request->nrSegments;
+            tmp->count += request->count;
+            tmp->lba = request->lba;
+            return tmp;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * ElevatorMergeRequest - 把请求合并到队列中等待的请求
+ * @queue: 队列
+ * @request: 请求
+ * 
+ * 正在执行的请求已经不在链表中，所以只会和等待的请求合并。
+ * 合并成功返回被合并进去的请求，新请求可以释放了；失败返回NULL
+ */
+PUBLIC struct Request *ElevatorMergeRequest(struct RequestQueue *queue, struct Request *request)
+{
+    struct Request *merged;
+
+    merged = MergeInList(&queue->upRequestList, request);
+    if (merged == NULL)
+        merged = MergeInList(&queue->downRequestList, request);
+    return merged;
+}
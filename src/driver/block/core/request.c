@@ -8,6 +8,7 @@
 #include <book/debug.h>
 #include <lib/string.h>
 #include <book/task.h>
+#include <book/memcache.h>
 
 #include <block/block.h>
 #include <block/blk-request.h>
@@ -15,28 +16,8 @@
 #include <block/blk-disk.h>
 #include <block/blk-elevator.h>
 
-/* 完成的请求的链表 */
-LIST_HEAD(doneRequestListHead);
-
-/**
- * GetRequestFromDoneList - 从完成请求队列中获取一个请求
- * 
- * 当一个请求被使用之后，就会把它添加到完成请求队列。这样可以将它重复利用
- */
-PRIVATE struct Request *GetRequestFromDoneList()
-{
-    struct Request *req;
-
-    if (ListEmpty(&doneRequestListHead)) {
-        return NULL;
-    }
-    /* 剩余则摘取一个并返回 */
-    req = ListFirstOwner(&doneRequestListHead, struct Request, queueList);
-    
-    ListDel(&req->queueList);
-
-    return req;
-}
+/* 请求的对象缓存，完成的请求会放回缓存，以便重复利用 */
+PRIVATE struct MemCache *requestCache;
 
 /**
  * SwitchRequestList - 切换请求链表指向
@@ -70,7 +51,7 @@ PRIVATE void SwitchRequestList(struct RequestQueue *queue)
  */
 PRIVATE void AddRequest(struct RequestQueue *queue, struct Request *req)
 {
-    struct Request *tmp;
+    struct Request *tmp, *merged;
 
     /* 准备添加到请求队列的时候，不允许产生其它进程进行访问 */
     unsigned long flags = InterruptSave();
@@ -78,14 +59,22 @@ PRIVATE void AddRequest(struct RequestQueue *queue, struct Request *req)
     /* 记录请求所在的队列 */
     req->queue = queue;
 
-    /* 把请求插入合适的位置 */
-    ElevatorIoSchedule(queue, req);
+    /* 先尝试和等待中的请求合并，不能合并才插入合适的位置 */
+    merged = ElevatorMergeRequest(queue, req);
+    if (merged == NULL)
+        ElevatorIoSchedule(queue, req);
     
     /* 如果请求队列没有请求，就立即执行当前请求 */
     tmp = queue->currentRequest;
 
 	InterruptRestore(flags);
 
+    /* 合并后的请求会唤醒所有段的等待者，新请求就不需要了 */
+    if (merged != NULL) {
+        MemCacheFree(requestCache, req);
+        req = merged;
+    }
+
     if (tmp == NULL) {
         /* 更新当前请求 */
         queue->currentRequest = req;
@@ -125,7 +114,79 @@ PUBLIC struct RequestQueue *BlockInitQueue(RequestFunction_t callback, void *que
 }
 
 /**
- * MakeRequest - 生成一个请求
+ * RequestAddSegment - 把缓冲添加到请求的末尾
+ * @req: 请求
+ * @bh: 缓冲头
+ * @count: 缓冲的扇区数
+ */
+PRIVATE void RequestAddSegment(struct Request *req, struct BufferHead *bh, unsigned long count)
+{
+    struct RequestSegment *seg = &req->segments[req->nrSegments++];
+
+    seg->buffer = bh->data;
+    seg->count = count;
+    seg->bh = bh;
+    /* 当前任务就是等待者 */
+    seg->waiter = CurrentTask();
+
+    req->count += count;
+    
+    /* 请求持有缓冲的一个引用，结束请求时释放 */
+    GetBH(bh);
+}
+
+/**
+ * AllocRequest - 根据缓冲头分配一个请求
+ * @rw: 读/写操作
+ * @bh: 缓冲头
+ * @dev: 缓冲所在的块设备
+ * 
+ * 成功返回请求，失败返回NULL
+ */
+PRIVATE struct Request *AllocRequest(int rw, struct BufferHead *bh, struct BlockDevice *dev)
+{
+    struct Request *req;
+    
+    req = MemCacheAlloc(requestCache);
+    if (req == NULL)
+        return NULL;
+    
+    req->queue = NULL;
+    req->devno = bh->devno;
+    req->cmd = rw;
+    req->errors = 0;
+    req->count = 0;
+    req->nrSegments = 0;
+
+    /* 请求的lba是对于磁盘设备的，而bh的lba是对于文件系统的
+    文件系统的最小单位是块，而磁盘设备的最小单位是扇区
+     */
+    req->lba = bh->lba * (dev->blockSize / SECTOR_SIZE);
+    
+    /* 绑定磁盘 */
+    req->disk = dev->disk;
+
+    /* 根据块设备的块大小来判断请求需要的扇区数 */
+    RequestAddSegment(req, bh, dev->blockSize / SECTOR_SIZE);
+    return req;
+}
+
+/**
+ * BufferNeedRequest - 检测缓冲是否需要读写磁盘
+ * @rw: 读/写操作
+ * @bh: 缓冲头
+ * 
+ * 如果是写，并且没有脏数据，就不需要。
+ * 如果是读，并且数据有效，也不需要
+ */
+PRIVATE int BufferNeedRequest(int rw, struct BufferHead *bh)
+{
+    return !((rw == BLOCK_WRITE && !bh->dirty) ||
+        (rw == BLOCK_READ && bh->uptodate));
+}
+
+/**
+ * MakeRequest - 创建一个请求
  * @major: 主设备号
  * @rw: 读/写操作
  * @bh: 缓冲头
@@ -140,28 +201,12 @@ PUBLIC void MakeRequest(int major, int rw, struct BufferHead *bh)
 
     LockBuffer(bh);
 
-    /* 如果是写，并且没有脏数据，就直接返回。
-    如果是读，并且数据有效，就直接返回 */
-    if ((rw == BLOCK_WRITE && !bh->dirty) ||
-    (rw == BLOCK_READ && bh->uptodate)) {
+    if (!BufferNeedRequest(rw, bh)) {
         UnlockBuffer(bh);
         //printk("do not need this request!\n");
         return;
     }
 
-    /* 初始化请求信息 */
-    struct Request *req;
-    
-    req = GetRequestFromDoneList();
-    if (req == NULL) 
-        req = kmalloc(SIZEOF_REQUEST, GFP_KERNEL);
-    
-    if (req == NULL) {
-        UnlockBuffer(bh);
-        return;
-    }
-    memset(req, 0, SIZEOF_REQUEST);
-
     /* 通过major获取对应的设备的disk */
     struct BlockDevice *dev = GetBlockDeviceByDevno(bh->devno);
     if (dev == NULL) {
@@ -169,29 +214,77 @@ PUBLIC void MakeRequest(int major, int rw, struct BufferHead *bh)
         return;
     }
     
-    req->buffer = bh->data;
-    req->devno = bh->devno;
-    /* 根据块设备的块大小来判断请求需要的扇区数 */
-    req->count = dev->blockSize / SECTOR_SIZE;
-    req->cmd = rw;
-
-    /* 请求的lba是对于磁盘设备的，而bh的lba是对于文件系统的
-    文件系统的最小单位是块，而磁盘设备的最小单位是扇区
-     */
-    req->lba = bh->lba * req->count;
-    req->errors = 0;
-    req->bh = bh;
-
-    /* 绑定磁盘 */
-    req->disk = dev->disk;
-    
-    /* 当前任务就是等待者 */
-    req->waiter = CurrentTask();    
+    /* 初始化请求信息 */
+    struct Request *req = AllocRequest(rw, bh, dev);
+    if (req == NULL) {
+        UnlockBuffer(bh);
+        return;
+    }
 
     /* 把请求添加到磁盘的请求队列 */
     AddRequest(dev->disk->requestQueue, req);
 }
 
+/**
+ * MakeRequestBatch - 为一批缓冲创建请求
+ * @rw: 读/写操作
+ * @bhs: 缓冲头数组，调用者已经获取了它们的信号量
+ * @count: 缓冲头数量
+ * 
+ * 块号连续的缓冲会合并成一个请求，按数组的顺序提交，
+ * 所以调用者应该先按块号排好序。返回时所有请求都已经完成
+ */
+PUBLIC void MakeRequestBatch(int rw, struct BufferHead **bhs, int count)
+{
+    struct BlockDevice *dev = NULL;
+    struct Request *req = NULL;
+    struct BufferHead *bh;
+    unsigned long sectors;
+    int i;
+
+    if (rw != BLOCK_READ && rw != BLOCK_WRITE)
+        Panic("Bad block dev command, must be R/W");  
+
+    for (i = 0; i < count; i++) {
+        bh = bhs[i];
+        
+        LockBuffer(bh);
+        if (!BufferNeedRequest(rw, bh)) {
+            UnlockBuffer(bh);
+            continue;
+        }
+        
+        if (dev == NULL || dev->super.devno != bh->devno) {
+            dev = GetBlockDeviceByDevno(bh->devno);
+            if (dev == NULL) {
+                UnlockBuffer(bh);
+                continue;
+            }
+        }
+        sectors = dev->blockSize / SECTOR_SIZE;
+        
+        /* 和上一个缓冲连续，就添加到同一个请求 */
+        if (req != NULL && req->devno == bh->devno &&
+            req->lba + req->count == bh->lba * sectors &&
+            req->nrSegments < REQUEST_MAX_SEGMENTS &&
+            req->count + sectors <= REQUEST_MAX_SECTORS) {
+            RequestAddSegment(req, bh, sectors);
+            continue;
+        }
+        
+        /* 不连续，先提交之前的请求 */
+        if (req != NULL)
+            AddRequest(req->disk->requestQueue, req);
+        
+        req = AllocRequest(rw, bh, dev);
+        if (req == NULL)
+            UnlockBuffer(bh);
+    }
+    
+    if (req != NULL)
+        AddRequest(req->disk->requestQueue, req);
+}
+
 /**
  * BlockStartRequeue - 执行一个请求
  * @request: 要执行的请求
@@ -264,40 +357,46 @@ PUBLIC void BlockEndRequest(struct Request *request, int errors)
     if (request == NULL)
         return;
 
+    struct BufferHead *bh;
+    int i;
+
     /* 结束请求过程中，不允许产生中断 */
     unsigned long flags = InterruptSave();
 
     /* 记录请求错误数，可以根据请求的错误数做一些设定 */
     request->errors += errors;
     
-    if (request->bh) {
-        request->bh->uptodate = 1;
+    for (i = 0; i < request->nrSegments; i++) {
+        bh = request->segments[i].bh;
+        
+        bh->uptodate = 1;
 
         /* 写命令才清理脏位 */
         if (request->cmd == BLOCK_WRITE) {
             /* 把缓冲区的脏位去掉，因为已经写入到磁盘了 */
-            request->bh->dirty = 0;
+            ClearBufferDirty(bh);
         }
         
         /* 解除阻塞 */
-        UnlockBuffer(request->bh);
+        UnlockBuffer(bh);
 
         /* 释放对它的占用 */
-        PutBH(request->bh);
+        PutBH(bh);
 
-        if (!request->bh->uptodate) {
+        if (!bh->uptodate) {
             printk("device %d I/O error!\n", request->devno);
         }
     }
 
-    /* 唤醒等待请求中的任务 */
-    TaskWakeUp(request->waiter);
+    /* 唤醒等待请求中的任务，合并的请求可能有多个等待者 */
+    for (i = 0; i < request->nrSegments; i++)
+        TaskWakeUp(request->segments[i].waiter);
 
     /* 结束请求的时候设置当前请求为空 */
     request->queue->currentRequest = NULL;
     
-    /* 把request添加到完成队列，以便重复利用 */
-    ListAdd(&request->queueList, &doneRequestListHead);
+    /* 把request放回缓存，以便重复利用 */
+    MemCacheFree(requestCache, request);
 
     InterruptRestore(flags);
 }
@@ -314,11 +413,24 @@ PUBLIC void BlockCleanUpQueue(struct RequestQueue *queue)
         kfree(queue);
 }
 
+/**
+ * InitBlockRequest - 初始化请求
+ * 
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int InitBlockRequest()
+{
+    requestCache = CreateMemCache("request", SIZEOF_REQUEST, 0, 0, NULL);
+    if (requestCache == NULL)
+        return -1;
+    return 0;
+}
+
 PUBLIC void DumpRequest(struct Request *request)
 {
     printk(PART_TIP "----Request----\n");
-    printk(PART_TIP "queue:%x disk:%x bh:%x data:%x \n",
-        request->queue, request->disk, request->bh, request->buffer);
+    printk(PART_TIP "queue:%x disk:%x segments:%d data:%x \n",
+        request->queue, request->disk, request->nrSegments, request->segments[0].buffer);
     printk(PART_TIP "devno:%x cmd:%d errors:%d lba:%d count:%d\n", 
         request->devno, request->cmd, request->errors, request->lba, request->count);
 }
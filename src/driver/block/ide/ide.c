@@ -25,6 +25,8 @@
 #include <block/blk-buffer.h>
 #include <block/block.h>
 #include <block/ide/ide.h>
+#include <pci/pci.h>
+#include <clock/clock.h>
 
 /* 配置开始 */
 //#define _DEBUG_IDE_INFO
@@ -116,6 +118,40 @@
 #define ATA_REG_ALT_STATUS(channel) 	(channel->base + 0x206)
 #define ATA_REG_CTL(channel) 			ATA_REG_ALT_STATUS(channel)
 
+/* PCI上IDE控制器的类代码和子类代码 */
+#define IDE_PCI_CLASS		0x01
+#define IDE_PCI_SUBCLASS	0x01
+
+/* 总线主控DMA的寄存器，地址在IDE控制器的BAR4中，从通道的偏移为8 */
+#define BM_REG_CMD(channel) 		(channel->bmBase + 0)
+#define BM_REG_STATUS(channel) 		(channel->bmBase + 2)
+#define BM_REG_PRDT(channel) 		(channel->bmBase + 4)
+
+#define BM_CMD_START		0x01	/* 开始传输 */
+#define BM_CMD_READ			0x08	/* 从磁盘读取到内存 */
+
+#define BM_STATUS_ACTIVE	0x01	/* 正在传输 */
+#define BM_STATUS_ERR		0x02	/* 传输出错 */
+#define BM_STATUS_IRQ		0x04	/* 磁盘产生了中断 */
+
+/* 描述符表的最大项数，以及一次DMA传输的最大扇区数（和反弹缓冲区大小一致） */
+#define IDE_PRD_MAX			128
+#define IDE_DMA_MAX_SECTORS	128
+
+/* PRD描述的内存区域不能跨越64KB边界 */
+#define IDE_PRD_BOUNDARY	0x10000
+#define IDE_PRD_EOT			0x8000
+
+/* DMA传输的超时时间（ticks） */
+#define IDE_DMA_TIMEOUT		(5 * HZ)
+
+/* 物理区域描述符（PRD），总线主控DMA按照描述符表传输数据 */
+struct IdePrd {
+	unsigned int addr;		/* 物理地址 */
+	unsigned short count;	/* 字节数，0表示64KB */
+	unsigned short flags;	/* 最高位为1表示最后一个描述符 */
+} PACKED;
+
 /* 设备寄存器的位 */
 #define BIT_DEV_MBS		0xA0	//bit 7 and 5 are 1
 
@@ -133,6 +169,9 @@ struct IdeChannel {
    	struct IdeDevice *devices;	// 通道上面的设备
 	char who;		/* 通道上主磁盘在活动还是从磁盘在活动 */
 	char what;		/* 执行的是什么操作 */
+	unsigned short bmBase;		/* 总线主控寄存器基址，为0表示不支持DMA */
+	struct IdePrd *prdt;		/* 描述符表 */
+	unsigned char *bounce;		/* 缓冲不能直接DMA时使用的反弹缓冲区 */
 } channels[2];
 
 /* IDE块设备结构体 */
@@ -148,6 +187,7 @@ PRIVATE struct IdeDevice {
 	unsigned int capabilities;// Features.
 	unsigned int commandSets; // Command Sets Supported.
 	unsigned int size;		// Size in Sectors.
+	unsigned char dma;		/* 使用DMA传输，出错后会退回PIO */
 	/* 状态信息 */
 	unsigned int rdSectors;	// 读取了多少扇区
 	unsigned int wrSectors;	// 写入了多少扇区
@@ -776,8 +816,8 @@ PRIVATE void SelectSector(struct IdeDevice* dev,
 	if (mode == 2) {
 		Out8(ATA_REG_FEATURE(channel), 0); // PIO mode.
 
-		/* 写入要读写的扇区数*/
-		Out8(ATA_REG_SECTOR_CNT(channel), 0);
+		/* 写入要读写的扇区数的高8位 */
+		Out8(ATA_REG_SECTOR_CNT(channel), (count >> 8) & 0xff);
 
 		/* 写入lba地址24~47位(即扇区号) */
 		Out8(ATA_REG_SECTOR_LOW(channel), lbaIO[3]);
@@ -870,12 +910,37 @@ PRIVATE void ResetDriver(struct IdeDevice *dev)
 
 	SoftResetDriver(dev->channel);
 }
+/**
+ * 分段传输时的数据位置，合并后的请求由多段不连续的缓冲组成
+ */
+struct IdeTransferCursor {
+	struct RequestSegment *segment;	/* 当前段 */
+	unsigned long offset;			/* 在当前段中已经传输的扇区数 */
+};
+
+/**
+ * CursorSectorBuffer - 获取当前扇区的缓冲，并前进一个扇区
+ * @cursor: 传输位置
+ */
+PRIVATE unsigned char *CursorSectorBuffer(struct IdeTransferCursor *cursor)
+{
+	unsigned char *buf = (unsigned char *)cursor->segment->buffer +
+		cursor->offset * SECTOR_SIZE;
+	
+	/* 当前段传输完了，就移动到下一段 */
+	if (++cursor->offset >= cursor->segment->count) {
+		cursor->segment++;
+		cursor->offset = 0;
+	}
+	return buf;
+}
+
 /**
  * PioDataTransfer - PIO数据传输
  * @dev: 设备
  * @rw: 传输方向（读，写）
  * @mode: 传输模式（CHS和LBA模式）
- * @buf: 扇区缓冲
+ * @cursor: 扇区缓冲的位置
  * @count: 扇区数
  * 
  * 传输成功返回0，失败返回非0
@@ -883,7 +948,7 @@ PRIVATE void ResetDriver(struct IdeDevice *dev)
 PRIVATE int PioDataTransfer(struct IdeDevice *dev,
 	unsigned char rw,
 	unsigned char mode,
-	unsigned char *buf,
+	struct IdeTransferCursor *cursor,
 	unsigned short count)
 {
 	short i;
@@ -899,8 +964,7 @@ PRIVATE int PioDataTransfer(struct IdeDevice *dev,
 				ResetDriver(dev);
 				return error;
 			}
-			ReadFromSector(dev, buf, 1);
-			buf += SECTOR_SIZE;
+			ReadFromSector(dev, CursorSectorBuffer(cursor), 1);
 		}
 	} else {
 		#ifdef _DEBUG_IDE
@@ -914,8 +978,7 @@ PRIVATE int PioDataTransfer(struct IdeDevice *dev,
 				return error;
 			}
 			/* 把数据写入端口，完成1个扇区后会产生一次中断 */
-			Write2Sector(dev, buf, 1);
-			buf += SECTOR_SIZE;
+			Write2Sector(dev, CursorSectorBuffer(cursor), 1);
             //printk("write success! ");
 		}
 		/* 刷新写缓冲区 */
@@ -926,32 +989,203 @@ PRIVATE int PioDataTransfer(struct IdeDevice *dev,
 	return 0;
 }
 
+/**
+ * CursorSkip - 跳过已经传输的扇区
+ * @cursor: 分段缓冲的位置
+ * @count: 扇区数
+ */
+PRIVATE void CursorSkip(struct IdeTransferCursor *cursor, unsigned int count)
+{
+	while (count--)
+		CursorSectorBuffer(cursor);
+}
+
+/**
+ * CursorCopy - 在分段缓冲和连续缓冲之间复制数据
+ * @cursor: 分段缓冲的位置，复制后会前进
+ * @buf: 连续缓冲
+ * @count: 扇区数
+ * @toBuf: 为1时从分段缓冲复制到连续缓冲，为0时反过来
+ */
+PRIVATE void CursorCopy(struct IdeTransferCursor *cursor,
+	unsigned char *buf,
+	unsigned int count,
+	char toBuf)
+{
+	while (count--) {
+		if (toBuf)
+			memcpy(buf, CursorSectorBuffer(cursor), SECTOR_SIZE);
+		else
+			memcpy(CursorSectorBuffer(cursor), buf, SECTOR_SIZE);
+		buf += SECTOR_SIZE;
+	}
+}
+
+/**
+ * IdeDmaAddRegion - 添加一段内存到描述符表
+ * @prdt: 描述符表
+ * @nr: 已经使用的描述符数
+ * @phy: 物理地址
+ * @bytes: 字节数
+ * 
+ * 跨越64KB边界的内存要拆成多个描述符，成功返回新的描述符数，表满了返回-1
+ */
+PRIVATE int IdeDmaAddRegion(struct IdePrd *prdt, int nr, unsigned long phy, unsigned long bytes)
+{
+	unsigned long len;
+
+	while (bytes > 0) {
+		if (nr >= IDE_PRD_MAX)
+			return -1;
+		len = MIN(bytes, IDE_PRD_BOUNDARY - (phy & (IDE_PRD_BOUNDARY - 1)));
+		
+		prdt[nr].addr = phy;
+		prdt[nr].count = len & 0xffff;	/* 64KB的时候正好是0 */
+		prdt[nr].flags = 0;
+		nr++;
+		
+		phy += len;
+		bytes -= len;
+	}
+	return nr;
+}
+
+/**
+ * IdeDmaAble - 检测缓冲能否直接DMA
+ * @buf: 缓冲
+ * @bytes: 字节数
+ * 
+ * 只有内核线性映射区的内存，物理地址才是连续的
+ */
+PRIVATE int IdeDmaAble(unsigned char *buf, unsigned long bytes)
+{
+	return (unsigned long)buf >= PAGE_OFFSET &&
+		(unsigned long)buf + bytes <= HIGH_MEM_ADDR;
+}
+
+/**
+ * IdeDmaPrepare - 准备DMA传输的描述符表
+ * @channel: 通道
+ * @cursor: 扇区缓冲的位置（不会改变）
+ * @count: 扇区数
+ * @bounced: 返回是否使用了反弹缓冲区
+ * 
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int IdeDmaPrepare(struct IdeChannel *channel,
+	struct IdeTransferCursor *cursor,
+	unsigned int count,
+	char *bounced)
+{
+	struct IdeTransferCursor tmp = *cursor;
+	struct IdePrd *prdt = channel->prdt;
+	unsigned char *buf;
+	unsigned int left = count;
+	unsigned long n;
+	int nr = 0;
+
+	*bounced = 0;
+	while (left > 0) {
+		buf = (unsigned char *)tmp.segment->buffer + tmp.offset * SECTOR_SIZE;
+		n = MIN(left, tmp.segment->count - tmp.offset);
+		
+		if (!IdeDmaAble(buf, n * SECTOR_SIZE) ||
+			(nr = IdeDmaAddRegion(prdt, nr, Vir2Phy(buf), n * SECTOR_SIZE)) < 0) {
+			/* 有缓冲不能直接DMA，整段都使用反弹缓冲区 */
+			nr = IdeDmaAddRegion(prdt, 0, Vir2Phy(channel->bounce), count * SECTOR_SIZE);
+			if (nr < 0)
+				return -1;
+			*bounced = 1;
+			break;
+		}
+		
+		left -= n;
+		tmp.segment++;
+		tmp.offset = 0;
+	}
+	prdt[nr - 1].flags = IDE_PRD_EOT;
+	return 0;
+}
+
+/**
+ * IdeDmaSetup - 设置总线主控寄存器，准备开始DMA
+ * @channel: 通道
+ * @rw: 传输方向（读，写）
+ */
+PRIVATE void IdeDmaSetup(struct IdeChannel *channel, unsigned char rw)
+{
+	Out8(BM_REG_CMD(channel), 0);
+	Out32(BM_REG_PRDT(channel), Vir2Phy(channel->prdt));
+	
+	/* 写1清除中断和错误位 */
+	Out8(BM_REG_STATUS(channel), In8(BM_REG_STATUS(channel)) | BM_STATUS_IRQ | BM_STATUS_ERR);
+	Out8(BM_REG_CMD(channel), rw == IDE_READ ? BM_CMD_READ : 0);
+}
+
+/**
+ * IdeDmaWait - 启动DMA并等待完成
+ * @dev: 设备
+ * @rw: 传输方向（读，写）
+ * 
+ * 等待期间让出CPU，成功返回0，失败返回非0
+ */
+PRIVATE int IdeDmaWait(struct IdeDevice *dev, unsigned char rw)
+{
+	struct IdeChannel *channel = dev->channel;
+	unsigned char status;
+	clock_t start = systicks;
+
+	Out8(BM_REG_CMD(channel), (rw == IDE_READ ? BM_CMD_READ : 0) | BM_CMD_START);
+	
+	while (1) {
+		status = In8(BM_REG_STATUS(channel));
+		/* 磁盘产生中断或者出错，说明传输结束了 */
+		if (status & (BM_STATUS_IRQ | BM_STATUS_ERR))
+			break;
+		if (systicks - start > IDE_DMA_TIMEOUT)
+			break;
+		TaskYield();
+	}
+	
+	/* 停止传输，清除状态 */
+	Out8(BM_REG_CMD(channel), 0);
+	Out8(BM_REG_STATUS(channel), status | BM_STATUS_IRQ | BM_STATUS_ERR);
+
+	if (!(status & BM_STATUS_IRQ) || (status & BM_STATUS_ERR))
+		return 5;
+	if (In8(ATA_REG_STATUS(channel)) & (ATA_STATUS_ERR | ATA_STATUS_DF))
+		return 2;
+	return 0;
+}
+
 /**
  * AtaTypeTransfer - ATA类型数据传输
  * @dev: 设备
  * @rw: 传输方向（读，写）
  * @lba: 逻辑扇区地址
  * @count: 扇区数
- * @buf: 扇区缓冲
+ * @segments: 扇区缓冲段，所有段的扇区数之和等于count
  * 
+ * 所有扇区只发送一次命令（超过256个扇区时才分多次），
  * 传输成功返回0，失败返回非0
  */
 PRIVATE int AtaTypeTransfer(struct IdeDevice *dev,
 	unsigned char rw,
 	unsigned int lba,
 	unsigned int count,
-	void *buf)
+	struct RequestSegment *segments)
 {
 	unsigned char mode;	/* 0: CHS, 1:LBA28, 2: LBA48 */
 	unsigned char dma; /* 0: No DMA, 1: DMA */
 	unsigned char cmd;	
-	unsigned char *_buf = (unsigned char *)buf;
+	struct IdeTransferCursor cursor;
 
 	unsigned char lbaIO[6];	/* 由于最大是48位，所以这里数组的长度为6 */
 
 	struct IdeChannel *channel = dev->channel;
 
    	unsigned char head, err;
+	char bounced;
 
 	/* 要去操作的扇区数 */
 	unsigned int todo;
@@ -963,20 +1197,31 @@ PRIVATE int AtaTypeTransfer(struct IdeDevice *dev,
 
 	/* 保存读写操作 */
 	channel->what = rw;
+
+	cursor.segment = segments;
+	cursor.offset = 0;
 	
 	while (done < count) {
+		/* 选择传输模式（PIO或DMA） */
+		dma = dev->dma;
+
 		/* 获取要去操作的扇区数
-		由于一次最大只能操作256个扇区，这里用256作为分界
+		由于一次最大只能操作256个扇区，这里用256作为分界，
+		DMA一次最多传输反弹缓冲区大小的扇区
 		 */
-		if ((done + 256) <= count) {
-			todo = 256;
-		} else {
-			todo = count - done;
+		todo = MIN(count - done, dma ? IDE_DMA_MAX_SECTORS : 256);
+
+		/* 准备DMA的描述符表，失败就用PIO传输 */
+		if (dma && IdeDmaPrepare(channel, &cursor, todo, &bounced))
+			dma = 0;
+		if (dma) {
+			if (bounced && rw == IDE_WRITE) {
+				struct IdeTransferCursor tmp = cursor;
+				CursorCopy(&tmp, channel->bounce, todo, 1);
+			}
+			IdeDmaSetup(channel, rw);
 		}
 
-		/* 选择传输模式（PIO或DMA） */
-		dma = 0; // We don't support DMA
-
 		/* 选择寻址模式 */
 		// (I) Select one from LBA28, LBA48 or CHS;
 		SelectAddressingMode(dev, lba + done, &mode, &head, lbaIO);
@@ -988,7 +1233,7 @@ PRIVATE int AtaTypeTransfer(struct IdeDevice *dev,
 		SelectDevice(dev, mode, head);
 
 		/* 填写参数，扇区和扇区数 */
-		SelectSector(dev, mode, lbaIO, count);
+		SelectSector(dev, mode, lbaIO, todo);
 
 		/* 等待磁盘控制器处于准备状态 */
 		while (!(In8(ATA_REG_STATUS(channel)) & ATA_STATUS_READY)) CpuNop();
@@ -1010,17 +1255,32 @@ PRIVATE int AtaTypeTransfer(struct IdeDevice *dev,
 
 		/* 根据不同的模式传输数据 */
 		if (dma) {	/* DMA模式 */
+			if ((err = IdeDmaWait(dev, rw))) {
+				/* DMA出错，以后这个设备都使用PIO，这次的扇区也用PIO重新传输 */
+				printk(PART_WARRING "ide: dma transfer failed, fall back to pio.\n");
+				dev->dma = 0;
+				ResetDriver(dev);
+				continue;
+			}
 			if (rw == IDE_READ) {
-				// DMA Read.
+				if (bounced)
+					CursorCopy(&cursor, channel->bounce, todo, 0);
+				else
+					CursorSkip(&cursor, todo);
 			} else {
-				// DMA Write.
+				CursorSkip(&cursor, todo);
+				/* 刷新写缓冲区 */
+				Out8(ATA_REG_CMD(channel), mode > 1 ?
+					ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+				IdePolling(channel, 0);
 			}
+			done += todo;
 		} else {
 			/* PIO模式数据传输 */
-			if ((err = PioDataTransfer(dev, rw, mode, _buf, todo))) {
+			if ((err = PioDataTransfer(dev, rw, mode, &cursor, todo))) {
+				SyncUnlock(&channel->lock);
 				return err;
 			}
-			_buf += todo * SECTOR_SIZE;
 			done += todo;
 		}
 	}
@@ -1030,18 +1290,20 @@ PRIVATE int AtaTypeTransfer(struct IdeDevice *dev,
 }
 
 /**
- * IdeReadSector - 读扇区
+ * IdeSegmentTransfer - 分段读写扇区
  * @dev: 设备
+ * @rw: 传输方向（读，写）
  * @lba: 逻辑扇区地址
  * @count: 扇区数
- * @buf: 扇区缓冲
+ * @segments: 扇区缓冲段
  * 
- * 数据读取磁盘，成功返回0，失败返回-1
+ * 成功返回0，失败返回-1
  */
-PRIVATE int IdeReadSector(struct IdeDevice *dev,
+PRIVATE int IdeSegmentTransfer(struct IdeDevice *dev,
+	unsigned char rw,
 	unsigned int lba,
-	void *buf,
-	unsigned int count)
+	unsigned int count,
+	struct RequestSegment *segments)
 {
 	unsigned char error;
 	/* 检查设备是否正确 */
@@ -1056,18 +1318,40 @@ PRIVATE int IdeReadSector(struct IdeDevice *dev,
 		/* 进行磁盘访问 */
 
 		/*如果类型是ATA*/
-			error = AtaTypeTransfer(dev, IDE_READ, lba, count, buf);
+			error = AtaTypeTransfer(dev, rw, lba, count, segments);
 		/*如果类型是ATAPI*/
 		
 		/* 打印驱动错误信息 */
 		if(IdePrintError(dev, error)) {
-			printk("ide read error!\n");
+			printk("ide %s error!\n", rw == IDE_READ ? "read" : "write");
             return -1;
 		}
 	}
 	return 0;
 }
 
+/**
+ * IdeReadSector - 读扇区
+ * @dev: 设备
+ * @lba: 逻辑扇区地址
+ * @count: 扇区数
+ * @buf: 扇区缓冲
+ * 
+ * 数据读取磁盘，成功返回0，失败返回-1
+ */
+PRIVATE int IdeReadSector(struct IdeDevice *dev,
+	unsigned int lba,
+	void *buf,
+	unsigned int count)
+{
+	/* 连续的缓冲只有一段 */
+	struct RequestSegment segment;
+	segment.buffer = buf;
+	segment.count = count;
+
+	return IdeSegmentTransfer(dev, IDE_READ, lba, count, &segment);
+}
+
 /**
  * IdeWriteSector - 写扇区
  * @dev: 设备
@@ -1082,25 +1366,11 @@ PRIVATE int IdeWriteSector(struct IdeDevice *dev,
 	void *buf,
 	unsigned int count)
 {
-	unsigned char error;
-	/* 检查设备是否正确 */
-	if (dev < devices || dev >= &devices[3] || dev->reserved == 0) {
-		return -1;
-	} else if (lba + count > dev->size && dev->type == IDE_ATA) {
-		return -1;
-	} else {
-		/* 进行磁盘访问，如果出错，就 */
-		
-		/*如果类型是ATA*/
-			error = AtaTypeTransfer(dev, IDE_WRITE, lba, count, buf);
-		/*如果类型是ATAPI*/
+	struct RequestSegment segment;
+	segment.buffer = buf;
+	segment.count = count;
 
-		/* 打印驱动错误信息 */
-		if(IdePrintError(dev, error)) {
-			return -1;
-		}
-	}
-	return 0;
+	return IdeSegmentTransfer(dev, IDE_WRITE, lba, count, &segment);
 }
 
 /**
@@ -1157,18 +1427,12 @@ PRIVATE void DoBlockRequest(struct RequestQueue *q)
 		printk("dev %s: ", rq->disk->diskName);
 		printk("queue %s waiter %s cmd %s disk lba %d\n",
 			q->requestList == &q->upRequestList ? "up" : "down",
-			rq->waiter->name, rq->cmd == BLOCK_READ ? "read" : "write", rq->lba);
+			rq->segments[0].waiter->name, rq->cmd == BLOCK_READ ? "read" : "write", rq->lba);
 		#endif
 
-		if (rq->cmd == BLOCK_READ) {
-            if (IdeReadSector(dev, rq->lba, rq->buffer, rq->count)) {
-                printk("ide write error!\n");   
-            }
-		} else {
-			if (IdeWriteSector(dev, rq->lba, rq->buffer, rq->count)) {
-                printk("ide write error!\n");   
-            }
-		}
+		/* 合并后的请求也只发送一次多扇区命令 */
+		IdeSegmentTransfer(dev, rq->cmd == BLOCK_READ ? IDE_READ : IDE_WRITE,
+			rq->lba, rq->count, rq->segments);
         
 		/* 结束当前请求 */
 		BlockEndRequest(rq, 0);
@@ -1215,6 +1479,13 @@ PRIVATE int IdeIoctl(struct Device *device, int cmd, int arg)
     case IDE_IO_BLKZE:	/* 获取块大小 */
         *((sector_t *)arg) = blkdev->blockSize;
 		break;
+	case IDE_IO_DMA:	/* 打开或关闭DMA */
+		if (arg && !dev->channel->bmBase) {
+			retval = -1;
+			break;
+		}
+		dev->dma = arg ? 1 : 0;
+		break;
 	default:
 		/* 失败 */
 		retval = -1;
@@ -1587,6 +1858,50 @@ PRIVATE void IdeTest()
 	#endif
 }
 
+/**
+ * IdeDmaInit - 初始化总线主控DMA
+ * @channelCnt: 使用的通道数
+ * 
+ * 通过PCI找到IDE控制器，它的BAR4是总线主控寄存器的基址。
+ * 找不到控制器或者磁盘不支持DMA时，继续使用PIO
+ */
+PRIVATE void IdeDmaInit(int channelCnt)
+{
+	struct PciDevice *pci = GetPciDeviceByClass(IDE_PCI_CLASS, IDE_PCI_SUBCLASS);
+	struct IdeChannel *channel;
+	struct IdeDevice *dev;
+	int i;
+
+	if (pci == NULL || pci->bar[4].type != PCI_BAR_TYPE_IO) {
+		printk(PART_WARRING "ide: no bus master controller, use pio mode.\n");
+		return;
+	}
+	EnablePciBusMastering(pci);
+
+	for (i = 0; i < channelCnt; i++) {
+		channel = &channels[i];
+		channel->prdt = kmalloc(IDE_PRD_MAX * sizeof(struct IdePrd), GFP_KERNEL);
+		channel->bounce = kmalloc(IDE_DMA_MAX_SECTORS * SECTOR_SIZE, GFP_KERNEL);
+		if (channel->prdt == NULL || channel->bounce == NULL) {
+			kfree(channel->prdt);
+			kfree(channel->bounce);
+			channel->prdt = NULL;
+			channel->bounce = NULL;
+			continue;
+		}
+		channel->bmBase = pci->bar[4].baseAddr + i * 8;
+	}
+
+	for (i = 0; i < MAX_IDE_DISK_NR; i++) {
+		dev = &devices[i];
+		/* 磁盘信息的第49个字的第8位表示支持DMA */
+		if (dev->reserved && dev->channel->bmBase && (dev->capabilities & 0x0100))
+			dev->dma = 1;
+	}
+	printk(PART_TIP "ide: bus master at %x, dma %s\n", pci->bar[4].baseAddr,
+		devices[0].dma ? "on" : "off");
+}
+
 /**
  * InitIdeDriver - 初始化IDE硬盘驱动
  */
@@ -1604,6 +1919,9 @@ PUBLIC int InitIdeDriver()
 		
         /* 驱动本身的初始化 */
 		IdeProbe(ideDiskFound);
+
+		/* 能够使用DMA就使用DMA */
+		IdeDmaInit(DIV_ROUND_UP(ideDiskFound, 2));
     
 		int status;
 		/* 块设备的初始化 */
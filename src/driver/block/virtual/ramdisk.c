@@ -105,6 +105,9 @@ PRIVATE void DoBlockRequest(struct RequestQueue *q)
 {
 	struct Request *rq;
 	struct RamdiskDevice *dev = q->queuedata;
+	struct RequestSegment *seg;
+	sector_t lba;
+	int i;
 
 	//printk("DoBlockRequest: start\n");
 
@@ -114,14 +117,19 @@ PRIVATE void DoBlockRequest(struct RequestQueue *q)
 		#ifdef _DEBUG_RAMDISK
 		printk("dev %s: ", rq->disk->diskName);
 		printk("queue %s waiter %s cmd %s disk lba %d\n",
-			q->requestList == &q->upRequestList ? "up" : "down", rq->waiter->name, rq->cmd == BLOCK_READ ? "read" : "write", rq->lba);
+			q->requestList == &q->upRequestList ? "up" : "down", rq->segments[0].waiter->name, rq->cmd == BLOCK_READ ? "read" : "write", rq->lba);
 		#endif
 
-		/* 执行单个扇区操作 */
-		if (rq->cmd == BLOCK_READ) {
-			RamdiskReadSector(dev, rq->lba, rq->buffer, rq->count);
-		} else {
-			RamdiskWriteSector(dev, rq->lba, rq->buffer, rq->count);
+		/* 依次操作请求中的每一段，各段的扇区是连续的 */
+		lba = rq->lba;
+		for (i = 0; i < rq->nrSegments; i++) {
+			seg = &rq->segments[i];
+			if (rq->cmd == BLOCK_READ) {
+				RamdiskReadSector(dev, lba, seg->buffer, seg->count);
+			} else {
+				RamdiskWriteSector(dev, lba, seg->buffer, seg->count);
+			}
+			lba += seg->count;
 		}
 
 		/* 结束当前请求 */
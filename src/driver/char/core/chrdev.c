@@ -13,8 +13,6 @@
 #include <char/char.h>
 #include <char/chr-dev.h>
 
-EXTERN struct List allDeviceListHead;
-
 /* 所有字符设备的队列 */
 LIST_HEAD(allCharDeviceList);
 
@@ -115,8 +113,8 @@ PUBLIC void AddCharDevice(struct CharDevice *chrdev)
     /* 添加到字符设备队列的最后面 */
     ListAddTail(&chrdev->list, &allCharDeviceList);
 
-    /* 添加到设备队列的最后面 */
-    ListAddTail(&chrdev->super.list, &allDeviceListHead);
+    /* 添加到设备队列和散列表 */
+    RegisterDevice(&chrdev->super);
 
     return;
 }
@@ -131,7 +129,8 @@ PUBLIC void DelCharDevice(struct CharDevice *chrdev)
 {
     ListDel(&chrdev->list);
 
-    ListDel(&chrdev->super.list);
+    /* 返回后可以释放字符设备 */
+    UnregisterDevice(&chrdev->super);
 }
 
 /**
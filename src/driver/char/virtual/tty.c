@@ -28,10 +28,9 @@
 
 /* TeleType 终端 */
 typedef struct TTY {
-    struct IoQueue ioqueue;     /* 输入输出队列，存放数据 */
+    struct IoQueue ioqueue;     /* 输入队列，每个单元是一个按键 */
     dev_t conDevno;             /* 对应的控制台的设备号 */
     struct CharDevice *chrdev;  /* 字符设备 */
-    int key;                    /* 设备按键 */
     pid_t holdPid;              /* 持有者进程 */
     int deviceID;               /* 设备ID，0~MAX_TTY_NR-1 */
     
@@ -319,9 +318,8 @@ PUBLIC void TTY_ProcessKey(TTY_t *tty, unsigned int key)
  */
 PRIVATE void TTY_PutKey(TTY_t *tty, u32 key)
 {
-    /* 把按键放入tty的io队列 */
-    IoQueuePut(&tty->ioqueue, key);
-    tty->key = key; /* 获取最新的key */
+    /* 把按键放入tty的io队列，满了就丢掉按键，不能阻塞输入 */
+    IoQueueTryPut(&tty->ioqueue, key);
 }
 /**
  * TTY_DoRead - tty执行读取操作
@@ -376,23 +374,24 @@ PRIVATE int TTY_Read(struct Device *device, unsigned int off, void *buffer, unsi
     struct CharDevice *chrdev = (struct CharDevice *)device;
     TTY_t *tty = (TTY_t *)chrdev->private;
     int retval = -1;
+    unsigned long key;
     /* 如果是当前控制台，才会进行键盘的读取 */
 	if (IS_CURRENT_TTY(tty)) {
 
         /* 如果是最后一个tty，就能直接读取数据 */
         if (tty->holdPid == CurrentTask()->pid || tty->deviceID == TTY_GRAPH_ID) {
-            if (len == 1) {
-                *(char *)buffer = (char )tty->key;
-            } else if (len == 2) {
-                *(short *)buffer = (short )tty->key;
-            } else if (len == 4) {
-                *(int *)buffer = (int )tty->key;
-            }
-            if (tty->key) {
+            /* 从输入队列取出一个按键，没有按键不等待 */
+            if (!IoQueueTryGet(&tty->ioqueue, &key) && key) {
+                if (len == 1) {
+                    *(char *)buffer = (char )key;
+                } else if (len == 2) {
+                    *(short *)buffer = (short )key;
+                } else if (len == 4) {
+                    *(int *)buffer = (int )key;
+                }
                 /* 获取按键成功 */
                 retval = 0;
             }
-            tty->key = IKEY_UNKNOWN;
             
         } else {
             /* 不是前台任务进行读取，就会产生SIGTTIN */
@@ -415,17 +414,14 @@ PRIVATE int TTY_Getc(struct Device *device)
     struct CharDevice *chrdev = (struct CharDevice *)device;
     TTY_t *tty = (TTY_t *)chrdev->private;
     
-    int key = IKEY_UNKNOWN;
+    unsigned long key = IKEY_UNKNOWN;
     /* 如果是当前控制台，才会进行键盘的读取 */
 	if (IS_CURRENT_TTY(tty)) {
         /* 如果是最后一个tty，就能直接读取数据 */
         if (tty->holdPid == CurrentTask()->pid || tty->deviceID == TTY_GRAPH_ID) {
-            //printk("getc");
-            /*if (!IoQueueEmpty(&tty->ioqueue)) {
-                key = IoQueueGet(&tty->ioqueue);
-            }*/
-            key = tty->key;
-            tty->key = IKEY_UNKNOWN;
+            /* 从输入队列取出一个按键，没有按键不等待 */
+            if (IoQueueTryGet(&tty->ioqueue, &key))
+                key = IKEY_UNKNOWN;
             
         } else {
             /* 不是前台任务进行读取，就会产生SIGTTIN */
@@ -565,11 +561,11 @@ PRIVATE int TTY_InitOne(TTY_t *tty)
 	/* 把字符设备添加到系统 */
 	AddCharDevice(tty->chrdev);
 
-    unsigned char *buf = kmalloc(IQ_BUF_LEN_8, GFP_KERNEL);
+    unsigned char *buf = kmalloc(IQ_BUF_LEN_32, GFP_KERNEL);
     if (buf == NULL)
         return -1;
-    /* 初始化io队列 */
-    IoQueueInit(&tty->ioqueue, buf, IQ_BUF_LEN_8, IQ_FACTOR_8);
+    /* 初始化io队列，按键带有标志，需要32位的单元 */
+    IoQueueInit(&tty->ioqueue, buf, IQ_BUF_LEN_32, IQ_FACTOR_32);
     
     /* 生成控制台设备号 */
     tty->holdPid = 0;
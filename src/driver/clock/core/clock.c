@@ -10,20 +10,22 @@
 #include <book/debug.h>
 #include <book/schedule.h>
 #include <book/task.h>
+#include <book/smp.h>
 #include <book/timer.h>
 #include <book/interrupt.h>
 #include <book/alarm.h>
 #include <book/kgc.h>
+#include <book/rcu.h>
+#include <book/threadpool.h>
 #include <block/block.h>
 #include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <clock/clocksource.h>
 #include <lib/time.h>
 #include <lib/math.h>
 
 #define CONFIG_TIMEZONE_AUTO 1 	/* 自动转换时区 */
 
-/* 1 ticks 对应的毫秒数 */
-#define MILLISECOND_PER_TICKS (1000 / HZ)
-
 /* ----驱动程序初始化文件导入---- */
 EXTERN void InitPitClockDriver();
 /* ----驱动程序初始化文件导入完毕---- */
@@ -154,63 +156,83 @@ PUBLIC void ClockChangeSystemDate()
 }
 
 /**
- * SleepByTicks - 休眠ticks时间
- * @sleepTicks: 要休眠多少个ticks
+ * SysMSleep - 以毫秒为单位进行休眠
  */
-PRIVATE void SleepByTicks(uint32_t sleepTicks)
+PUBLIC void SysMSleep(uint32_t msecond)
 {
-	/* 获取起始ticks，后面进行差值运算 */
-	uint32_t startTicks = systicks;
-
-	/* 如果最新ticks和开始ticks差值小于要休眠的ticks，就继续休眠 */
-	while (systicks - startTicks < sleepTicks) {
-		/* 让出cpu占用，相当于休眠 */
-		TaskYield();
-        //CpuNop();
-	}
+	/* 阻塞休眠，不再让出cpu空转 */
+	TaskUSleep(msecond * 1000);
 }
 
 /**
- 
- * SysMSleep - 以毫秒为单位进行休眠
+ * SysUSleep - 以微秒为单位进行休眠
+ * 
+ * 有高精度定时器时精度可以小于1个时钟节拍
  */
-PUBLIC void SysMSleep(uint32_t msecond)
+PUBLIC void SysUSleep(uint32_t usecond)
+{
+	TaskUSleep(usecond);
+}
+
+/**
+ * PerSecondKgcWork - 每秒的图形定时器工作
+ * @work: 工作
+ */
+PRIVATE void PerSecondKgcWork(struct PoolWork *work)
+{
+	KGC_TimerOccur();
+}
+
+/**
+ * PerSecondSyncWork - 每秒的磁盘同步工作
+ * @work: 工作
+ */
+PRIVATE void PerSecondSyncWork(struct PoolWork *work)
 {
-	/* 把毫秒转换成ticks */
-	uint32_t sleepTicks = DIV_ROUND_UP(msecond, MILLISECOND_PER_TICKS);
-	ASSERT(sleepTicks > 0);
-	/* 进行休眠 */
-	SleepByTicks(sleepTicks);
+	BlockDiskSync();
 }
 
+PRIVATE DEFINE_POOL_WORK(perSecondKgcWork, PerSecondKgcWork, POOL_PRIO_NORMAL);
+PRIVATE DEFINE_POOL_WORK(perSecondSyncWork, PerSecondSyncWork, POOL_PRIO_LOW);
+
 /**
  * WorkForPerSecond - 每秒需要执行的工作
  * 
+ * 系统时间马上更新，图形定时器和磁盘同步互不相关，放到线程池中执行，
+ * 慢的磁盘同步不会推迟其它工作。上一次还没有执行完的就跳过这一次
  */
 PRIVATE void WorkForPerSecond(Work_t *work)
 {
-    ClockChangeSystemDate();
-    KGC_TimerOccur();
-    BlockDiskSync();
+	ClockChangeSystemDate();
+	ThreadPoolQueueOrRun(&perSecondKgcWork);
+	ThreadPoolQueueOrRun(&perSecondSyncWork);
 }
 
 PRIVATE DECLEAR_WORK(perSecondWork, WorkForPerSecond);
 
+/* 定时器软中断上次处理到的systicks */
+PRIVATE clock_t timerSoftirqTicks;
+
 /* 定时器软中断处理 */
 PROTECT void TimerSoftirqHandler(struct SoftirqAction *action)
 {
+	/* 空闲时停止了时钟节拍，一次可能经过多个ticks */
+	clock_t now = systicks;
+	clock_t elapsed = now - timerSoftirqTicks;
+
 	/* 改变系统时间 */
-    if (systicks % HZ == 0) {  /* 1s更新一次 */
-        /* 唤醒每秒时间工作 */
-        ScheduleWork(&perSecondWork);
-    }
+	if (now / HZ != timerSoftirqTicks / HZ) {  /* 1s更新一次 */
+		/* 唤醒每秒时间工作 */
+		ScheduleWork(&perSecondWork);
+	}
+	timerSoftirqTicks = now;
 	
 	/* 更新闹钟 */
-    UpdateAlarmSystem();
+	UpdateAlarmSystem(elapsed);
 
 	/* 更新定时器 */
 	UpdateTimerSystem();
-    //printk("s");
+	//printk("s");
 }
 
 /* SchedSoftirqHandler - 调度程序软中断处理
@@ -224,18 +246,52 @@ PROTECT void SchedSoftirqHandler(struct SoftirqAction *action)
 
 	/* 检测内核栈是否溢出 */
 	ASSERT(current->stackMagic == TASK_STACK_MAGIC);
+
 	/* 更新任务调度 */
 	current->elapsedTicks++;
+
+	/* 处理器之间的负载均衡 */
+	ScheduleBalance();
+
+	/* 推进RCU的宽限期 */
+	RcuCheckCallbacks(current->cpu);
+
+	/* 在RCU读临界区中推迟了的抢占，再检查一次 */
+	if (cpus[current->cpu].needResched)
+		ActiveSoftirq(RESCHED_SOFTIRQ);
 	
-    /* 需要进行调度的时候才会去调度 */
+	/* 需要进行调度的时候才会去调度，在RCU读临界区中就等到下一个节拍 */
 	if (current->ticks <= 0) {
-		ScheduleInClock();
+		if (!current->rcuReadDepth)
+			ScheduleInClock();
 	} else {
 		
 		current->ticks--;
 	}
 }
 
+/* ReschedSoftirqHandler - 抢占检查软中断处理
+ * @action: 中断行为
+ * 
+ * 有比当前任务优先级更高的任务加入就绪队列时激活，
+ * 不用等到时间片用完，马上切换过去。
+ */
+PROTECT void ReschedSoftirqHandler(struct SoftirqAction *action)
+{
+	struct Cpu *cpu = CurrentCpu();
+
+	if (!cpu->needResched)
+		return;
+	
+	/* 在RCU读临界区中，推迟到下一个时钟节拍再检查 */
+	if (CurrentTask()->rcuReadDepth)
+		return;
+	cpu->needResched = 0;
+
+	if (ScheduleNeedPreempt(cpu))
+		ScheduleInClock();
+}
+
 /**
  * GetLocalTime - 获取本地时间
  * @time: 时间结构体
@@ -326,6 +382,12 @@ PUBLIC void InitClockSystem()
 
 	/* 初始化定时器 */
 	InitTimer();
+
+    InitClockEvent();
+
+    /* 先用时钟节拍计时，tsc可用时再切换 */
+    InitClockSource();
+    InitTsc();
     
     InitPitClockDriver();
 }
@@ -0,0 +1,365 @@
+/*
+ * file:		clock/core/clockevent.c
+ * auther:		Jason Hu
+ * time:		2020/3/9
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/config.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/interrupt.h>
+#include <book/timer.h>
+#include <book/alarm.h>
+#include <book/smp.h>
+#include <book/rcu.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <clock/clocksource.h>
+#include <lib/math.h>
+
+/* 每个处理器的时钟事件 */
+struct ClockEventCpu {
+    struct ClockEventDevice *dev;   /* 使用的设备 */
+    char oneshot;                   /* 设备工作在单次触发模式 */
+    char tickStopped;               /* 空闲时停止了时钟节拍 */
+    unsigned long long tickBase;    /* 最近一次计入的时钟节拍的时间（纳秒） */
+    unsigned long long idleUntil;   /* 停止节拍后下一次醒来的时间（纳秒） */
+    unsigned long idleTicks;        /* 醒来时对应的systicks */
+    struct List hrtimerList;        /* 高精度定时器，按到期时间排序 */
+};
+
+PRIVATE struct ClockEventCpu clockEventCpus[NR_CPUS];
+
+/**
+ * ClockEventHandleTicks - 处理经过的时钟节拍
+ * @ticks: 经过的节拍数
+ *
+ * systicks和定时器只在引导处理器上更新
+ */
+PRIVATE void ClockEventHandleTicks(unsigned long ticks)
+{
+    struct Cpu *cpu = CurrentCpu();
+
+    if (!cpu->id) {
+        systicks += ticks;
+        ActiveSoftirq(TIMER_SOFTIRQ);
+    }
+
+    /* 停止节拍期间的ticks也要计入负载均衡的间隔 */
+    if (ticks > 1)
+        cpu->balanceTicks = cpu->balanceTicks > ticks - 1 ?
+            cpu->balanceTicks - (ticks - 1) : 0;
+
+    ActiveSoftirq(SCHED_SOFTIRQ);
+}
+
+/**
+ * ClockEventTick - 计入到now为止的时钟节拍
+ * @ce: 处理器的时钟事件
+ * @now: 当前时间
+ */
+PRIVATE void ClockEventTick(struct ClockEventCpu *ce, unsigned long long now)
+{
+    unsigned long long ticks;
+
+    if (now < ce->tickBase + TICK_NSEC)
+        return;
+
+    ticks = now - ce->tickBase;
+    DivU64(&ticks, TICK_NSEC);
+    ce->tickBase += ticks * TICK_NSEC;
+
+    ClockEventHandleTicks((unsigned long)ticks);
+}
+
+/**
+ * ClockEventReprogram - 设置设备的下一个事件
+ * @ce: 处理器的时钟事件
+ * @now: 当前时间
+ *
+ * 下一个事件是下一个时钟节拍（停止节拍时是醒来的时间）和
+ * 最近的高精度定时器中更早的那个
+ */
+PRIVATE void ClockEventReprogram(struct ClockEventCpu *ce, unsigned long long now)
+{
+    struct ClockEventDevice *dev = ce->dev;
+    struct HrTimer *timer;
+    unsigned long long next, delta;
+
+    next = ce->tickStopped ? ce->idleUntil : ce->tickBase + TICK_NSEC;
+
+    if (!ListEmpty(&ce->hrtimerList)) {
+        timer = ListFirstOwner(&ce->hrtimerList, struct HrTimer, list);
+        if (timer->expires < next)
+            next = timer->expires;
+    }
+
+    delta = next > now ? next - now : 0;
+    if (delta > NSEC_PER_SEC)
+        delta = NSEC_PER_SEC;
+
+    /* 换算成设备的计数，向上取整，避免事件提前到来 */
+    delta = ((delta * dev->mult) >> 32) + 1;
+    if (delta < dev->minDelta)
+        delta = dev->minDelta;
+    if (delta > dev->maxDelta)
+        delta = dev->maxDelta;
+
+    dev->setNextEvent((unsigned long)delta, dev);
+}
+
+/**
+ * HrTimerRunExpired - 执行到期的高精度定时器
+ * @ce: 处理器的时钟事件
+ * @now: 当前时间
+ */
+PRIVATE void HrTimerRunExpired(struct ClockEventCpu *ce, unsigned long long now)
+{
+    struct HrTimer *timer;
+
+    while (!ListEmpty(&ce->hrtimerList)) {
+        timer = ListFirstOwner(&ce->hrtimerList, struct HrTimer, list);
+        if (timer->expires > now)
+            break;
+
+        /* 处理函数里面可以重新启动定时器 */
+        ListDelInit(&timer->list);
+        timer->function(timer->data);
+    }
+}
+
+/**
+ * ClockEventPeriodic - 周期触发的设备的中断处理
+ * @dev: 设备
+ */
+PRIVATE void ClockEventPeriodic(struct ClockEventDevice *dev)
+{
+    ClockEventHandleTicks(1);
+}
+
+/**
+ * ClockEventOneshot - 单次触发的设备的中断处理
+ * @dev: 设备
+ *
+ * 计入经过的时钟节拍，执行到期的高精度定时器，再设置下一个事件
+ */
+PRIVATE void ClockEventOneshot(struct ClockEventDevice *dev)
+{
+    struct ClockEventCpu *ce = &clockEventCpus[CurrentCpuId()];
+    unsigned long long now = ClockSourceNow();
+
+    /* 事件到来后就恢复节拍，还是空闲的话idle任务会再次停止 */
+    ce->tickStopped = 0;
+
+    ClockEventTick(ce, now);
+    HrTimerRunExpired(ce, now);
+    ClockEventReprogram(ce, ClockSourceNow());
+}
+
+/**
+ * ClockEventRegister - 注册时钟事件设备
+ * @cpu: 设备所在的处理器
+ * @dev: 设备
+ *
+ * 需要在设备所在的处理器上执行，如果处理器上已经有更好的设备就不使用。
+ * 时钟源在停止节拍时也能计时，支持单次触发的设备才工作在单次触发模式
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int ClockEventRegister(int cpu, struct ClockEventDevice *dev)
+{
+    struct ClockEventCpu *ce = &clockEventCpus[cpu];
+    struct ClockEventDevice *old = ce->dev;
+
+    if (old && old->rating >= dev->rating)
+        return -1;
+
+    unsigned long flags = InterruptSave();
+
+    if (old && old->shutdown)
+        old->shutdown(old);
+
+    ce->dev = dev;
+    ce->tickStopped = 0;
+
+    if ((dev->features & CLOCK_EVT_FEAT_ONESHOT) && ClockSourceContinuous()) {
+        ce->oneshot = 1;
+        dev->eventHandler = ClockEventOneshot;
+        ce->tickBase = ClockSourceNow();
+        ClockEventReprogram(ce, ce->tickBase);
+    } else {
+        ce->oneshot = 0;
+        dev->eventHandler = ClockEventPeriodic;
+        dev->setPeriodic(dev);
+    }
+
+    InterruptRestore(flags);
+
+    /* 应用处理器启动时还没有获取大内核锁，不输出信息 */
+    if (!cpu)
+        printk(PART_TIP "clockevent: use %s in %s mode\n", dev->name,
+            ce->oneshot ? "oneshot" : "periodic");
+    return 0;
+}
+
+/**
+ * ClockEventIdleEnter - 处理器进入空闲
+ *
+ * 在idle任务中关闭中断后调用，把下一个事件推迟到需要处理的时候。
+ * 引导处理器要处理定时器、闹钟和每秒的工作，其它处理器只需要做负载均衡
+ */
+PUBLIC void ClockEventIdleEnter()
+{
+    struct Cpu *cpu = CurrentCpu();
+    struct ClockEventCpu *ce = &clockEventCpus[cpu->id];
+    unsigned long limit, ticks;
+
+    if (!ce->oneshot || ce->tickStopped)
+        return;
+
+    /* RCU还需要时钟节拍推进宽限期 */
+    if (RcuNeedsCpu(cpu->id))
+        return;
+
+    /* 有多个处理器时需要按时醒来做负载均衡 */
+    limit = cpuOnlineNr > 1 ? cpu->balanceTicks + 1 : HZ;
+
+    if (!cpu->id) {
+        /* 每秒的工作 */
+        limit = MIN(limit, HZ - systicks % HZ);
+        limit = AlarmNextExpiry(limit);
+        ticks = TimerNextExpiry(limit) - systicks;
+        ce->idleTicks = systicks + ticks;
+    } else {
+        ticks = limit;
+    }
+
+    /* 下一个节拍就有事情要做，不用停止 */
+    if (ticks <= 1)
+        return;
+
+    ce->tickStopped = 1;
+    ce->idleUntil = ce->tickBase + (unsigned long long)ticks * TICK_NSEC;
+    ClockEventReprogram(ce, ClockSourceNow());
+}
+
+/**
+ * ClockEventIdleExit - 处理器退出空闲
+ *
+ * 空闲时被其它中断唤醒，在处理软中断前调用，补上停止期间的时钟节拍，
+ * 恢复周期的节拍，这样唤醒的任务才有时间片轮转
+ */
+PUBLIC void ClockEventIdleExit()
+{
+    struct ClockEventCpu *ce = &clockEventCpus[CurrentCpuId()];
+    unsigned long long now;
+
+    if (!ce->tickStopped)
+        return;
+    ce->tickStopped = 0;
+
+    now = ClockSourceNow();
+    ClockEventTick(ce, now);
+    ClockEventReprogram(ce, now);
+}
+
+/**
+ * ClockEventTimerAdded - 添加了一个定时器
+ * @expires: 定时器到期的systicks
+ *
+ * 定时器在引导处理器上处理，如果它停止了节拍，并且会在定时器到期之后
+ * 才醒来，就唤醒它重新计算
+ */
+PUBLIC void ClockEventTimerAdded(unsigned long expires)
+{
+    struct ClockEventCpu *ce = &clockEventCpus[0];
+
+    if (CurrentCpuId() && ce->tickStopped && (long)(expires - ce->idleTicks) < 0)
+        SmpReschedule(0);
+}
+
+/**
+ * HrTimerInit - 初始化高精度定时器
+ * @timer: 定时器
+ * @function: 到期时执行的函数，在中断中执行
+ * @data: 传递的参数
+ */
+PUBLIC void HrTimerInit(struct HrTimer *timer,
+        void (*function)(unsigned long), unsigned long data)
+{
+    INIT_LIST_HEAD(&timer->list);
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+    timer->cpu = -1;
+}
+
+/**
+ * HrTimerStart - 启动高精度定时器
+ * @timer: 定时器
+ * @expires: 到期时间（ClockSourceNow的纳秒数）
+ *
+ * 定时器放在当前处理器上，需要单次触发的设备
+ * 成功返回0，不支持高精度定时器时返回-1
+ */
+PUBLIC int HrTimerStart(struct HrTimer *timer, unsigned long long expires)
+{
+    struct ClockEventCpu *ce;
+    struct HrTimer *pos;
+
+    unsigned long flags = InterruptSave();
+
+    ce = &clockEventCpus[CurrentCpuId()];
+    if (!ce->oneshot) {
+        InterruptRestore(flags);
+        return -1;
+    }
+
+    ASSERT(ListEmpty(&timer->list));
+
+    timer->expires = expires;
+    timer->cpu = CurrentCpuId();
+
+    /* 按到期时间插入，放在第一个更晚到期的定时器前面 */
+    ListForEachOwner(pos, &ce->hrtimerList, list) {
+        if (pos->expires > expires)
+            break;
+    }
+    ListAddTail(&timer->list, &pos->list);
+
+    /* 成为最早到期的定时器时，需要提前下一个事件 */
+    if (ce->hrtimerList.next == &timer->list)
+        ClockEventReprogram(ce, ClockSourceNow());
+
+    InterruptRestore(flags);
+    return 0;
+}
+
+/**
+ * HrTimerCancel - 取消高精度定时器
+ * @timer: 定时器
+ *
+ * 已经到期的定时器什么也不做，设备上的事件不用修改，到来时会重新计算
+ */
+PUBLIC void HrTimerCancel(struct HrTimer *timer)
+{
+    unsigned long flags = InterruptSave();
+
+    ListDelInit(&timer->list);
+
+    InterruptRestore(flags);
+}
+
+/**
+ * InitClockEvent - 初始化时钟事件
+ */
+PUBLIC void InitClockEvent()
+{
+    int i;
+    for (i = 0; i < NR_CPUS; i++) {
+        clockEventCpus[i].dev = NULL;
+        clockEventCpus[i].oneshot = 0;
+        clockEventCpus[i].tickStopped = 0;
+        INIT_LIST_HEAD(&clockEventCpus[i].hrtimerList);
+    }
+}
@@ -0,0 +1,132 @@
+/*
+ * file:		clock/core/clocksource.c
+ * auther:		Jason Hu
+ * time:		2020/3/10
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/debug.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <clock/clocksource.h>
+#include <lib/math.h>
+
+/* 当前使用的时钟源 */
+PRIVATE struct ClockSource *currentClockSource;
+
+/* 切换时钟源时的计数和对应的纳秒数，保证时间不会倒退 */
+PRIVATE unsigned long long clockSourceBase;
+PRIVATE unsigned long long clockSourceNsBase;
+
+/**
+ * JiffiesRead - 读取时钟节拍
+ */
+PRIVATE unsigned long long JiffiesRead()
+{
+    return systicks;
+}
+
+/* 时钟节拍，没有其它时钟源时使用，精度是1个节拍 */
+PRIVATE struct ClockSource jiffiesClockSource = {
+    .name = "jiffies",
+    .rating = 1,
+    .flags = 0,
+    .read = JiffiesRead,
+    .mult = TICK_NSEC,
+    .shift = 0,
+};
+
+/**
+ * ClockSourceCyclesToNs - 把时钟源的计数转换成纳秒
+ * @cs: 时钟源
+ * @cycles: 计数
+ *
+ * 分成高低32位分别相乘，避免64位乘法溢出，shift不能大于32
+ */
+PRIVATE INLINE unsigned long long ClockSourceCyclesToNs(struct ClockSource *cs,
+        unsigned long long cycles)
+{
+    uint32_t high = (uint32_t)(cycles >> 32);
+    uint32_t low = (uint32_t)cycles;
+
+    return (((unsigned long long)low * cs->mult) >> cs->shift) +
+        (((unsigned long long)high * cs->mult) << (32 - cs->shift));
+}
+
+/**
+ * ClockSourceNow - 获取开机后经过的纳秒数
+ */
+PUBLIC unsigned long long ClockSourceNow()
+{
+    struct ClockSource *cs = currentClockSource;
+
+    return clockSourceNsBase + ClockSourceCyclesToNs(cs, cs->read() - clockSourceBase);
+}
+
+/**
+ * ClockSourceContinuous - 当前的时钟源是否在停止时钟节拍时也能计时
+ *
+ * 只有这样才能使用单次触发的时钟事件
+ */
+PUBLIC int ClockSourceContinuous()
+{
+    return currentClockSource->flags & CLOCK_SOURCE_CONTINUOUS;
+}
+
+/**
+ * ClockSourceRegister - 注册时钟源
+ * @cs: 时钟源
+ *
+ * 比当前的时钟源更好就切换过去，从当前时间继续计时
+ * 切换了返回0，否则返回-1
+ */
+PUBLIC int ClockSourceRegister(struct ClockSource *cs)
+{
+    if (currentClockSource && currentClockSource->rating >= cs->rating)
+        return -1;
+
+    unsigned long flags = InterruptSave();
+
+    if (currentClockSource)
+        clockSourceNsBase = ClockSourceNow();
+    clockSourceBase = cs->read();
+    currentClockSource = cs;
+
+    InterruptRestore(flags);
+
+    printk(PART_TIP "clocksource: switched to %s\n", cs->name);
+    return 0;
+}
+
+/**
+ * SysClockGetTime - 获取时钟的时间
+ * @clockid: 时钟的类型，现在只支持CLOCK_MONOTONIC
+ * @ts: 保存时间
+ *
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SysClockGetTime(clockid_t clockid, struct timespec *ts)
+{
+    unsigned long long ns;
+
+    if (clockid != CLOCK_MONOTONIC || ts == NULL)
+        return -1;
+
+    ns = ClockSourceNow();
+    ts->tv_nsec = DivU64(&ns, NSEC_PER_SEC);
+    ts->tv_sec = ns;
+    return 0;
+}
+
+/**
+ * InitClockSource - 初始化时钟源
+ *
+ * 先使用时钟节拍计时，有更好的时钟源时再切换
+ */
+PUBLIC void InitClockSource()
+{
+    currentClockSource = NULL;
+    clockSourceNsBase = 0;
+    ClockSourceRegister(&jiffiesClockSource);
+}
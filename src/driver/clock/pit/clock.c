@@ -12,9 +12,11 @@
 #include <lib/stddef.h>
 #include <clock/clock.h>
 #include <clock/pit/clock.h>
+#include <clock/clockevent.h>
 
 EXTERN void TimerSoftirqHandler(struct SoftirqAction *action);
 EXTERN void SchedSoftirqHandler(struct SoftirqAction *action);
+EXTERN void ReschedSoftirqHandler(struct SoftirqAction *action);
 
 /* 时钟产生频率增快，默认是1，最大时10，表示增大10倍，现在的linux内核都是10
 我们约定，当有图形界面的时候把它设置为5~10，没有的时候设置为1~5
@@ -22,26 +24,32 @@ EXTERN void SchedSoftirqHandler(struct SoftirqAction *action);
 
 #define COUNTER0_VALUE  (TIMER_FREQ / HZ)	    //pit count0 数值
 
+PRIVATE void PitSetPeriodic(struct ClockEventDevice *dev);
+PRIVATE void PitShutdown(struct ClockEventDevice *dev);
+
+/* pit只作为周期触发的设备使用，有本地APIC定时器后就不再使用 */
+PRIVATE struct ClockEventDevice pitClockEvent = {
+    .name = "pit",
+    .features = CLOCK_EVT_FEAT_PERIODIC,
+    .rating = 100,
+    .setPeriodic = PitSetPeriodic,
+    .shutdown = PitShutdown,
+};
+
 /**
  * ClockHandler - 时钟中断处理函数
  */
 PRIVATE void ClockHandler(unsigned int irq, unsigned int data)
 {
-    /* 改变ticks计数 */
-	systicks++;
-	
-	/* 激活定时器软中断 */
-	ActiveSoftirq(TIMER_SOFTIRQ);
-
-	/* 激活调度器软中断 */
-	ActiveSoftirq(SCHED_SOFTIRQ);
-	
+    /* 由时钟事件层改变ticks计数，激活定时器和调度器软中断 */
+    pitClockEvent.eventHandler(&pitClockEvent);
 }
 
 /**
- * InitPitClockDriver - 初始化时钟管理
+ * PitSetPeriodic - 让pit周期产生时钟中断
+ * @dev: 设备
  */
-PUBLIC void InitPitClockDriver()
+PRIVATE void PitSetPeriodic(struct ClockEventDevice *dev)
 {
 	//初始化时钟
 	Out8(PIT_CTRL, PIT_MODE_2 | PIT_MODE_MSB_LSB | 
@@ -53,6 +61,25 @@ PUBLIC void InitPitClockDriver()
 	Out8(PIT_COUNTER0, 0x2e);
     printk("timer value:%x , %x\n", COUNTER0_VALUE, (0x2e << 8) | 0x9c);
     */
+
+	/* 注册时钟中断并打开中断 */	
+	RegisterIRQ(IRQ0_CLOCK, &ClockHandler, IRQF_DISABLED, "clockirq", "clock", 0);
+}
+
+/**
+ * PitShutdown - 停止pit的时钟中断
+ * @dev: 设备
+ */
+PRIVATE void PitShutdown(struct ClockEventDevice *dev)
+{
+    UnregisterIRQ(IRQ0_CLOCK, 0);
+}
+
+/**
+ * InitPitClockDriver - 初始化时钟管理
+ */
+PUBLIC void InitPitClockDriver()
+{
 	systicks = 0;
 
 	/* 注册定时器软中断处理 */
@@ -61,7 +88,9 @@ PUBLIC void InitPitClockDriver()
 	/* 注册定时器软中断处理 */
 	BuildSoftirq(SCHED_SOFTIRQ, SchedSoftirqHandler);
 
-	/* 注册时钟中断并打开中断 */	
-	RegisterIRQ(IRQ0_CLOCK, &ClockHandler, IRQF_DISABLED, "clockirq", "clock", 0);
+	/* 注册抢占检查软中断处理 */
+	BuildSoftirq(RESCHED_SOFTIRQ, ReschedSoftirqHandler);
 
+	/* 作为引导处理器的时钟事件设备 */
+	ClockEventRegister(0, &pitClockEvent);
 }
@@ -172,6 +172,29 @@ PUBLIC struct PciDevice* GetPciDevice(uint16 vendorID, uint16 deviceID)
     return NULL;
 }
 
+/**
+ * GetPciDeviceByClass - 根据类代码获取PCI设备
+ * @classCode: 类代码
+ * @subClass: 子类代码
+ * 
+ * 不关心厂商的通用设备（例如IDE控制器）通过类代码查找，没找到返回NULL
+ */
+PUBLIC struct PciDevice *GetPciDeviceByClass(uint8 classCode, uint8 subClass)
+{
+	int i;
+	struct PciDevice* device;
+	
+	for (i = 0; i < PCI_MAX_DEVICE_NR; i++) {
+		device = &pciDeviceTable[i];
+		if (device->status == PCI_DEVICE_STATUS_USING &&
+			((device->classCode >> 16) & 0xff) == classCode &&
+			((device->classCode >> 8) & 0xff) == subClass) {
+			return device;
+		}
+	}
+    return NULL;
+}
+
 PUBLIC void EnablePciBusMastering(struct PciDevice *device)
 {
     uint32 val = PciRead(device->bus, device->dev, device->function, PCI_STATUS_COMMAND);
@@ -13,6 +13,10 @@
 #include <book/list.h>
 #include <book/semaphore.h>
 #include <book/device.h>
+#include <lib/const.h>
+#include <lib/mman.h>
+#include <lib/string.h>
+#include <clock/clock.h>
 
 #include <block/block.h>
 #include <block/blk-dev.h>
@@ -24,8 +28,35 @@
  * 
  * 缓冲头是用于对单次磁盘块读写的描述
  */
+/* 缓冲区占用的内存上限，超过后回收最久没有使用的缓冲区 */
+#define BUFFER_CACHE_MAX_SIZE   (4 * MB)
+
+/* 哈希表的大小，需要是2的次幂 */
+#define BUFFER_HASH_SIZE        1024
+
+/* 一次回收最多扫描的轮数，防止写回一直失败时无法返回 */
+#define BUFFER_RECLAIM_TRIES    32
+
+/* 脏缓冲超过这个时间（ticks）后，写回线程会把它写回 */
+#define BUFFER_DIRTY_EXPIRE     (5 * HZ)
+
+/* 脏缓冲占预算的百分比超过后，写回线程写回所有脏缓冲 */
+#define BUFFER_DIRTY_BACKGROUND_RATIO   10
+
+/* 脏缓冲占预算的百分比超过后，写入者需要自己写回一批 */
+#define BUFFER_DIRTY_RATIO      20
+
+/* 一次批量读写的最多缓冲数 */
+#define BUFFER_BATCH_MAX        64
+
+/* 每批写回的缓冲数，以及写回线程和同步时最多写回的批数 */
+#define BUFFER_WRITEBACK_BATCH  BUFFER_BATCH_MAX
+#define BUFFER_WRITEBACK_ROUNDS 16
+#define BUFFER_SYNC_ROUNDS      1024
+
 struct BufferHead {
-    struct List list;
+    struct List list;       // LRU链表，最近使用的在末尾
+    struct List hashList;   // 哈希链表
     char uptodate;      // 读取了新的数据
     char dirty;         // 写入了新数据
     char locked;       // 上锁
@@ -37,6 +68,8 @@ struct BufferHead {
     size_t size;        // 缓冲区大小
 
     struct BlockDevice *device; // 设备指针
+    clock_t dirtyTime;          // 变脏的时间
+    unsigned long long lockTime;    // 上锁的时间，用于锁统计
 
     void *private;  // 私有数据
     Atomic_t count; // 使用者计数
@@ -45,17 +78,39 @@ struct BufferHead {
 
 #define SIZEOF_BUFFER_HEAD sizeof(struct BufferHead)
 
+/* 块缓冲的统计信息 */
+struct BufferCacheStat {
+    unsigned long buffers;      /* 缓冲区数量 */
+    unsigned long size;         /* 缓冲区占用的内存 */
+    unsigned long hits;         /* 读取时命中的次数 */
+    unsigned long misses;       /* 读取时需要访问磁盘的次数 */
+    unsigned long evictions;    /* 回收的缓冲区数 */
+    unsigned long writebacks;   /* 回收前写回的脏缓冲区数 */
+    unsigned long dirty;        /* 脏缓冲区数量 */
+    unsigned long dirtySize;    /* 脏缓冲区占用的内存 */
+    unsigned long flushed;      /* 写回线程写回的缓冲区数 */
+    unsigned long throttled;    /* 写入者被限制的次数 */
+};
+
 PUBLIC struct BufferHead *Bread(dev_t dev, sector_t block);
+PUBLIC int BreadBlocks(dev_t devno, sector_t *blocks, int count, struct BufferHead **bhs);
+PUBLIC int BlockReadBlocks(dev_t devno, sector_t *blocks, int count, void *buffer);
 PUBLIC struct BufferHead *Bwrite(dev_t dev, sector_t block, void *buffer);
+PUBLIC void Brelease(struct BufferHead *bh);
 PUBLIC int BsyncOne(struct BufferHead *bh);
+PUBLIC void ClearBufferDirty(struct BufferHead *bh);
+PUBLIC void WakeupBufferWriteback();
 PUBLIC int Bsync();
 PUBLIC int DirtyCheck();
 
 PUBLIC void DumpBH(struct BufferHead *bh);
+PUBLIC int InitBlockBuffer();
 
 PUBLIC void LockBuffer(struct BufferHead *bh);
 PUBLIC void UnlockBuffer(struct BufferHead *bh);
 
+PUBLIC int SysBufferStat(bufstat_t *buf);
+
 
 STATIC INLINE void GetBH(struct BufferHead *bh)
 {
@@ -80,6 +135,7 @@ STATIC INLINE int BlockRead(dev_t devno, sector_t block,void *buffer)
     struct BufferHead *bh = Bread(devno, block);
     if (bh) {
         memcpy(buffer, bh->data, bh->size);
+        Brelease(bh);
         return 0;
     }
     return -1;
@@ -97,10 +153,13 @@ STATIC INLINE int BlockWrite(dev_t devno, sector_t block, void *buffer, char syn
 {
     struct BufferHead *bh = Bwrite(devno, block, buffer);
     
+    int ret = 0;
+
     if (bh) {
         if (sync) 
-            return BsyncOne(bh);
-        return 0;
+            ret = BsyncOne(bh);
+        Brelease(bh);
+        return ret;
     }
     return -1;
 }
@@ -51,7 +51,6 @@ struct Disk {
     sector_t capacity;      /* 磁盘扇区数 */
     struct BlockDevice *blkdev; /* 磁盘对应的块设备 */
     int flags;       
-    struct List bufferHeadList;   /* 缓冲头链表 */
 };
 
 #define SIZEOF_DISK     sizeof(struct Disk)
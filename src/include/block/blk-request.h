@@ -15,6 +15,23 @@
 #include <block/block.h>
 #include <block/blk-buffer.h>
 
+/* 一个请求最多合并的缓冲数 */
+#define REQUEST_MAX_SEGMENTS    64
+
+/* 一个请求最多操作的扇区数 */
+#define REQUEST_MAX_SECTORS     256
+
+/**
+ * 请求段，一个缓冲对应一段，合并后的请求由多段组成，
+ * 各段的扇区在磁盘上是连续的，但是数据缓冲不连续
+ */
+struct RequestSegment {
+    char *buffer;               /* 这一段的数据缓冲 */
+    unsigned long count;        /* 这一段的扇区数 */
+    struct BufferHead *bh;      /* 对应的缓冲头 */
+    struct Task *waiter;        /* 等待这一段完成的任务 */
+};
+
 /**
  * 请求是每一次操作的请求 
  */
@@ -27,10 +44,9 @@ struct Request {
     int cmd;        // 命令（读或写）
     int errors;     // 错误数
     sector_t lba;    //逻辑块地址
-    unsigned long count;    // 操作的块数
-    char *buffer;       // 读写用到的buffer
-    struct BufferHead *bh;
-    struct Task *waiter;
+    unsigned long count;    // 操作的扇区数（所有段的和）
+    int nrSegments;         // 段数
+    struct RequestSegment segments[REQUEST_MAX_SEGMENTS];
 };
 #define SIZEOF_REQUEST sizeof(struct Request)
 
@@ -61,6 +77,7 @@ PUBLIC struct RequestQueue *BlockInitQueue(RequestFunction_t callback, void *que
 PUBLIC void BlockCleanUpQueue(struct RequestQueue *request);
 
 PUBLIC void MakeRequest(int major, int rw, struct BufferHead *bh);
+PUBLIC void MakeRequestBatch(int rw, struct BufferHead **bhs, int count);
 
 /* 提取请求队列 */
 PUBLIC struct Request *BlockFetchRequest(struct RequestQueue *queue);
@@ -73,4 +90,6 @@ PUBLIC void BlockEndRequest(struct Request *request, int errors);
 
 PUBLIC void DumpRequestQueue(struct RequestQueue *queue);
 
+PUBLIC int InitBlockRequest();
+
 #endif   /* _BLOCK_REQUEST_H */
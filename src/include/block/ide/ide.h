@@ -17,6 +17,7 @@ enum {
 	IDE_IO_CLEAN = 1,
     IDE_IO_SECTORS,
     IDE_IO_BLKZE,
+    IDE_IO_DMA,         /* 参数为1打开DMA，为0使用PIO */
 	IDE_IO_NR,
 };
 
@@ -11,7 +11,8 @@
 #include <lib/stdint.h>
 #include <lib/types.h>
 
-PUBLIC void UpdateAlarmSystem();
+PUBLIC void UpdateAlarmSystem(unsigned long ticks);
+PUBLIC unsigned long AlarmNextExpiry(unsigned long limit);
 PUBLIC unsigned int SysAlarm(unsigned int seconds);
 
 #endif   /* _BOOK_ALARM_H */
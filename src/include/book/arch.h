@@ -24,6 +24,9 @@
    #include "../arch/x86/include/kernel/intel8255.h"
    #include "../arch/x86/include/kernel/dma.h"
    #include "../arch/x86/include/kernel/power.h"
+   #include "../arch/x86/include/kernel/apic.h"
+   #include "../arch/x86/include/kernel/tsc.h"
+   #include "../arch/x86/include/kernel/smp.h"
    #include "../arch/x86/include/mm/page.h"
    #include "../arch/x86/include/mm/phymem.h"
    #include "../arch/x86/include/mm/ioremap.h"
@@ -105,4 +105,20 @@ PRIVATE INLINE unsigned int TestAndSetBit(int nr, unsigned int *addr)
    return old;  
 }
 
+/**
+ * FindFirstSet - 查找第一个为1的位
+ * @word: 要查找的值
+ * 
+ * 返回最低的为1的位的位置(0-31)，如果值为0就返回-1
+ */
+PRIVATE INLINE int FindFirstSet(unsigned int word)
+{
+   int bit;
+
+   if (!word)
+      return -1;
+   __asm__ __volatile__ ("bsfl %1, %0" : "=r" (bit) : "rm" (word));
+   return bit;
+}
+
 #endif   /*_BOOK_BITOPS_H*/
@@ -46,9 +46,22 @@
  * ------------------------
  */
 
+#define CONFIG_SMP          /* 配置对称多处理，启动所有的处理器 */
+#define CONFIG_NR_CPUS  8   /* 最多支持的处理器数量 */
+
+#ifdef CONFIG_SMP
+#define NR_CPUS CONFIG_NR_CPUS
+#else
+#define NR_CPUS 1
+#endif
+
+//#define CONFIG_TSC_RELIABLE /* 没有invariant标志也使用tsc计时（虚拟机中通常没有这个标志） */
+
 #define CONFIG_SEMAPHORE_M /* 配置多元信号量（Multivariate semaphore） */
 //#define CONFIG_SEMAPHORE_B /* 配置二元信号量（Binary semaphore） */
 
+#define CONFIG_LOCK_STAT    /* 统计睡眠锁的获取次数、竞争次数、等待时间和持有时间 */
+
 /* 3大设备模块 */
 #define CONFIG_BLOCK_DEVICE     /* 配置块设备模块 */
 #define CONFIG_CHAR_DEVICE      /* 配置字符设备模块 */
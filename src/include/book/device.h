@@ -118,6 +118,8 @@ struct Device {
     char type;                          /* 设备类型 */
     void *private;                      /* 指向设备子系统（字符设备，块设备） */
     Atomic_t references;                /* 设备的引用计数 */
+    struct Device *nameHashNext;        /* 设备名散列表中的下一个设备 */
+    struct Device *devnoHashNext;       /* 设备号散列表中的下一个设备 */
 };
 
 struct DeviceOperations {
@@ -139,6 +141,9 @@ PUBLIC struct Device *GetDeviceByID(int devno);
 
 PUBLIC void DumpDevice(struct Device *device);
 
+PUBLIC void RegisterDevice(struct Device *device);
+PUBLIC void UnregisterDevice(struct Device *device);
+
 /* 空操作或者错误操作 */
 PUBLIC int IoNull();
 PUBLIC int IoError();
@@ -20,6 +20,7 @@ symphyses: 交接处
 #include <lib/file.h>
 #include <lib/dir.h>
 #include <lib/stddef.h>
+#include <book/atomic.h>
 
 enum {
     D_UNKNOWN = 0,
@@ -80,6 +81,19 @@ PUBLIC int SysMakeDev(const char *pathname, char type,
         int major, int minor, size_t size);
 PUBLIC int SysMakeTsk(const char *pathname, pid_t pid);
 
+/* 文件映射，程序段按需加载时在文件关闭后继续读取数据 */
+struct FileMap {
+    Atomic_t reference;     /* 引用计数，fork后的空间共享同一个映射 */
+    void *inode;            /* 文件系统中的节点 */
+    void *superBlock;       /* 节点所在的超级块 */
+};
+
+PUBLIC struct FileMap *FileMapCreate(int fd);
+PUBLIC int FileMapRead(struct FileMap *map, unsigned int offset, 
+        void *buffer, unsigned int size);
+PUBLIC void FileMapGet(struct FileMap *map);
+PUBLIC void FileMapPut(struct FileMap *map);
+
 /* 初始化文件系统 */
 PUBLIC void InitFileSystem();
 
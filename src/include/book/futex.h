@@ -0,0 +1,26 @@
+/*
+ * file:		include/book/futex.h
+ * auther:		Jason Hu
+ * time:		2020/3/14
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_FUTEX_H
+#define _BOOK_FUTEX_H
+
+#include <lib/types.h>
+#include <lib/futex.h>
+
+/*
+futex（快速用户空间互斥）：
+    锁的状态放在用户空间的一个整数里，没有竞争的时候用户态用原子操作就能完成
+加锁和解锁，只有需要等待的时候才进入内核。
+    内核只提供两个操作：WAIT在整数还等于期望值的时候睡眠，WAKE唤醒在这个整数上
+睡眠的任务。等待者按(地址空间, 用户虚拟地址)散列到一个等待表中，检查整数和
+睡眠在关闭中断并持有大内核锁的情况下完成，所以不会丢失唤醒。
+*/
+
+PUBLIC int SysFutex(int *uaddr, int op, int val);
+PUBLIC void InitFutex();
+
+#endif   /* _BOOK_FUTEX_H */
@@ -85,6 +85,7 @@ PUBLIC int RegisterIRQ(unsigned int irq,
     unsigned int data);
 
 PUBLIC int UnregisterIRQ(unsigned int irq, unsigned int data);
+PUBLIC void SetIrqController(struct HardwareIntController *controller);
 
 
 PUBLIC int HandleIRQ(unsigned int irq, struct TrapFrame *frame);
@@ -108,6 +109,7 @@ enum
     NET_RX_SOFTIRQ,
     TASKASSIST_SOFTIRQ,
     SCHED_SOFTIRQ, 
+    RESCHED_SOFTIRQ,    /* 有更高优先级的任务就绪，检查抢占 */
     RCU_SOFTIRQ,    /* Preferable RCU should always be the last softirq */
     NR_SOFTIRQS
 };
@@ -212,6 +214,7 @@ typedef void (*WrokFunc_t)(struct Work *work);
 struct CpuWorkQueue {
     struct List workList;   // 工作的链表头
     struct WaitQueue moreWork;  // 更多的工作
+    struct WaitQueue workDone;  // 等待工作全部完成的任务
     struct Work *currentWork;   // 指向当前的工作
     struct WorkQueue *myWorkQueue;  // 所属的工作队列 
     struct Task *thread;    // 工作队列的内核线程      
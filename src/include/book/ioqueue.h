@@ -12,6 +12,7 @@
 #include <lib/stdint.h>
 #include <book/synclock.h>
 #include <book/task.h>
+#include <book/waitqueue.h>
 
 
 #define IQ_QUEUE_IDLE 0
@@ -32,8 +33,25 @@
 #define IQ_BUF_LEN_32   (IQ_BUF_DATA_NR * IQ_FACTOR_32)
 #define IQ_BUF_LEN_64   (IQ_BUF_DATA_NR * IQ_FACTOR_64)
 
+/* 批量操作的标志 */
+#define IQ_NONBLOCK     0x01    /* 不能马上完成就返回，不会睡眠 */
+#define IQ_ALL          0x02    /* 等到能一次放入或者取出全部单元 */
+
 /*
 生产者消费者模型来实现IoQueue
+    队列以单元为单位，单元的大小是factor，缓冲区的长度必须是factor的整数倍。
+批量操作一次复制尽可能多的单元，绕回缓冲区开头时分两次复制，每一批数据只唤醒
+一次对方，而不是每个单元都唤醒一次。
+    放入数据的时候可能在中断中，中断里面只能用不会睡眠的操作。
+    数据可能来自用户缓冲区，复制时会缺页睡眠，所以不能在关闭中断的时候复制。
+关闭中断只用来预留空间并移动head或者tail，复制时打开中断，复制完再发布：
+生产者预留的单元在所有正在复制的生产者都完成后才对消费者可见，消费者预留的
+单元在所有正在复制的消费者都完成后才还给生产者，这样同时复制的任务不会使用
+同样的位置，也不会读到还没有复制完的数据。
+    环形缓冲区只在这里实现，管道等使用者不直接访问缓冲区和等待队列。使用者
+需要在其它条件下停止等待时（比如管道的另一端关闭或者收到信号），设置
+interrupted，阻塞的操作在它返回非0时不再等待，条件变化后用IoQueueWakeUpAll
+让等待者重新检测。
 */
 struct IoQueue {
     struct Synclock lock;
@@ -41,12 +59,17 @@ struct IoQueue {
     unsigned int buflen;            // 缓冲区大小
     unsigned char *head;			    // 队首,数据往队首处写入
     unsigned char *tail;			    // 队尾,数据从队尾处读出
-	size_t size;
+	size_t size;                    // 消费者可以取出的单元数
+	unsigned int putHeld;           // 生产者预留了但是还没有发布的单元数
+	unsigned int getHeld;           // 消费者预留了但是还没有归还的单元数
+	unsigned int putCopying;        // 正在复制的生产者数
+	unsigned int getCopying;        // 正在复制的消费者数
     /* 因子大小，表示队列中每一个单元的大小。
     8位，16位，32位，64位 */
     char factor;                    
-	struct Task *producer;
-	struct Task *consumer;
+	struct WaitQueue producers;		/* 等待空位置的生产者 */
+	struct WaitQueue consumers;		/* 等待数据的消费者 */
+	int (*interrupted)(struct IoQueue *ioQueue);	/* 返回非0时停止等待，可以为NULL */
 };
 
 #define IO_QUEUE_SIZE sizeof(struct IoQueue)
@@ -54,6 +77,14 @@ struct IoQueue {
 #define IO_QUEUE_LENGTH(ioqueue) \
         (ioqueue)->size 
 
+/* 队列能容纳的单元数 */
+#define IO_QUEUE_CAPACITY(ioqueue) \
+        ((ioqueue)->buflen / (ioqueue)->factor)
+
+/* 队列中空闲的单元数，正在复制的单元不是空闲的 */
+#define IO_QUEUE_FREE(ioqueue) \
+        (IO_QUEUE_CAPACITY(ioqueue) - (ioqueue)->size - \
+        (ioqueue)->putHeld - (ioqueue)->getHeld)
 
 PUBLIC struct IoQueue *CreateIoQueue();
 PUBLIC int IoQueueInit(struct IoQueue *ioQueue, 
@@ -62,6 +93,41 @@ PUBLIC int IoQueueInit(struct IoQueue *ioQueue,
 PUBLIC unsigned long IoQueueGet(struct IoQueue *ioQueue);
 PUBLIC void IoQueuePut(struct IoQueue *ioQueue, unsigned long data); 
 
+PUBLIC int IoQueuePutMany(struct IoQueue *ioQueue, const void *data,
+    unsigned int count, int flags);
+PUBLIC int IoQueueGetMany(struct IoQueue *ioQueue, void *data,
+    unsigned int count, int flags);
+PUBLIC int IoQueuePutTimeout(struct IoQueue *ioQueue, const void *data,
+    unsigned int count, int flags, unsigned long ticks);
+PUBLIC int IoQueueGetTimeout(struct IoQueue *ioQueue, void *data,
+    unsigned int count, int flags, unsigned long ticks);
+PUBLIC int IoQueuePeek(struct IoQueue *ioQueue, void *data, unsigned int count);
+PUBLIC void IoQueueWakeUpAll(struct IoQueue *ioQueue);
+
+/**
+ * IoQueueTryPut - 尝试放入一个单元，不会睡眠
+ * @ioQueue: io队列
+ * @data: 数据，单元不能大于unsigned long
+ * 
+ * 可以在中断中使用，队列满了返回-1
+ */
+PRIVATE INLINE int IoQueueTryPut(struct IoQueue *ioQueue, unsigned long data)
+{
+	return IoQueuePutMany(ioQueue, &data, 1, IQ_NONBLOCK) == 1 ? 0 : -1;
+}
+
+/**
+ * IoQueueTryGet - 尝试取出一个单元，不会睡眠
+ * @ioQueue: io队列
+ * @data: 保存数据，单元不能大于unsigned long
+ * 
+ * 队列为空返回-1
+ */
+PRIVATE INLINE int IoQueueTryGet(struct IoQueue *ioQueue, unsigned long *data)
+{
+	*data = 0;
+	return IoQueueGetMany(ioQueue, data, 1, IQ_NONBLOCK) == 1 ? 0 : -1;
+}
 
 
 PRIVATE INLINE bool IoQueueEmpty(struct IoQueue *ioQueue)
@@ -71,7 +137,7 @@ PRIVATE INLINE bool IoQueueEmpty(struct IoQueue *ioQueue)
 
 PRIVATE INLINE bool IoQueueFull(struct IoQueue *ioQueue)
 {
-	return (ioQueue->size == ioQueue->buflen / ioQueue->factor) ? 1:0;	//如果大小为0就是空的
+	return (IO_QUEUE_FREE(ioQueue) == 0) ? 1:0;	//没有空闲的单元就是满的
 }
 
 #endif /* _BOOK_IOQUEQUE_H */
\ No newline at end of file
@@ -0,0 +1,74 @@
+/*
+ * file:		include/book/lockstat.h
+ * auther:		Jason Hu
+ * time:		2020/3/11
+ * copyright:   (C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_LOCKSTAT_H
+#define _BOOK_LOCKSTAT_H
+
+#include <lib/types.h>
+#include <lib/lockscan.h>
+#include <book/config.h>
+#include <book/list.h>
+
+/*
+锁的竞争统计：
+    同一种用途的锁属于同一个锁类，比如所有缓冲区的锁，统计信息按锁类累计。
+锁类在第一次使用时才注册到全局链表中，所以可以静态定义，不需要初始化函数。
+时间使用时钟源的纳秒数。
+*/
+
+struct LockClass {
+    char *name;                     /* 锁类的名字 */
+    struct List list;               /* 所有锁类的链表，next为NULL表示还没有注册 */
+    unsigned long acquisitions;     /* 获取次数 */
+    unsigned long contentions;      /* 需要等待的次数 */
+    unsigned long long waitTime;    /* 总等待时间 */
+    unsigned long long waitMax;     /* 最长等待时间 */
+    unsigned long long holdTime;    /* 总持有时间 */
+    unsigned long long holdMax;     /* 最长持有时间 */
+};
+
+#define LOCK_CLASS_INIT(lockname) \
+        { .name = (lockname) }
+
+/* 定义一个锁类 */
+#define DEFINE_LOCK_CLASS(classname, lockname) \
+        struct LockClass classname = LOCK_CLASS_INIT(lockname)
+
+#ifdef CONFIG_LOCK_STAT
+
+PUBLIC unsigned long long LockStatWaitStart();
+PUBLIC void LockStatContended(struct LockClass *lockClass, unsigned long long waitStart);
+PUBLIC unsigned long long LockStatAcquired(struct LockClass *lockClass);
+PUBLIC void LockStatReleased(struct LockClass *lockClass, unsigned long long acquireTime);
+
+#else
+
+PRIVATE INLINE unsigned long long LockStatWaitStart()
+{
+    return 0;
+}
+
+PRIVATE INLINE void LockStatContended(struct LockClass *lockClass,
+        unsigned long long waitStart)
+{
+}
+
+PRIVATE INLINE unsigned long long LockStatAcquired(struct LockClass *lockClass)
+{
+    return 0;
+}
+
+PRIVATE INLINE void LockStatReleased(struct LockClass *lockClass,
+        unsigned long long acquireTime)
+{
+}
+
+#endif  /* CONFIG_LOCK_STAT */
+
+PUBLIC int SysLockScan(lockscan_status_t *ls, unsigned int *idx);
+
+#endif   /* _BOOK_LOCKSTAT_H */
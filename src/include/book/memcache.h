@@ -14,6 +14,7 @@
 #include <book/config.h>
 #include <book/bitmap.h>
 #include <book/list.h>
+#include <lib/mman.h>
 
 /*
 当内存对象大小小于1024时，储存在一个页中。
@@ -52,16 +53,49 @@ struct MemGroup {
 
 #define MEM_CACHE_NAME_LEN 24
 
+/* 弹匣最多缓存的对象数量 */
+#define MEM_MAGAZINE_SIZE   16
+
+/* 弹匣最多缓存的字节数，避免大对象长期占用内存 */
+#define MEM_MAGAZINE_BYTES  (16 * KB)
+
+/*
+弹匣：缓存最近释放的对象，分配和释放时直接从弹匣中存取，
+不需要访问group的位图。弹匣空了就从group中批量装填，
+满了就把一半的对象还给group。
+*/
+struct MemMagazine {
+    unsigned int count;                 // 弹匣中的对象数量
+    unsigned int limit;                 // 弹匣的容量，为0表示不使用弹匣
+    void *objects[MEM_MAGAZINE_SIZE];   // 对象栈，最后释放的对象在栈顶
+};
+
 struct MemCache {
+    struct List list;            // 所有cache组成的链表
     struct List fullGroups;      // group对象都被使用了，就放在这个链表
     struct List partialGroups;   // group对象一部分被使用了，就放在这个链表
     struct List freeGroups;      // group对象都未被使用了，就放在这个链表
 
-    unsigned int objectSize;    // group中每个对象的大小
+    unsigned int objectSize;    // group中每个对象占用的大小（对齐后）
+    unsigned int rawSize;       // 创建cache时要求的对象大小
+    unsigned int objectOffset;  // 小对象在group页中的偏移
     flags_t flags;              // cache的标志位
     unsigned int objectNumber;  // 每个group中有多少个对象
+    void (*ctor)(void *);       // 对象的构造函数
     
     char name[MEM_CACHE_NAME_LEN];     // cache的名字
+
+    /* 每个CPU一个弹匣，目前只有一个CPU */
+    struct MemMagazine magazine;
+
+    /* 统计信息 */
+    unsigned int allocs;        // 分配次数
+    unsigned int allocHits;     // 直接从弹匣中分配的次数
+    unsigned int frees;         // 释放次数
+    unsigned int freeHits;      // 直接放入弹匣的次数
+    unsigned int refills;       // 从group装填弹匣的次数
+    unsigned int flushes;       // 弹匣满了，把对象还给group的次数
+    unsigned int grows;         // 创建group的次数
 };
 
 struct CacheSize {
@@ -75,4 +109,12 @@ PUBLIC void *kmalloc(size_t size, unsigned int flags);
 PUBLIC void kfree(void *objcet);
 PUBLIC int kmshrink();
 
+PUBLIC struct MemCache *CreateMemCache(char *name, size_t size, size_t align,
+    flags_t flags, void (*ctor)(void *));
+PUBLIC int DestroyMemCache(struct MemCache *cache);
+PUBLIC void *MemCacheAlloc(struct MemCache *cache);
+PUBLIC void MemCacheFree(struct MemCache *cache, void *object);
+
+PUBLIC int SysCacheScan(cachescan_status_t *cs, unsigned int *idx);
+
 #endif   /* _BOOK_MEMCACHE_H */
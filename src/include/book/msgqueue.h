@@ -0,0 +1,93 @@
+/*
+ * file:		include/book/msgqueue.h
+ * auther:		Jason Hu
+ * time:		2020/3/17
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_MSGQUEUE_H
+#define _BOOK_MSGQUEUE_H
+
+#include <lib/types.h>
+#include <lib/stddef.h>
+#include <book/waitqueue.h>
+
+/*
+消息队列：
+    创建时一次分配好所有的槽，每个槽保存一条不超过msgSize的消息，发送和接收
+只复制数据，不再为每条消息分配内存。空闲的槽放在一个栈里面，每个优先级有一个
+保存槽号的环，接收时从最高的非空优先级取最早的消息，同一个优先级先进先出。
+    发送和接收都可以不阻塞、一直阻塞或者最多等待一段时间，等待时收到信号或者
+队列被关闭就返回失败。一次可以接收多条消息，只等待第一条，之后有多少取多少，
+一批只唤醒一次发送者。
+*/
+
+/* 优先级的数量，数值大的优先级高 */
+#define MQ_PRIO_NR          8
+
+/* 槽数量和消息大小的上限，所有槽的数据要能用kmalloc一次分配 */
+#define MQ_MAX_MSGS         256
+#define MQ_MAX_MSGSIZE      4096
+#define MQ_MAX_BYTES        (64 * 1024)
+
+/* 操作的标志 */
+#define MQ_NONBLOCK         0x01    /* 不能完成时立即返回 */
+
+struct MsgRing {
+    unsigned short *slots;          /* 槽号，长度为maxMsgs */
+    unsigned int head;              /* 下一个接收的位置 */
+    unsigned int count;             /* 环中的消息数 */
+};
+
+struct MsgQueue {
+    unsigned int maxMsgs;           /* 槽的数量 */
+    unsigned int msgSize;           /* 每条消息的最大字节数 */
+    unsigned int count;             /* 可以接收的消息数 */
+    unsigned char *data;            /* 所有槽的数据 */
+    unsigned short *sizes;          /* 每个槽中消息的大小 */
+    unsigned short *freeSlots;      /* 空闲槽的栈，正在复制的槽既不空闲也不能接收 */
+    unsigned int freeTop;           /* 空闲槽的数量 */
+    struct MsgRing rings[MQ_PRIO_NR];
+    unsigned char prioMask;         /* 有消息的优先级 */
+    char closed;                    /* 已经关闭，唤醒所有等待者 */
+    struct WaitQueue senders;       /* 等待空槽的任务 */
+    struct WaitQueue receivers;     /* 等待消息的任务 */
+};
+
+/* 一次接收多条消息时每条消息的缓冲区 */
+struct MsgBuffer {
+    void *buf;                      /* 缓冲区 */
+    unsigned int len;               /* 传入缓冲区大小，返回消息大小 */
+    unsigned int prio;              /* 返回消息的优先级 */
+};
+
+#define MSG_QUEUE_FULL(mq)  (!(mq)->freeTop)
+#define MSG_QUEUE_EMPTY(mq) (!(mq)->count)
+
+PUBLIC int MsgQueueInit(struct MsgQueue *mq, unsigned int maxMsgs, unsigned int msgSize);
+PUBLIC void MsgQueueClose(struct MsgQueue *mq);
+PUBLIC void MsgQueueDestroy(struct MsgQueue *mq);
+PUBLIC struct MsgQueue *CreateMsgQueue(unsigned int maxMsgs, unsigned int msgSize);
+PUBLIC void FreeMsgQueue(struct MsgQueue *mq);
+
+PUBLIC int MsgQueueSend(struct MsgQueue *mq, const void *msg, unsigned int len,
+        unsigned int prio, int flags, unsigned long *ticks);
+PUBLIC int MsgQueueReceive(struct MsgQueue *mq, void *buf, unsigned int len,
+        unsigned int *prio, int flags, unsigned long *ticks);
+PUBLIC int MsgQueueReceiveMany(struct MsgQueue *mq, struct MsgBuffer *bufs,
+        int count, int flags, unsigned long *ticks);
+
+/* 具名的消息队列，给用户进程使用 */
+#define MQ_NAME_LEN         24
+#define MQ_MAX_NR           32
+
+/* 打开的标志 */
+#define MQ_CREAT            0x01    /* 不存在就创建 */
+#define MQ_EXCL             0x02    /* 和MQ_CREAT一起使用，已经存在就失败 */
+
+PUBLIC int SysMqOpen(const char *name, int flags, unsigned int maxMsgs, unsigned int msgSize);
+PUBLIC int SysMqUnlink(const char *name);
+PUBLIC int SysMqSend(int mqd, struct MsgBuffer *msg, int msecs);
+PUBLIC int SysMqReceive(int mqd, struct MsgBuffer *msgs, int count, int msecs);
+
+#endif   /* _BOOK_MSGQUEUE_H */
@@ -25,6 +25,10 @@
     b、如果被保护资源需要睡眠的话，那么只能使用互斥锁或者信号量，不能使用自旋锁。而互斥锁的效率又比信号量高，所以这时候最佳选择是互斥锁。
 
     c、中断里面不能使用互斥锁，因为互斥锁在获取不到锁的情况下会进入睡眠，而中断是不能睡眠的。
+
+3、自适应自旋
+    如果锁的持有者正在其它处理器上运行，它很可能马上就会释放锁，这时先让出大内核锁自旋一会儿，
+比睡眠再唤醒的开销小；持有者没有运行或者自旋次数用完后才睡眠。
  */
 
 #ifndef _BOOK_MUTEX_H
@@ -35,36 +39,40 @@
 #include <book/atomic.h>
 #include <book/spinlock.h>
 #include <book/task.h>
+#include <book/waitqueue.h>
+#include <book/lockstat.h>
+
+/* 持有者在其它处理器上运行时，获取锁的任务最多自旋的次数 */
+#define MUTEX_SPIN_COUNT    100
 
 typedef struct Mutex {
     /* 为1表示未上锁，0表示上锁，小于0表示有等待者 */
     Atomic_t count;
 
-    /* 用于对count的运算和判断多步骤进行保护，使得它们是原子操作 */
-    Spinlock_t countLock;
-    
-    /* waitList是多任务(进程/线程)共享的，需要采用自旋锁互斥访问，
-    自旋锁会不停循环检查且不会阻塞任务的执行，适合时间短的加锁。
-    waitLock就是拿来保护waitList的访问的 */
+    /* 保护count的多步骤运算和等待队列，使得它们是原子操作 */
     Spinlock_t waitLock;
 
+    struct WaitQueue waitQueue;     /* 等待队列 */
 
-    struct List waitList;   /* 等待队列 */
+    struct Task *owner;             /* 锁的持有者 */
 
-    struct Task *owner;     /* 锁的持有者 */
+    struct LockClass *lockClass;    /* 锁类，用于竞争统计 */
+    unsigned long long acquireTime; /* 获取锁的时间 */
 } Mutex_t;
 
 /* 初始化互斥锁 */
-#define MUTEX_INIT(lockname) \
+#define MUTEX_INIT(lockname, class) \
         { .count = ATOMIC_INIT(1) \
-        , .countLock = SPIN_LOCK_INIT_UNLOCKED((lockname).countLock) \
-        , .waitLock = SPIN_LOCK_INIT_UNLOCKED((lockname).waitLock) \
-        , .waitList = LIST_HEAD_INIT((lockname).waitList) \
-        , .owner = NULL }
+        , .waitLock = { .lock = ATOMIC_INIT(0) } \
+        , .waitQueue = WAIT_QUEUE_INIT((lockname).waitQueue) \
+        , .owner = NULL \
+        , .lockClass = (class) \
+        , .acquireTime = 0 }
 
-/* 定义一个互斥锁 */
+/* 定义一个互斥锁，只能在函数外面定义，锁类是静态的复合字面量 */
 #define DEFINE_MUTEX(lockname) \
-        struct Mutex lockname = MUTEX_INIT(lockname)
+        struct Mutex lockname = MUTEX_INIT(lockname, \
+            &(struct LockClass) LOCK_CLASS_INIT(#lockname))
 
 #define MUTEX_CLEAR_OWNER(lockname) \
         (lockname)->owner = NULL
@@ -72,7 +80,14 @@ typedef struct Mutex {
 #define MUTEX_SET_OWNER(lockname) \
         (lockname)->owner = CurrentTask()
 
-PUBLIC void MutexInit(struct Mutex *lock);
+/* 初始化互斥锁，同一个位置初始化的锁属于同一个锁类 */
+#define MutexInit(lock) \
+do { \
+    PRIVATE struct LockClass __lockClass = LOCK_CLASS_INIT(#lock); \
+    __MutexInit((lock), &__lockClass); \
+} while (0)
+
+PUBLIC void __MutexInit(struct Mutex *lock, struct LockClass *lockClass);
 
 PUBLIC void MutexLock(struct Mutex *lock);
 PUBLIC void MutexUnlock(struct Mutex *lock);
@@ -0,0 +1,131 @@
+/*
+ * file:		include/book/rcu.h
+ * auther:		Jason Hu
+ * time:		2020/3/12
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_RCU_H
+#define _BOOK_RCU_H
+
+#include <lib/types.h>
+#include <book/list.h>
+#include <book/arch.h>
+
+/*
+读-复制-更新（RCU）：
+    读者不加锁，只在读临界区里面禁止被抢占，写者之间用自旋锁串行。写者把对象
+从链表上摘下来以后不能马上释放，要等所有处理器都经过一次静止状态（任务切换、
+空闲循环），保证摘下之前就开始的读者都已经退出，这段时间叫宽限期。
+    宽限期由调度器驱动：每个处理器在时钟节拍里检测自己是否经过了静止状态，
+最后一个报告的处理器结束宽限期，然后在RCU软中断里调用等待这个宽限期的回调。
+    读临界区里面不能睡眠。
+*/
+
+/* 宽限期结束后调用的回调，嵌入到要释放的对象中 */
+struct RcuHead {
+    struct RcuHead *next;
+    void (*func)(struct RcuHead *head);
+};
+
+/**
+ * RcuReadLock - 进入读临界区
+ *
+ * 可以嵌套，嵌套深度大于0时时钟不会抢占当前任务
+ */
+#define RcuReadLock() \
+    do { \
+        CurrentTask()->rcuReadDepth++; \
+        Barrier(); \
+    } while (0)
+
+/**
+ * RcuReadUnlock - 退出读临界区
+ */
+#define RcuReadUnlock() \
+    do { \
+        Barrier(); \
+        CurrentTask()->rcuReadDepth--; \
+    } while (0)
+
+/**
+ * RcuDereference - 读者读取受保护的指针
+ * @ptr: 指针
+ */
+#define RcuDereference(ptr) (*(volatile typeof(ptr) *)&(ptr))
+
+/**
+ * RcuAssignPointer - 写者发布一个指针
+ * @ptr: 指针
+ * @val: 新的值
+ *
+ * 先让对象的初始化对其它处理器可见，再发布指针
+ */
+#define RcuAssignPointer(ptr, val) \
+    do { \
+        WriteMemoryBarrier(); \
+        (ptr) = (val); \
+    } while (0)
+
+/**
+ * ListAddRcu - 把节点添加到读者可能正在遍历的链表头
+ * @new: 新节点
+ * @head: 链表头
+ */
+PRIVATE INLINE void ListAddRcu(struct List *new, struct List *head)
+{
+    new->next = head->next;
+    new->prev = head;
+    /* 节点初始化好了才能被读者看到 */
+    WriteMemoryBarrier();
+    head->next->prev = new;
+    head->next = new;
+}
+
+/**
+ * ListAddTailRcu - 把节点添加到读者可能正在遍历的链表尾
+ * @new: 新节点
+ * @head: 链表头
+ */
+PRIVATE INLINE void ListAddTailRcu(struct List *new, struct List *head)
+{
+    new->next = head;
+    new->prev = head->prev;
+    WriteMemoryBarrier();
+    head->prev->next = new;
+    head->prev = new;
+}
+
+/**
+ * ListDelRcu - 把节点从读者可能正在遍历的链表中删除
+ * @node: 节点
+ *
+ * 保留next，正在这个节点上的读者还能继续往后走，宽限期后才能释放节点
+ */
+PRIVATE INLINE void ListDelRcu(struct List *node)
+{
+    __ListDelNode(node);
+    node->prev = NULL;
+}
+
+/*
+ * ListForEachOwnerRcu - 在读临界区中遍历链表节点宿主
+ * @pos: 宿主类型结构体指针
+ * @head: 链表头
+ * @member: 节点在宿主中的名字
+ */
+#define ListForEachOwnerRcu(pos, head, member) \
+    for (pos = ListOwner(RcuDereference((head)->next), typeof(*pos), member); \
+        &pos->member != (head); \
+        pos = ListOwner(RcuDereference(pos->member.next), typeof(*pos), member))
+
+PUBLIC void CallRcu(struct RcuHead *head, void (*func)(struct RcuHead *));
+PUBLIC void SynchronizeRcu();
+
+PUBLIC void RcuNoteContextSwitch(int cpu);
+PUBLIC void RcuCheckCallbacks(int cpu);
+PUBLIC int RcuNeedsCpu(int cpu);
+
+PUBLIC void InitRcu();
+
+#endif   /* _BOOK_RCU_H */
@@ -11,8 +11,26 @@
 #include <lib/types.h>
 #include <lib/const.h>
 #include <lib/stddef.h>
+#include <book/task.h>
+
+/*
+动态优先级：只有静态优先级不高于用户优先级的任务才会调整，内核线程保持不变。
+等待输入后被唤醒的任务提升优先级，用完时间片被抢占的任务降低优先级，
+降低优先级的任务获得更长的时间片，这样交互任务响应快，计算任务切换少。
+*/
+
+/* 动态优先级最多提升的级数 */
+#define SCHED_MAX_BONUS     2
+
+/* 动态优先级最多降低的级数 */
+#define SCHED_MAX_PENALTY   2
+
+/* 每降低一级优先级，时间片增加的ticks数 */
+#define SCHED_SLICE_STEP    2
 
 PUBLIC void Schedule();
 PUBLIC void ScheduleInClock();
 
+PUBLIC void ScheduleBoost(struct Task *task);
+
 #endif   /*_BOOK_SCHEDULE_H*/
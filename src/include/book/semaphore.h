@@ -77,6 +77,21 @@ PRIVATE INLINE void SemaphoreDown(struct Semaphore *sema)
 	}
 }
 
+/**
+ * SemaphoreTryDown - 尝试信号量down
+ * @sema: 信号量
+ * 
+ * 不会阻塞，获取成功返回0，信号量被占用返回-1
+ */
+PRIVATE INLINE int SemaphoreTryDown(struct Semaphore *sema)
+{
+	if (AtomicGet(&sema->counter) > 0) {
+		AtomicDec(&sema->counter);
+		return 0;
+	}
+	return -1;
+}
+
 /**
  * __SemaphoreDown - 执行具体的up操作
  * @sema: 信号量
@@ -0,0 +1,55 @@
+/*
+ * file:		include/book/shm.h
+ * auther:		Jason Hu
+ * time:		2020/3/16
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_SHM_H
+#define _BOOK_SHM_H
+
+#include <lib/types.h>
+#include <lib/stddef.h>
+#include <lib/stdint.h>
+
+/*
+共享内存：
+    共享内存对象有一个名字和一组物理页，物理页在第一次访问的时候才分配并清零。
+对象自己持有每个物理页的一个引用，映射到进程的页通过SharePages再增加一个引用，
+进程取消映射或者退出时只减少引用，最后一个使用者才把物理页还给伙伴系统。
+    映射通过DoMmap创建空间，空间记录对象和对象第一个页所在的地址，页故障时把
+对象的页直接链接到进程，不复制数据。fork后共享内存的页不做写时复制，
+父子进程看到的还是同一个物理页。
+    对象的引用来自名字和映射的空间，删除名字并且没有空间映射后才释放对象。
+*/
+
+#define SHM_NAME_LEN        24
+
+/* 最多的共享内存对象数量 */
+#define SHM_MAX_NR          32
+
+/* 一个对象最大的大小，默认16MB */
+#define SHM_MAX_SIZE        0x01000000
+
+/* 打开的标志 */
+#define SHM_CREAT           0x01    /* 不存在就创建 */
+#define SHM_EXCL            0x02    /* 和SHM_CREAT一起使用，已经存在就失败 */
+
+struct ShmObject {
+    char name[SHM_NAME_LEN];        /* 名字，第一个字符为0表示没有使用 */
+    unsigned int size;              /* 页对齐后的大小 */
+    unsigned int pageCount;         /* 物理页的数量 */
+    unsigned int *pages;            /* 物理页地址，0表示还没有分配 */
+    int links;                      /* 引用数：名字和映射的空间 */
+    char unlinked;                  /* 名字已经删除 */
+};
+
+PUBLIC void ShmGet(struct ShmObject *shm);
+PUBLIC void ShmPut(struct ShmObject *shm);
+PUBLIC unsigned int ShmSharePage(struct ShmObject *shm, unsigned int index);
+
+PUBLIC int SysShmOpen(const char *name, unsigned int size, int flags);
+PUBLIC void *SysShmMap(int shmid, uint32_t addr, uint32_t prot, uint32_t flags);
+PUBLIC int SysShmUnlink(const char *name);
+
+#endif   /* _BOOK_SHM_H */
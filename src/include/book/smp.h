@@ -0,0 +1,71 @@
+/*
+ * file:		include/book/smp.h
+ * auther:		Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+/*
+对称多处理：每个处理器有自己的当前任务、idle任务和就绪队列。
+进入内核时需要获取大内核锁，所以同一时刻只有一个处理器在内核中运行，
+用户态的代码可以在所有处理器上并行执行。
+*/
+
+#ifndef _BOOK_SMP_H
+#define _BOOK_SMP_H
+
+#include <lib/types.h>
+#include <book/config.h>
+#include <book/list.h>
+#include <book/task.h>
+
+/* 负载均衡的间隔（ticks） */
+#define SCHED_BALANCE_TICKS     50
+
+/* 处理器 */
+struct Cpu {
+    int id;                     /* 处理器编号 */
+    char online;                /* 处理器已经运行 */
+    volatile char needResched;  /* 有更高优先级的任务就绪，需要检查抢占 */
+    Task_t *idle;               /* idle任务 */
+    Task_t *current;            /* 当前运行的任务 */
+    struct List priorityQueue[MAX_PRIORITY_NR]; /* 就绪队列 */
+    unsigned int readyBitmap;   /* 第n位为1表示第n个优先级队列不为空 */
+    unsigned int nrReady;       /* 就绪队列中的任务数，不包括idle */
+    unsigned int balanceTicks;  /* 距离下一次负载均衡的ticks */
+    unsigned int migrations;    /* 迁移到这个处理器的任务数 */
+    unsigned int switches;      /* 任务切换的次数 */
+    volatile char tlbFlushPending;  /* 其它处理器修改了页表，需要刷新TLB */
+};
+
+EXTERN struct Cpu cpus[NR_CPUS];
+EXTERN int cpuOnlineNr;
+
+/**
+ * CurrentCpuId - 获取当前处理器的编号
+ *
+ * 任务切换到某个处理器上时会记录处理器编号
+ */
+#define CurrentCpuId() (CurrentTask()->cpu)
+
+/**
+ * CurrentCpu - 获取当前处理器
+ */
+#define CurrentCpu() (&cpus[CurrentCpuId()])
+
+PUBLIC void KernelLock();
+PUBLIC void KernelUnlock();
+PUBLIC void KernelLockRelax();
+
+PUBLIC int ScheduleSelectCpu();
+PUBLIC void ScheduleBalance();
+PUBLIC Task_t *ScheduleIdleBalance(struct Cpu *cpu);
+PUBLIC void SmpReschedule(int cpu);
+PUBLIC void SmpFlushTlbOthers(struct MemoryManager *mm);
+PUBLIC void SmpTlbFlushPoll();
+PUBLIC int ScheduleNeedPreempt(struct Cpu *cpu);
+
+PUBLIC void SmpApStart(int cpu);
+PUBLIC void InitSmp();
+
+#endif  /* _BOOK_SMP_H */
@@ -70,6 +70,21 @@ enum {
     SYS_REDIRECT,           /* 55 */
     SYS_REBOOT,             /* 56 */
     SYS_GETVER,             /* 57 */
+    SYS_CACHESCAN,          /* 58 */
+    SYS_BUFSTAT,            /* 59 */
+    SYS_USLEEP,             /* 60 */
+    SYS_CLOCKGETTIME,       /* 61 */
+    SYS_LOCKSCAN,           /* 62 */
+    SYS_FUTEX,              /* 63 */
+    SYS_CLONE,              /* 64 */
+    SYS_WAITPID,            /* 65 */
+    SYS_SHMOPEN,            /* 66 */
+    SYS_SHMMAP,             /* 67 */
+    SYS_SHMUNLINK,          /* 68 */
+    SYS_MQOPEN,             /* 69 */
+    SYS_MQUNLINK,           /* 70 */
+    SYS_MQSEND,             /* 71 */
+    SYS_MQRECEIVE,          /* 72 */
     MAX_SYSCALL_NR,
 };
 
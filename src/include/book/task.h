@@ -12,11 +12,13 @@
 #include <lib/const.h>
 #include <lib/stddef.h>
 #include <lib/taskscan.h>
+#include <lib/sched.h>
 #include <book/list.h>
 #include <book/arch.h>
 #include <book/vmspace.h>
 #include <book/signal.h>
 #include <book/timer.h>
+#include <book/rcu.h>
 #include <kgc/window/window.h>
 
 /* 在线程中作为形参 */
@@ -46,11 +48,15 @@ struct ThreadStack {
     void *arg;  // 线程携带的参数
 };
 
+/* 特权级队列数量，不能超过32，每个处理器用一个32位的位图记录非空的队列 */
+#define MAX_PRIORITY_NR  10
+
+/* 用户优先级的上下都留出了空间，用来动态调整优先级 */
 enum TaskPriority {
     TASK_PRIORITY_BEST = 0,     /* 最佳优先级 */
     TASK_PRIORITY_RT,           /* 实时优先级 */
-    TASK_PRIORITY_USER,         /* 用户优先级 */
-    TASK_PRIORITY_IDLE,         /* IDLE优先级 */
+    TASK_PRIORITY_USER = 4,     /* 用户优先级 */
+    TASK_PRIORITY_IDLE = MAX_PRIORITY_NR - 1,   /* IDLE优先级 */
 };
 
 #define MAX_TASK_NAMELEN 32
@@ -67,12 +73,15 @@ enum TaskPriority {
 
 #define TASK_PWD_DEFAULT    "root:/"
 
-/* 特权级队列数量 */
-#define MAX_PRIORITY_NR  10
-
 /* 内核栈大小为8kb */
 #define TASK_KSTACK_SIZE    8192
 
+/* 文件描述符表，用CLONE_FILES创建的线程共享同一个表 */
+struct FileTable {
+    Atomic_t count;                             /* 使用这个表的任务数 */
+    int fdTable[MAX_OPEN_FILES_IN_PROC];        /* 局部描述符到全局描述符 */
+};
+
 typedef struct Task {
     uint8_t *kstack;                // 内核栈
     pid_t pid;                      // 自己的进程id
@@ -80,27 +89,38 @@ typedef struct Task {
     pid_t groupPid;                 // 组id
     enum TaskStatus status;
     pde_t *pgdir;                   // 页目录表指针
-    uint32_t priority;              /* 任务所在的优先级队列 */
-    uint32_t ticks;                 /*  */
+    uint32_t priority;              /* 任务所在的优先级队列，也就是动态优先级 */
+    uint32_t staticPriority;        /* 静态优先级，动态优先级在它的上下调整 */
+    uint32_t ticks;                 /* 剩余的时间片 */
     uint32_t timeslice;             /* 时间片，可以动态调整 */
 
-    uint32_t elapsedTicks;
+    uint32_t elapsedTicks;          /* 运行的ticks数 */
+    uint32_t waitTicks;             /* 在就绪队列中等待的ticks数 */
+    uint32_t readyStamp;            /* 进入就绪队列时的ticks */
+    uint32_t voluntarySwitches;     /* 主动让出处理器的次数 */
+    uint32_t involuntarySwitches;   /* 被抢占的次数 */
+    int cpu;                        /* 任务所在的处理器 */
+    int lockDepth;                  /* 大内核锁的嵌套深度，大于0表示持有锁 */
     int exitStatus;                 // 退出时的状态
     char name[MAX_TASK_NAMELEN];
     
     char cwd[MAX_PATH_LEN];		//当前工作路径,指针
 	
-    int fdTable[MAX_OPEN_FILES_IN_PROC];    // 文件描述符表
+    struct FileTable *files;        /* 文件描述符表 */
 
     struct MemoryManager *mm;       // 内存管理
     struct List list;               // 处于所在队列的链表
     struct List globalList;         // 全局任务队列，用来查找所有存在的任务
+    struct List pidList;            // pid哈希表的链表，用来按pid查找任务
+
+    int rcuReadDepth;               /* RCU读临界区的嵌套深度，大于0时不能被抢占 */
+    struct RcuHead rcuHead;         /* 宽限期后释放任务结构 */
 
     /* 信号相关 */
     uint8_t signalLeft;     /* 有信号未处理 */
     uint8_t signalCatched;     /* 有一个信号被捕捉，并处理了 */
     
-    Signal_t signals;        /* 进程对应的信号 */
+    Signal_t *signals;       /* 信号行为，用CLONE_SIGHAND创建的线程共享 */
     sigset_t signalBlocked;  /* 信号阻塞 */
     sigset_t signalPending;     /* 信号未决 */
     Spinlock_t signalMaskLock;  /* 信号屏蔽锁 */
@@ -142,18 +162,24 @@ PUBLIC void InitSignalInTask(struct Task *task);
 
 PUBLIC void TaskPriorityQueueAddTail(struct Task *task);
 PUBLIC void TaskPriorityQueueAddHead(struct Task *task);
+PUBLIC void TaskPriorityQueueDel(struct Task *task);
 PUBLIC void TaskGloablListAdd(struct Task *task);
+PUBLIC void TaskGloablListDel(struct Task *task);
 
 PUBLIC int IsTaskInPriorityQueue(struct Task *task);
 PUBLIC int IsAllPriorityQueueEmpty();
 
 PUBLIC void SystemPause();
+PUBLIC void TaskIdleLoop();
+PUBLIC struct Task *CreateIdleTask(int cpu);
 
 PUBLIC pid_t ForkPid();
 
 PUBLIC void TaskActivate(struct Task *task);
 PUBLIC void AllocTaskMemory(struct Task *task);
 PUBLIC void FreeTaskMemory(struct Task *task);
+PUBLIC void AllocTaskFiles(struct Task *task);
+PUBLIC void AllocTaskSignals(struct Task *task);
 PUBLIC void PageDirActive(struct Task *task);
 PUBLIC uint32_t *CreatePageDir();
 
@@ -169,12 +195,14 @@ PUBLIC void SysGetVersion(char *buf, int buflen);
 
 /* fork.c */
 PUBLIC pid_t SysFork();
+PUBLIC pid_t SysClone(unsigned long flags, void *stack);
 
 /* exec.c */
 PUBLIC int SysExecv(const char *path, const char *argv[]);
 PUBLIC int SysExecv2(const char *path, const char *argv[]);
 /* sleep_wakeup.c */
 PUBLIC uint32_t TaskSleep(uint32_t ticks);
+PUBLIC void TaskUSleep(uint32_t usec);
 PUBLIC uint32_t SysSleep(uint32_t second);
 PUBLIC void TaskWakeUp(struct Task *task);
 PUBLIC void TaskSleepOn(struct Task *task);
@@ -182,6 +210,7 @@ PUBLIC void TaskSleepOn(struct Task *task);
 /* exit_wait.c */
 PUBLIC void SysExit(int status);
 PUBLIC pid_t SysWait(int *status);
+PUBLIC pid_t SysWaitPid(pid_t pid, int *status);
 
 
 #endif   /*_BOOK_TASK_H*/
@@ -0,0 +1,95 @@
+/*
+ * file:		include/book/threadpool.h
+ * auther:		Jason Hu
+ * time:		2020/3/13
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _BOOK_THREADPOOL_H
+#define _BOOK_THREADPOOL_H
+
+#include <lib/types.h>
+#include <lib/stddef.h>
+#include <book/config.h>
+#include <book/waitqueue.h>
+
+/*
+内核线程池：
+    每个处理器一个工作者线程，每个工作者有自己的双端队列。提交到自己队列的工作
+从尾部取（后进先出，缓存是热的），空闲的工作者从其它队列的头部偷取最早的工作，
+这样一个慢的工作不会拖住后面互不相关的工作。
+    每个工作者按优先级分成几个队列，先处理高优先级的工作，包括偷取的。
+    工作执行时持有大内核锁，线程池用来让互不相关的后台工作不互相推迟，
+而不是把一个操作拆开并行执行。
+*/
+
+/* 工作的优先级 */
+enum PoolPriority {
+    POOL_PRIO_HIGH = 0,     /* 时间相关的工作 */
+    POOL_PRIO_NORMAL,       /* 普通工作 */
+    POOL_PRIO_LOW,          /* 可以推迟的工作，比如磁盘同步 */
+    POOL_PRIO_NR,
+};
+
+/* 每个队列能容纳的工作数，必须是2的幂 */
+#define POOL_DEQUE_SIZE     64
+
+/* 最多的工作者数量 */
+#define POOL_MAX_WORKERS    NR_CPUS
+
+struct PoolWork {
+    void (*func)(struct PoolWork *work);    /* 要执行的函数 */
+    unsigned long data;                     /* 传给函数的数据 */
+    unsigned char priority;                 /* 优先级 */
+    volatile char pending;                  /* 在队列中或者正在执行 */
+};
+
+/* 双端队列，头部是最早的工作，尾部是最新的工作 */
+struct PoolDeque {
+    struct PoolWork *works[POOL_DEQUE_SIZE];
+    unsigned int head;
+    unsigned int tail;
+};
+
+struct PoolWorker {
+    int id;
+    struct Task *thread;                        /* 工作者线程 */
+    struct PoolDeque deques[POOL_PRIO_NR];      /* 每个优先级一个队列 */
+    struct WaitQueue moreWork;                  /* 空闲时在这里等待 */
+    unsigned long executed;                     /* 执行的工作数 */
+    unsigned long stolen;                       /* 从其它工作者偷取的工作数 */
+};
+
+/**
+ * PoolWorkInit - 初始化工作
+ * @work: 工作
+ * @func: 要执行的函数
+ * @data: 传给函数的数据
+ * @priority: 优先级
+ */
+PRIVATE INLINE void PoolWorkInit(struct PoolWork *work,
+        void (*func)(struct PoolWork *), unsigned long data, int priority)
+{
+    work->func = func;
+    work->data = data;
+    work->priority = priority;
+    work->pending = 0;
+}
+
+/**
+ * DEFINE_POOL_WORK - 定义一个工作
+ * @name: 工作的名字
+ * @fn: 要执行的函数
+ * @prio: 优先级
+ */
+#define DEFINE_POOL_WORK(name, fn, prio) \
+    struct PoolWork name = { .func = (fn), .priority = (prio) }
+
+PUBLIC void InitThreadPool();
+
+PUBLIC int ThreadPoolQueueWork(struct PoolWork *work);
+PUBLIC void ThreadPoolQueueOrRun(struct PoolWork *work);
+
+PUBLIC void PrintThreadPool();
+
+#endif   /* _BOOK_THREADPOOL_H */
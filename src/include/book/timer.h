@@ -26,9 +26,9 @@
  * 定时器结构
  */
 typedef struct Timer {
-    struct List list;   // 链表
-    uint64_t expires;   // 到期时间
-    uint64_t lastExpires;   // 上一个到期时间
+    struct List list;   // 链表，位于时间轮的某个槽中
+    unsigned long expires;      // 到期时的systicks，停止时保存剩余的ticks数
+    unsigned long lastExpires;  // 定时的ticks数，添加定时器时从当前时间开始计算
     uint32_t data;      // 传递的数据
     void (*function)(uint32_t);     // 到期后要调用的函数
     char state;         // 定时器的状态
@@ -51,5 +51,7 @@ PUBLIC void StopTimer(struct Timer *timer);
 PUBLIC void ResumeTimer(struct Timer *timer);
 PUBLIC void CancelTimer(struct Timer *timer);
 PUBLIC void DoTimerHandler(struct Timer *timer);
+PUBLIC unsigned long TimerRemaining(struct Timer *timer);
+PUBLIC unsigned long TimerNextExpiry(unsigned long limit);
 
 #endif  /* _BOOK_TIMER_H */
@@ -12,6 +12,7 @@
 #include <lib/const.h>
 #include <book/list.h>
 #include <book/arch.h>
+#include <book/atomic.h>
 
 #define USER_VM_SIZE        (PAGE_OFFSET - 1)
 #define USER_STACK_TOP      USER_VM_SIZE
@@ -39,8 +40,15 @@
 /* 最大可扩展的堆的大小,默认512MB */
 #define MAX_VMS_HEAP_SIZE    0x20000000
 
+struct FileMap;
+struct ShmObject;
+
 /**
  * VMSpace - 虚拟空间结构
+ * 
+ * 有文件映射的空间在页故障时才从文件读取数据，
+ * [fileStart, fileStart + fileSize)以外的部分填0（bss）
+ * 共享内存空间的页故障直接链接对象的物理页，shmStart处是对象的第一个页
  */
 struct VMSpace {
     struct MemoryManager    *mm;    // 所在的内存管理者
@@ -49,11 +57,21 @@ struct VMSpace {
     unsigned int            pageProt;   //页保护
     flags_t                 flags;  // 空间的标志
     struct VMSpace          *next;  // 指向下一个空间
+    struct FileMap          *fileMap;   // 文件映射，匿名空间为NULL
+    address_t               fileStart;  // 文件数据在空间中的起始地址
+    unsigned int            fileOffset; // fileStart对应的文件偏移
+    unsigned int            fileSize;   // 文件数据的大小
+    struct ShmObject        *shm;       // 共享内存对象，其它空间为NULL
+    address_t               shmStart;   // 对象第一个页所在的地址
 };
 
 struct MemoryManager {
     struct VMSpace *spaceMap;   // 管理所有的空间 
 
+    /* 用CLONE_VM创建的线程共享内存管理器 */
+    Atomic_t users;             /* 还没有退出的任务数，为0时释放地址空间 */
+    Atomic_t count;             /* 引用的任务数，包括僵尸，为0时释放结构 */
+
     // 空间中的各种地址
     address_t      codeStart, codeEnd;
     address_t      dataStart, dataEnd;
@@ -66,14 +84,23 @@ struct MemoryManager {
 
 
 PUBLIC void InitVMSpace();
+PUBLIC struct VMSpace *AllocVMSpace();
+PUBLIC void FreeVMSpace(struct VMSpace *space);
 PUBLIC void InitMemoryManager(struct MemoryManager *mm);
 PUBLIC void ReleaseVMSpace(struct MemoryManager *mm, unsigned int flags);
 PUBLIC struct VMSpace *FindVMSpacePrev(struct MemoryManager *mm, 
-        address_t addr, struct VMSpace *prev);
+        address_t addr, struct VMSpace **prev);
 PUBLIC struct VMSpace *FindVMSpace(struct MemoryManager *mm, address_t addr);
 PUBLIC int InsertVMSpace(struct MemoryManager *mm, struct VMSpace* space);
 PUBLIC void RemoveVMSpace(struct MemoryManager *mm, struct VMSpace *space, 
         struct VMSpace *prev);
+PUBLIC int SetVMSpaceFile(struct VMSpace *space, struct FileMap *map,
+        address_t start, unsigned int offset, unsigned int size);
+PUBLIC int FillVMSpacePage(struct VMSpace *space, address_t addr);
+
+PUBLIC int32 DoMmap(struct MemoryManager *mm, address_t addr, uint32_t len,
+        uint32_t prot, uint32_t flags, struct ShmObject *shm);
+PUBLIC int DoMunmap(struct MemoryManager *mm, uint32 addr, uint32 len);
 
 PUBLIC void *SysMmap(uint32_t addr, uint32_t len, uint32_t prot, uint32_t flags);
 PUBLIC int SysMunmap(uint32_t addr, uint32_t len);
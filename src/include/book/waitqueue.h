@@ -13,16 +13,36 @@
 #include <book/arch.h>
 #include <book/task.h>
 #include <book/debug.h>
+#include <book/schedule.h>
+
+/*
+等待队列：
+    同一个结构既是队列头，也是等待者。作为队列头时task为NULL，waitList链接所有等待者；
+作为等待者时定义在等待任务的栈上，task是等待的任务，通过waitList挂到队列头上。
+等待者不使用任务的list，所以被其它原因唤醒时也不会破坏就绪队列。
+
+    等待的时候先检测条件，条件不满足才挂到队列上睡眠，被唤醒后再次检测条件，
+在关闭中断并持有大内核锁的情况下完成，所以不会丢失唤醒。
+*/
 
 typedef struct WaitQueue {
-	struct List waitList;	// 记录所有被挂起的进程（等待中）的链表
-	struct Task *task;		// 当前被挂起的进程
+	struct List waitList;	// 队列头：所有等待者的链表；等待者：链表节点
+	struct Task *task;		// 等待者的任务，队列头为NULL
 } WaitQueue_t;
 
+/* 初始化等待队列头 */
+#define WAIT_QUEUE_INIT(name) \
+        { .waitList = LIST_HEAD_INIT((name).waitList) \
+        , .task = NULL }
+
+/* 定义一个等待队列头 */
+#define DEFINE_WAIT_QUEUE(name) \
+        struct WaitQueue name = WAIT_QUEUE_INIT(name)
+
 /**
  * WaitQueueInit - 等待队列初始化
  * @waitQueue: 等待队列
- * @task: 等待的任务
+ * @task: 等待的任务，队列头为NULL
  */
 PRIVATE INLINE void WaitQueueInit(struct WaitQueue *waitQueue, struct Task *task)
 {
@@ -33,70 +53,195 @@ PRIVATE INLINE void WaitQueueInit(struct WaitQueue *waitQueue, struct Task *task
 }
 
 /**
- * WaitQueueAdd - 把进程添加到等待队列中
+ * WaitQueueActive - 检测等待队列上是否有等待者
  * @waitQueue: 等待队列
- * @task: 要添加的任务
  */
-PRIVATE INLINE void WaitQueueAdd(struct WaitQueue *waitQueue, struct Task *task)
+PRIVATE INLINE int WaitQueueActive(struct WaitQueue *waitQueue)
+{
+	return !ListEmpty(&waitQueue->waitList);
+}
+
+/**
+ * WaitQueueAdd - 把等待者添加到等待队列中
+ * @waitQueue: 等待队列
+ * @waiter: 等待者
+ *
+ * 已经在队列中就不再添加
+ */
+PRIVATE INLINE void WaitQueueAdd(struct WaitQueue *waitQueue, struct WaitQueue *waiter)
 {
 	/* 添加到队列时，需要关闭中断 */
     unsigned long flags = InterruptSave();
 
-	/* 确保任务不在等待队列中 */
-	ASSERT(!ListFind(&task->list, &waitQueue->waitList));
-	
 	/* 添加到等待队列中，添加到最后 */
-	ListAddTail(&task->list, &waitQueue->waitList);
+	if (ListEmpty(&waiter->waitList))
+		ListAddTail(&waiter->waitList, &waitQueue->waitList);
 
 	InterruptRestore(flags);
 }
 
 /**
- * WaitQueueRemove - 把进程从等待队列中移除
+ * WaitQueueRemove - 把等待者从等待队列中移除
  * @waitQueue: 等待队列
- * @task: 要移除的任务
+ * @waiter: 等待者
+ *
+ * 被唤醒时已经移除了，再次移除什么也不做
  */
-PRIVATE INLINE void WaitQueueRemove(struct WaitQueue *waitQueue, struct Task *task)
+PRIVATE INLINE void WaitQueueRemove(struct WaitQueue *waitQueue, struct WaitQueue *waiter)
 {
-	/* 添加到队列时，需要关闭中断 */
+	/* 从队列移除时，需要关闭中断 */
     unsigned long flags = InterruptSave();
-    
-	struct Task *target, *next;
-	/* 在队列中寻找任务，找到后就把任务从队列中删除 */
-	ListForEachOwnerSafe(target, next, &waitQueue->waitList, list) {
-		if (target == task) {
-			/* 把任务从等待队列中删除 */
-			ListDelInit(&target->list);
-			break;
-		}
-	}
-	
+
+	ListDelInit(&waiter->waitList);
+
+	InterruptRestore(flags);
+}
+
+/**
+ * WaitQueuePrepare - 准备在等待队列上睡眠
+ * @waitQueue: 等待队列
+ * @waiter: 等待者
+ *
+ * 需要关闭中断后调用，之后调用Schedule让出处理器
+ */
+PRIVATE INLINE void WaitQueuePrepare(struct WaitQueue *waitQueue, struct WaitQueue *waiter)
+{
+	WaitQueueAdd(waitQueue, waiter);
+
+	/* 先把状态设置成阻塞，这样调度后就不会再次被调度，只有等待唤醒 */
+	waiter->task->status = TASK_BLOCKED;
+}
+
+/**
+ * WaitQueueFinish - 结束等待
+ * @waitQueue: 等待队列
+ * @waiter: 等待者
+ */
+PRIVATE INLINE void WaitQueueFinish(struct WaitQueue *waitQueue, struct WaitQueue *waiter)
+{
+	WaitQueueRemove(waitQueue, waiter);
+}
+
+/**
+ * WAIT_EVENT - 在等待队列上睡眠，直到条件满足
+ * @waitQueue: 等待队列
+ * @condition: 等待的条件，每次被唤醒后都会重新检测
+ */
+#define WAIT_EVENT(waitQueue, condition) \
+do { \
+	struct WaitQueue *__wq = (waitQueue); \
+	struct WaitQueue __waiter; \
+	WaitQueueInit(&__waiter, CurrentTask()); \
+	unsigned long __flags = InterruptSave(); \
+	while (!(condition)) { \
+		WaitQueuePrepare(__wq, &__waiter); \
+		Schedule(); \
+	} \
+	WaitQueueFinish(__wq, &__waiter); \
+	InterruptRestore(__flags); \
+} while (0)
+
+/**
+ * WaitQueueTimeout - 等待超时，唤醒等待的任务
+ * @data: 等待的任务
+ */
+PRIVATE INLINE void WaitQueueTimeout(uint32_t data)
+{
+	TaskWakeUp((struct Task *)data);
+}
+
+/**
+ * WAIT_EVENT_TIMEOUT - 在等待队列上睡眠，直到条件满足或者超时
+ * @waitQueue: 等待队列
+ * @condition: 等待的条件，每次被唤醒后都会重新检测
+ * @ticks: 最多等待的ticks数，是一个变量，返回时保存剩余的ticks数，为0表示已经超时
+ */
+#define WAIT_EVENT_TIMEOUT(waitQueue, condition, ticks) \
+do { \
+	struct WaitQueue *__wq = (waitQueue); \
+	struct WaitQueue __waiter; \
+	struct Timer __timer; \
+	WaitQueueInit(&__waiter, CurrentTask()); \
+	TimerInit(&__timer, (ticks), (uint32_t)CurrentTask(), WaitQueueTimeout); \
+	unsigned long __flags = InterruptSave(); \
+	if (!(condition) && (ticks) > 0) { \
+		AddTimer(&__timer); \
+		while (!(condition) && (ticks) > 0) { \
+			WaitQueuePrepare(__wq, &__waiter); \
+			Schedule(); \
+			(ticks) = TimerRemaining(&__timer); \
+		} \
+		/* 定时器在栈上，提前唤醒时必须移除 */ \
+		RemoveTimer(&__timer); \
+	} \
+	WaitQueueFinish(__wq, &__waiter); \
+	InterruptRestore(__flags); \
+} while (0)
+
+/**
+ * WaitQueueSleep - 在等待队列上睡眠一次
+ * @waitQueue: 等待队列
+ *
+ * 被唤醒后返回，调用者需要在关闭中断的情况下检测条件，然后调用
+ */
+PRIVATE INLINE void WaitQueueSleep(struct WaitQueue *waitQueue)
+{
+	struct WaitQueue waiter;
+	WaitQueueInit(&waiter, CurrentTask());
+
+	unsigned long flags = InterruptSave();
+
+	WaitQueuePrepare(waitQueue, &waiter);
+	Schedule();
+	WaitQueueFinish(waitQueue, &waiter);
+
 	InterruptRestore(flags);
 }
- 
+
 /**
  * WaitQueueWakeUp - 唤醒等待队列中的一个任务
  * @waitQueue: 等待队列
+ *
+ * 唤醒最早等待的任务，队列为空就什么也不做
  */
 PRIVATE INLINE void WaitQueueWakeUp(struct WaitQueue *waitQueue)
 {
-	/* 添加到队列时，需要关闭中断 */
+	/* 操作队列时，需要关闭中断 */
 	unsigned long flags = InterruptSave();
-    
+
 	/* 不是空队列就获取第一个等待者 */
 	if (!ListEmpty(&waitQueue->waitList)) {
-		/* 获取任务 */		
-        struct Task *task = ListFirstOwner(&waitQueue->waitList, struct Task, list);
-		
+		/* 获取等待者 */
+        struct WaitQueue *waiter = ListFirstOwner(&waitQueue->waitList, struct WaitQueue, waitList);
+
         /* 从当前队列删除 */
-		ListDel(&task->list);
+		ListDelInit(&waiter->waitList);
 		/* 唤醒任务 */
-		TaskWakeUp(task);
-		
+		TaskWakeUp(waiter->task);
     }
-    
+
+	InterruptRestore(flags);
+}
+
+/**
+ * WaitQueueWakeUpAll - 唤醒等待队列中的所有任务
+ * @waitQueue: 等待队列
+ */
+PRIVATE INLINE void WaitQueueWakeUpAll(struct WaitQueue *waitQueue)
+{
+	struct WaitQueue *waiter, *next;
+
+	unsigned long flags = InterruptSave();
+
+	ListForEachOwnerSafe(waiter, next, &waitQueue->waitList, waitList) {
+		ListDelInit(&waiter->waitList);
+		TaskWakeUp(waiter->task);
+    }
+
 	InterruptRestore(flags);
 }
 
+PUBLIC struct WaitQueue *AddressWaitQueue(void *addr);
+PUBLIC void InitWaitQueueTable();
 
 #endif   /*_BOOK_WAITQUEUE_H*/
@@ -0,0 +1,72 @@
+/*
+ * file:		include/clock/clockevent.h
+ * auther:		Jason Hu
+ * time:		2020/3/9
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _CLOCK_CLOCKEVENT_H
+#define _CLOCK_CLOCKEVENT_H
+
+#include <lib/stdint.h>
+#include <lib/types.h>
+#include <book/list.h>
+#include <book/arch.h>
+
+/*
+时钟事件设备：能在指定的时间产生中断的硬件，比如pit和本地APIC定时器。
+只能周期触发的设备按HZ产生时钟节拍；能单次触发的设备每次都设置下一个事件，
+空闲时把事件推迟到最近的定时器到期时，不再每个节拍都唤醒处理器（tickless），
+同时支持比节拍精度更高的高精度定时器。
+*/
+
+#define NSEC_PER_SEC    1000000000UL
+#define NSEC_PER_USEC   1000UL
+#define USEC_PER_SEC    1000000UL
+
+/* 1个时钟节拍对应的纳秒数 */
+#define TICK_NSEC       (NSEC_PER_SEC / HZ)
+
+/* 设备的特性 */
+#define CLOCK_EVT_FEAT_PERIODIC     0x01    /* 可以周期触发 */
+#define CLOCK_EVT_FEAT_ONESHOT      0x02    /* 可以单次触发 */
+
+/* 时钟事件设备 */
+struct ClockEventDevice {
+    char *name;
+    unsigned int features;
+    int rating;                     /* 设备的质量，同一个处理器上选择值更大的设备 */
+    unsigned long mult;             /* 计数 = (纳秒 * mult) >> 32 */
+    unsigned long minDelta;         /* 单次触发允许的最小计数 */
+    unsigned long maxDelta;         /* 单次触发允许的最大计数 */
+
+    void (*setPeriodic)(struct ClockEventDevice *dev);
+    void (*setNextEvent)(unsigned long delta, struct ClockEventDevice *dev);
+    void (*shutdown)(struct ClockEventDevice *dev);
+
+    /* 设备中断时调用，由时钟事件层设置 */
+    void (*eventHandler)(struct ClockEventDevice *dev);
+};
+
+/* 高精度定时器 */
+struct HrTimer {
+    struct List list;               /* 按到期时间排序的链表 */
+    unsigned long long expires;     /* 到期时间（纳秒） */
+    void (*function)(unsigned long data);
+    unsigned long data;
+    int cpu;                        /* 所在的处理器 */
+};
+
+PUBLIC void InitClockEvent();
+PUBLIC int ClockEventRegister(int cpu, struct ClockEventDevice *dev);
+
+PUBLIC void ClockEventIdleEnter();
+PUBLIC void ClockEventIdleExit();
+PUBLIC void ClockEventTimerAdded(unsigned long expires);
+
+PUBLIC void HrTimerInit(struct HrTimer *timer,
+        void (*function)(unsigned long), unsigned long data);
+PUBLIC int HrTimerStart(struct HrTimer *timer, unsigned long long expires);
+PUBLIC void HrTimerCancel(struct HrTimer *timer);
+
+#endif   /* _CLOCK_CLOCKEVENT_H */
@@ -0,0 +1,42 @@
+/*
+ * file:		include/clock/clocksource.h
+ * auther:		Jason Hu
+ * time:		2020/3/10
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#ifndef _CLOCK_CLOCKSOURCE_H
+#define _CLOCK_CLOCKSOURCE_H
+
+#include <lib/stdint.h>
+#include <lib/types.h>
+#include <lib/time.h>
+
+/*
+时钟源：可以随时读取的单调递增的计数器，比如tsc。
+系统选择质量最好的时钟源来计算开机后经过的纳秒数，
+没有可用的硬件时钟源时，使用时钟节拍（jiffies）计时。
+*/
+
+/* 时钟源的特性 */
+#define CLOCK_SOURCE_CONTINUOUS     0x01    /* 停止时钟节拍时也能正确计时 */
+
+/* 时钟源 */
+struct ClockSource {
+    char *name;
+    int rating;                     /* 时钟源的质量，选择值更大的时钟源 */
+    unsigned int flags;
+    unsigned long long (*read)(void);
+    unsigned long mult;             /* 纳秒 = (计数 * mult) >> shift */
+    unsigned int shift;
+    unsigned long khz;              /* 计数的频率 */
+};
+
+PUBLIC void InitClockSource();
+PUBLIC int ClockSourceRegister(struct ClockSource *cs);
+PUBLIC unsigned long long ClockSourceNow();
+PUBLIC int ClockSourceContinuous();
+
+PUBLIC int SysClockGetTime(clockid_t clockid, struct timespec *ts);
+
+#endif   /* _CLOCK_CLOCKSOURCE_H */
@@ -17,5 +17,6 @@
 PUBLIC void InitPitClockDriver();
 */
 PUBLIC void SysMSleep(unsigned int msecond);
+PUBLIC void SysUSleep(unsigned int usecond);
 
 #endif  /* _DRIVER_ */
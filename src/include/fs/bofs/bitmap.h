@@ -26,6 +26,9 @@ PUBLIC int BOFS_AllocBitmap(struct BOFS_SuperBlock *sb, enum BOFS_BM_TYPE bmType
 PUBLIC int BOFS_FreeBitmap(struct BOFS_SuperBlock *sb, enum BOFS_BM_TYPE bmType, unsigned int idx);
 PUBLIC int BOFS_SyncBitmap(struct BOFS_SuperBlock *sb, enum BOFS_BM_TYPE bmType, unsigned int idx);
 
+PUBLIC int BOFS_AllocBitmapRun(struct BOFS_SuperBlock *sb, int goal, unsigned int counts, unsigned int *got);
+PUBLIC int BOFS_SyncBitmapRange(struct BOFS_SuperBlock *sb, enum BOFS_BM_TYPE bmType, unsigned int idx, unsigned int counts);
+
 /* 扇区位图idx和lba的转换 */
 #define BOFS_IDX_TO_LBA(sb, idx) ((sb)->dataStartLba + (idx))
 #define BOFS_LBA_TO_IDX(sb, lba) ((lba) - (sb)->dataStartLba)
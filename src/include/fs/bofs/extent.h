@@ -0,0 +1,92 @@
+/*
+ * file:		include/fs/bofs/extent.h
+ * auther:		Jason Hu
+ * time:		2020/3/18
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+/*
+区段：用（起始lba，块数）记录文件中一段磁盘上连续的数据块。
+    有BOFS_INODE_EXTENTS标志的节点，blocks[0~13]直接保存7个区段，放不下的区段
+保存在区段块里面，blocks[14]指向第一个区段块，区段块通过next连成链表。
+区段按照文件中的顺序排列，文件没有空洞，第n个区段的第一个块在文件中的索引
+就是前面所有区段块数的和。
+    打开的节点在内存中有一份完整的区段表，映射一个块只需要找到所在的区段，
+顺序读取时一个区段内的块直接计算出来，不用再读取间接块。
+*/
+
+#ifndef _BOFS_EXTENT_H
+#define _BOFS_EXTENT_H
+
+#include <lib/types.h>
+#include <lib/stdint.h>
+#include <book/list.h>
+
+#include <fs/bofs/inode.h>
+#include <fs/bofs/super_block.h>
+
+struct BOFS_Extent {
+	uint32 start;	/* 第一个块的lba */
+	uint32 count;	/* 块的数量，0表示没有使用 */
+} PACKED;
+
+/* 节点中直接保存的区段数，以及保存区段块链表的位置 */
+#define BOFS_INODE_EXTENT_NR	7
+#define BOFS_EXTENT_BLOCK_INDEX	14
+
+#define BOFS_INODE_EXTENT(inode) ((struct BOFS_Extent *)(inode)->blocks)
+
+/* 区段块，占用一个数据块 */
+struct BOFS_ExtentBlock {
+	uint32 next;	/* 下一个区段块的lba，0表示最后一个 */
+	uint32 count;	/* 这个块中的区段数 */
+	struct BOFS_Extent extents[0];
+} PACKED;
+
+#define BOFS_EXTENTS_PER_BLOCK(sb) \
+	(((sb)->blockSize - sizeof(struct BOFS_ExtentBlock)) / sizeof(struct BOFS_Extent))
+
+/* 一次最多分配的连续块数，太大的话找不到连续空间时扫描位图太慢 */
+#define BOFS_EXTENT_ALLOC_MAX	256
+
+/* 内存中最多保存的区段表数，超过后回收最久没有使用的 */
+#define BOFS_EXTENT_CACHE_MAX	32
+
+/* 节点在内存中的区段表 */
+struct BOFS_ExtentCache {
+	struct List list;		/* LRU链表，最近使用的在末尾 */
+	dev_t devno;			/* 设备号 */
+	unsigned int inode;		/* 节点id */
+	int users;				/* 正在使用的数量 */
+	char dead;				/* 已经失效，最后一个使用者释放 */
+	unsigned int count;		/* 区段数 */
+	unsigned int capacity;	/* 数组能保存的区段数 */
+	struct BOFS_Extent *extents;	/* 所有的区段 */
+	uint32 *firsts;			/* 每个区段第一个块在文件中的索引 */
+	uint32 blocks;			/* 所有区段的块数 */
+	uint32 headLba;			/* 第一个区段块 */
+	uint32 tailLba;			/* 最后一个区段块 */
+	unsigned int hint;		/* 上次找到的区段，顺序访问时直接命中 */
+};
+
+PUBLIC int BOFS_ExtentGetBlock(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 *block,
+	struct BOFS_SuperBlock *sb);
+
+PUBLIC int BOFS_ExtentMapBlocks(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 count,
+	uint32 *blocks,
+	struct BOFS_SuperBlock *sb);
+
+PUBLIC int BOFS_ExtentReserve(struct BOFS_Inode *inode,
+	uint32 count,
+	struct BOFS_SuperBlock *sb);
+
+PUBLIC int BOFS_ExtentRelease(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb);
+
+PUBLIC void BOFS_ExtentCacheInvalidate(dev_t devno, unsigned int inode);
+
+#endif /* _BOFS_EXTENT_H */
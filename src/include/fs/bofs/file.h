@@ -14,6 +14,7 @@
 #include <lib/time.h>
 #include <fs/bofs/super_block.h>
 #include <fs/bofs/pipe.h>
+#include <fs/bofs/page_cache.h>
 
 #define BOFS_MAX_FD_NR 128
 
@@ -58,6 +59,7 @@ struct BOFS_FileDescriptor
 	struct BOFS_DirEntry *parentEntry;	/* parent dir entry */
 	struct BOFS_Inode *inode;			/* file inode */
     struct BOFS_Pipe *pipe;			    /* pipe file */
+    struct BOFS_ReadAhead readAhead;    /* 顺序读取的预读状态 */
 };
 
 /* 记录一些重要信息 */
@@ -99,6 +101,12 @@ PUBLIC int BOFS_Remove(const char *pathname, struct BOFS_SuperBlock *sb);
 
 PUBLIC int BOFS_Write(int fd, void *buf, unsigned int count);
 PUBLIC int BOFS_Read(int fd, void *buf, unsigned int count);
+PUBLIC int BOFS_InodeRead(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb,
+	uint32 pos,
+	void* buf,
+	uint32 count);
+PUBLIC struct BOFS_Inode *BOFS_DupInode(int fd, struct BOFS_SuperBlock **sb);
 PUBLIC int BOFS_Lseek(int fd, int offset, unsigned char whence);
 PUBLIC int BOFS_Ioctl(int fd, int cmd, int arg);
 PUBLIC int BOFS_Trancate(int fd);
@@ -115,6 +123,7 @@ PUBLIC int BOFS_Stat(const char *pathname,
 PUBLIC void BOFS_InitFile();
 
 PUBLIC void BOFS_UpdateInodeOpenCounts(struct Task *task);
+PUBLIC void BOFS_PutInodeOpenCounts(struct Task *task);
 PUBLIC void BOFS_ReleaseTaskFiles(struct Task *task);
 
 void BOFS_Redirect(unsigned int oldfd, unsigned int newfd);
@@ -39,6 +39,9 @@
 #define BOFS_IMODE_D 0X20 /*directory type mode*/
 #define BOFS_IMODE_V 0X20 /* device mode*/
 
+/* 节点标志 */
+#define BOFS_INODE_EXTENTS 0X01 /* 数据块用区段记录，见fs/bofs/extent.h */
+
 /*
 we assume a inode is 128 bytes
 */
@@ -0,0 +1,74 @@
+/*
+ * file:		include/fs/bofs/page_cache.h
+ * auther:		Jason Hu
+ * time:		2020/2/20
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+/*
+页缓存：以节点为索引，按页（4KB）缓存文件的数据。
+读取文件时直接从缓存页复制到读取者的缓冲区，
+检测到顺序读取后，由预读线程提前把后面的页读入缓存。
+写入和释放节点数据时，对应的缓存页会失效。
+*/
+
+#ifndef _BOFS_PAGE_CACHE_H
+#define _BOFS_PAGE_CACHE_H
+
+#include <lib/types.h>
+#include <lib/stdint.h>
+#include <book/atomic.h>
+#include <book/list.h>
+
+#include <fs/bofs/inode.h>
+#include <fs/bofs/super_block.h>
+
+/* 最多缓存的页数，超过后回收最久没有使用的页（2MB） */
+#define BOFS_PAGE_CACHE_MAX     512
+
+/* 哈希表的大小，需要是2的次幂 */
+#define BOFS_PAGE_HASH_SIZE     256
+
+/* 预读窗口的最小和最大页数 */
+#define BOFS_READ_AHEAD_MIN     4
+#define BOFS_READ_AHEAD_MAX     32
+
+/* 缓存页 */
+struct BOFS_CachePage {
+    struct List hashList;       /* 哈希链表 */
+    struct List lruList;        /* LRU链表，最近使用的在末尾 */
+    dev_t devno;                /* 文件所在的设备 */
+    unsigned int inode;         /* 节点id */
+    unsigned int index;         /* 页在文件中的索引 */
+    char uptodate;              /* 数据有效 */
+    char locked;                /* 正在从磁盘读取数据 */
+    char hashed;                /* 在哈希表中，失效后为0 */
+    Atomic_t count;             /* 使用者计数 */
+    unsigned char *data;        /* 页的数据 */
+};
+
+/* 预读状态，每个打开的文件有一个 */
+struct BOFS_ReadAhead {
+    unsigned int nextPos;       /* 顺序读取时，下一次读取的位置 */
+    unsigned int window;        /* 预读窗口的页数，0表示不是顺序读取 */
+    unsigned int aheadEnd;      /* 已经提交预读的页的结束索引 */
+};
+
+PUBLIC int BOFS_InitPageCache();
+
+PUBLIC int BOFS_PageCacheRead(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb,
+	uint32 pos,
+	void *buf,
+	uint32 count,
+	struct BOFS_ReadAhead *ra);
+
+PUBLIC void BOFS_PageCacheInvalidate(struct BOFS_SuperBlock *sb,
+	struct BOFS_Inode *inode,
+	uint32 pos,
+	uint32 count);
+
+PUBLIC void BOFS_PageCacheInvalidateInode(struct BOFS_SuperBlock *sb,
+	struct BOFS_Inode *inode);
+
+#endif  /* _BOFS_PAGE_CACHE_H */
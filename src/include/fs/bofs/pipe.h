@@ -11,12 +11,16 @@
 2、如果有写端没有关闭，但也没有写入数据，此时读取，剩余数据读取后，再次读取会阻塞，直到管道有数据可读后才返回。
 3.如果所有读端的文件描述符都关闭，仍然写入，那么会发出SIGPIPE信号，默认终止进程，但可以捕捉
 4、如果有读端没有关闭，但也没有读取数据，此时写入，写满时会阻塞，直到有空位置才写入数据，并返回。
+5.不大于PIPE_BUF的写入是原子的，要等到有足够的空间一次写完，不会和其它写者的数据交错；
+大于PIPE_BUF的写入分成多次，每次写入当前能容纳的数据量。
+6.阻塞的读写被信号打断时，已经传输了数据就返回传输的数据量，否则返回-1。
 
-读写整体互斥：
-1.读取的时候，如果有进程正在写，那么当前进程进入等待队列，等进程写完后唤醒。
-2.写入的时候，如果有进程正在读取，那么当前进程进入等待队列，等进程读完后再写入。
-3.如果数据量超过PIPE_SIZE，写入进程会阻塞，此时允许读取。
-4.在写进程阻塞过程中，读取进程可以被写进程中断，如果有空间可以写入。
+【实现】
+匿名管道和命名管道（FIFO）使用同一个struct BOFS_Pipe，数据放在以字节为单元的
+io队列中，环形缓冲区的复制和读写的等待都由io队列完成，管道只通过interrupted
+告诉io队列什么时候停止等待（一端全部关闭或者收到信号）。
+读写不互斥：读者和写者各自在io队列中预留位置，然后同时复制数据，
+一次读写最多复制两次（绕回缓冲区开头时），每一批数据只唤醒一次对方。
 */
 
 #ifndef _BOFS_PIPE_H
@@ -25,21 +29,23 @@
 #include <lib/stdint.h>
 #include <lib/types.h>
 #include <book/atomic.h>
+#include <lib/const.h>
 #include <book/ioqueue.h>
+#include <book/waitqueue.h>
 #include <fs/bofs/file.h>
 
 /* 一个管道最多能被多少个任务占用 */
 #define MAX_PIPE_PER_TASK_NR    32
 
-/* 管道大小为1个页的大小 */
+/* 管道大小为1个页的大小，不能小于PIPE_BUF */
 #define PIPE_SIZE    4096
 
 /* 进程间通信管道 */
 struct BOFS_Pipe {
-    struct IoQueue ioqueue;     /* 输入输出队列 */
+    struct IoQueue ioqueue;     /* 输入输出队列，以字节为单元 */
     Atomic_t readReference;     /* 读端引用 */
     Atomic_t writeReference;    /* 写端引用 */
-    struct List waitList;       /* 打开时的等待队列 */
+    struct WaitQueue waitQueue; /* 打开时的等待队列 */
 
     /* 使用通道的任务的进程id */
     
@@ -53,6 +59,9 @@ struct BOFS_Pipe {
         (file->flags & BOFS_FLAGS_PIPE)
 
 PUBLIC int BOFS_PipeInit(struct BOFS_Pipe *pipe);
+PUBLIC int BOFS_PipeReadData(struct BOFS_Pipe *pipe, void *buffer, size_t count);
+PUBLIC int BOFS_PipeWriteData(struct BOFS_Pipe *pipe, void *buffer, size_t count);
+PUBLIC void BOFS_PipeWakeUp(struct BOFS_Pipe *pipe);
 
 PUBLIC bool BOFS_IsPipe(unsigned int localFd);
 PUBLIC int BOFS_Pipe(int fd[2]);
@@ -10,6 +10,9 @@
 /* 超级块魔数 */
 #define BOFS_SUPER_BLOCK_MAGIC 0x19980325
 
+/* 文件系统特性 */
+#define BOFS_FEATURE_EXTENTS 0x01	/* 新建的节点使用区段 */
+
 struct BOFS_SuperBlock
 {
 	/*disk info*/
@@ -44,10 +47,19 @@ struct BOFS_SuperBlock
 	struct Bitmap sectorBitmap;	/*sector manager bitmap*/
 	struct Bitmap inodeBitmap;		/*inode manager bitmap*/
 	struct BOFS_Dir *rootDir;   /* 根目录指针，每一个文件系统都有一个自己的根目录 */
+
+	/* 放在最后，旧的文件系统格式化时这里被清0，读出来就是没有任何特性 */
+	uint32 features;	/* 文件系统特性 */
 } PACKED;
 
 #define BOFS_HAD_FS(sb) ((sb)->magic == BOFS_SUPER_BLOCK_MAGIC) ? 1: 0
 
+#define BOFS_HAS_FEATURE(sb, feature) ((sb)->features & (feature))
+
+/* 新建节点的标志 */
+#define BOFS_NEW_INODE_FLAGS(sb) \
+	(BOFS_HAS_FEATURE(sb, BOFS_FEATURE_EXTENTS) ? BOFS_INODE_EXTENTS : 0)
+
 /* fs */
 PUBLIC int BOFS_MakeFS(struct BOFS_SuperBlock *superBlock,
     dev_t devno, 
@@ -117,6 +129,16 @@ PUBLIC int BOFS_GetInodeData(struct BOFS_Inode *inode,
 	uint32 *block,
 	struct BOFS_SuperBlock *sb);
 
+PUBLIC int BOFS_MapInodeBlocks(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 count,
+	uint32 *blocks,
+	struct BOFS_SuperBlock *sb);
+
+PUBLIC int BOFS_ReserveInodeBlocks(struct BOFS_Inode *inode,
+	uint32 count,
+	struct BOFS_SuperBlock *sb);
+
 int BOFS_SyncInode(struct BOFS_Inode *inode, 
     struct BOFS_SuperBlock *sb);
 
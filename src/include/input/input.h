@@ -79,9 +79,10 @@ PUBLIC int RegisterInputDevice(InputDevice_t *iptdev,
 
 PUBLIC int UnregisterInputDevice(InputDevice_t *iptdev);
 
+/* 在中断中调用，队列满了就丢弃数据，不能睡眠 */
 STATIC INLINE void InputDevicePutIoData(InputDevice_t *iptdev, uint32_t data)
 {
-    IoQueuePut(&iptdev->ioqueue, data);
+    IoQueueTryPut(&iptdev->ioqueue, data);
 }
 
 STATIC INLINE uint32_t InputDeviceGetIoData(InputDevice_t *iptdev)
@@ -14,19 +14,20 @@
 #include <kgc/color.h>
 #include <kgc/window/window.h>
 
-/* 消息节点，多个消息节点组成窗口消息队列 */
-typedef struct KGC_MessageNode {
-    struct List list;           /* 链表节点 */
-    KGC_Message_t message;      /* 消息 */
-} KGC_MessageNode_t;
+/* 窗口消息队列的槽数 */
+#define KGC_MESSAGE_QUEUE_LEN   64
+
+/* 消息的优先级，鼠标移动最低，不会挡住按键和鼠标按钮 */
+#define KGC_MSG_PRIO_MOTION     0
+#define KGC_MSG_PRIO_INPUT      1
+#define KGC_MSG_PRIO_QUIT       2
 
 /* 管理 */
 PUBLIC int KGC_SendMessage(KGC_Message_t *message);
 PUBLIC int KGC_RecvMessage(KGC_Message_t *message);
+PUBLIC int KGC_WaitMessage(KGC_Message_t *message);
 PUBLIC int SysKGC_Message(int operate, KGC_Message_t *message);
-PUBLIC KGC_MessageNode_t *KGC_CreateMessageNode();
-PUBLIC void KGC_AddMessageNode(KGC_MessageNode_t *node, KGC_Window_t *window);
-PUBLIC void KGC_FreeMessageList(KGC_Window_t *window);
+PUBLIC int KGC_PostMessage(KGC_Window_t *window, KGC_Message_t *message);
 
 /* 执行 */
 PUBLIC int KGC_MessageDoWindow(KGC_MessageWindow_t *message);
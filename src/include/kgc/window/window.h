@@ -66,6 +66,8 @@ typedef struct KGC_WindowWidget {
     
 } KGC_WindowWidget_t;
 
+struct MsgQueue;
+
 /* 窗口结构 */
 typedef struct KGC_Window {
     struct List list;                           /* 在全局窗口中的链表 */
@@ -77,8 +79,7 @@ typedef struct KGC_Window {
     /* 窗口对应的任务，避免互相引用，使用空指针，使用时转换 */
     void *task;
     
-    struct List messageListHead;                /* 消息队列头 */
-    Spinlock_t messageLock;                     /* 消息锁 */
+    struct MsgQueue *msgQueue;                  /* 消息队列 */
     char name[KGC_WINDOW_NAME_LEN];      /* 窗口名字 */
     char title[KGC_WINDOW_TITLE_LEN];      /* 窗口的标题 */
     struct KGC_Window *parentWindow;        /* 父窗口 */
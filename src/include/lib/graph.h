@@ -71,5 +71,6 @@ int GUI_DrawBitmapPlus(int x, int y, int width, int height, unsigned int *bitmap
 int GUI_DrawTextPlus(int x, int y, char *text, unsigned int color);
 
 int GUI_PollEven(GUI_Even_t *even);
+int GUI_WaitEven(GUI_Even_t *even);
 
 #endif /* _LIB_GRAPH_H */
\ No newline at end of file
@@ -0,0 +1,27 @@
+/*
+ * file:		include/lib/lockscan.h
+ * auther:		Jason Hu
+ * time:		2020/3/11
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+#ifndef _LIB_LOCKSCAN_H
+#define _LIB_LOCKSCAN_H
+
+#include "stdint.h"
+#include "stddef.h"
+#include "types.h"
+
+/* 锁类扫描状态，时间以微秒为单位 */
+typedef struct lockscan_status {
+    char ls_name[32];               /* 锁类的名字 */
+    unsigned long ls_acquisitions;  /* 获取次数 */
+    unsigned long ls_contentions;   /* 需要等待的次数 */
+    unsigned long ls_waittime;      /* 总等待时间 */
+    unsigned long ls_waitmax;       /* 最长等待时间 */
+    unsigned long ls_holdtime;      /* 总持有时间 */
+    unsigned long ls_holdmax;       /* 最长持有时间 */
+} lockscan_status_t;
+
+int lockscan(lockscan_status_t *ls, int *idx);
+
+#endif  /* _LIB_LOCKSCAN_H */
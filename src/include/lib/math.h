@@ -8,6 +8,9 @@
 #ifndef _LIB_MATH_H
 #define _LIB_MATH_H
 
+#include <lib/stdint.h>
+#include <lib/types.h>
+
 /* max() & min() */
 #define	MAX(a,b)	((a) > (b) ? (a) : (b))
 #define	MIN(a,b)	((a) < (b) ? (a) : (b))
@@ -18,6 +21,29 @@
 /* 除后下舍 */
 #define DIV_ROUND_DOWN(X, STEP) ((X) / (STEP))
 
+/**
+ * DivU64 - 64位数除以32位数
+ * @n: 被除数，返回时保存商
+ * @base: 除数
+ * 
+ * 内核没有链接libgcc，不能直接用64位除法，所以分成两次32位除法
+ * 返回余数
+ */
+PRIVATE INLINE uint32_t DivU64(unsigned long long *n, uint32_t base)
+{
+    uint32_t high = (uint32_t)(*n >> 32);
+    uint32_t low = (uint32_t)*n;
+    uint32_t quotHigh = 0, rem;
+
+    if (high >= base) {
+        quotHigh = high / base;
+        high %= base;
+    }
+    __asm__ ("divl %2" : "=a" (low), "=d" (rem) : "rm" (base), "0" (low), "1" (high));
+    *n = ((unsigned long long)quotHigh << 32) | low;
+    return rem;
+}
+
 int min(int a, int b);
 int max(int a, int b);
 int abs(int n);
@@ -18,7 +18,40 @@ typedef struct meminfo {
     unsigned long mi_used;     /* 物理内存已使用大小 */
 } meminfo_t;
 
+/* 内存缓存扫描状态 */
+typedef struct cachescan_status {
+    char cs_name[24];           /* 缓存名字 */
+    unsigned long cs_objsize;   /* 对象大小 */
+    unsigned long cs_objnum;    /* 每个组的对象数量 */
+    unsigned long cs_groups;    /* 组的数量 */
+    unsigned long cs_inuse;     /* 正在使用的对象数量 */
+    unsigned long cs_wasted;    /* 组占用的内存中没有被对象使用的字节数 */
+    unsigned long cs_magazine;  /* 弹匣中缓存的对象数量 */
+    unsigned long cs_allocs;    /* 分配次数 */
+    unsigned long cs_hits;      /* 弹匣命中次数 */
+    unsigned long cs_frees;     /* 释放次数 */
+    unsigned long cs_refills;   /* 弹匣装填次数 */
+    unsigned long cs_flushes;   /* 弹匣回写次数 */
+    unsigned long cs_grows;     /* 组创建次数 */
+} cachescan_status_t;
+
+/* 块缓冲状态 */
+typedef struct bufstat {
+    unsigned long bs_buffers;       /* 缓冲区数量 */
+    unsigned long bs_size;          /* 缓冲区占用的内存 */
+    unsigned long bs_maxsize;       /* 缓冲区占用内存的上限 */
+    unsigned long bs_dirty;         /* 脏缓冲区数量 */
+    unsigned long bs_hits;          /* 读取命中次数 */
+    unsigned long bs_misses;        /* 读取未命中次数 */
+    unsigned long bs_evictions;     /* 回收次数 */
+    unsigned long bs_writebacks;    /* 回收前写回次数 */
+    unsigned long bs_flushed;       /* 写回线程写回次数 */
+    unsigned long bs_throttled;     /* 写入者被限制的次数 */
+} bufstat_t;
+
 void getmem(meminfo_t *mi);
+int cachescan(cachescan_status_t *cs, int *idx);
+int bufstat(bufstat_t *bs);
 
 void *mmap(uint32_t addr, uint32_t len, uint32_t prot, uint32_t flags);
 int munmap(uint32_t addr, uint32_t len);
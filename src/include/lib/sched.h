@@ -0,0 +1,21 @@
+/*
+ * file:		include/lib/sched.h
+ * auther:		Jason Hu
+ * time:		2020/3/15
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+#ifndef _LIB_SCHED_H
+#define _LIB_SCHED_H
+
+/* clone的标志，没有设置的资源和fork一样复制一份 */
+#define CLONE_VM        0x01    /* 共享地址空间 */
+#define CLONE_FILES     0x02    /* 共享文件描述符表 */
+#define CLONE_SIGHAND   0x04    /* 共享信号行为，必须同时共享地址空间 */
+
+/* 创建线程使用的标志 */
+#define CLONE_THREAD_FLAGS  (CLONE_VM | CLONE_FILES | CLONE_SIGHAND)
+
+/* 子任务在stack指向的栈上调用fn(arg)，返回值作为退出状态 */
+int clone(int (*fn)(void *), void *stack, unsigned long flags, void *arg);
+
+#endif  /* _LIB_SCHED_H */
@@ -49,5 +49,6 @@ int reboot();
 void getver(char *buf, int buflen);
 
 #include "taskscan.h"
+#include "lockscan.h"
 
 #endif  /* _LIB_STDLIB_H */
@@ -12,6 +12,17 @@
 
 typedef unsigned long clock_t;
 typedef unsigned long time_t;
+typedef int clockid_t;
+
+/* 时钟的类型 */
+#define CLOCK_REALTIME      0
+#define CLOCK_MONOTONIC     1   /* 开机后经过的时间，不会倒退 */
+
+struct timespec
+{
+  time_t tv_sec;		/* Seconds.  */
+  long tv_nsec;			/* Nanoseconds.  */
+};
 
 struct tm
 {
@@ -27,6 +38,7 @@ struct tm
 };
 
 unsigned int time(struct tm *tm);
+int clock_gettime(clockid_t clockid, struct timespec *ts);
 char *asctime_r(const struct tm *tp, char *buf);
 char *asctime(const struct tm *tp);
 
@@ -15,6 +15,8 @@
 #include <book/fs.h>
 #include <book/mmu.h>
 #include <book/power.h>
+#include <book/smp.h>
+#include <book/threadpool.h>
 #include <net/network.h>
 #include <pci/pci.h>
 #include <clock/clock.h>
@@ -81,6 +83,14 @@ PUBLIC int main()
     /* 初始化文件系统 */
     InitFileSystem();
 
+#ifdef CONFIG_SMP
+    /* 启动其它处理器 */
+    InitSmp();
+#endif /* CONFIG_SMP */
+
+    /* 处理器都启动后，每个处理器创建一个线程池的工作者 */
+    InitThreadPool();
+
     /* 执行最后的初始化设置，进入群雄逐鹿的场面 */
 	InitUserProcess();
 	
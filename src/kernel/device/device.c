@@ -8,6 +8,9 @@
 #include <book/debug.h>
 #include <book/arch.h>
 #include <book/device.h>
+#include <book/spinlock.h>
+#include <book/task.h>
+#include <book/rcu.h>
 #include <lib/string.h>
 
 /* 设备链表 */
@@ -16,9 +19,94 @@ LIST_HEAD(allDeviceListHead);
 
 /*
 构建一个散列表，用来把设备号和结构进行对应，可以提高
-对设备的搜索速度
+对设备的搜索速度。
+设备名和设备号各有一个散列表，链是以NULL结尾的单链表，不需要初始化。
+查找的时候不加锁，使用RCU；注册和注销持有deviceLock，注销后等待宽限期，
+之后才能释放设备。
 */
 
+/* 散列表的大小，必须是2的幂 */
+#define DEVICE_HASH_SIZE    64
+
+#define DEVNO_HASH(devno)     (((unsigned long)(devno) ^ ((unsigned long)(devno) >> MINORBITS)) & (DEVICE_HASH_SIZE - 1))
+
+PRIVATE struct Device *deviceNameHash[DEVICE_HASH_SIZE];
+PRIVATE struct Device *deviceDevnoHash[DEVICE_HASH_SIZE];
+
+PRIVATE SPIN_LOCK_INIT(deviceLock);
+
+/**
+ * DeviceNameHash - 计算设备名的散列值
+ * @name: 设备名
+ */
+PRIVATE unsigned long DeviceNameHash(char *name)
+{
+    unsigned long hash = 0;
+
+    while (*name)
+        hash = hash * 31 + *name++;
+
+    return hash & (DEVICE_HASH_SIZE - 1);
+}
+
+/**
+ * RegisterDevice - 把设备添加到设备链表和散列表
+ * @device: 设备
+ *
+ * 设备名和设备号需要在注册前设置好
+ */
+PUBLIC void RegisterDevice(struct Device *device)
+{
+    unsigned long nameHash = DeviceNameHash(device->name);
+    unsigned long devnoHash = DEVNO_HASH(device->devno);
+
+    unsigned long flags = SpinLockIrqSave(&deviceLock);
+
+    /* 添加到设备队列的最后面 */
+    ListAddTailRcu(&device->list, &allDeviceListHead);
+
+    /* 插入到散列链的最前面，初始化完成后才能被读者看到 */
+    device->nameHashNext = deviceNameHash[nameHash];
+    RcuAssignPointer(deviceNameHash[nameHash], device);
+
+    device->devnoHashNext = deviceDevnoHash[devnoHash];
+    RcuAssignPointer(deviceDevnoHash[devnoHash], device);
+
+    SpinUnlockIrqSave(&deviceLock, flags);
+}
+
+/**
+ * UnregisterDevice - 把设备从设备链表和散列表中删除
+ * @device: 设备
+ *
+ * 会等待宽限期，返回后就没有读者引用这个设备了，可以释放
+ */
+PUBLIC void UnregisterDevice(struct Device *device)
+{
+    struct Device **pprev;
+
+    unsigned long flags = SpinLockIrqSave(&deviceLock);
+
+    ListDelRcu(&device->list);
+
+    /* 跳过自己，保留自己的next，正在这里的读者还能继续往后查找 */
+    pprev = &deviceNameHash[DeviceNameHash(device->name)];
+    while (*pprev != NULL && *pprev != device)
+        pprev = &(*pprev)->nameHashNext;
+    if (*pprev != NULL)
+        *pprev = device->nameHashNext;
+
+    pprev = &deviceDevnoHash[DEVNO_HASH(device->devno)];
+    while (*pprev != NULL && *pprev != device)
+        pprev = &(*pprev)->devnoHashNext;
+    if (*pprev != NULL)
+        *pprev = device->devnoHashNext;
+
+    SpinUnlockIrqSave(&deviceLock, flags);
+
+    SynchronizeRcu();
+}
+
 /**
  * LookUpDevice - 查找一个设备
  * @name: 设备名
@@ -27,14 +115,7 @@ LIST_HEAD(allDeviceListHead);
  */
 PUBLIC int SearchDevice(char *name)
 {
-    struct Device *device;
-    ListForEachOwner(device, &allDeviceListHead, list) {
-        /* 如果名字相等就说明找到 */
-        if (!strcmp(device->name, name)) {
-            return 1;
-        }
-    }
-    return 0;
+    return GetDeviceByName(name) != NULL;
 }
 
 /**
@@ -46,13 +127,19 @@ PUBLIC int SearchDevice(char *name)
 PUBLIC struct Device *GetDeviceByName(char *name)
 {
     struct Device *device;
-    ListForEachOwner(device, &allDeviceListHead, list) {
+
+    RcuReadLock();
+
+    device = RcuDereference(deviceNameHash[DeviceNameHash(name)]);
+    while (device != NULL) {
         /* 如果名字相等就说明找到 */
-        if (!strcmp(device->name, name)) {
-            return device;
-        }
+        if (!strcmp(device->name, name))
+            break;
+        device = RcuDereference(device->nameHashNext);
     }
-    return NULL;
+
+    RcuReadUnlock();
+    return device;
 }
 
 PUBLIC void DumpDevice(struct Device *device)
@@ -96,17 +183,20 @@ PRIVATE int IsBadDevice(int devno)
  */
 PUBLIC struct Device *GetDeviceByID(int devno)
 {
-    /* 先用散列表的形式搜索 */
+    struct Device *device;
 
+    /* 用散列表的形式搜索 */
+    RcuReadLock();
 
-    /* 再用链表搜索的方式 */
-    struct Device *device;
-    ListForEachOwner(device, &allDeviceListHead, list) {
-        if (device->devno == devno) {
-            return device;
-        }
+    device = RcuDereference(deviceDevnoHash[DEVNO_HASH(devno)]);
+    while (device != NULL) {
+        if (device->devno == devno)
+            break;
+        device = RcuDereference(device->devnoHashNext);
     }
-    return NULL;
+
+    RcuReadUnlock();
+    return device;
 }
 
 /**
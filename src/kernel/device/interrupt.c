@@ -16,6 +16,9 @@ EXTERN struct HardwareIntController picHardwareIntContorller;
 /* irq描述表，更深层次地表现中断 */
 struct IrqDescription irqDescriptionTable[NR_IRQS];
 
+/* 当前使用的硬件中断控制器，默认是pic，多处理器时会切换成ioapic */
+PRIVATE struct HardwareIntController *irqController = &picHardwareIntContorller;
+
 /** 
  *  InitIrqDescription - 初始化中断描述 
  */
@@ -73,7 +76,7 @@ PUBLIC int RegisterIRQ(unsigned int irq,
         return -1;
     
     /* 指定硬件控制器 */
-    irqDesc->controller = &picHardwareIntContorller;
+    irqDesc->controller = irqController;
     
     /* 设置irq名字 */
     irqDesc->irqname = irqname;
@@ -132,6 +135,35 @@ PUBLIC int RegisterIRQ(unsigned int irq,
 }
 
 
+/**
+ * SetIrqController - 设置硬件中断控制器
+ * @controller: 新的控制器
+ * 
+ * 已经注册的中断会从旧的控制器上关闭，然后在新的控制器上打开，
+ * 之后注册的中断都使用新的控制器
+ */
+PUBLIC void SetIrqController(struct HardwareIntController *controller)
+{
+    struct IrqDescription *irqDesc;
+    int i;
+
+    unsigned long flags = InterruptSave();
+
+    for (i = 0; i < NR_IRQS; i++) {
+        irqDesc = &irqDescriptionTable[i];
+        /* 没有注册的中断不用迁移 */
+        if (irqDesc->controller == NULL)
+            continue;
+
+        irqDesc->controller->disable(i);
+        irqDesc->controller = controller;
+        controller->enable(i);
+    }
+    irqController = controller;
+
+    InterruptRestore(flags);
+}
+
 /**
  * UnregisterIRQ - 注销中断
  * @irq: 中断号
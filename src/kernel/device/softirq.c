@@ -9,6 +9,8 @@
 #include <book/arch.h>
 #include <book/debug.h>
 #include <book/bitops.h>
+#include <book/smp.h>
+#include <clock/clockevent.h>
 #include <lib/string.h>
 
 /* 普通任务协助队列 */
@@ -20,24 +22,24 @@ struct TaskAssistHead highTaskAssistHead;
 /* 软中断表 */
 PRIVATE struct SoftirqAction softirqTable[NR_SOFTIRQS];
 
-/* 软中断事件的标志 */
-PRIVATE unsigned int softirqEvens;
+/* 软中断事件的标志，每个处理器各自处理自己的事件 */
+PRIVATE unsigned int softirqEvens[NR_CPUS];
 
 /**
- * GetSoftirqEvens - 获取软中断事件
+ * GetSoftirqEvens - 获取当前处理器的软中断事件
  */
 PRIVATE unsigned int GetSoftirqEvens()
 {
-    return softirqEvens;
+    return softirqEvens[CurrentCpuId()];
 }
 
 
 /**
- * SetSoftirqEvens - 设置软中断事件
+ * SetSoftirqEvens - 设置当前处理器的软中断事件
  */
 PRIVATE void SetSoftirqEvens(unsigned int evens)
 {
-    softirqEvens = evens;
+    softirqEvens[CurrentCpuId()] = evens;
 }
 
 /**
@@ -68,7 +70,7 @@ PUBLIC void ActiveSoftirq(unsigned int softirq)
     if (0 <= softirq && softirq < NR_SOFTIRQS) {
         /* 在对应位置修改软中断事件 */
         if (softirqTable[softirq].action)
-            softirqEvens |= (1 << softirq);  
+            softirqEvens[CurrentCpuId()] |= (1 << softirq);  
     }
 }
 
@@ -142,6 +144,9 @@ PUBLIC void DoSoftirq()
     /* 关闭中断 */
     unsigned long flags = InterruptSave();
 
+    /* 空闲时停止了时钟节拍，被中断唤醒后先恢复节拍 */
+    ClockEventIdleExit();
+
     /* 获取事件 */
     evens = GetSoftirqEvens();
 
@@ -306,7 +311,7 @@ PRIVATE void TaskAssistAction(struct SoftirqAction *action)
 PUBLIC void InitSoftirq()
 {
     /* 初始化软中断事件 */
-    softirqEvens = 0;
+    memset(softirqEvens, 0, sizeof(softirqEvens));
 
     /* 设置高级任务协助头为空 */
     highTaskAssistHead.head = NULL;
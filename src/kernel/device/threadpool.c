@@ -0,0 +1,288 @@
+/*
+ * file:		kernel/device/threadpool.c
+ * auther:	    Jason Hu
+ * time:		2020/3/13
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/threadpool.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/task.h>
+#include <book/smp.h>
+#include <lib/string.h>
+#include <lib/vsprintf.h>
+
+PRIVATE struct PoolWorker poolWorkers[POOL_MAX_WORKERS];
+
+/* 工作者的数量，为0表示线程池还没有运行 */
+PRIVATE int poolWorkerNr;
+
+/* 不是工作者提交的工作轮流放到各个工作者的队列 */
+PRIVATE unsigned int poolNextWorker;
+
+PRIVATE INLINE int DequeEmpty(struct PoolDeque *deque)
+{
+    return deque->head == deque->tail;
+}
+
+PRIVATE INLINE int DequeFull(struct PoolDeque *deque)
+{
+    return deque->tail - deque->head >= POOL_DEQUE_SIZE;
+}
+
+/* 添加到尾部 */
+PRIVATE INLINE void DequePush(struct PoolDeque *deque, struct PoolWork *work)
+{
+    deque->works[deque->tail++ & (POOL_DEQUE_SIZE - 1)] = work;
+}
+
+/* 所有者从尾部取出最新的工作 */
+PRIVATE INLINE struct PoolWork *DequePop(struct PoolDeque *deque)
+{
+    return deque->works[--deque->tail & (POOL_DEQUE_SIZE - 1)];
+}
+
+/* 其它工作者从头部偷取最早的工作 */
+PRIVATE INLINE struct PoolWork *DequeSteal(struct PoolDeque *deque)
+{
+    return deque->works[deque->head++ & (POOL_DEQUE_SIZE - 1)];
+}
+
+/**
+ * CurrentWorker - 获取当前任务对应的工作者
+ *
+ * 当前任务不是工作者返回NULL
+ */
+PRIVATE struct PoolWorker *CurrentWorker()
+{
+    struct Task *current = CurrentTask();
+    int i;
+
+    for (i = 0; i < poolWorkerNr; i++) {
+        if (poolWorkers[i].thread == current)
+            return &poolWorkers[i];
+    }
+    return NULL;
+}
+
+/**
+ * ThreadPoolHasWork - 线程池中是否有等待执行的工作
+ */
+PRIVATE int ThreadPoolHasWork()
+{
+    int i, prio;
+
+    for (i = 0; i < poolWorkerNr; i++) {
+        for (prio = 0; prio < POOL_PRIO_NR; prio++) {
+            if (!DequeEmpty(&poolWorkers[i].deques[prio]))
+                return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * ThreadPoolGetWork - 为工作者获取一个工作
+ * @worker: 工作者
+ *
+ * 按优先级从高到低，先取自己队列尾部的，再偷取其它队列头部的。
+ * 需要关闭中断后调用
+ */
+PRIVATE struct PoolWork *ThreadPoolGetWork(struct PoolWorker *worker)
+{
+    struct PoolDeque *deque;
+    int i, prio;
+
+    for (prio = 0; prio < POOL_PRIO_NR; prio++) {
+        deque = &worker->deques[prio];
+        if (!DequeEmpty(deque))
+            return DequePop(deque);
+
+        for (i = 1; i < poolWorkerNr; i++) {
+            deque = &poolWorkers[(worker->id + i) % poolWorkerNr].deques[prio];
+            if (!DequeEmpty(deque)) {
+                worker->stolen++;
+                return DequeSteal(deque);
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * ThreadPoolRunWork - 执行一个工作
+ * @work: 工作
+ *
+ * 执行完后工作就不属于线程池了，所有者可以马上重用或者释放它
+ */
+PRIVATE void ThreadPoolRunWork(struct PoolWork *work)
+{
+    work->func(work);
+    work->pending = 0;
+}
+
+/**
+ * PoolWorkerThread - 工作者线程
+ * @arg: 工作者
+ */
+PRIVATE void PoolWorkerThread(void *arg)
+{
+    struct PoolWorker *worker = arg;
+    struct PoolWork *work;
+    unsigned long flags;
+
+    while (1) {
+        /* 任何一个队列有工作都可以去偷取 */
+        WAIT_EVENT(&worker->moreWork, ThreadPoolHasWork());
+
+        while (1) {
+            flags = InterruptSave();
+            work = ThreadPoolGetWork(worker);
+            InterruptRestore(flags);
+
+            if (work == NULL)
+                break;
+
+            worker->executed++;
+            ThreadPoolRunWork(work);
+        }
+    }
+}
+
+/**
+ * ThreadPoolKick - 唤醒工作者处理新的工作
+ * @target: 放入工作的工作者
+ *
+ * 目标正在忙的话就唤醒一个空闲的工作者去偷取。需要关闭中断后调用
+ */
+PRIVATE void ThreadPoolKick(struct PoolWorker *target)
+{
+    int i;
+
+    if (WaitQueueActive(&target->moreWork)) {
+        WaitQueueWakeUp(&target->moreWork);
+        return;
+    }
+
+    for (i = 0; i < poolWorkerNr; i++) {
+        if (WaitQueueActive(&poolWorkers[i].moreWork)) {
+            WaitQueueWakeUp(&poolWorkers[i].moreWork);
+            return;
+        }
+    }
+}
+
+/**
+ * ThreadPoolQueueWork - 把工作提交到线程池
+ * @work: 工作
+ *
+ * 工作者提交的工作放到自己的队列，其它任务提交的轮流放到各个工作者的队列。
+ * 可以在中断上下文中调用。
+ * 成功返回0，线程池没有运行、工作已经在等待执行或者队列都满了返回-1
+ */
+PUBLIC int ThreadPoolQueueWork(struct PoolWork *work)
+{
+    struct PoolWorker *worker;
+    int i, ret = -1;
+
+    if (work == NULL || work->priority >= POOL_PRIO_NR)
+        return -1;
+
+    unsigned long flags = InterruptSave();
+
+    if (!poolWorkerNr || work->pending)
+        goto ToEnd;
+
+    worker = CurrentWorker();
+    if (worker == NULL)
+        worker = &poolWorkers[poolNextWorker++ % poolWorkerNr];
+
+    /* 队列满了就放到下一个工作者的队列 */
+    for (i = 0; i < poolWorkerNr; i++) {
+        if (!DequeFull(&worker->deques[work->priority]))
+            break;
+        worker = &poolWorkers[(worker->id + 1) % poolWorkerNr];
+    }
+    if (i == poolWorkerNr)
+        goto ToEnd;
+
+    work->pending = 1;
+    DequePush(&worker->deques[work->priority], work);
+    ThreadPoolKick(worker);
+    ret = 0;
+
+ToEnd:
+    InterruptRestore(flags);
+    return ret;
+}
+
+/**
+ * ThreadPoolQueueOrRun - 提交工作，不能提交就直接执行
+ * @work: 工作
+ *
+ * 工作还在等待执行就什么也不做，需要在能睡眠的上下文中调用
+ */
+PUBLIC void ThreadPoolQueueOrRun(struct PoolWork *work)
+{
+    if (work->pending)
+        return;
+
+    if (ThreadPoolQueueWork(work) < 0) {
+        work->pending = 1;
+        ThreadPoolRunWork(work);
+    }
+}
+
+/**
+ * PrintThreadPool - 打印线程池的状态
+ */
+PUBLIC void PrintThreadPool()
+{
+    int i;
+
+    printk(PART_TIP "\n----Thread Pool----\n");
+    for (i = 0; i < poolWorkerNr; i++) {
+        printk("worker %d cpu %d executed %d stolen %d\n", i,
+            poolWorkers[i].thread->cpu, poolWorkers[i].executed, poolWorkers[i].stolen);
+    }
+}
+
+/**
+ * InitThreadPool - 初始化线程池
+ *
+ * 在其它处理器启动后调用，每个处理器一个工作者
+ */
+PUBLIC void InitThreadPool()
+{
+    struct PoolWorker *worker;
+    char name[MAX_TASK_NAMELEN];
+    int i, prio, n;
+
+    n = cpuOnlineNr;
+    if (n > POOL_MAX_WORKERS)
+        n = POOL_MAX_WORKERS;
+
+    for (i = 0; i < n; i++) {
+        worker = &poolWorkers[i];
+        worker->id = i;
+        worker->thread = NULL;
+        for (prio = 0; prio < POOL_PRIO_NR; prio++) {
+            worker->deques[prio].head = worker->deques[prio].tail = 0;
+        }
+        WaitQueueInit(&worker->moreWork, NULL);
+        worker->executed = worker->stolen = 0;
+    }
+
+    /* 工作者开始运行前要能看到所有的队列 */
+    unsigned long flags = InterruptSave();
+
+    poolWorkerNr = n;
+    for (i = 0; i < n; i++) {
+        sprintf(name, "pool%d", i);
+        poolWorkers[i].thread = ThreadStart(name, TASK_WORKER_PRIO,
+            PoolWorkerThread, &poolWorkers[i]);
+    }
+
+    InterruptRestore(flags);
+}
@@ -39,8 +39,13 @@ PRIVATE void DoAllWork(struct CpuWorkQueue *cpuWorkQueue)
         ListDelInit(&work->list);
 
         /* 执行工作 */
+        cpuWorkQueue->currentWork = work;
         func(work);
+        cpuWorkQueue->currentWork = NULL;
     }
+
+    /* 工作都做完了，唤醒等待刷新的任务 */
+    WaitQueueWakeUpAll(&cpuWorkQueue->workDone);
 }
 
 /**
@@ -50,26 +55,10 @@ PRIVATE void DoAllWork(struct CpuWorkQueue *cpuWorkQueue)
 PRIVATE void WorkerThread(void *__cpuWorkQueue)
 {
     struct CpuWorkQueue *cpuWorkQueue = __cpuWorkQueue;
-    struct Task *current = CurrentTask();
     // printk("worker\n");
     while (1) {
-        /* 如果队列为空，就休眠 */
-        WaitQueueAdd(&cpuWorkQueue->moreWork, current);
-        /* 先把状态设置成阻塞，这样调度后就不会再次被调度，只有等待唤醒 */
-        current->status = TASK_BLOCKED;
-
-        if (ListEmpty(&cpuWorkQueue->workList)) {
-            //printk("empty thread %s blocked\n", cpuWorkQueue->thread->name);
-            
-            // 任务调度，不运行
-            Schedule();
-        }
-        
-        /* 之前如果工作为空就会休眠，直到被唤醒。到这里的时候，要么是唤醒后，
-        要么是没休眠直接到这，把任务从等待队列删除 */
-        WaitQueueRemove(&cpuWorkQueue->moreWork, current);
-        /* 再把状态设置成运行 */
-        current->status = TASK_RUNNING;
+        /* 如果队列为空，就在等待队列上睡眠，直到有工作加入后被唤醒 */
+        WAIT_EVENT(&cpuWorkQueue->moreWork, !ListEmpty(&cpuWorkQueue->workList));
         
         /* 执行工作 */
         DoAllWork(cpuWorkQueue);
@@ -108,11 +97,12 @@ PUBLIC struct WorkQueue *CreateWorkQueue(const char *name)
     cpuWorkQueue->myWorkQueue = workQueue;
     //
     // printk("ALLOC");
+    /* 初始化等待队列，线程开始运行后就会在上面等待 */
+    WaitQueueInit(&cpuWorkQueue->moreWork, NULL);
+    WaitQueueInit(&cpuWorkQueue->workDone, NULL);
+
     /* 需要创建一个线程来处理 */
     cpuWorkQueue->thread = ThreadStart((char *)name, TASK_PRIORITY_BEST, WorkerThread, cpuWorkQueue);   
-    
-    /* 初始化等待队列 */
-    WaitQueueInit(&cpuWorkQueue->moreWork, NULL);
 
     /* 把工作队列添加到工作队列链表 */
     ListAddTail(&workQueue->list, &workQueueList);
@@ -143,8 +133,8 @@ PUBLIC void DestroyWorkQueue(struct WorkQueue *workQueue)
     /* 从工作队列链表删除 */
     ListDel(&workQueue->list);
 
-    /* 如果线程在等待队列里面，就把等待队列中的线程删除 */
-    WaitQueueRemove(&cpuWorkQueue->moreWork, cpuWorkQueue->thread);
+    /* 线程的等待者在它自己的栈上，线程退出后直接清空等待队列 */
+    WaitQueueInit(&cpuWorkQueue->moreWork, NULL);
 
     /* 线程退出运行 */
     ThreadExit(cpuWorkQueue->thread);
@@ -218,13 +208,9 @@ PUBLIC void FlushWorkQueue(struct WorkQueue *workQueue)
 
     struct CpuWorkQueue *cpuWorkQueue = &workQueue->cpuWorkQueue;
     
-    /* 如果还有工作就休眠，直到没有工作才返回 */
-    while (!ListEmpty(&cpuWorkQueue->workList)) {
-        /* 应该休眠，在调度完所有工作后，查看是否有休眠者，有的话就唤醒休眠者
-        这里简单地使用了yield
-         */
-        TaskYield();
-    }
+    /* 如果还有工作就休眠，工作者线程做完所有工作后会唤醒自己 */
+    WAIT_EVENT(&cpuWorkQueue->workDone, ListEmpty(&cpuWorkQueue->workList) &&
+        cpuWorkQueue->currentWork == NULL);
     /* 工作队列的工作都做完了，现在返回 */
 }
 
@@ -206,4 +206,70 @@ PUBLIC int BOFS_SyncBitmap(struct BOFS_SuperBlock *sb,
 		return true;
 	}
 	return false;
-}
\ No newline at end of file
+}
+
+/**
+ * BOFS_AllocBitmapRun - 从扇区位图中分配一段连续的位
+ * @sb: 超级块
+ * @goal: 希望开始的位置，-1表示没有
+ * @counts: 最多分配的位数
+ * @got: 返回实际分配的位数
+ * 
+ * 目标位置空闲就从目标位置开始，文件可以接着使用上一个区段。
+ * 否则找一段足够长的空闲位，找不到就从第一个空闲位开始，能分配多少是多少。
+ * 超级块是紧凑的结构，位图复制一份再使用，位的数据还是同一份
+ * @return 成功返回索引下标，失败返回-1
+ */
+PUBLIC int BOFS_AllocBitmapRun(struct BOFS_SuperBlock *sb,
+    int goal, uint32 counts, uint32 *got)
+{
+	struct Bitmap btmp = sb->sectorBitmap;
+	uint32 bits = btmp.btmpBytesLen * 8;
+	uint32 n;
+	int idx;
+
+	if (goal >= 0 && goal < bits && !BitmapScanTest(&btmp, goal)) {
+		idx = goal;
+	} else {
+		idx = BitmapScan(&btmp, counts);
+		if (idx == -1 && counts > 1)
+			idx = BitmapScan(&btmp, 1);
+		if (idx == -1) {
+			printk("alloc sector bitmap run failed!\n");
+			return -1;
+		}
+	}
+
+	for (n = 0; n < counts && idx + n < bits; n++) {
+		if (BitmapScanTest(&btmp, idx + n))
+			break;
+		BitmapSet(&btmp, idx + n, 1);
+	}
+	*got = n;
+	return idx;
+}
+
+/**
+ * BOFS_SyncBitmapRange - 把一段位同步到磁盘
+ * @sb: 超级块
+ * @bmType: 位图类型
+ * @idx: 第一个位的索引
+ * @counts: 位的数量
+ * 
+ * 每个扇区只写一次
+ * @return 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_SyncBitmapRange(struct BOFS_SuperBlock *sb,
+    enum BOFS_BM_TYPE bmType, uint32 idx, uint32 counts)
+{
+	uint32 bitsPerSector = 8 * SECTOR_SIZE;
+	uint32 end = idx + counts;
+
+	while (idx < end) {
+		if (BOFS_SyncBitmap(sb, bmType, idx) == -1)
+			return -1;
+		/* 下一个扇区的第一个位 */
+		idx = (idx / bitsPerSector + 1) * bitsPerSector;
+	}
+	return 0;
+}
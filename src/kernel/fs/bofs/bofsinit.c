@@ -25,6 +25,7 @@
 #include <fs/bofs/dir.h>
 #include <fs/bofs/file.h>
 #include <fs/bofs/drive.h>
+#include <fs/bofs/page_cache.h>
 
 EXTERN struct List allBlockDeviceList;
 
@@ -138,6 +139,11 @@ PUBLIC int InitBoFS()
 {
     BOFS_InitFdTable();
 
+    if (BOFS_InitPageCache()) {
+        printk(PART_ERROR "init bofs page cache failed!\n");
+        return -1;
+    }
+
     /* 获取设备文件 */
     struct BlockDevice *device;
 
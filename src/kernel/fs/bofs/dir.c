@@ -616,7 +616,7 @@ PRIVATE int BOFS_CreateNewDirEntry(struct BOFS_SuperBlock *sb,
     //printk("BOFS_SyncBitmap\n");
 	
 	BOFS_CreateInode(&inode, inodeID, (BOFS_IMODE_R|BOFS_IMODE_W),
-		0, sb->devno);    
+		BOFS_NEW_INODE_FLAGS(sb), sb->devno);    
     //printk("BOFS_CreateInode\n");
 	
 	// 创建子目录项
@@ -13,6 +13,7 @@
 #include <lib/math.h>
 #include <fs/bofs/dir_entry.h>
 #include <fs/bofs/bitmap.h>
+#include <fs/bofs/extent.h>
 #include <clock/clock.h>
 #include <block/blk-buffer.h>
 
@@ -288,6 +289,9 @@ PUBLIC void BOFS_ReleaseDirEntry(struct BOFS_SuperBlock *sb,
     }
     /* 字符设备，块设备，任务文件都不用释放节点数据 */
 	
+	/* 节点id会被重新使用 */
+	BOFS_ExtentCacheInvalidate(sb->devno, childDir->inode);
+
 	/*free inode bitmap*/
 	BOFS_FreeBitmap(sb, BOFS_BMT_INODE, childDir->inode);
 	/*free inode bitmap*/
@@ -0,0 +1,708 @@
+/*
+ * file:		kernel/fs/bofs/extent.c
+ * auther:		Jason Hu
+ * time:		2020/3/18
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/memcache.h>
+#include <book/debug.h>
+#include <book/interrupt.h>
+
+#include <lib/string.h>
+#include <lib/math.h>
+
+#include <block/blk-buffer.h>
+
+#include <fs/bofs/inode.h>
+#include <fs/bofs/bitmap.h>
+#include <fs/bofs/super_block.h>
+#include <fs/bofs/extent.h>
+
+/* 所有的区段表，最近使用的在末尾 */
+PRIVATE LIST_HEAD(extentLruList);
+
+/* 区段表的数量 */
+PRIVATE unsigned int cachedExtents;
+
+/**
+ * FreeExtentCache - 释放区段表
+ * @cache: 区段表
+ */
+PRIVATE void FreeExtentCache(struct BOFS_ExtentCache *cache)
+{
+	if (cache->extents != NULL)
+		kfree(cache->extents);
+	if (cache->firsts != NULL)
+		kfree(cache->firsts);
+	kfree(cache);
+}
+
+/**
+ * UnlinkExtentCache - 让区段表失效
+ * @cache: 区段表
+ *
+ * 需要在关闭中断的情况下调用，没有使用者就直接释放
+ */
+PRIVATE void UnlinkExtentCache(struct BOFS_ExtentCache *cache)
+{
+	ListDel(&cache->list);
+	cachedExtents--;
+	cache->dead = 1;
+	if (!cache->users)
+		FreeExtentCache(cache);
+}
+
+/**
+ * GrowExtentCache - 扩大区段表的数组
+ * @cache: 区段表
+ *
+ * 新数组在开中断的时候分配，只在替换的时候关闭中断，
+ * 正在映射块的读者看到的总是完整的数组
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int GrowExtentCache(struct BOFS_ExtentCache *cache)
+{
+	unsigned int capacity = cache->capacity ? cache->capacity * 2 : BOFS_INODE_EXTENT_NR;
+	struct BOFS_Extent *extents, *oldExtents;
+	uint32 *firsts, *oldFirsts;
+
+	extents = kmalloc(capacity * sizeof(struct BOFS_Extent), GFP_KERNEL);
+	if (extents == NULL)
+		return -1;
+	firsts = kmalloc(capacity * sizeof(uint32), GFP_KERNEL);
+	if (firsts == NULL) {
+		kfree(extents);
+		return -1;
+	}
+
+	unsigned long flags = InterruptSave();
+	memcpy(extents, cache->extents, cache->count * sizeof(struct BOFS_Extent));
+	memcpy(firsts, cache->firsts, cache->count * sizeof(uint32));
+	oldExtents = cache->extents;
+	oldFirsts = cache->firsts;
+	cache->extents = extents;
+	cache->firsts = firsts;
+	cache->capacity = capacity;
+	InterruptRestore(flags);
+
+	if (oldExtents != NULL)
+		kfree(oldExtents);
+	if (oldFirsts != NULL)
+		kfree(oldFirsts);
+	return 0;
+}
+
+/**
+ * AddExtent - 在区段表末尾添加区段
+ * @cache: 区段表
+ * @extent: 区段
+ *
+ * 只用于还没有加入LRU链表的区段表
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int AddExtent(struct BOFS_ExtentCache *cache, struct BOFS_Extent *extent)
+{
+	if (cache->count >= cache->capacity && GrowExtentCache(cache))
+		return -1;
+
+	cache->extents[cache->count] = *extent;
+	cache->firsts[cache->count] = cache->blocks;
+	cache->blocks += extent->count;
+	cache->count++;
+	return 0;
+}
+
+/**
+ * LoadExtentCache - 从磁盘读取节点的区段表
+ * @inode: 节点
+ * @sb: 超级块
+ *
+ * 成功返回区段表，失败返回NULL
+ */
+PRIVATE struct BOFS_ExtentCache *LoadExtentCache(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_Extent *extents = BOFS_INODE_EXTENT(inode);
+	struct BOFS_ExtentBlock *eb;
+	uint32 lba;
+	int i;
+
+	struct BOFS_ExtentCache *cache = kmalloc(sizeof(struct BOFS_ExtentCache), GFP_KERNEL);
+	if (cache == NULL)
+		return NULL;
+	memset(cache, 0, sizeof(struct BOFS_ExtentCache));
+	cache->devno = sb->devno;
+	cache->inode = inode->id;
+	cache->users = 1;
+
+	for (i = 0; i < BOFS_INODE_EXTENT_NR && extents[i].count; i++) {
+		if (AddExtent(cache, &extents[i]))
+			goto ToFailed;
+	}
+
+	/* 节点中放满了才会有区段块 */
+	cache->headLba = inode->blocks[BOFS_EXTENT_BLOCK_INDEX];
+	if (i < BOFS_INODE_EXTENT_NR || !cache->headLba)
+		return cache;
+
+	buf8_t iobuf = kmalloc(sb->blockSize, GFP_KERNEL);
+	if (iobuf == NULL)
+		goto ToFailed;
+	eb = (struct BOFS_ExtentBlock *)iobuf;
+
+	for (lba = cache->headLba; lba; lba = eb->next) {
+		if (BlockRead(sb->devno, lba, iobuf)) {
+			printk(PART_ERROR "device %d read failed!\n", sb->devno);
+			kfree(iobuf);
+			goto ToFailed;
+		}
+		for (i = 0; i < eb->count; i++) {
+			if (AddExtent(cache, &eb->extents[i])) {
+				kfree(iobuf);
+				goto ToFailed;
+			}
+		}
+		cache->tailLba = lba;
+	}
+	kfree(iobuf);
+	return cache;
+
+ToFailed:
+	FreeExtentCache(cache);
+	return NULL;
+}
+
+/**
+ * LookupExtentCache - 查找节点的区段表
+ * @devno: 设备号
+ * @inode: 节点
+ *
+ * 需要在关闭中断的情况下调用。节点id可能已经被重新使用，
+ * 节点第一个区段和表中不一样时区段表已经过时。
+ * 找到返回区段表，没找到返回NULL
+ */
+PRIVATE struct BOFS_ExtentCache *LookupExtentCache(dev_t devno, struct BOFS_Inode *inode)
+{
+	struct BOFS_ExtentCache *cache;
+	uint32 start = BOFS_INODE_EXTENT(inode)[0].start;
+
+	ListForEachOwner(cache, &extentLruList, list) {
+		if (cache->devno != devno || cache->inode != inode->id)
+			continue;
+
+		if (start && (!cache->count || cache->extents[0].start != start)) {
+			UnlinkExtentCache(cache);
+			return NULL;
+		}
+		return cache;
+	}
+	return NULL;
+}
+
+/**
+ * GetExtentCache - 获取节点的区段表
+ * @inode: 节点
+ * @sb: 超级块
+ *
+ * 没有缓存就从磁盘读取，用完需要调用PutExtentCache
+ * 成功返回区段表，失败返回NULL
+ */
+PRIVATE struct BOFS_ExtentCache *GetExtentCache(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_ExtentCache *cache, *other, *next;
+
+	unsigned long flags = InterruptSave();
+	cache = LookupExtentCache(sb->devno, inode);
+	if (cache != NULL) {
+		cache->users++;
+		ListMoveTail(&cache->list, &extentLruList);
+		InterruptRestore(flags);
+		return cache;
+	}
+	InterruptRestore(flags);
+
+	/* 读取磁盘的时候可能被别的任务抢先加入了 */
+	cache = LoadExtentCache(inode, sb);
+	if (cache == NULL)
+		return NULL;
+
+	flags = InterruptSave();
+	other = LookupExtentCache(sb->devno, inode);
+	if (other != NULL) {
+		other->users++;
+		ListMoveTail(&other->list, &extentLruList);
+		InterruptRestore(flags);
+		FreeExtentCache(cache);
+		return other;
+	}
+
+	ListAddTail(&cache->list, &extentLruList);
+	cachedExtents++;
+
+	/* 回收最久没有使用的区段表，正在使用的跳过 */
+	ListForEachOwnerSafe(other, next, &extentLruList, list) {
+		if (cachedExtents <= BOFS_EXTENT_CACHE_MAX)
+			break;
+		if (!other->users)
+			UnlinkExtentCache(other);
+	}
+	InterruptRestore(flags);
+	return cache;
+}
+
+/**
+ * PutExtentCache - 使用完区段表
+ * @cache: 区段表
+ */
+PRIVATE void PutExtentCache(struct BOFS_ExtentCache *cache)
+{
+	unsigned long flags = InterruptSave();
+	if (!--cache->users && cache->dead)
+		FreeExtentCache(cache);
+	InterruptRestore(flags);
+}
+
+/**
+ * DropExtentCache - 使用完并且让区段表失效
+ * @cache: 区段表
+ *
+ * 区段表和磁盘不一致的时候调用，下次使用时重新读取
+ */
+PRIVATE void DropExtentCache(struct BOFS_ExtentCache *cache)
+{
+	unsigned long flags = InterruptSave();
+	if (!cache->dead) {
+		ListDel(&cache->list);
+		cachedExtents--;
+		cache->dead = 1;
+	}
+	InterruptRestore(flags);
+	PutExtentCache(cache);
+}
+
+/**
+ * BOFS_ExtentCacheInvalidate - 让节点的区段表失效
+ * @devno: 设备号
+ * @inode: 节点id
+ *
+ * 创建和删除节点时调用，节点id会被重新使用
+ */
+PUBLIC void BOFS_ExtentCacheInvalidate(dev_t devno, unsigned int inode)
+{
+	struct BOFS_ExtentCache *cache, *next;
+
+	unsigned long flags = InterruptSave();
+	ListForEachOwnerSafe(cache, next, &extentLruList, list) {
+		if (cache->devno == devno && cache->inode == inode)
+			UnlinkExtentCache(cache);
+	}
+	InterruptRestore(flags);
+}
+
+/**
+ * FindExtent - 查找块所在的区段
+ * @cache: 区段表
+ * @index: 块在文件中的索引，需要小于区段表的块数
+ *
+ * 需要在关闭中断的情况下调用。顺序访问时一般还在上次的区段，
+ * 或者是下一个区段，其它情况二分查找
+ * 返回区段的索引
+ */
+PRIVATE unsigned int FindExtent(struct BOFS_ExtentCache *cache, uint32 index)
+{
+	unsigned int low, high, mid;
+	unsigned int i = cache->hint;
+
+	if (i < cache->count && index >= cache->firsts[i]) {
+		if (index < cache->firsts[i] + cache->extents[i].count)
+			return i;
+		if (i + 1 < cache->count &&
+			index < cache->firsts[i + 1] + cache->extents[i + 1].count) {
+			cache->hint = i + 1;
+			return i + 1;
+		}
+	}
+
+	/* 最后一个第一块不超过index的区段 */
+	low = 0;
+	high = cache->count - 1;
+	while (low < high) {
+		mid = (low + high + 1) / 2;
+		if (cache->firsts[mid] <= index)
+			low = mid;
+		else
+			high = mid - 1;
+	}
+	cache->hint = low;
+	return low;
+}
+
+/**
+ * WriteExtent - 把区段写入磁盘
+ * @inode: 节点
+ * @cache: 区段表
+ * @pos: 区段的位置，最多是区段表的末尾
+ * @extent: 区段
+ * @sb: 超级块
+ *
+ * 区段表是最新的，传入的节点可能是旧的副本，同步节点时用区段表覆盖节点中的区段。
+ * 最后一个区段块满了就分配新的区段块链接到链表末尾
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int WriteExtent(struct BOFS_Inode *inode,
+	struct BOFS_ExtentCache *cache,
+	unsigned int pos,
+	struct BOFS_Extent *extent,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_Extent *extents = BOFS_INODE_EXTENT(inode);
+	struct BOFS_ExtentBlock *eb;
+	unsigned int slot;
+	uint32 lba;
+	int idx;
+
+	if (pos < BOFS_INODE_EXTENT_NR) {
+		memset(extents, 0, BOFS_INODE_EXTENT_NR * sizeof(struct BOFS_Extent));
+		memcpy(extents, cache->extents, MIN(cache->count, BOFS_INODE_EXTENT_NR) *
+			sizeof(struct BOFS_Extent));
+		extents[pos] = *extent;
+		inode->blocks[BOFS_EXTENT_BLOCK_INDEX] = cache->headLba;
+		return BOFS_SyncInode(inode, sb);
+	}
+
+	buf8_t iobuf = kmalloc(sb->blockSize, GFP_KERNEL);
+	if (iobuf == NULL)
+		return -1;
+	eb = (struct BOFS_ExtentBlock *)iobuf;
+
+	slot = (pos - BOFS_INODE_EXTENT_NR) % BOFS_EXTENTS_PER_BLOCK(sb);
+	if (slot == 0 && pos == cache->count) {
+		idx = BOFS_AllocBitmap(sb, BOFS_BMT_SECTOR, 1);
+		if (idx == -1)
+			goto ToFailed;
+		BOFS_SyncBitmap(sb, BOFS_BMT_SECTOR, idx);
+		lba = BOFS_IDX_TO_LBA(sb, idx);
+
+		if (cache->tailLba) {
+			/* 链接到最后一个区段块后面 */
+			if (BlockRead(sb->devno, cache->tailLba, iobuf))
+				goto ToFreeBlock;
+			eb->next = lba;
+			if (BlockWrite(sb->devno, cache->tailLba, iobuf, 0))
+				goto ToFreeBlock;
+		} else {
+			/* 第一个区段块记录在节点中 */
+			memcpy(extents, cache->extents, BOFS_INODE_EXTENT_NR * sizeof(struct BOFS_Extent));
+			inode->blocks[BOFS_EXTENT_BLOCK_INDEX] = lba;
+			if (BOFS_SyncInode(inode, sb)) {
+				inode->blocks[BOFS_EXTENT_BLOCK_INDEX] = 0;
+				goto ToFreeBlock;
+			}
+			cache->headLba = lba;
+		}
+		cache->tailLba = lba;
+		memset(iobuf, 0, sb->blockSize);
+	} else {
+		if (BlockRead(sb->devno, cache->tailLba, iobuf))
+			goto ToFailed;
+	}
+
+	eb->extents[slot] = *extent;
+	eb->count = slot + 1;
+	if (BlockWrite(sb->devno, cache->tailLba, iobuf, 0))
+		goto ToFailed;
+
+	kfree(iobuf);
+	return 0;
+
+ToFreeBlock:
+	/* 新的区段块没有链接上，还给位图 */
+	BOFS_FreeBitmap(sb, BOFS_BMT_SECTOR, idx);
+	BOFS_SyncBitmap(sb, BOFS_BMT_SECTOR, idx);
+ToFailed:
+	printk(PART_ERROR "BOFS write extent %d of inode %d failed!\n", pos, inode->id);
+	kfree(iobuf);
+	return -1;
+}
+
+/**
+ * AppendExtent - 在文件末尾添加一段数据块
+ * @inode: 节点
+ * @cache: 区段表
+ * @start: 第一个块的lba
+ * @count: 块的数量
+ * @sb: 超级块
+ *
+ * 和最后一个区段连续时加长最后一个区段，不然添加一个新的区段。
+ * 先写入磁盘，成功后再更新区段表
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int AppendExtent(struct BOFS_Inode *inode,
+	struct BOFS_ExtentCache *cache,
+	uint32 start,
+	uint32 count,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_Extent extent;
+	unsigned int pos = cache->count;
+
+	if (pos > 0 && cache->extents[pos - 1].start + cache->extents[pos - 1].count == start) {
+		pos--;
+		extent = cache->extents[pos];
+		extent.count += count;
+	} else {
+		extent.start = start;
+		extent.count = count;
+		if (pos >= cache->capacity && GrowExtentCache(cache))
+			return -1;
+	}
+
+	if (WriteExtent(inode, cache, pos, &extent, sb))
+		return -1;
+
+	unsigned long flags = InterruptSave();
+	if (pos == cache->count) {
+		cache->firsts[pos] = cache->blocks;
+		cache->count++;
+	}
+	cache->extents[pos] = extent;
+	cache->blocks += count;
+	InterruptRestore(flags);
+	return 0;
+}
+
+/**
+ * GrowExtents - 在文件末尾分配数据块
+ * @inode: 节点
+ * @cache: 区段表
+ * @count: 块的数量
+ * @clear: 是否清空新的块
+ * @sb: 超级块
+ *
+ * 尽量接着最后一个区段分配，一次分配一段连续的块
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int GrowExtents(struct BOFS_Inode *inode,
+	struct BOFS_ExtentCache *cache,
+	uint32 count,
+	int clear,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_Extent *last;
+	uint32 got, i, lba;
+	int goal, idx;
+	buf8_t zero = NULL;
+
+	if (clear) {
+		zero = kmalloc(sb->blockSize, GFP_KERNEL);
+		if (zero == NULL)
+			return -1;
+		memset(zero, 0, sb->blockSize);
+	}
+
+	while (count > 0) {
+		goal = -1;
+		if (cache->count) {
+			last = &cache->extents[cache->count - 1];
+			goal = BOFS_LBA_TO_IDX(sb, last->start + last->count);
+		}
+
+		idx = BOFS_AllocBitmapRun(sb, goal, MIN(count, BOFS_EXTENT_ALLOC_MAX), &got);
+		if (idx == -1)
+			goto ToFailed;
+		BOFS_SyncBitmapRange(sb, BOFS_BMT_SECTOR, idx, got);
+		lba = BOFS_IDX_TO_LBA(sb, idx);
+
+		for (i = 0; clear && i < got; i++) {
+			if (BlockWrite(sb->devno, lba + i, zero, 0)) {
+				printk(PART_ERROR "device %d write failed!\n", sb->devno);
+				break;
+			}
+		}
+
+		if ((clear && i < got) || AppendExtent(inode, cache, lba, got, sb)) {
+			for (i = 0; i < got; i++)
+				BOFS_FreeBitmap(sb, BOFS_BMT_SECTOR, idx + i);
+			BOFS_SyncBitmapRange(sb, BOFS_BMT_SECTOR, idx, got);
+			goto ToFailed;
+		}
+		count -= got;
+	}
+
+	if (zero != NULL)
+		kfree(zero);
+	return 0;
+
+ToFailed:
+	if (zero != NULL)
+		kfree(zero);
+	return -1;
+}
+
+/**
+ * BOFS_ExtentGetBlock - 通过数据块索引获取块
+ * @inode: 节点
+ * @index: 块索引
+ * @block: 存储块的地址
+ * @sb: 超级块
+ *
+ * 块还没有分配就分配到这个块为止，新的块会被清空
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_ExtentGetBlock(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 *block,
+	struct BOFS_SuperBlock *sb)
+{
+	unsigned int i;
+
+	struct BOFS_ExtentCache *cache = GetExtentCache(inode, sb);
+	if (cache == NULL)
+		return -1;
+
+	if (index >= cache->blocks &&
+		GrowExtents(inode, cache, index + 1 - cache->blocks, 1, sb)) {
+		DropExtentCache(cache);
+		return -1;
+	}
+
+	unsigned long flags = InterruptSave();
+	i = FindExtent(cache, index);
+	*block = cache->extents[i].start + index - cache->firsts[i];
+	InterruptRestore(flags);
+
+	PutExtentCache(cache);
+	return 0;
+}
+
+/**
+ * BOFS_ExtentMapBlocks - 获取连续多个数据块的地址
+ * @inode: 节点
+ * @index: 第一个块索引
+ * @count: 块的数量
+ * @blocks: 存储块地址的数组，没有分配的块填0
+ * @sb: 超级块
+ *
+ * 只读不分配，每个区段只查找一次，区段内的块直接计算出来
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_ExtentMapBlocks(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 count,
+	uint32 *blocks,
+	struct BOFS_SuperBlock *sb)
+{
+	unsigned int e, i, j, n;
+	uint32 lba;
+
+	struct BOFS_ExtentCache *cache = GetExtentCache(inode, sb);
+	if (cache == NULL)
+		return -1;
+
+	unsigned long flags = InterruptSave();
+	for (i = 0; i < count; i += n, index += n) {
+		if (index >= cache->blocks) {
+			blocks[i] = 0;
+			n = 1;
+			continue;
+		}
+		e = FindExtent(cache, index);
+		lba = cache->extents[e].start + index - cache->firsts[e];
+		n = MIN(cache->firsts[e] + cache->extents[e].count - index, count - i);
+		for (j = 0; j < n; j++)
+			blocks[i + j] = lba + j;
+	}
+	InterruptRestore(flags);
+
+	PutExtentCache(cache);
+	return 0;
+}
+
+/**
+ * BOFS_ExtentReserve - 预先分配文件的数据块
+ * @inode: 节点
+ * @count: 文件需要的块数
+ * @sb: 超级块
+ *
+ * 写入前一次分配所有需要的块，大文件可以得到连续的块。
+ * 文件不会有空洞，写入会覆盖新的块，所以不用清空
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_ExtentReserve(struct BOFS_Inode *inode,
+	uint32 count,
+	struct BOFS_SuperBlock *sb)
+{
+	int ret = 0;
+
+	struct BOFS_ExtentCache *cache = GetExtentCache(inode, sb);
+	if (cache == NULL)
+		return -1;
+
+	if (count > cache->blocks) {
+		ret = GrowExtents(inode, cache, count - cache->blocks, 0, sb);
+		if (ret) {
+			DropExtentCache(cache);
+			return ret;
+		}
+	}
+	PutExtentCache(cache);
+	return ret;
+}
+
+/**
+ * BOFS_ExtentRelease - 释放节点所有的数据块
+ * @inode: 节点
+ * @sb: 超级块
+ *
+ * 释放区段和区段块，然后清空节点中的区段
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_ExtentRelease(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb)
+{
+	struct BOFS_ExtentBlock *eb;
+	struct BOFS_Extent *extent;
+	uint32 i, lba, idx;
+	int ret = 0;
+
+	struct BOFS_ExtentCache *cache = GetExtentCache(inode, sb);
+	if (cache == NULL)
+		return -1;
+
+	for (extent = cache->extents; extent < cache->extents + cache->count; extent++) {
+		idx = BOFS_LBA_TO_IDX(sb, extent->start);
+		for (i = 0; i < extent->count; i++)
+			BOFS_FreeBitmap(sb, BOFS_BMT_SECTOR, idx + i);
+		BOFS_SyncBitmapRange(sb, BOFS_BMT_SECTOR, idx, extent->count);
+	}
+
+	if (cache->headLba) {
+		buf8_t iobuf = kmalloc(sb->blockSize, GFP_KERNEL);
+		if (iobuf == NULL) {
+			DropExtentCache(cache);
+			return -1;
+		}
+		eb = (struct BOFS_ExtentBlock *)iobuf;
+
+		for (lba = cache->headLba; lba; lba = eb->next) {
+			if (BlockRead(sb->devno, lba, iobuf)) {
+				printk(PART_ERROR "device %d read failed!\n", sb->devno);
+				ret = -1;
+				break;
+			}
+			idx = BOFS_LBA_TO_IDX(sb, lba);
+			BOFS_FreeBitmap(sb, BOFS_BMT_SECTOR, idx);
+			BOFS_SyncBitmap(sb, BOFS_BMT_SECTOR, idx);
+		}
+		kfree(iobuf);
+	}
+
+	memset(inode->blocks, 0, sizeof(inode->blocks));
+	BOFS_SyncInode(inode, sb);
+
+	DropExtentCache(cache);
+	return ret;
+}
@@ -9,7 +9,6 @@
 #include <book/memcache.h>
 #include <book/debug.h>
 #include <book/device.h>
-#include <book/ioqueue.h>
 #include <book/signal.h>
 
 #include <lib/string.h>
@@ -218,8 +217,6 @@ PUBLIC int BOFS_FifoOpen(int fd, flags_t flags)
     
     struct BOFS_Pipe *pipe = (struct BOFS_Pipe *)file->inode->blocks[0];
 
-    struct Task *task, *nextTask;
-
     struct Task *cur = CurrentTask();
 
     /* 读打开 */
@@ -233,32 +230,11 @@ PUBLIC int BOFS_FifoOpen(int fd, flags_t flags)
         /* 读引用 */
         AtomicInc(&pipe->readReference); 
 
-        /* 如果没有写，那么就会阻塞自己 */
-        if (AtomicGet(&pipe->writeReference) == 0) {
-            //printk("fifo open with read, no writer, block me.\n");
-
-            /* 等待队列头部 */
-            ListAdd(&cur->list, &pipe->waitList);
-            InterruptRestore(eflags);
-            /* 阻塞自己 */
-            TaskBlock(TASK_BLOCKED);
-
-            //printk("fifo open with read, has writer, unblock me.\n");
-            /* 唤醒后获取cpu占用 */
-            eflags = InterruptSave();
-        }
+        /* 读打开的时候，之前被阻塞的写进程现在有读者了，唤醒它们 */
+        WaitQueueWakeUpAll(&pipe->waitQueue);
 
-        /* 读打开的时候，发现之前有写进程已经被阻塞，那么就唤醒被阻塞的进程 */
-        if (!ListEmpty(&pipe->waitList)) {
-            /* 唤醒所有阻塞的任务 */
-            ListForEachOwnerSafe(task, nextTask, &pipe->waitList, list) {
-                //printk("fifo open with read, has waiter, unblock %s.\n", task->name);
-                /* 脱离链表 */
-                ListDel(&task->list);
-                
-                TaskUnblock(task);
-            }
-        }
+        /* 如果没有写，那么就会阻塞自己，直到有进程写打开 */
+        WAIT_EVENT(&pipe->waitQueue, AtomicGet(&pipe->writeReference) > 0);
     } else if (flags & BOFS_O_WRONLY) {
         /* 添加到读任务表 */
         if (BOFS_PipeRecordWriteTask(pipe, cur->pid)) {
@@ -269,33 +245,11 @@ PUBLIC int BOFS_FifoOpen(int fd, flags_t flags)
         /* 写引用 */
         AtomicInc(&pipe->writeReference); 
 
-        /* 如果没有读，那么就会阻塞自己 */
-        if (AtomicGet(&pipe->readReference) == 0) {
-            //printk("fifo open with write, no reader, block me.\n");
-            /* 等待队列头部 */
-            
-            ListAdd(&CurrentTask()->list, &pipe->waitList);
-            InterruptRestore(eflags);
-            /* 阻塞自己 */
-            TaskBlock(TASK_BLOCKED);
-
-            //printk("fifo open with write, has reader, unblock me.\n");
-            
-            /* 唤醒后获取cpu占用 */
-            eflags = InterruptSave();
-        }
+        /* 写打开的时候，之前被阻塞的读进程现在有写者了，唤醒它们 */
+        WaitQueueWakeUpAll(&pipe->waitQueue);
 
-        /* 写打开的时候，发现之前有读进程已经被阻塞，那么就唤醒被阻塞的进程 */
-        if (!ListEmpty(&pipe->waitList)) {
-            /* 唤醒所有阻塞的任务 */
-            ListForEachOwnerSafe(task, nextTask, &pipe->waitList, list) {
-                //printk("fifo open with write, has waiter, unblock %s.\n", task->name);
-                /* 脱离链表 */
-                ListDel(&task->list);
-                
-                TaskUnblock(task);
-            }
-        }
+        /* 如果没有读，那么就会阻塞自己，直到有进程读打开 */
+        WAIT_EVENT(&pipe->waitQueue, AtomicGet(&pipe->readReference) > 0);
     } else {
         printk("fifo open flags error!\n");
 
@@ -310,102 +264,20 @@ PUBLIC int BOFS_FifoOpen(int fd, flags_t flags)
 /**
  * BOFS_FifoRead - 从管道读取
  * 
- * 
+ * 和匿名管道使用同样的io队列，数据成批复制，读写规则也一样
  */
 PUBLIC int BOFS_FifoRead(struct BOFS_FileDescriptor *file, void *buffer, size_t count)
 {
-    /*
-    1.判断写端是否已经关闭
-    2.判断是否有数据
-    */
     struct BOFS_Pipe *pipe = (struct BOFS_Pipe *)file->inode->blocks[0];
 
-    unsigned char *buf = (unsigned char *)buffer;
-    int readBytes = 0;
-    int len = 0;
-    /* 判断写端是否关闭 */
-    if (AtomicGet(&pipe->writeReference) > 0) {
-        //printk("fifo read has writer\n");
-        
-        /* 尝试获取一个字符，如果成功，继续往后，不然就会阻塞 */
-        *buf++ = IoQueueGet(&pipe->ioqueue);
-        readBytes++;
-        
-        /* 现在缓冲区有数据，并且已经被读取了一个，
-        获取较小的数据量.
-        已经在前面获取一个字符，所以是count-1
-         */
-        len = MIN(count - 1, IO_QUEUE_LENGTH(&pipe->ioqueue));
-
-        while (len > 0) {
-            //printk("<%c>", *(buf-1));
-            /* 从缓冲中读取数据 */
-            *buf++ = IoQueueGet(&pipe->ioqueue);
-            readBytes++;
-            len--;
-        }
-        
-        //printk("fifo read buf %s\n", (char *)buffer);
-
-    } else {
-        /* 写端已经关闭 */
-        //printk("fifo read no writer\n");
-
-        /* 判断数据量，返回已有的数据量，如果为0，返回0 */
-        len = MIN(count, IO_QUEUE_LENGTH(&pipe->ioqueue));
-        while (len > 0) {
-            /* 从缓冲中读取数据 */
-            *buf++ = IoQueueGet(&pipe->ioqueue);
-            //printk("<%c>", *(buf-1));
-            readBytes++;
-            len--;
-        }
-    }
-
-    //printk("fifo read %d bytes\n", readBytes);
-    return readBytes;
+    return BOFS_PipeReadData(pipe, buffer, count);
 }
 
 PUBLIC int BOFS_FifoWrite(struct BOFS_FileDescriptor *file, void *buffer, size_t count)
 {
-    /*
-    1.判断读端是否已经关闭
-    2.判断是否数据已满
-    */
     struct BOFS_Pipe *pipe = (struct BOFS_Pipe *)file->inode->blocks[0];
 
-    unsigned char *buf = (unsigned char *)buffer;
-    int writeBytes = 0;
-    int len = 0;
-    /* 判断读端是否关闭 */
-    if (AtomicGet(&pipe->readReference) > 0) {
-        //printk("fifo write has reader\n");
-
-        /* 写入长度就是传入的长度 */
-        len = count;
-        while (len > 0) {
-            /* 写入数据到管道 */
-            IoQueuePut(&pipe->ioqueue, *buf++);
-            //printk("[%c]", *(buf-1));
-            writeBytes++;
-            len--;
-        }
-
-        /* */
-        //printk("pipe data: %s\n", pipe->ioqueue.buf);
-
-    } else {
-        /* 读端已经关闭 */
-        //printk("fifo write no reader\n");
-
-        /* 此时写入是没有意义的，所以会发出SIGPIPE信号终止进程 */
-        printk(PART_ERROR "fifo write occur a SIGPIPE!");
-        ForceSignal(SIGPIPE, SysGetPid());
-    }
-
-    //printk("fifo write %d bytes\n", writeBytes);
-
-    return writeBytes;
+    return BOFS_PipeWriteData(pipe, buffer, count);
 }
 
 PUBLIC int BOFS_FifoUpdate(struct BOFS_Pipe *pipe, struct Task *task)
@@ -470,5 +342,7 @@ PUBLIC int BOFS_FifoClose(struct BOFS_Pipe *pipe)
         //printk("close write ref %d\n", AtomicGet(&pipe->writeReference));
     }
 
+    /* 另一端可能在等待数据或者空间 */
+    BOFS_PipeWakeUp(pipe);
     return 0;
 }
\ No newline at end of file
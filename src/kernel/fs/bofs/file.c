@@ -153,7 +153,7 @@ PUBLIC int BOFS_GlobalFdHasFlags(unsigned int globalFd, unsigned int flags)
 PUBLIC int FdLocal2Global(uint32_t localFD)
 {
     struct Task *cur = CurrentTask();
-    int globalFD = cur->fdTable[localFD]; /* 文件描述符表中存放的就是全局的文件描述符 */
+    int globalFD = cur->files->fdTable[localFD]; /* 文件描述符表中存放的就是全局的文件描述符 */
     return globalFD;
 }
 
@@ -171,8 +171,8 @@ PUBLIC int TaskInstallFD(int globalFdIdx)
     /* 跨过stdin,stdout,stderr */
     uint8_t localFdIdx = 0; 
     while (localFdIdx < MAX_OPEN_FILES_IN_PROC) {
-        if (cur->fdTable[localFdIdx] == -1) {	// -1表示空闲，可以使用
-	        cur->fdTable[localFdIdx] = globalFdIdx; // 填写全局描述符索引到局部描述符表
+        if (cur->files->fdTable[localFdIdx] == -1) {	// -1表示空闲，可以使用
+	        cur->files->fdTable[localFdIdx] = globalFdIdx; // 填写全局描述符索引到局部描述符表
 	        break;
         }
         localFdIdx++;
@@ -254,7 +254,7 @@ PRIVATE int BOFS_CreateFile(struct BOFS_DirEntry *parentDir,
 	BOFS_SyncBitmap(sb, BOFS_BMT_INODE, inodeID);
     
 	BOFS_CreateInode(inode, inodeID, mode,
-		0, sb->devno);    
+		BOFS_NEW_INODE_FLAGS(sb), sb->devno);    
 
 	// 创建目录项，普通文件
 	BOFS_CreateDirEntry(dirEntry, inodeID, BOFS_FILE_TYPE_NORMAL, name);
@@ -478,7 +478,7 @@ PUBLIC int BOFS_Dup2(int oldfd, int target_fd)
     }
     
     /* 共享同一个数据结构 */
-    CurrentTask()->fdTable[target_fd] = globalFD;
+    CurrentTask()->files->fdTable[target_fd] = globalFD;
     
     /* 共享旧描述符的所有内容，所以只是在临时表中的索引不一样而已。 */
     return TaskInstallFD(target_fd); 
@@ -553,6 +553,7 @@ PRIVATE int BOFS_OpenFile(struct BOFS_DirEntry *parentDir,
 		BOFS_GlobalFdTable[fd].inode = inode;
 		
 		BOFS_GlobalFdTable[fd].pos = 0;
+		memset(&BOFS_GlobalFdTable[fd].readAhead, 0, sizeof(struct BOFS_ReadAhead));
 		
 		AtomicSet(&BOFS_GlobalFdTable[fd].reference, 1);
 		BOFS_GlobalFdTable[fd].flags |= flags;
@@ -812,7 +813,7 @@ PUBLIC int BOFS_Close(int fd)
 
             /* 如果引用不为0，就只关闭局部，而不关闭全局 */
             if (AtomicGet(&fdec->reference) > 0) {
-                CurrentTask()->fdTable[fd] = -1; 
+                CurrentTask()->files->fdTable[fd] = -1; 
                 return -1;
             }
 
@@ -832,8 +833,9 @@ PUBLIC int BOFS_Close(int fd)
                         printk("close fifo file failed!\n");    
                     }
                 } else {    /* 普通文件 */
-                    /* 文件关闭之前做一次强制同步，保证写入磁盘的数据能够在磁盘上 */
-                    BlockSync();
+                    /* 关闭时不再同步所有缓冲，只提前唤醒写回线程，
+                    需要保证数据在磁盘上时使用fsync */
+                    WakeupBufferWriteback();
 
                     ret = BOFS_CloseFile(fdec);
                 }
@@ -842,7 +844,7 @@ PUBLIC int BOFS_Close(int fd)
             }
             //printk("close fd:%d success!\n", fd);
             /* 释放局部文件描述符，置-1表示未使用 */
-            CurrentTask()->fdTable[fd] = -1; 
+            CurrentTask()->files->fdTable[fd] = -1; 
             
         }
 	}else{
@@ -1026,6 +1028,10 @@ PRIVATE int BOFS_FileWrite(struct BOFS_FileDescriptor *fdptr,
 
 	struct BOFS_SuperBlock *sb = fdptr->superBlock;
 
+	/* 一次分配所有需要的块，失败的话写入时还会逐个分配 */
+	BOFS_ReserveInodeBlocks(fdptr->inode,
+		DIV_ROUND_UP(fdptr->pos + count, blockSize), sb);
+
 	//printk(">>>start block id:%d\n", blockID);
 	while (bytesWritten < count) {
 		
@@ -1072,6 +1078,9 @@ PRIVATE int BOFS_FileWrite(struct BOFS_FileDescriptor *fdptr,
 	*/
 	BOFS_SyncInode(fdptr->inode, sb);
 	
+	/* 写入范围内的缓存页已经过时 */
+	BOFS_PageCacheInvalidate(sb, fdptr->inode, fdptr->pos - bytesWritten, bytesWritten);
+	
     kfree(iobuf);
     /* 如果写入0字节，那么表示出错 */
     if (!bytesWritten)
@@ -1080,6 +1089,7 @@ PRIVATE int BOFS_FileWrite(struct BOFS_FileDescriptor *fdptr,
 	return bytesWritten;
 
 ToFailed:
+	BOFS_PageCacheInvalidate(sb, fdptr->inode, fdptr->pos - bytesWritten, bytesWritten);
     kfree(iobuf);
     return -1;
 }
@@ -1186,114 +1196,72 @@ PUBLIC int BOFS_Ioctl(int fd, int cmd, int arg)
 	return ret;
 }
 
-PRIVATE int BOFS_FileRead( struct BOFS_FileDescriptor *fdptr, void* buf, uint32 count)
+/**
+ * BOFS_InodeRead - 从节点读取数据
+ * @inode: 文件的节点
+ * @sb: 节点所在的超级块
+ * @pos: 开始读取的文件偏移
+ * @buf: 缓冲区
+ * @count: 字节数
+ * 
+ * 不依赖文件描述符，按需加载的程序段在文件关闭后也通过它读取数据
+ * @return: 成功返回读取的数据量，到达文件末尾返回0，失败返回-1
+ */
+PUBLIC int BOFS_InodeRead(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb,
+	uint32 pos,
+	void* buf,
+	uint32 count)
 {
-    //printk("file read start!\n");
-
-	/*step 1:
-	calculate that we can read how many bytes
-	*/
-	uint32 size = count, sizeLeft = count;
-	//printk("pos:%d count:%d size:%d\n", fdptr->pos, count, fdptr->inode->size);
-
-	//check read bytes
-	if ((fdptr->pos + count) > fdptr->inode->size){
-		size = fdptr->inode->size - fdptr->pos;
-		sizeLeft = size;
-		
-		if (sizeLeft == 0) {	   // if read at the end of file, return 0
-            //printk("sizeLeft:%d\n", sizeLeft);
-        	return -1;
-		}
-	}
-	
-	/*step 2:
-	calculate that we read data from which block id(sector)
-	*/
-	/*block id for get file data block.
-	we need set it by fd pos, we will start at a pos, not always 0.
-	because sometimes, pos is not start from 0, so we should set it use 
-	pos/SECTOR_SIZE.
-	for example:
-		if (0<= pos < 512) : id = 0
-		if (512<= pos < 1024) : id = 1
-		if (1024<= pos < 1536) : id = 2
-		...
-	*/
-    unsigned int blockSize = fdptr->superBlock->blockSize;
+	return BOFS_PageCacheRead(inode, sb, pos, buf, count, NULL);
+}
 
-	uint32 blockID = fdptr->pos/blockSize;    
-	//printk(">>>start block id:%d\n", blockID);
+PRIVATE int BOFS_FileRead( struct BOFS_FileDescriptor *fdptr, void* buf, uint32 count)
+{
+	/* 通过页缓存读取，顺序读取时会提前预读后面的页 */
+	int bytesRead = BOFS_PageCacheRead(fdptr->inode, fdptr->superBlock, 
+		fdptr->pos, buf, count, &fdptr->readAhead);
 	
-	/*step 3:
-	read data to buf
-	*/
-	uint8 *dst = buf;        // src is buffer we will write to file 
-	uint32 bytesRead = 0;	    // we have written n bytes
-	uint32 sectorLba;	      // we will write data to a sector 
-	uint32 sectorOffsetBytes;    // bytes offset in a sector 
-	uint32 sectorLeftBytes;   // bytes left in a sector
-	uint32 chunkSize;	      // every time will write chunk size to disk
+    /* 如果读取0字节，那么就到文件末尾，EOF */
+	if (bytesRead <= 0)
+		return -1;
 	
-    buf8_t iobuf = kmalloc(blockSize, GFP_KERNEL);
-    if (iobuf == NULL) {
-        //printk("alloc failed!\n");
-        return -1;
-    }
-        
-	struct BOFS_SuperBlock *sb = fdptr->superBlock;
-
-    //printk("file read start!\n");
-    //printk("will read size %d\n", size);
-	while (bytesRead < size) {
-		//printk("get inode data");
-		/*BOFS_DumpSuperBlock(sb);
-		BOFS_DumpInode(fdptr->inode);*/
-		BOFS_GetInodeData(fdptr->inode, blockID, &sectorLba, sb);
+	fdptr->pos += bytesRead;
+	return bytesRead;
+}
 
-		//printk("read block %d\n", sectorLba);
-		//get remainder of pos = pos/512
-		sectorOffsetBytes = fdptr->pos % blockSize;	
-		sectorLeftBytes = blockSize - sectorOffsetBytes;
-		
-		chunkSize = sizeLeft < sectorLeftBytes ? sizeLeft : sectorLeftBytes;
-		
-		//printk("sector:%d off:%d left:%d chunk:%d\n", sectorLba, sectorOffsetBytes, sectorLeftBytes, chunkSize);
-		
-		//clean buf and read data to buf
-		//memset(sb->iobuf, 0, blockSize);
-		//printk("read done!\n");
-		if(BlockRead(sb->devno, sectorLba, iobuf)) {
-            //printk("block read failed!\n");
-			goto ToFailed;
-		}
-		//printk("read done!\n");
-		/*copy disk data to out buf*/
-		memcpy(dst, iobuf + sectorOffsetBytes, chunkSize);
-		
-		dst += chunkSize;
-		fdptr->pos += chunkSize;
-		bytesRead += chunkSize;
-		sizeLeft -= chunkSize;
-		blockID++;
+/**
+ * BOFS_DupInode - 复制文件的节点
+ * @fd: 文件描述符（局部）
+ * @sb: 返回节点所在的超级块
+ * 
+ * 复制出来的节点不属于任何文件描述符，需要调用者用kfree释放
+ * 只支持普通文件，成功返回节点，失败返回NULL
+ */
+PUBLIC struct BOFS_Inode *BOFS_DupInode(int fd, struct BOFS_SuperBlock **sb)
+{
+    if (fd < 0 || fd >= MAX_OPEN_FILES_IN_PROC) {
+		printk("bofs dup inode: fd error\n");
+		return NULL;
 	}
-	
-    //printk("read ok!\n");
-    kfree(iobuf);
-    
-    /* 如果读取0字节，那么就到文件末尾，EOF */
-    if (!bytesRead)
-        bytesRead = -1;
+    int globalFD = FdLocal2Global(fd);
+    if (globalFD < 0)
+        return NULL;
 
-	return bytesRead;
+    struct BOFS_FileDescriptor *fdptr = &BOFS_GlobalFdTable[globalFD];
+    if (IS_PIPE_FILE(fdptr) || fdptr->dirEntry->type != BOFS_FILE_TYPE_NORMAL)
+        return NULL;
 
-ToFailed:
-    kfree(iobuf);
-    printk("read failed!\n");
-    return -1;
+	struct BOFS_Inode *inode = (struct BOFS_Inode *)kmalloc(\
+		sizeof(struct BOFS_Inode), GFP_KERNEL);
+	if (inode == NULL)
+		return NULL;
+    
+    *inode = *fdptr->inode;
+    *sb = fdptr->superBlock;
+    return inode;
 }
 
-
 /**
  * BOFS_Read - 读取数据
  * @fd: 文件描述符
@@ -1607,7 +1575,7 @@ PUBLIC void BOFS_UpdateInodeOpenCounts(struct Task *task)
     int localFd = 0, globalFd = 0;
     struct BOFS_FileDescriptor *file;
     while (localFd < MAX_OPEN_FILES_IN_PROC) {
-        globalFd = task->fdTable[localFd];
+        globalFd = task->files->fdTable[localFd];
         ASSERT(globalFd < BOFS_MAX_FD_NR);
         /* 是已经使用中的文件 */
         if (globalFd != -1) {
@@ -1619,13 +1587,34 @@ PUBLIC void BOFS_UpdateInodeOpenCounts(struct Task *task)
     }
 }
 
+/**
+ * BOFS_PutInodeOpenCounts - 撤销BOFS_UpdateInodeOpenCounts增加的引用
+ * @task: 任务
+ * 
+ * fork失败时使用，父进程还持有这些文件，引用不会减到0
+ */
+PUBLIC void BOFS_PutInodeOpenCounts(struct Task *task)
+{
+    int localFd = 0, globalFd = 0;
+    struct BOFS_FileDescriptor *file;
+    while (localFd < MAX_OPEN_FILES_IN_PROC) {
+        globalFd = task->files->fdTable[localFd];
+        ASSERT(globalFd < BOFS_MAX_FD_NR);
+        if (globalFd != -1) {
+            file = BOFS_GetFileByFD(globalFd);
+            AtomicDec(&file->reference);
+        }
+        localFd++;
+    }
+}
+
 PUBLIC void BOFS_ReleaseTaskFiles(struct Task *task)
 {
     //printk("task %s %d release file.\n", task->name, task->pid);
     
     int localFd = 0, globalFd = 0;
     while (localFd < MAX_OPEN_FILES_IN_PROC) {
-        globalFd = task->fdTable[localFd];
+        globalFd = task->files->fdTable[localFd];
         ASSERT(globalFd < BOFS_MAX_FD_NR);
         /* 关闭局部描述符对应的全局文件 */
         if (globalFd >= 0) {
@@ -1646,7 +1635,7 @@ void BOFS_Redirect(unsigned int oldfd, unsigned int newfd)
 {
     Task_t *cur = CurrentTask();
     //printk("redirect from %d to %d\n", oldfd, newfd);
-    cur->fdTable[oldfd] = cur->fdTable[newfd];
+    cur->files->fdTable[oldfd] = cur->files->fdTable[newfd];
 }
 
 /**
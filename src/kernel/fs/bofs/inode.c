@@ -14,6 +14,8 @@
 #include <lib/math.h>
 #include <fs/bofs/inode.h>
 #include <fs/bofs/bitmap.h>
+#include <fs/bofs/page_cache.h>
+#include <fs/bofs/extent.h>
 #include <block/blk-buffer.h>
 #include <clock/clock.h>
 
@@ -62,6 +64,9 @@ PUBLIC void BOFS_CreateInode(struct BOFS_Inode *inode,
 	for(i = 0; i < BOFS_BLOCK_NR; i++){
 		inode->blocks[i] = 0;
 	}
+
+	/* 节点id可能被重新使用，旧的区段表已经过时 */
+	BOFS_ExtentCacheInvalidate(devno, id);
 }
 
 /**
@@ -225,6 +230,9 @@ PUBLIC int BOFS_CopyInodeData(struct BOFS_Inode *dst,
 	if(src->size == 0){
 		return -1;
 	}
+	/* 目的节点的数据会被覆盖 */
+	BOFS_PageCacheInvalidateInode(sb, dst);
+
 	/*inode data blocks*/
 	uint32 blocks = DIV_ROUND_UP(src->size, sb->blockSize);
 	uint32 blockID = 0;
@@ -755,6 +763,10 @@ PUBLIC int BOFS_GetInodeData(struct BOFS_Inode *inode,
 {
 	unsigned int base;
 	
+	/* 区段记录的节点没有大小的限制 */
+	if (inode->flags & BOFS_INODE_EXTENTS)
+		return BOFS_ExtentGetBlock(inode, index, block, sb);
+
 	/* 分级 */
 	if (index < BLOCK_LV0) {
 		/* 直接块，12个 */
@@ -816,6 +828,108 @@ PUBLIC int BOFS_GetInodeData(struct BOFS_Inode *inode,
 }
 
 
+/**
+ * BOFS_MapInodeBlocks - 获取连续多个数据块的地址
+ * @inode: 节点文件
+ * @index: 第一个块索引
+ * @count: 块的数量
+ * @blocks: 存储块地址的数组，没有分配的块填0
+ * @sb: 超级块
+ * 
+ * 和BOFS_GetInodeData不同，这里只读不分配数据块。
+ * 每一级间接块只在发生变化时才读取，读取连续的块时不用每次都从头查找
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_MapInodeBlocks(struct BOFS_Inode *inode,
+	uint32 index,
+	uint32 count,
+	uint32 *blocks,
+	struct BOFS_SuperBlock *sb)
+{
+	/* 每一级间接块的缓冲区以及缓冲区对应的块地址 */
+	uint32 cached[3] = {0, 0, 0};
+	unsigned int offsets[3];
+	unsigned int base, levels, level, i;
+	uint32 lba;
+
+	if (inode->flags & BOFS_INODE_EXTENTS)
+		return BOFS_ExtentMapBlocks(inode, index, count, blocks, sb);
+
+	buf32_t buffer = kmalloc(sb->blockSize * 3, GFP_KERNEL);
+	if (buffer == NULL) {
+		printk(PART_ERROR "kmalloc for buffer failed!\n");
+		return -1;
+	}
+	unsigned int entries = sb->blockSize / sizeof(uint32);
+
+	for (i = 0; i < count; i++, index++) {
+		/* 直接块 */
+		if (index < BLOCK_LV0) {
+			blocks[i] = inode->blocks[index];
+			continue;
+		}
+
+		/* 计算间接块的级数，以及每一级中的索引 */
+		if (index < BLOCK_LV1) {
+			levels = 1;
+			base = index - BLOCK_LV0;
+			lba = inode->blocks[INDERCT_BLOCKS_LV1_INDEX];
+		} else if (index < BLOCK_LV2) {
+			levels = 2;
+			base = index - BLOCK_LV1;
+			lba = inode->blocks[INDERCT_BLOCKS_LV2_INDEX];
+		} else if (index < BLOCK_LV3) {
+			levels = 3;
+			base = index - BLOCK_LV2;
+			lba = inode->blocks[INDERCT_BLOCKS_LV3_INDEX];
+		} else {
+			printk(PART_ERROR "file block index %d out of boundary!\n", index);
+			kfree(buffer);
+			return -1;
+		}
+		for (level = levels; level > 0; level--) {
+			offsets[level - 1] = base % 256;
+			base /= 256;
+		}
+
+		/* 逐级查找，遇到没有分配的间接块就是空洞 */
+		for (level = 0; level < levels && lba != 0; level++) {
+			buf32_t table = buffer + entries * level;
+			if (cached[level] != lba) {
+				if (BlockRead(sb->devno, lba, table)) {
+					printk(PART_ERROR "device %d read failed!\n", sb->devno);
+					kfree(buffer);
+					return -1;
+				}
+				cached[level] = lba;
+			}
+			lba = table[offsets[level]];
+		}
+		blocks[i] = lba;
+	}
+	kfree(buffer);
+	return 0;
+}
+
+/**
+ * BOFS_ReserveInodeBlocks - 预先分配节点的数据块
+ * @inode: 节点文件
+ * @count: 文件需要的块数
+ * @sb: 超级块
+ * 
+ * 只有区段记录的节点会预先分配，可以得到连续的块。
+ * 间接块记录的节点在写入时逐个分配
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_ReserveInodeBlocks(struct BOFS_Inode *inode,
+	uint32 count,
+	struct BOFS_SuperBlock *sb)
+{
+	if (inode->flags & BOFS_INODE_EXTENTS)
+		return BOFS_ExtentReserve(inode, count, sb);
+	return 0;
+}
+
 /**
  * IsEmprtyBlock - 判断是否为空块 
  * @block: 块地址
@@ -1404,10 +1518,19 @@ PUBLIC int PutBlockByBlockIndex(struct BOFS_Inode *inode,
 PUBLIC int BOFS_ReleaseInodeData(struct BOFS_SuperBlock *sb,
 	struct BOFS_Inode *inode)
 {
+	/* 区段记录的节点一次释放所有区段，预先分配的块也在里面 */
+	if (inode->flags & BOFS_INODE_EXTENTS) {
+		BOFS_PageCacheInvalidateInode(sb, inode);
+		return BOFS_ExtentRelease(inode, sb);
+	}
+
 	/* 如果节点没有数据，就直接返回 */
 	if (!inode->size)
 		return 0;
 
+	/* 节点的数据将被释放，缓存页也要失效 */
+	BOFS_PageCacheInvalidateInode(sb, inode);
+
 	int index;
 
 	unsigned int blocks = DIV_ROUND_UP(inode->size, sb->blockSize);
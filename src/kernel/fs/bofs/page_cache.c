@@ -0,0 +1,567 @@
+/*
+ * file:		kernel/fs/bofs/page_cache.c
+ * auther:		Jason Hu
+ * time:		2020/2/20
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/memcache.h>
+#include <book/debug.h>
+#include <book/interrupt.h>
+#include <book/task.h>
+#include <book/waitqueue.h>
+
+#include <lib/string.h>
+#include <lib/math.h>
+
+#include <block/block.h>
+#include <block/blk-buffer.h>
+
+#include <fs/bofs/inode.h>
+#include <fs/bofs/super_block.h>
+#include <fs/bofs/page_cache.h>
+
+/* 缓存页哈希表 */
+PRIVATE struct List pageHashTable[BOFS_PAGE_HASH_SIZE];
+
+/* 所有在哈希表中的页，最近使用的在末尾 */
+PRIVATE LIST_HEAD(pageLruList);
+
+/* 哈希表中页的数量 */
+PRIVATE unsigned int cachedPages;
+
+/* 缓存页的对象缓存 */
+PRIVATE struct MemCache *cachePageCache;
+
+/* 预读的工作队列，有一个单独的线程来读取 */
+PRIVATE struct WorkQueue *readAheadQueue;
+
+/* 节点的失效代数，缓存页失效时增加，按(devno, inode)散列，
+冲突时只会让预读多丢弃一些页 */
+PRIVATE unsigned int inodeGeneration[BOFS_PAGE_HASH_SIZE];
+
+#define INODE_GENERATION(devno, inode) \
+	inodeGeneration[((devno) * 31 + (inode) * 131) & (BOFS_PAGE_HASH_SIZE - 1)]
+
+/* 预读的工作 */
+struct BOFS_ReadAheadWork {
+	struct Work work;
+	struct BOFS_Inode inode;        /* 节点的副本，文件关闭后也能读取 */
+	struct BOFS_SuperBlock *sb;
+	unsigned int start;             /* 开始的页索引 */
+	unsigned int count;             /* 页的数量 */
+	unsigned int generation;        /* 提交时节点的失效代数 */
+};
+
+#define PAGE_HASH(devno, inode, index) \
+	(((devno) * 31 + (inode) * 131 + (index)) & (BOFS_PAGE_HASH_SIZE - 1))
+
+/**
+ * LookupCachePage - 在哈希表中查找缓存页
+ * @devno: 设备号
+ * @inode: 节点id
+ * @index: 页索引
+ *
+ * 需要在关闭中断的情况下调用，找到返回页，没找到返回NULL
+ */
+PRIVATE struct BOFS_CachePage *LookupCachePage(dev_t devno, unsigned int inode,
+	unsigned int index)
+{
+	struct BOFS_CachePage *page;
+	struct List *head = &pageHashTable[PAGE_HASH(devno, inode, index)];
+
+	ListForEachOwner(page, head, hashList) {
+		if (page->devno == devno && page->inode == inode && page->index == index)
+			return page;
+	}
+	return NULL;
+}
+
+/**
+ * UnhashCachePage - 把页从哈希表和LRU链表中移除
+ * @page: 缓存页
+ *
+ * 需要在关闭中断的情况下调用，移除后就不能再被找到
+ */
+PRIVATE void UnhashCachePage(struct BOFS_CachePage *page)
+{
+	ListDel(&page->hashList);
+	ListDel(&page->lruList);
+	page->hashed = 0;
+	cachedPages--;
+}
+
+/**
+ * FreeCachePage - 释放缓存页
+ * @page: 缓存页
+ */
+PRIVATE void FreeCachePage(struct BOFS_CachePage *page)
+{
+	kfree(page->data);
+	MemCacheFree(cachePageCache, page);
+}
+
+/**
+ * PutCachePage - 释放对缓存页的使用
+ * @page: 缓存页
+ *
+ * 已经失效的页在最后一个使用者释放时释放
+ */
+PRIVATE void PutCachePage(struct BOFS_CachePage *page)
+{
+	unsigned long flags = InterruptSave();
+	AtomicDec(&page->count);
+	if (!page->hashed && !AtomicGet(&page->count)) {
+		InterruptRestore(flags);
+		FreeCachePage(page);
+		return;
+	}
+	InterruptRestore(flags);
+}
+
+/**
+ * AllocCachePage - 分配一个缓存页
+ *
+ * 缓存页达到上限时，回收最久没有使用并且空闲的页
+ * 成功返回页，失败返回NULL
+ */
+PRIVATE struct BOFS_CachePage *AllocCachePage()
+{
+	struct BOFS_CachePage *page;
+
+	if (cachedPages >= BOFS_PAGE_CACHE_MAX) {
+		unsigned long flags = InterruptSave();
+		ListForEachOwner(page, &pageLruList, lruList) {
+			if (!AtomicGet(&page->count) && !page->locked) {
+				UnhashCachePage(page);
+				InterruptRestore(flags);
+				/* 直接复用被回收的页 */
+				return page;
+			}
+		}
+		InterruptRestore(flags);
+		/* 所有的页都在使用中，只能超出上限 */
+	}
+
+	page = MemCacheAlloc(cachePageCache);
+	if (page == NULL)
+		return NULL;
+
+	page->data = kmalloc(PAGE_SIZE, GFP_KERNEL);
+	if (page->data == NULL) {
+		MemCacheFree(cachePageCache, page);
+		return NULL;
+	}
+	return page;
+}
+
+/**
+ * FillCachePage - 从磁盘读取页的数据
+ * @page: 缓存页
+ * @inode: 节点
+ * @sb: 超级块
+ *
+ * 文件末尾以外的部分和空洞填0
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int FillCachePage(struct BOFS_CachePage *page, struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb)
+{
+	uint32 blocks[PAGE_SIZE / SECTOR_SIZE];
+	sector_t run[PAGE_SIZE / SECTOR_SIZE];
+	unsigned int blockSize = sb->blockSize;
+	unsigned int count = PAGE_SIZE / blockSize;
+	unsigned int first = page->index * count;
+	unsigned int fileBlocks = DIV_ROUND_UP(inode->size, blockSize);
+	unsigned int i, j, n;
+
+	memset(page->data, 0, PAGE_SIZE);
+
+	if (first >= fileBlocks)
+		return 0;
+	if (first + count > fileBlocks)
+		count = fileBlocks - first;
+
+	/* 一次获取页中所有块的地址 */
+	if (BOFS_MapInodeBlocks(inode, first, count, blocks, sb))
+		return -1;
+
+	for (i = 0; i < count; i = j) {
+		/* 空洞已经填0了 */
+		if (blocks[i] == 0) {
+			j = i + 1;
+			continue;
+		}
+		/* 不是空洞的一段块一起读取 */
+		for (j = i, n = 0; j < count && blocks[j]; j++)
+			run[n++] = blocks[j];
+		if (BlockReadBlocks(sb->devno, run, n, page->data + i * blockSize))
+			return -1;
+	}
+	return 0;
+}
+
+/**
+ * UnlockCachePage - 读取结束，解锁缓存页
+ * @page: 缓存页
+ *
+ * 唤醒等待这个页读取完成的任务
+ */
+PRIVATE void UnlockCachePage(struct BOFS_CachePage *page)
+{
+	page->locked = 0;
+	WaitQueueWakeUpAll(AddressWaitQueue(page));
+}
+
+/**
+ * GetCachePage - 获取文件的一个缓存页
+ * @inode: 节点
+ * @sb: 超级块
+ * @index: 页索引
+ * @generation: 节点的失效代数，为NULL时不检测
+ *
+ * 不在缓存中就从磁盘读取，返回的页数据有效并且增加了使用者计数，
+ * 使用完后需要用PutCachePage释放，失败返回NULL。
+ * 预读使用的是节点的副本，如果提交预读之后节点的缓存页失效过，
+ * 副本已经过时，就不把页放入缓存，返回NULL
+ */
+PRIVATE struct BOFS_CachePage *GetCachePage(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb, unsigned int index, unsigned int *generation)
+{
+	struct BOFS_CachePage *page, *new;
+
+	unsigned long flags = InterruptSave();
+	page = LookupCachePage(sb->devno, inode->id, index);
+	if (page != NULL) {
+		AtomicInc(&page->count);
+		/* 移动到LRU链表末尾 */
+		ListDel(&page->lruList);
+		ListAddTail(&page->lruList, &pageLruList);
+		InterruptRestore(flags);
+
+		/* 其它任务正在读取这个页，睡眠到读取完成 */
+		WAIT_EVENT(AddressWaitQueue(page), !page->locked);
+
+		if (page->uptodate)
+			return page;
+		PutCachePage(page);
+		return NULL;
+	}
+	InterruptRestore(flags);
+
+	new = AllocCachePage();
+	if (new == NULL)
+		return NULL;
+
+	new->devno = sb->devno;
+	new->inode = inode->id;
+	new->index = index;
+	new->uptodate = 0;
+	new->locked = 1;
+	AtomicSet(&new->count, 1);
+
+	flags = InterruptSave();
+	/* 分配的时候可能有其它任务添加了同一个页 */
+	page = LookupCachePage(sb->devno, inode->id, index);
+	if (page != NULL) {
+		InterruptRestore(flags);
+		FreeCachePage(new);
+		return GetCachePage(inode, sb, index, generation);
+	}
+	if (generation != NULL && *generation != INODE_GENERATION(sb->devno, inode->id)) {
+		InterruptRestore(flags);
+		FreeCachePage(new);
+		return NULL;
+	}
+	ListAddTail(&new->hashList, &pageHashTable[PAGE_HASH(sb->devno, inode->id, index)]);
+	ListAddTail(&new->lruList, &pageLruList);
+	new->hashed = 1;
+	cachedPages++;
+	InterruptRestore(flags);
+
+	if (!FillCachePage(new, inode, sb)) {
+		new->uptodate = 1;
+		UnlockCachePage(new);
+		return new;
+	}
+
+	printk(PART_ERROR "BOFS_PageCache: read page %d of inode %d failed!\n",
+		index, inode->id);
+
+	/* 读取失败的页不能留在缓存中 */
+	flags = InterruptSave();
+	if (new->hashed)
+		UnhashCachePage(new);
+	UnlockCachePage(new);
+	InterruptRestore(flags);
+	PutCachePage(new);
+	return NULL;
+}
+
+/**
+ * PrefetchBlocks - 把预读窗口中的块读入块缓冲
+ * @inode: 节点
+ * @sb: 超级块
+ * @start: 起始页索引
+ * @count: 页数
+ *
+ * 整个窗口的块一起提交，连续的块会合并成一个多扇区请求，
+ * 之后填充缓存页时就只需要从块缓冲中复制数据
+ */
+PRIVATE void PrefetchBlocks(struct BOFS_Inode *inode, struct BOFS_SuperBlock *sb,
+	unsigned int start, unsigned int count)
+{
+	unsigned int perPage = PAGE_SIZE / sb->blockSize;
+	unsigned int first = start * perPage;
+	unsigned int fileBlocks = DIV_ROUND_UP(inode->size, sb->blockSize);
+	unsigned int total, i, n;
+
+	if (first >= fileBlocks)
+		return;
+	total = MIN(count * perPage, fileBlocks - first);
+
+	uint32 *blocks = kmalloc(total * sizeof(uint32), GFP_KERNEL);
+	if (blocks == NULL)
+		return;
+	sector_t *run = kmalloc(total * sizeof(sector_t), GFP_KERNEL);
+	if (run == NULL) {
+		kfree(blocks);
+		return;
+	}
+
+	if (!BOFS_MapInodeBlocks(inode, first, total, blocks, sb)) {
+		/* 跳过空洞 */
+		for (i = 0, n = 0; i < total; i++) {
+			if (blocks[i])
+				run[n++] = blocks[i];
+		}
+		BlockReadBlocks(sb->devno, run, n, NULL);
+	}
+	kfree(run);
+	kfree(blocks);
+}
+
+/**
+ * ReadAheadWorkHandler - 预读工作
+ * @work: 工作
+ *
+ * 在预读线程中把页读入缓存
+ */
+PRIVATE void ReadAheadWorkHandler(struct Work *work)
+{
+	struct BOFS_ReadAheadWork *raw = container_of(work, struct BOFS_ReadAheadWork, work);
+	struct BOFS_CachePage *page;
+	unsigned int i;
+
+	PrefetchBlocks(&raw->inode, raw->sb, raw->start, raw->count);
+
+	for (i = 0; i < raw->count; i++) {
+		page = GetCachePage(&raw->inode, raw->sb, raw->start + i, &raw->generation);
+		if (page == NULL)
+			break;
+		PutCachePage(page);
+	}
+	kfree(raw);
+}
+
+/**
+ * ReadAheadUpdate - 更新预读状态
+ * @ra: 预读状态
+ * @inode: 节点
+ * @sb: 超级块
+ * @pos: 本次读取的位置
+ * @count: 本次读取的数据量
+ *
+ * 顺序读取时预读窗口成倍增长，后面剩余的预读页少于半个窗口时，
+ * 就提交下一段预读
+ */
+PRIVATE void ReadAheadUpdate(struct BOFS_ReadAhead *ra, struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb, uint32 pos, uint32 count)
+{
+	unsigned int next = (pos + count - 1) / PAGE_SIZE + 1;
+	unsigned int endPage = DIV_ROUND_UP(inode->size, PAGE_SIZE);
+
+	if (pos == ra->nextPos) {
+		ra->window = ra->window ? MIN(ra->window * 2, BOFS_READ_AHEAD_MAX) : BOFS_READ_AHEAD_MIN;
+	} else {
+		/* 随机读取，不进行预读 */
+		ra->window = 0;
+		ra->aheadEnd = 0;
+	}
+	ra->nextPos = pos + count;
+
+	if (!ra->window || readAheadQueue == NULL)
+		return;
+
+	if (ra->aheadEnd < next)
+		ra->aheadEnd = next;
+
+	/* 已经提交的预读还足够 */
+	if (ra->aheadEnd - next >= ra->window / 2 || ra->aheadEnd >= endPage)
+		return;
+
+	unsigned int end = MIN(next + ra->window, endPage);
+
+	struct BOFS_ReadAheadWork *raw = kmalloc(sizeof(struct BOFS_ReadAheadWork), GFP_KERNEL);
+	if (raw == NULL)
+		return;
+
+	WorkInit(&raw->work, ReadAheadWorkHandler);
+	/* 先记录代数再复制节点，之间的写入也会让预读丢弃 */
+	raw->generation = INODE_GENERATION(sb->devno, inode->id);
+	raw->inode = *inode;
+	raw->sb = sb;
+	raw->start = ra->aheadEnd;
+	raw->count = end - ra->aheadEnd;
+
+	if (QueueScheduleWork(readAheadQueue, &raw->work)) {
+		kfree(raw);
+		return;
+	}
+	ra->aheadEnd = end;
+}
+
+/**
+ * BOFS_PageCacheRead - 通过页缓存读取文件数据
+ * @inode: 节点
+ * @sb: 超级块
+ * @pos: 文件偏移
+ * @buf: 缓冲区
+ * @count: 字节数
+ * @ra: 预读状态，为NULL时不预读
+ *
+ * 数据直接从缓存页复制到缓冲区
+ * @return: 成功返回读取的数据量，到达文件末尾返回0，失败返回-1
+ */
+PUBLIC int BOFS_PageCacheRead(struct BOFS_Inode *inode,
+	struct BOFS_SuperBlock *sb,
+	uint32 pos,
+	void *buf,
+	uint32 count,
+	struct BOFS_ReadAhead *ra)
+{
+	struct BOFS_CachePage *page;
+	uint8 *dst = buf;
+	uint32 bytesRead = 0;
+	uint32 offset, chunkSize;
+
+	if (pos >= inode->size || !count)
+		return 0;
+
+	if (pos + count > inode->size)
+		count = inode->size - pos;
+
+	if (ra != NULL)
+		ReadAheadUpdate(ra, inode, sb, pos, count);
+
+	while (bytesRead < count) {
+		page = GetCachePage(inode, sb, pos / PAGE_SIZE, NULL);
+		if (page == NULL)
+			return bytesRead ? bytesRead : -1;
+
+		offset = pos % PAGE_SIZE;
+		chunkSize = MIN(count - bytesRead, PAGE_SIZE - offset);
+		memcpy(dst, page->data + offset, chunkSize);
+		PutCachePage(page);
+
+		dst += chunkSize;
+		pos += chunkSize;
+		bytesRead += chunkSize;
+	}
+	return bytesRead;
+}
+
+/**
+ * BOFS_PageCacheInvalidate - 使文件一段数据的缓存页失效
+ * @sb: 超级块
+ * @inode: 节点
+ * @pos: 文件偏移
+ * @count: 字节数
+ *
+ * 写入文件数据后调用，下次读取时重新从磁盘读取
+ */
+PUBLIC void BOFS_PageCacheInvalidate(struct BOFS_SuperBlock *sb,
+	struct BOFS_Inode *inode,
+	uint32 pos,
+	uint32 count)
+{
+	struct BOFS_CachePage *page;
+	unsigned int index, last;
+
+	if (!count)
+		return;
+
+	/* 即使没有缓存页，也可能有预读正在读取 */
+	unsigned long flags = InterruptSave();
+	INODE_GENERATION(sb->devno, inode->id)++;
+	InterruptRestore(flags);
+	if (!cachedPages)
+		return;
+
+	last = (pos + count - 1) / PAGE_SIZE;
+	for (index = pos / PAGE_SIZE; index <= last; index++) {
+		flags = InterruptSave();
+		page = LookupCachePage(sb->devno, inode->id, index);
+		if (page != NULL) {
+			UnhashCachePage(page);
+			/* 没有使用者就直接释放，不然由最后一个使用者释放 */
+			if (!AtomicGet(&page->count)) {
+				InterruptRestore(flags);
+				FreeCachePage(page);
+				continue;
+			}
+		}
+		InterruptRestore(flags);
+	}
+}
+
+/**
+ * BOFS_PageCacheInvalidateInode - 使节点所有的缓存页失效
+ * @sb: 超级块
+ * @inode: 节点
+ *
+ * 截断文件或者释放节点数据时调用
+ */
+PUBLIC void BOFS_PageCacheInvalidateInode(struct BOFS_SuperBlock *sb,
+	struct BOFS_Inode *inode)
+{
+	struct BOFS_CachePage *page, *next;
+
+	unsigned long flags = InterruptSave();
+	INODE_GENERATION(sb->devno, inode->id)++;
+	ListForEachOwnerSafe(page, next, &pageLruList, lruList) {
+		if (page->devno == sb->devno && page->inode == inode->id) {
+			UnhashCachePage(page);
+			if (!AtomicGet(&page->count))
+				FreeCachePage(page);
+		}
+	}
+	InterruptRestore(flags);
+}
+
+/**
+ * BOFS_InitPageCache - 初始化页缓存
+ *
+ * 需要在工作队列初始化之后调用
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int BOFS_InitPageCache()
+{
+	int i;
+	for (i = 0; i < BOFS_PAGE_HASH_SIZE; i++)
+		INIT_LIST_HEAD(&pageHashTable[i]);
+
+	cachedPages = 0;
+
+	cachePageCache = CreateMemCache("bofs_page", sizeof(struct BOFS_CachePage), 0, 0, NULL);
+	if (cachePageCache == NULL)
+		return -1;
+
+	/* 没有预读线程也可以工作，只是不进行预读 */
+	readAheadQueue = CreateWorkQueue("readahead");
+	if (readAheadQueue == NULL)
+		printk(PART_WARRING "BOFS_InitPageCache: create read ahead queue failed!\n");
+
+	return 0;
+}
@@ -11,6 +11,7 @@
 #include <book/device.h>
 #include <book/ioqueue.h>
 #include <book/signal.h>
+#include <book/waitqueue.h>
 
 #include <lib/string.h>
 #include <lib/math.h>
@@ -130,6 +131,22 @@ PUBLIC int BOFS_PipeInTable(struct BOFS_Pipe *pipe, pid_t pid)
     return -1;
 }
 
+/**
+ * PipeInterrupted - 管道的等待是否需要停止
+ * @ioqueue: 管道的io队列
+ * 
+ * 有一端已经全部关闭，或者当前任务有需要处理的信号时，读写不再等待
+ */
+PRIVATE int PipeInterrupted(struct IoQueue *ioqueue)
+{
+    struct BOFS_Pipe *pipe = container_of(ioqueue, struct BOFS_Pipe, ioqueue);
+    struct Task *cur = CurrentTask();
+
+    return AtomicGet(&pipe->writeReference) <= 0 ||
+        AtomicGet(&pipe->readReference) <= 0 ||
+        (cur->signalPending & ~cur->signalBlocked) != 0;
+}
+
 PUBLIC int BOFS_PipeInit(struct BOFS_Pipe *pipe)
 {
     /* 分配缓冲区 */
@@ -138,14 +155,15 @@ PUBLIC int BOFS_PipeInit(struct BOFS_Pipe *pipe)
         return -1;
     }
 
-    /* 初始化io队列 */
+    /* 数据都放在以字节为单元的io队列中，由io队列负责复制和等待 */
     IoQueueInit(&pipe->ioqueue, buf, PIPE_SIZE, IQ_FACTOR_8);
+    pipe->ioqueue.interrupted = PipeInterrupted;
 
     /* 设置引用计数位0 */
     AtomicSet(&pipe->readReference, 0);
     AtomicSet(&pipe->writeReference, 0);
     
-    INIT_LIST_HEAD(&pipe->waitList);
+    WaitQueueInit(&pipe->waitQueue, NULL);
 
     int i;
     for (i = 0; i < MAX_PIPE_PER_TASK_NR; i++) {
@@ -156,6 +174,75 @@ PUBLIC int BOFS_PipeInit(struct BOFS_Pipe *pipe)
     return 0;
 }
 
+/**
+ * BOFS_PipeReadData - 从管道读取数据
+ * @pipe: 管道
+ * @buffer: 缓冲区
+ * @count: 最多读取的数据量
+ * 
+ * 管道为空时阻塞，直到有数据、写端全部关闭或者收到信号，
+ * 有数据时一次取出能取的所有数据。
+ * 返回读取的数据量，写端全部关闭并且没有数据返回0，被信号打断返回-1
+ */
+PUBLIC int BOFS_PipeReadData(struct BOFS_Pipe *pipe, void *buffer, size_t count)
+{
+    int len;
+
+    if (!count)
+        return 0;
+
+    len = IoQueueGetMany(&pipe->ioqueue, buffer, count, 0);
+    if (len < 0) {
+        /* 写端已经关闭，就像到达文件末尾 */
+        if (AtomicGet(&pipe->writeReference) <= 0)
+            return 0;
+        return -1;
+    }
+    return len;
+}
+
+/**
+ * BOFS_PipeWriteData - 往管道写入数据
+ * @pipe: 管道
+ * @buffer: 数据
+ * @count: 数据量
+ * 
+ * 不大于PIPE_BUF的数据要等到能一次放下才写入，保证原子性；
+ * 大于PIPE_BUF的数据有空间就写入一部分，唤醒读者后继续等待。
+ * 读端全部关闭时发出SIGPIPE信号。
+ * 返回写入的数据量，一个字节都没有写入时返回-1
+ */
+PUBLIC int BOFS_PipeWriteData(struct BOFS_Pipe *pipe, void *buffer, size_t count)
+{
+    int written = -1;
+
+    if (!count)
+        return 0;
+
+    /* PIPE_SIZE不小于PIPE_BUF，原子写入总能一次放下 */
+    if (AtomicGet(&pipe->readReference) > 0)
+        written = IoQueuePutMany(&pipe->ioqueue, buffer, count,
+            count <= PIPE_BUF ? IQ_ALL : 0);
+
+    /* 读端已经关闭，写入是没有意义的 */
+    if (written < (int)count && AtomicGet(&pipe->readReference) <= 0) {
+        printk(PART_ERROR "pipe write occur a SIGPIPE!\n");
+        ForceSignal(SIGPIPE, SysGetPid());
+    }
+    return written;
+}
+
+/**
+ * BOFS_PipeWakeUp - 唤醒管道上所有的读者和写者
+ * @pipe: 管道
+ * 
+ * 关闭一端的时候调用，让另一端的等待者重新检测管道的状态
+ */
+PUBLIC void BOFS_PipeWakeUp(struct BOFS_Pipe *pipe)
+{
+    IoQueueWakeUpAll(&pipe->ioqueue);
+}
+
 /**
  * BOFS_Pipe - 创建管道文件
  * @fd: 管道文件描述符，2个
@@ -231,7 +318,6 @@ ToFailed:
 
 PUBLIC unsigned int BOFS_PipeRead(int fd, void *buffer, size_t count)
 {
-    //printk("in BOFS_PipeRead, fd %d\n", fd);
     /* 获取全局描文件述符 */
     unsigned int globalFd = FdLocal2Global(fd);
 
@@ -240,51 +326,11 @@ PUBLIC unsigned int BOFS_PipeRead(int fd, void *buffer, size_t count)
     if (pipe == NULL) {
         return 0;
     }
-    unsigned char *buf = (unsigned char *)buffer;
-    size_t bytesRead = 0;
-    /* 获取输入输出队列 */
-    struct IoQueue *ioqueue = (struct IoQueue *)&file->pipe->ioqueue;
-    unsigned int iolen;
-    /* 判断写端是否关闭 */
-    if (AtomicGet(&pipe->writeReference) > 0) {
-        //printk("try get char\n", (char *)buffer);
-        if (!IO_QUEUE_LENGTH(ioqueue)) {
-            return -1;
-        }
-        /* 尝试获取一个字符，如果成功，继续往后，不然就会阻塞 */
-        *buf++ = IoQueueGet(ioqueue);
-        bytesRead++;
-        
-        /* 获取较小的数据量 */
-        iolen = MIN(count - 1, IO_QUEUE_LENGTH(ioqueue));
-
-        /* 没有关闭，正常读取 */
-        while (iolen > 0) {
-            *buf++ = IoQueueGet(ioqueue);
-            bytesRead++;
-            iolen--;
-        }
-        //printk(">>> pipe readcal: %s\n", (char *)buffer);
-    } else {
-        //printk("close pipe!\n");
-        /* 已经关闭，读取剩余量 */
-        iolen = IO_QUEUE_LENGTH(ioqueue);
-        while (iolen > 0) {
-            *buf++ = IoQueueGet(ioqueue);
-            bytesRead++;
-            iolen--;
-        }
-    }
-    if (!bytesRead)
-        bytesRead = -1;
-
-    return bytesRead;
+    return BOFS_PipeReadData(pipe, buffer, count);
 }
 
 PUBLIC unsigned int BOFS_PipeWrite(int fd, void *buffer, size_t count)
 {
-    //printk("in BOFS_PipeWrite, fd %d\n", fd);
-
     /* 获取全局描文件述符 */
     unsigned int globalFd = FdLocal2Global(fd);
     struct BOFS_FileDescriptor *file = BOFS_GetFileByFD(globalFd);
@@ -292,35 +338,11 @@ PUBLIC unsigned int BOFS_PipeWrite(int fd, void *buffer, size_t count)
     if (pipe == NULL) {
         return 0;
     }
-    unsigned char *buf = (unsigned char *)buffer;
-    size_t bytesWrite = 0;
-    
-    /* 获取输入输出队列 */
-    struct IoQueue *ioqueue = (struct IoQueue *)&file->pipe->ioqueue;
-    /* 判断写端是否关闭 */
-    if (AtomicGet(&pipe->readReference) > 0) {
-        //printk(">>> pipe write: %s\n", buf);
-        while (count > 0) {
-            IoQueuePut(ioqueue, *buf++);
-            bytesWrite++;
-            count--;
-        }
-    } else {
-        /* 读端已经关闭，发出SIGPIPE信号 */
-        printk(PART_ERROR "pipe write occur a SIGPIPE!\n");
-        ForceSignal(SIGPIPE, SysGetPid());
-    }
-    
-    if (!bytesWrite)
-        bytesWrite = -1;
-
-    return bytesWrite;
+    return BOFS_PipeWriteData(pipe, buffer, count);
 }
 
 PUBLIC void BOFS_PipeClose(struct BOFS_FileDescriptor *file)
 {
-    printk("### pipe ref %d\n", AtomicGet(&file->reference));
-    
     /* 主动close的时候会减少一个，自动close的时候会再进入之前做一个减少，导致可能为负 */
     AtomicDec(&file->reference);
     
@@ -329,12 +351,9 @@ PUBLIC void BOFS_PipeClose(struct BOFS_FileDescriptor *file)
         struct BOFS_Pipe *pipe = file->pipe;
         
         if (file->pos == 0) {
-            printk("### will free read pipe file\n");
             /* 是读文件，把管道读引用设置为0 */
             AtomicSet(&pipe->readReference, 0);
         } else if (file->pos == 1) {
-            
-            printk("### will free write pipe file\n");
             /* 是写文件，把管道写引用设置为0 */
             AtomicSet(&pipe->writeReference, 0);
         }
@@ -345,11 +364,13 @@ PUBLIC void BOFS_PipeClose(struct BOFS_FileDescriptor *file)
         if (AtomicGet(&pipe->readReference) == 0 && 
             AtomicGet(&pipe->writeReference) == 0) {
             
-            printk("### will free pipe\n");
             /* 释放缓冲区 */
             kfree(pipe->ioqueue.buf);
             /* 释放管道 */
             kfree(pipe);
+        } else {
+            /* 另一端可能在等待，唤醒后会发现这一端已经关闭 */
+            BOFS_PipeWakeUp(pipe);
         }
     }
 }  
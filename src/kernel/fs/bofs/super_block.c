@@ -113,6 +113,9 @@ PUBLIC int BOFS_MakeFS(struct BOFS_SuperBlock *superBlock,
     superBlock->magic = BOFS_SUPER_BLOCK_MAGIC;
     superBlock->devno = devno;
     superBlock->blockSize = blockSize;
+
+    /* 新的文件系统使用区段记录数据块 */
+    superBlock->features = BOFS_FEATURE_EXTENTS;
     
     superBlock->totalSectors = totalSectors;
 
@@ -738,6 +738,73 @@ PUBLIC int SysClose(int fd)
 	return BOFS_Close(fd);
 }
 
+/**
+ * FileMapCreate - 为打开的文件创建文件映射
+ * @fd: 文件描述符
+ * 
+ * 映射持有节点的副本，文件关闭后仍然可以读取，引用计数初始为1
+ * 成功返回映射，失败返回NULL
+ */
+PUBLIC struct FileMap *FileMapCreate(int fd)
+{
+    struct FileMap *map = kmalloc(sizeof(struct FileMap), GFP_KERNEL);
+    if (map == NULL)
+        return NULL;
+    
+    struct BOFS_SuperBlock *sb;
+    struct BOFS_Inode *inode = BOFS_DupInode(fd, &sb);
+    if (inode == NULL) {
+        printk(PART_ERROR "FileMapCreate: dup inode of fd %d failed!\n", fd);
+        kfree(map);
+        return NULL;
+    }
+
+    map->inode = inode;
+    map->superBlock = sb;
+    AtomicSet(&map->reference, 1);
+    return map;
+}
+
+/**
+ * FileMapRead - 从文件映射读取数据
+ * @map: 文件映射
+ * @offset: 文件偏移
+ * @buffer: 缓冲区
+ * @size: 要读取的数据量
+ * 
+ * 返回读取的数据量，失败返回-1
+ */
+PUBLIC int FileMapRead(struct FileMap *map, unsigned int offset, 
+        void *buffer, unsigned int size)
+{
+    return BOFS_InodeRead(map->inode, map->superBlock, offset, buffer, size);
+}
+
+/**
+ * FileMapGet - 增加文件映射的引用
+ * @map: 文件映射
+ */
+PUBLIC void FileMapGet(struct FileMap *map)
+{
+    AtomicInc(&map->reference);
+}
+
+/**
+ * FileMapPut - 减少文件映射的引用
+ * @map: 文件映射
+ * 
+ * 引用为0时释放节点副本和映射
+ */
+PUBLIC void FileMapPut(struct FileMap *map)
+{
+    AtomicDec(&map->reference);
+    if (AtomicGet(&map->reference) > 0)
+        return;
+    
+    kfree(map->inode);
+    kfree(map);
+}
+
 PUBLIC int SysStat(const char *pathname, struct stat *buf)
 {
     char absPath[MAX_PATH_LEN] = {0};
@@ -0,0 +1,145 @@
+/*
+ * file:		kernel/ipc/futex.c
+ * auther:	    Jason Hu
+ * time:		2020/3/14
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/futex.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/task.h>
+#include <book/schedule.h>
+#include <book/vmspace.h>
+
+/* futex等待表的大小，必须是2的幂 */
+#define FUTEX_HASH_SIZE     64
+
+#define FUTEX_HASH(mm, uaddr) \
+    ((((unsigned long)(uaddr) >> 2) ^ ((unsigned long)(mm) >> 4)) & (FUTEX_HASH_SIZE - 1))
+
+/* 等待者，定义在等待任务的栈上 */
+struct FutexWaiter {
+    struct List list;               /* 等待表中的链表，被唤醒时从表中删除 */
+    struct Task *task;              /* 等待的任务 */
+    struct MemoryManager *mm;       /* 地址空间 */
+    int *uaddr;                     /* 用户虚拟地址 */
+};
+
+PRIVATE struct List futexTable[FUTEX_HASH_SIZE];
+
+/**
+ * FutexWait - 在futex上等待
+ * @uaddr: 用户空间的整数
+ * @val: 期望的值
+ *
+ * 值不等于期望值直接返回-1，被唤醒返回0，被信号打断返回-1
+ */
+PRIVATE int FutexWait(int *uaddr, int val)
+{
+    struct Task *current = CurrentTask();
+    struct FutexWaiter waiter;
+    int retval = 0;
+
+    waiter.task = current;
+    waiter.mm = current->mm;
+    waiter.uaddr = uaddr;
+
+    /* 检查值和加入等待表之间不能有唤醒插进来 */
+    unsigned long flags = InterruptSave();
+
+    if (*uaddr != val) {
+        InterruptRestore(flags);
+        return -1;
+    }
+
+    ListAddTail(&waiter.list, &futexTable[FUTEX_HASH(waiter.mm, uaddr)]);
+
+    while (1) {
+        current->status = TASK_BLOCKED;
+        Schedule();
+
+        /* 唤醒者会把自己从等待表中删除 */
+        if (ListEmpty(&waiter.list))
+            break;
+
+        /* 有信号需要处理，放弃等待 */
+        if (current->signalPending & ~current->signalBlocked) {
+            ListDel(&waiter.list);
+            retval = -1;
+            break;
+        }
+    }
+
+    InterruptRestore(flags);
+    return retval;
+}
+
+/**
+ * FutexWake - 唤醒futex上的等待者
+ * @uaddr: 用户空间的整数
+ * @count: 最多唤醒的数量
+ *
+ * 按等待的先后顺序唤醒，返回唤醒的数量
+ */
+PRIVATE int FutexWake(int *uaddr, int count)
+{
+    struct MemoryManager *mm = CurrentTask()->mm;
+    struct FutexWaiter *waiter, *next;
+    struct List *bucket = &futexTable[FUTEX_HASH(mm, uaddr)];
+    int woken = 0;
+
+    unsigned long flags = InterruptSave();
+
+    ListForEachOwnerSafe(waiter, next, bucket, list) {
+        if (woken >= count)
+            break;
+        if (waiter->mm != mm || waiter->uaddr != uaddr)
+            continue;
+
+        ListDelInit(&waiter->list);
+        TaskWakeUp(waiter->task);
+        woken++;
+    }
+
+    InterruptRestore(flags);
+    return woken;
+}
+
+/**
+ * SysFutex - futex系统调用
+ * @uaddr: 用户空间的整数，需要4字节对齐
+ * @op: 操作
+ * @val: 操作的参数
+ *
+ * 失败返回-1
+ */
+PUBLIC int SysFutex(int *uaddr, int op, int val)
+{
+    /* 只能是用户空间中对齐的地址 */
+    if (uaddr == NULL || ((unsigned long)uaddr & 3) ||
+        (unsigned long)uaddr >= USER_VM_SIZE)
+        return -1;
+
+    switch (op) {
+    case FUTEX_WAIT:
+        return FutexWait(uaddr, val);
+    case FUTEX_WAKE:
+        if (val <= 0)
+            return 0;
+        return FutexWake(uaddr, val);
+    default:
+        break;
+    }
+    return -1;
+}
+
+/**
+ * InitFutex - 初始化futex等待表
+ */
+PUBLIC void InitFutex()
+{
+    int i;
+    for (i = 0; i < FUTEX_HASH_SIZE; i++)
+        INIT_LIST_HEAD(&futexTable[i]);
+}
@@ -0,0 +1,637 @@
+/*
+ * file:		kernel/ipc/msgqueue.c
+ * auther:	    Jason Hu
+ * time:		2020/3/17
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/msgqueue.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/memcache.h>
+#include <book/task.h>
+#include <book/schedule.h>
+#include <lib/string.h>
+#include <lib/math.h>
+
+/* 一次最多接收的消息数，槽号保存在栈上 */
+#define MQ_RECV_BATCH       16
+
+/**
+ * MsgQueueSignalPending - 任务是否有需要处理的信号
+ * @task: 任务
+ */
+PRIVATE INLINE int MsgQueueSignalPending(struct Task *task)
+{
+    return (task->signalPending & ~task->signalBlocked) != 0;
+}
+
+/* 发送者可以继续：有空槽、队列已经关闭或者有信号 */
+#define MQ_SEND_READY(mq, task) \
+    (!MSG_QUEUE_FULL(mq) || (mq)->closed || MsgQueueSignalPending(task))
+
+/* 接收者可以继续：有消息、队列已经关闭或者有信号 */
+#define MQ_RECV_READY(mq, task) \
+    (!MSG_QUEUE_EMPTY(mq) || (mq)->closed || MsgQueueSignalPending(task))
+
+/**
+ * MsgQueueInit - 初始化消息队列
+ * @mq: 消息队列
+ * @maxMsgs: 槽的数量
+ * @msgSize: 每条消息的最大字节数
+ *
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int MsgQueueInit(struct MsgQueue *mq, unsigned int maxMsgs, unsigned int msgSize)
+{
+    int i;
+
+    if (!maxMsgs || maxMsgs > MQ_MAX_MSGS || !msgSize || msgSize > MQ_MAX_MSGSIZE ||
+        maxMsgs * msgSize > MQ_MAX_BYTES)
+        return -1;
+
+    mq->data = kmalloc(maxMsgs * msgSize, GFP_KERNEL);
+    if (mq->data == NULL) {
+        printk(PART_ERROR "MsgQueueInit: kmalloc slots failed!\n");
+        return -1;
+    }
+
+    /* 消息大小、空闲栈和每个优先级的环放在一起分配 */
+    mq->sizes = kmalloc((MQ_PRIO_NR + 2) * maxMsgs * sizeof(unsigned short), GFP_KERNEL);
+    if (mq->sizes == NULL) {
+        printk(PART_ERROR "MsgQueueInit: kmalloc rings failed!\n");
+        kfree(mq->data);
+        return -1;
+    }
+    mq->freeSlots = mq->sizes + maxMsgs;
+    for (i = 0; i < MQ_PRIO_NR; i++) {
+        mq->rings[i].slots = mq->freeSlots + (i + 1) * maxMsgs;
+        mq->rings[i].head = 0;
+        mq->rings[i].count = 0;
+    }
+
+    /* 从栈顶取槽，先使用前面的槽 */
+    for (i = 0; i < maxMsgs; i++)
+        mq->freeSlots[i] = maxMsgs - 1 - i;
+    mq->freeTop = maxMsgs;
+
+    mq->maxMsgs = maxMsgs;
+    mq->msgSize = msgSize;
+    mq->count = 0;
+    mq->prioMask = 0;
+    mq->closed = 0;
+    WaitQueueInit(&mq->senders, NULL);
+    WaitQueueInit(&mq->receivers, NULL);
+    return 0;
+}
+
+/**
+ * MsgQueueClose - 关闭消息队列
+ * @mq: 消息队列
+ *
+ * 唤醒所有等待者，之后的发送都会失败，接收只能取走已有的消息
+ */
+PUBLIC void MsgQueueClose(struct MsgQueue *mq)
+{
+    unsigned long flags = InterruptSave();
+
+    mq->closed = 1;
+    WaitQueueWakeUpAll(&mq->senders);
+    WaitQueueWakeUpAll(&mq->receivers);
+
+    InterruptRestore(flags);
+}
+
+/**
+ * MsgQueueDestroy - 释放消息队列的槽
+ * @mq: 消息队列
+ *
+ * 不能再有任务在使用队列
+ */
+PUBLIC void MsgQueueDestroy(struct MsgQueue *mq)
+{
+    kfree(mq->data);
+    kfree(mq->sizes);
+    mq->data = NULL;
+    mq->sizes = NULL;
+}
+
+/**
+ * CreateMsgQueue - 动态创建一个消息队列
+ * @maxMsgs: 槽的数量
+ * @msgSize: 每条消息的最大字节数
+ *
+ * 成功返回队列，失败返回NULL
+ */
+PUBLIC struct MsgQueue *CreateMsgQueue(unsigned int maxMsgs, unsigned int msgSize)
+{
+    struct MsgQueue *mq = kmalloc(sizeof(struct MsgQueue), GFP_KERNEL);
+    if (mq == NULL)
+        return NULL;
+
+    if (MsgQueueInit(mq, maxMsgs, msgSize)) {
+        kfree(mq);
+        return NULL;
+    }
+    return mq;
+}
+
+/**
+ * FreeMsgQueue - 释放动态创建的消息队列
+ * @mq: 消息队列
+ */
+PUBLIC void FreeMsgQueue(struct MsgQueue *mq)
+{
+    MsgQueueDestroy(mq);
+    kfree(mq);
+}
+
+/**
+ * MsgQueueWait - 等待队列可以发送或者接收
+ * @mq: 消息队列
+ * @send: 1表示等待空槽，0表示等待消息
+ * @flags: 操作的标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待
+ *
+ * 返回0后调用者需要关闭中断重新检测，不阻塞、关闭、信号和超时返回-1
+ */
+PRIVATE int MsgQueueWait(struct MsgQueue *mq, int send, int flags, unsigned long *ticks)
+{
+    struct Task *cur = CurrentTask();
+    int ready;
+
+    if (flags & MQ_NONBLOCK)
+        return -1;
+
+    if (send) {
+        if (ticks)
+            WAIT_EVENT_TIMEOUT(&mq->senders, MQ_SEND_READY(mq, cur), *ticks);
+        else
+            WAIT_EVENT(&mq->senders, MQ_SEND_READY(mq, cur));
+        ready = !MSG_QUEUE_FULL(mq);
+    } else {
+        if (ticks)
+            WAIT_EVENT_TIMEOUT(&mq->receivers, MQ_RECV_READY(mq, cur), *ticks);
+        else
+            WAIT_EVENT(&mq->receivers, MQ_RECV_READY(mq, cur));
+        ready = !MSG_QUEUE_EMPTY(mq);
+    }
+
+    if (mq->closed || MsgQueueSignalPending(cur))
+        return -1;
+    if (ticks && !*ticks && !ready)
+        return -1;
+    return 0;
+}
+
+/**
+ * MsgQueueTopPrio - 有消息的最高优先级
+ * @mq: 消息队列
+ *
+ * 队列不能为空，需要关闭中断后调用
+ */
+PRIVATE INLINE int MsgQueueTopPrio(struct MsgQueue *mq)
+{
+    int prio = MQ_PRIO_NR - 1;
+
+    while (prio > 0 && !(mq->prioMask & (1 << prio)))
+        prio--;
+    return prio;
+}
+
+/**
+ * MsgQueueSend - 发送一条消息
+ * @mq: 消息队列
+ * @msg: 消息
+ * @len: 消息的字节数
+ * @prio: 优先级
+ * @flags: 操作的标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待，返回时保存剩余的ticks数
+ *
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int MsgQueueSend(struct MsgQueue *mq, const void *msg, unsigned int len,
+        unsigned int prio, int flags, unsigned long *ticks)
+{
+    struct MsgRing *ring;
+    unsigned long eflags;
+    unsigned int slot;
+
+    if (len > mq->msgSize || prio >= MQ_PRIO_NR)
+        return -1;
+
+    for (;;) {
+        eflags = InterruptSave();
+        if (mq->closed) {
+            InterruptRestore(eflags);
+            return -1;
+        }
+        if (!MSG_QUEUE_FULL(mq))
+            break;
+        InterruptRestore(eflags);
+
+        if (MsgQueueWait(mq, 1, flags, ticks))
+            return -1;
+    }
+
+    /* 1.取出一个空槽，消息可能在用户空间，复制时会发生页故障，不能关闭中断 */
+    slot = mq->freeSlots[--mq->freeTop];
+    InterruptRestore(eflags);
+
+    memcpy(mq->data + slot * mq->msgSize, msg, len);
+    mq->sizes[slot] = len;
+
+    /* 2.把槽放到优先级的环中，接收者才能看到 */
+    eflags = InterruptSave();
+
+    ring = &mq->rings[prio];
+    ring->slots[(ring->head + ring->count) % mq->maxMsgs] = slot;
+    ring->count++;
+    mq->prioMask |= 1 << prio;
+    mq->count++;
+
+    if (WaitQueueActive(&mq->receivers))
+        WaitQueueWakeUp(&mq->receivers);
+
+    /* 还有空槽，让下一个发送者继续发送 */
+    if (!MSG_QUEUE_FULL(mq) && WaitQueueActive(&mq->senders))
+        WaitQueueWakeUp(&mq->senders);
+
+    InterruptRestore(eflags);
+    return 0;
+}
+
+/**
+ * MsgQueueReceiveMany - 接收多条消息
+ * @mq: 消息队列
+ * @bufs: 每条消息的缓冲区
+ * @count: 最多接收的消息数
+ * @flags: 操作的标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待，返回时保存剩余的ticks数
+ *
+ * 只等待第一条消息，然后按优先级取出已有的消息，直到缓冲区用完或者
+ * 下一条消息放不下，一次最多接收MQ_RECV_BATCH条。
+ * 返回接收的消息数，第一条消息放不下或者没有接收到返回-1
+ */
+PUBLIC int MsgQueueReceiveMany(struct MsgQueue *mq, struct MsgBuffer *bufs,
+        int count, int flags, unsigned long *ticks)
+{
+    unsigned short slots[MQ_RECV_BATCH];
+    unsigned char prios[MQ_RECV_BATCH];
+    unsigned int lens[MQ_RECV_BATCH];
+    struct MsgRing *ring;
+    unsigned long eflags;
+    unsigned int slot;
+    int i, n, prio;
+
+    if (count <= 0)
+        return -1;
+    count = MIN(count, MQ_RECV_BATCH);
+
+    /* 缓冲区可能在用户空间，关闭中断前读出大小 */
+    for (i = 0; i < count; i++)
+        lens[i] = bufs[i].len;
+
+    for (;;) {
+        eflags = InterruptSave();
+        if (!MSG_QUEUE_EMPTY(mq))
+            break;
+        if (mq->closed) {
+            InterruptRestore(eflags);
+            return -1;
+        }
+        InterruptRestore(eflags);
+
+        if (MsgQueueWait(mq, 0, flags, ticks))
+            return -1;
+    }
+
+    /* 1.按优先级取出能放进缓冲区的消息 */
+    for (n = 0; n < count && !MSG_QUEUE_EMPTY(mq); n++) {
+        prio = MsgQueueTopPrio(mq);
+        ring = &mq->rings[prio];
+        slot = ring->slots[ring->head];
+        if (mq->sizes[slot] > lens[n])
+            break;
+
+        if (++ring->head >= mq->maxMsgs)
+            ring->head = 0;
+        if (!--ring->count)
+            mq->prioMask &= ~(1 << prio);
+        mq->count--;
+
+        slots[n] = slot;
+        prios[n] = prio;
+    }
+    InterruptRestore(eflags);
+
+    if (!n)
+        return -1;
+
+    /* 2.复制消息，这些槽已经不在环中，也不会被发送者使用 */
+    for (i = 0; i < n; i++) {
+        memcpy(bufs[i].buf, mq->data + slots[i] * mq->msgSize, mq->sizes[slots[i]]);
+        bufs[i].len = mq->sizes[slots[i]];
+        bufs[i].prio = prios[i];
+    }
+
+    /* 3.归还槽，一批只唤醒一次发送者 */
+    eflags = InterruptSave();
+
+    for (i = 0; i < n; i++)
+        mq->freeSlots[mq->freeTop++] = slots[i];
+
+    if (WaitQueueActive(&mq->senders))
+        WaitQueueWakeUp(&mq->senders);
+
+    /* 还有消息，让下一个接收者继续接收 */
+    if (!MSG_QUEUE_EMPTY(mq) && WaitQueueActive(&mq->receivers))
+        WaitQueueWakeUp(&mq->receivers);
+
+    InterruptRestore(eflags);
+    return n;
+}
+
+/**
+ * MsgQueueReceive - 接收一条消息
+ * @mq: 消息队列
+ * @buf: 缓冲区
+ * @len: 缓冲区的大小
+ * @prio: 保存消息的优先级，可以为NULL
+ * @flags: 操作的标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待，返回时保存剩余的ticks数
+ *
+ * 成功返回消息的字节数，失败返回-1
+ */
+PUBLIC int MsgQueueReceive(struct MsgQueue *mq, void *buf, unsigned int len,
+        unsigned int *prio, int flags, unsigned long *ticks)
+{
+    struct MsgBuffer msg;
+
+    msg.buf = buf;
+    msg.len = len;
+    if (MsgQueueReceiveMany(mq, &msg, 1, flags, ticks) != 1)
+        return -1;
+
+    if (prio != NULL)
+        *prio = msg.prio;
+    return msg.len;
+}
+
+/* 具名的消息队列 */
+struct MqObject {
+    char name[MQ_NAME_LEN];         /* 名字 */
+    int links;                      /* 引用数：名字和正在使用队列的系统调用 */
+    char unlinked;                  /* 名字已经删除 */
+    struct MsgQueue queue;
+};
+
+PRIVATE struct MqObject mqTable[MQ_MAX_NR];
+
+/**
+ * MqFind - 通过名字查找消息队列
+ * @name: 名字
+ */
+PRIVATE struct MqObject *MqFind(const char *name)
+{
+    struct MqObject *mq;
+
+    for (mq = mqTable; mq < mqTable + MQ_MAX_NR; mq++) {
+        if (mq->links > 0 && !mq->unlinked && !strcmp(mq->name, name))
+            return mq;
+    }
+    return NULL;
+}
+
+/**
+ * MqGet - 通过id获取消息队列并增加引用
+ * @mqd: 队列的id
+ *
+ * 系统调用睡眠的时候队列不会被释放，失败返回NULL
+ */
+PRIVATE struct MqObject *MqGet(int mqd)
+{
+    struct MqObject *mq;
+
+    if (mqd < 0 || mqd >= MQ_MAX_NR)
+        return NULL;
+
+    unsigned long flags = InterruptSave();
+
+    mq = &mqTable[mqd];
+    if (mq->links <= 0 || mq->unlinked) {
+        InterruptRestore(flags);
+        return NULL;
+    }
+    mq->links++;
+
+    InterruptRestore(flags);
+    return mq;
+}
+
+/**
+ * MqPut - 减少消息队列的引用
+ * @mq: 消息队列
+ *
+ * 最后一个引用释放队列的槽
+ */
+PRIVATE void MqPut(struct MqObject *mq)
+{
+    unsigned long flags = InterruptSave();
+
+    if (--mq->links > 0) {
+        InterruptRestore(flags);
+        return;
+    }
+    MsgQueueDestroy(&mq->queue);
+    mq->name[0] = '\0';
+
+    InterruptRestore(flags);
+}
+
+/**
+ * MqTimeout - 把毫秒转换成等待的ticks数
+ * @msecs: 毫秒，小于0表示一直等待，0表示不等待
+ * @ticks: 保存ticks数
+ * @flags: 不等待时添加MQ_NONBLOCK
+ *
+ * 返回传给队列操作的ticks指针
+ */
+PRIVATE unsigned long *MqTimeout(int msecs, unsigned long *ticks, int *flags)
+{
+    if (msecs < 0)
+        return NULL;
+    if (!msecs) {
+        *flags |= MQ_NONBLOCK;
+        return NULL;
+    }
+    *ticks = DIV_ROUND_UP((unsigned long)msecs * HZ, 1000);
+    return ticks;
+}
+
+/**
+ * SysMqOpen - 打开或者创建消息队列
+ * @name: 名字
+ * @flags: 打开的标志
+ * @maxMsgs: 创建时槽的数量
+ * @msgSize: 创建时每条消息的最大字节数
+ *
+ * 成功返回队列的id，失败返回-1
+ */
+PUBLIC int SysMqOpen(const char *name, int flags, unsigned int maxMsgs, unsigned int msgSize)
+{
+    struct MqObject *mq;
+
+    if (name == NULL || !name[0] || strlen(name) >= MQ_NAME_LEN)
+        return -1;
+
+    mq = MqFind(name);
+    if (mq != NULL) {
+        if ((flags & MQ_CREAT) && (flags & MQ_EXCL))
+            return -1;
+        return mq - mqTable;
+    }
+
+    if (!(flags & MQ_CREAT))
+        return -1;
+
+    for (mq = mqTable; mq < mqTable + MQ_MAX_NR; mq++) {
+        if (mq->links == 0)
+            break;
+    }
+    if (mq >= mqTable + MQ_MAX_NR) {
+        printk(PART_ERROR "SysMqOpen: no free message queue!\n");
+        return -1;
+    }
+
+    if (MsgQueueInit(&mq->queue, maxMsgs, msgSize))
+        return -1;
+
+    memset(mq->name, 0, MQ_NAME_LEN);
+    strcpy(mq->name, name);
+    mq->unlinked = 0;
+    /* 名字的引用 */
+    mq->links = 1;
+    return mq - mqTable;
+}
+
+/**
+ * SysMqUnlink - 删除消息队列
+ * @name: 名字
+ *
+ * 没有进程描述符记录打开的队列，删除名字的同时关闭队列，唤醒所有等待者。
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SysMqUnlink(const char *name)
+{
+    struct MqObject *mq;
+
+    if (name == NULL)
+        return -1;
+
+    mq = MqFind(name);
+    if (mq == NULL)
+        return -1;
+
+    mq->unlinked = 1;
+    MsgQueueClose(&mq->queue);
+    MqPut(mq);
+    return 0;
+}
+
+/**
+ * MqUserRange - 检查用户传入的地址范围
+ * @addr: 起始地址
+ * @len: 长度
+ *
+ * 地址不能为NULL，整个范围必须在用户空间内，不能回绕
+ * 合法返回0，否则返回-1
+ */
+PRIVATE int MqUserRange(const void *addr, unsigned long len)
+{
+    unsigned long start = (unsigned long)addr;
+
+    if (addr == NULL || start >= USER_VM_SIZE)
+        return -1;
+    if (len > USER_VM_SIZE - start)
+        return -1;
+    return 0;
+}
+
+/**
+ * SysMqSend - 发送一条消息
+ * @mqd: 队列的id
+ * @msg: 消息
+ * @msecs: 最多等待的毫秒数，小于0表示一直等待，0表示不等待
+ *
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SysMqSend(int mqd, struct MsgBuffer *msg, int msecs)
+{
+    struct MqObject *mq;
+    struct MsgBuffer kmsg;
+    unsigned long ticks, *timeout;
+    int flags = 0, retval;
+
+    /* 先复制一份再检查，避免检查后被用户修改 */
+    if (MqUserRange(msg, sizeof(struct MsgBuffer)))
+        return -1;
+    kmsg = *msg;
+    if (MqUserRange(kmsg.buf, kmsg.len))
+        return -1;
+
+    mq = MqGet(mqd);
+    if (mq == NULL)
+        return -1;
+
+    timeout = MqTimeout(msecs, &ticks, &flags);
+    retval = MsgQueueSend(&mq->queue, kmsg.buf, kmsg.len, kmsg.prio, flags, timeout);
+
+    MqPut(mq);
+    return retval;
+}
+
+/**
+ * SysMqReceive - 接收一条或者多条消息
+ * @mqd: 队列的id
+ * @msgs: 每条消息的缓冲区
+ * @count: 最多接收的消息数
+ * @msecs: 最多等待的毫秒数，小于0表示一直等待，0表示不等待
+ *
+ * 返回接收的消息数，失败返回-1
+ */
+PUBLIC int SysMqReceive(int mqd, struct MsgBuffer *msgs, int count, int msecs)
+{
+    struct MqObject *mq;
+    struct MsgBuffer kmsgs[MQ_RECV_BATCH];
+    unsigned long ticks, *timeout;
+    int flags = 0, retval, i;
+
+    /* 最多只会使用前MQ_RECV_BATCH个缓冲区 */
+    if (count <= 0)
+        return -1;
+    count = MIN(count, MQ_RECV_BATCH);
+
+    /* 先复制一份再检查，避免检查后被用户修改 */
+    if (MqUserRange(msgs, count * sizeof(struct MsgBuffer)))
+        return -1;
+    memcpy(kmsgs, msgs, count * sizeof(struct MsgBuffer));
+    for (i = 0; i < count; i++) {
+        if (MqUserRange(kmsgs[i].buf, kmsgs[i].len))
+            return -1;
+    }
+
+    mq = MqGet(mqd);
+    if (mq == NULL)
+        return -1;
+
+    timeout = MqTimeout(msecs, &ticks, &flags);
+    retval = MsgQueueReceiveMany(&mq->queue, kmsgs, count, flags, timeout);
+
+    MqPut(mq);
+
+    /* 返回每条消息的大小和优先级 */
+    if (retval > 0)
+        memcpy(msgs, kmsgs, retval * sizeof(struct MsgBuffer));
+    return retval;
+}
@@ -0,0 +1,225 @@
+/*
+ * file:		kernel/ipc/shm.c
+ * auther:	    Jason Hu
+ * time:		2020/3/16
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/shm.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/memcache.h>
+#include <book/task.h>
+#include <book/vmspace.h>
+#include <lib/string.h>
+
+PRIVATE struct ShmObject shmTable[SHM_MAX_NR];
+
+/**
+ * ShmFind - 通过名字查找共享内存对象
+ * @name: 名字
+ *
+ * 已经删除名字的对象找不到，返回对象，没找到返回NULL
+ */
+PRIVATE struct ShmObject *ShmFind(const char *name)
+{
+    struct ShmObject *shm;
+
+    for (shm = shmTable; shm < shmTable + SHM_MAX_NR; shm++) {
+        if (shm->links > 0 && !shm->unlinked && !strcmp(shm->name, name))
+            return shm;
+    }
+    return NULL;
+}
+
+/**
+ * ShmCreate - 创建共享内存对象
+ * @name: 名字
+ * @size: 大小
+ *
+ * 只分配页地址表，物理页在访问的时候才分配。成功返回对象，失败返回NULL
+ */
+PRIVATE struct ShmObject *ShmCreate(const char *name, unsigned int size)
+{
+    struct ShmObject *shm;
+
+    for (shm = shmTable; shm < shmTable + SHM_MAX_NR; shm++) {
+        if (shm->links == 0)
+            break;
+    }
+    if (shm >= shmTable + SHM_MAX_NR) {
+        printk(PART_ERROR "ShmCreate: no free shm object!\n");
+        return NULL;
+    }
+
+    shm->size = PAGE_ALIGN(size);
+    shm->pageCount = shm->size / PAGE_SIZE;
+    shm->pages = kmalloc(shm->pageCount * sizeof(unsigned int), GFP_KERNEL);
+    if (shm->pages == NULL) {
+        printk(PART_ERROR "ShmCreate: kmalloc page table failed!\n");
+        return NULL;
+    }
+    memset(shm->pages, 0, shm->pageCount * sizeof(unsigned int));
+
+    memset(shm->name, 0, SHM_NAME_LEN);
+    strcpy(shm->name, name);
+    shm->unlinked = 0;
+    /* 名字的引用 */
+    shm->links = 1;
+    return shm;
+}
+
+/**
+ * ShmGet - 增加共享内存对象的引用
+ * @shm: 对象
+ */
+PUBLIC void ShmGet(struct ShmObject *shm)
+{
+    unsigned long flags = InterruptSave();
+    shm->links++;
+    InterruptRestore(flags);
+}
+
+/**
+ * ShmPut - 减少共享内存对象的引用
+ * @shm: 对象
+ *
+ * 最后一个引用释放对象持有的物理页，映射过的页在进程取消映射时已经减少了引用，
+ * 这里减少后就会还给伙伴系统
+ */
+PUBLIC void ShmPut(struct ShmObject *shm)
+{
+    unsigned int i;
+    unsigned long flags = InterruptSave();
+
+    if (--shm->links > 0) {
+        InterruptRestore(flags);
+        return;
+    }
+
+    for (i = 0; i < shm->pageCount; i++) {
+        if (shm->pages[i])
+            FreePages(shm->pages[i]);
+    }
+    kfree(shm->pages);
+    shm->pages = NULL;
+    shm->name[0] = '\0';
+
+    InterruptRestore(flags);
+}
+
+/**
+ * ShmSharePage - 共享对象的一个物理页
+ * @shm: 对象
+ * @index: 页在对象中的索引
+ *
+ * 页还没有分配就分配并清零，然后增加一个引用给调用者链接到页表。
+ * 成功返回物理地址，失败返回0
+ */
+PUBLIC unsigned int ShmSharePage(struct ShmObject *shm, unsigned int index)
+{
+    unsigned int page;
+
+    if (index >= shm->pageCount)
+        return 0;
+
+    unsigned long flags = InterruptSave();
+
+    page = shm->pages[index];
+    if (!page) {
+        page = AllocPage();
+        if (!page) {
+            InterruptRestore(flags);
+            return 0;
+        }
+        memset(Phy2Vir(page), 0, PAGE_SIZE);
+        shm->pages[index] = page;
+    }
+
+    if (SharePages(page)) {
+        InterruptRestore(flags);
+        return 0;
+    }
+
+    InterruptRestore(flags);
+    return page;
+}
+
+/**
+ * SysShmOpen - 打开或者创建共享内存对象
+ * @name: 名字
+ * @size: 创建时的大小，打开已有的对象时不能超过对象的大小
+ * @flags: 打开的标志
+ *
+ * 成功返回对象的id，失败返回-1
+ */
+PUBLIC int SysShmOpen(const char *name, unsigned int size, int flags)
+{
+    struct ShmObject *shm;
+
+    if (name == NULL || !name[0] || strlen(name) >= SHM_NAME_LEN)
+        return -1;
+
+    shm = ShmFind(name);
+    if (shm != NULL) {
+        if ((flags & SHM_CREAT) && (flags & SHM_EXCL))
+            return -1;
+        if (size > shm->size)
+            return -1;
+        return shm - shmTable;
+    }
+
+    if (!(flags & SHM_CREAT) || !size || size > SHM_MAX_SIZE)
+        return -1;
+
+    shm = ShmCreate(name, size);
+    if (shm == NULL)
+        return -1;
+    return shm - shmTable;
+}
+
+/**
+ * SysShmMap - 把共享内存对象映射到当前进程
+ * @shmid: 对象的id
+ * @addr: 地址，有MAP_FIXED时才使用
+ * @prot: 页保护
+ * @flags: 映射的标志
+ *
+ * 映射整个对象，用munmap取消映射。成功返回地址，失败返回-1
+ */
+PUBLIC void *SysShmMap(int shmid, uint32_t addr, uint32_t prot, uint32_t flags)
+{
+    struct ShmObject *shm;
+
+    if (shmid < 0 || shmid >= SHM_MAX_NR)
+        return (void *)-1;
+
+    shm = &shmTable[shmid];
+    if (shm->links <= 0 || shm->unlinked)
+        return (void *)-1;
+
+    return (void *)DoMmap(CurrentTask()->mm, addr, shm->size, prot, flags, shm);
+}
+
+/**
+ * SysShmUnlink - 删除共享内存对象的名字
+ * @name: 名字
+ *
+ * 已经映射的进程还可以继续使用，最后一个映射取消后才释放。
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SysShmUnlink(const char *name)
+{
+    struct ShmObject *shm;
+
+    if (name == NULL)
+        return -1;
+
+    shm = ShmFind(name);
+    if (shm == NULL)
+        return -1;
+
+    shm->unlinked = 1;
+    ShmPut(shm);
+    return 0;
+}
@@ -120,7 +120,7 @@ PRIVATE int IgnoreSignal(int signo, struct Task *task)
         return 0;
     }
         
-    unsigned long handler = (unsigned long)task->signals.action[signo - 1].handler;
+    unsigned long handler = (unsigned long)task->signals->action[signo - 1].handler;
     
     /* 处理函数是用户自定义，不会被忽略掉 */
     if (handler > 1)
@@ -168,7 +168,7 @@ PRIVATE int DeliverSignal(int signo, pid_t sender, struct Task *task)
     printk("deliver signal %d from %d to %d\n", signo, task->pid, sender);
 #endif
     /* 填写信号信息 */
-    task->signals.sender[signo - 1] = sender;
+    task->signals->sender[signo - 1] = sender;
 
     /* 设置对应的信号 */
     sigaddset(&task->signalPending, signo);
@@ -257,7 +257,7 @@ PRIVATE void BuildSignalFrame(int signo, SignalAction_t *sa, struct TrapFrame *f
 PRIVATE int HandleSignal(struct TrapFrame *frame, int signo)
 {
     /* 获取信号行为 */
-    SignalAction_t *sa = &CurrentTask()->signals.action[signo - 1];
+    SignalAction_t *sa = &CurrentTask()->signals->action[signo - 1];
 
     /* 处理自定义函数 */
     //printk("handle user function!\n");
@@ -339,18 +339,18 @@ PUBLIC int DoSignal(struct TrapFrame *frame)
         if (cur->signalPending & (1 << sig) && !(cur->signalBlocked & (1 << sig))) {
             #ifdef _DEBUG_SIGNAL
             printk("task %d received signal %d from task %d.\n",
-                cur->pid, sig, cur->signals.sender[sig - 1]);
+                cur->pid, sig, cur->signals->sender[sig - 1]);
             #endif
             
             /* 已经获取这个信号了，删除它 */
             sigdelset(&cur->signalPending, sig);
 
             /* 删除发送者 */
-            cur->signals.sender[sig - 1] = -1;
+            cur->signals->sender[sig - 1] = -1;
             CalcSignalLeft(cur);
 
             /* 指向信号对应的信号行为 */
-            sa = &cur->signals.action[sig - 1];  
+            sa = &cur->signals->action[sig - 1];  
 
             /* 如果是忽略处理，那么就会把忽略掉 */
             if (sa->handler == SIG_IGN) {
@@ -455,10 +455,13 @@ PUBLIC int DoSendSignal(pid_t pid, int signal, pid_t sender)
     if (IS_BAD_SIGNAL(signal)) {
         return -1;
     }
+    /* 任务可能同时退出并被回收，查找和使用都要在读临界区中 */
+    RcuReadLock();
     Task_t *task = FindTaskByPid(pid);
     
     /* 没找到要发送的进程，返回失败 */
     if (task == NULL) {
+        RcuReadUnlock();
         return -1;
     }
     int ret = 0;
@@ -496,6 +499,7 @@ ToOut:
         
         CalcSignalLeft(task);
     }
+    RcuReadUnlock();
     
     return ret;
 }
@@ -532,9 +536,11 @@ PRIVATE int DoSendSignalGroup(pid_t gpid, int signal, pid_t sender)
  */
 PUBLIC int ForceSignal(int signo, pid_t pid)
 {
+    RcuReadLock();
     Task_t *task = FindTaskByPid(pid);
     /* 没找到要发送的进程，返回失败 */
     if (task == NULL) {
+        RcuReadUnlock();
         return -1;
     }
 
@@ -545,8 +551,8 @@ PUBLIC int ForceSignal(int signo, pid_t pid)
     1.如果该信号的处理方法是忽略，那么就要变成默认处理方法，才会被处理
     2.由于要强制发送信号，那么该信号是不能被屏蔽的，于是要清除屏蔽
      */
-    if (task->signals.action[signo - 1].handler == SIG_IGN)
-        task->signals.action[signo - 1].handler = SIG_DFL;
+    if (task->signals->action[signo - 1].handler == SIG_IGN)
+        task->signals->action[signo - 1].handler = SIG_DFL;
 
     sigdelset(&task->signalBlocked, signo); /* 清除屏蔽阻塞 */ 
 
@@ -554,9 +560,10 @@ PUBLIC int ForceSignal(int signo, pid_t pid)
     CalcSignalLeft(task);
     
     SpinUnlockIrqSave(&task->signalMaskLock, flags);
+    RcuReadUnlock();
 
     /* 正式发送信号过去 */
-    return DoSendSignal(task->pid, signo, CurrentTask()->pid);
+    return DoSendSignal(pid, signo, CurrentTask()->pid);
 }
 
 /**
@@ -632,11 +639,11 @@ PUBLIC int SysSignal(int signal, sighandler_t handler)
     struct Task *cur = CurrentTask();
 
     /* 当需要修改信号行为的时候，就需要上锁 */
-    SpinLock(&cur->signals.signalLock);
+    SpinLock(&cur->signals->signalLock);
     
     if (handler) {
         /* 设置信号行为 */
-        SetSignalAction(&cur->signals, signal, &sa);
+        SetSignalAction(cur->signals, signal, &sa);
 
         /* 如果处理函数是忽略，或者是默认并且信号是SIGCONT,SIGCHLD,SIGWINCH，
         按照POSIX标准，需要把已经到达的信号丢弃 */
@@ -655,7 +662,7 @@ PUBLIC int SysSignal(int signal, sighandler_t handler)
         }
     }
 
-    SpinUnlock(&cur->signals.signalLock);
+    SpinUnlock(&cur->signals->signalLock);
     return 0;
 }
 
@@ -681,11 +688,11 @@ PUBLIC int SysSignalAction(int signal, struct sigaction *act, struct sigaction *
     SignalAction_t sa;
 
     /* 当需要修改信号行为的时候，就需要上锁 */
-    SpinLock(&cur->signals.signalLock);
+    SpinLock(&cur->signals->signalLock);
     
     /* 备份旧的行为 */
     if (oldact) {
-        GetSignalAction(&cur->signals, signal, &sa);
+        GetSignalAction(cur->signals, signal, &sa);
         /* 复制数据 */
         oldact->sa_flags = sa.flags;
         oldact->sa_handler = sa.handler;
@@ -699,7 +706,7 @@ PUBLIC int SysSignalAction(int signal, struct sigaction *act, struct sigaction *
 
         //printk("new act handler %x\n", act->sa_handler);
         /* 设置信号行为 */
-        SetSignalAction(&cur->signals, signal, &sa);
+        SetSignalAction(cur->signals, signal, &sa);
 
         /* 如果处理函数是忽略，或者是默认并且信号是SIGCONT,SIGCHLD,SIGWINCH，
         按照POSIX标准，需要把已经到达的信号丢弃 */
@@ -718,7 +725,7 @@ PUBLIC int SysSignalAction(int signal, struct sigaction *act, struct sigaction *
         }
     }
 
-    SpinUnlock(&cur->signals.signalLock);
+    SpinUnlock(&cur->signals->signalLock);
     return 0;
 }
 
@@ -827,7 +834,7 @@ PUBLIC int SysSignalPause()
     /* 阻塞，直到有信号唤醒 */
     TaskBlock(TASK_BLOCKED);
 
-    //printk("blocked %x wake up. %x", cur->signalBlocked, cur->signals.action[SIGINT-1].handler);
+    //printk("blocked %x wake up. %x", cur->signalBlocked, cur->signals->action[SIGINT-1].handler);
     
     /* 唤醒后还要查看是否信号已经被捕捉，已经被捕捉就是1，没有就是0 */
     return cur->signalCatched;
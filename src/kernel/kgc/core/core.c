@@ -30,6 +30,7 @@
 #include <kgc/handler.h>
 #include <kgc/font/font.h>
 #include <kgc/container/container.h>
+#include <kgc/window/message.h>
 
 #include <clock/clock.h>
 
@@ -266,13 +266,11 @@ PUBLIC void WindowButtonCloseHandler(KGC_Button_t *button)
     
     /* 给当前窗口发送关闭窗口消息 */
     if (GET_CURRENT_WINDOW() == window) {       
-        KGC_MessageNode_t *node = KGC_CreateMessageNode();
-        if (node) {
-            /* 发出退出事件 */
-            node->message.type = KGC_MSG_QUIT;
-            KGC_AddMessageNode(node, window);
-            //printk("send close to %s\n", GET_CURRENT_WINDOW()->title);
-        }
+        KGC_Message_t msg;
+        /* 发出退出事件 */
+        msg.type = KGC_MSG_QUIT;
+        KGC_PostMessage(window, &msg);
+        //printk("send close to %s\n", GET_CURRENT_WINDOW()->title);
     }
 }
 
@@ -24,12 +24,10 @@ EXTERN KGC_WindowMovement_t windowMovement;
 PUBLIC void KGC_WindowDoTimer(int ticks)
 {
     /*if (GET_CURRENT_WINDOW()) {           
-        KGC_MessageNode_t *node = KGC_CreateMessageNode();
-        if (node) {
-            node->message.type = KGC_MSG_TIMER;
-            node->message.timer.ticks = ticks;
-            KGC_AddMessageNode(node, GET_CURRENT_WINDOW());
-        }
+        KGC_Message_t msg;
+        msg.type = KGC_MSG_TIMER;
+        msg.timer.ticks = ticks;
+        KGC_PostMessage(GET_CURRENT_WINDOW(), &msg);
     }*/
 }
 
@@ -88,15 +86,12 @@ PUBLIC void KGC_WindowMouseDown(int button, int mx, int my)
                 }
             } else {
                 /* 只要鼠标在窗口范围内，就发送鼠标消息 */
-                KGC_MessageNode_t *node = KGC_CreateMessageNode();
-                if (node) {
-                    node->message.type = KGC_MSG_MOUSE_BUTTON_DOWN;
-                    node->message.mouse.button = button;
-                    node->message.mouse.x = localX + window->x;
-                    node->message.mouse.y = localX + window->y;
-                    /* 上锁保护信息链表 */
-                    KGC_AddMessageNode(node, window);
-                }
+                KGC_Message_t msg;
+                msg.type = KGC_MSG_MOUSE_BUTTON_DOWN;
+                msg.mouse.button = button;
+                msg.mouse.x = localX + window->x;
+                msg.mouse.y = localX + window->y;
+                KGC_PostMessage(window, &msg);
                 /* 如果不是当前窗口，才进行选择，如果已经是了，就不进行选择了 */
                 if (GET_CURRENT_WINDOW() != window) {
                     /* 只是选择一个窗口 */
@@ -146,14 +141,12 @@ PUBLIC void KGC_WindowMouseUp(int button, int mx, int my)
             mx < container->x + container->width &&
             my < container->y + container->height) {
             /* 在窗口里面就发送消息给窗口 */
-            KGC_MessageNode_t *node = KGC_CreateMessageNode();
-            if (node) {
-                node->message.type = KGC_MSG_MOUSE_BUTTON_UP;
-                node->message.mouse.button = button;
-                node->message.mouse.x = localX + window->x;
-                node->message.mouse.y = localX + window->y;
-                KGC_AddMessageNode(node, window);
-            }
+            KGC_Message_t msg;
+            msg.type = KGC_MSG_MOUSE_BUTTON_UP;
+            msg.mouse.button = button;
+            msg.mouse.x = localX + window->x;
+            msg.mouse.y = localX + window->y;
+            KGC_PostMessage(window, &msg);
             break;
         }
         
@@ -185,13 +178,11 @@ PUBLIC void KGC_WindowMouseMotion(int mx, int my)
             mx < container->x + container->width &&
             my < container->y + container->height) {
             
-            KGC_MessageNode_t *node = KGC_CreateMessageNode();
-            if (node) {
-                node->message.type = KGC_MSG_MOUSE_MOTION;
-                node->message.mouse.x = localX + window->x;
-                node->message.mouse.y = localX + window->y;
-                KGC_AddMessageNode(node, window);
-            }
+            KGC_Message_t msg;
+            msg.type = KGC_MSG_MOUSE_MOTION;
+            msg.mouse.x = localX + window->x;
+            msg.mouse.y = localX + window->y;
+            KGC_PostMessage(window, &msg);
             break;
         }
     }
@@ -208,14 +199,12 @@ PUBLIC int KGC_WindowKeyDown(KGC_KeyboardEven_t *even)
     /* 往窗口的事件队列发送一个按键信息 */
     //printk("keycode:%c mod:%x\n", even->keycode.code, even->keycode.modify);
     if (GET_CURRENT_WINDOW()) {       
-        KGC_MessageNode_t *node = KGC_CreateMessageNode();
-        if (node) {
-            node->message.type = KGC_MSG_KEY_DOWN;
-            node->message.key.code = even->keycode.code;
-            node->message.key.modify = even->keycode.modify;
-            
-            KGC_AddMessageNode(node, GET_CURRENT_WINDOW());
-        }
+        KGC_Message_t msg;
+        msg.type = KGC_MSG_KEY_DOWN;
+        msg.key.code = even->keycode.code;
+        msg.key.modify = even->keycode.modify;
+        
+        KGC_PostMessage(GET_CURRENT_WINDOW(), &msg);
         
     }
     return 0;
@@ -226,13 +215,11 @@ PUBLIC int KGC_WindowKeyUp(KGC_KeyboardEven_t *even)
     //printk("window key up\n");
     //printk("keycode:%c mod:%x\n", even->keycode.code, even->keycode.modify);
     if (GET_CURRENT_WINDOW()) {           
-        KGC_MessageNode_t *node = KGC_CreateMessageNode();
-        if (node) {
-            node->message.type = KGC_MSG_KEY_UP;
-            node->message.key.code = even->keycode.code;
-            node->message.key.modify = even->keycode.modify;
-            KGC_AddMessageNode(node, GET_CURRENT_WINDOW());
-        }
+        KGC_Message_t msg;
+        msg.type = KGC_MSG_KEY_UP;
+        msg.key.code = even->keycode.code;
+        msg.key.modify = even->keycode.modify;
+        KGC_PostMessage(GET_CURRENT_WINDOW(), &msg);
     }
     return 0;
 }
@@ -11,78 +11,90 @@
 #include <book/debug.h>
 #include <book/kgc.h>
 #include <book/task.h>
+#include <book/schedule.h>
+#include <book/msgqueue.h>
 #include <video/video.h>
 #include <kgc/input/mouse.h>
 #include <kgc/window/message.h>
 #include <kgc/window/window.h>
 
-PUBLIC KGC_MessageNode_t *KGC_CreateMessageNode()
-{
-    KGC_MessageNode_t *node = kmalloc(sizeof(KGC_MessageNode_t), GFP_KERNEL);
-    return node;
-}
-
-PUBLIC void KGC_FreeMessageList(KGC_Window_t *window)
+/**
+ * KGC_MessagePriority - 消息在窗口消息队列中的优先级
+ * @type: 消息类型
+ */
+PRIVATE int KGC_MessagePriority(KGC_MsgType_t type)
 {
-    KGC_MessageNode_t *node, *next;
-    /* 释放消息队列 */
-    ListForEachOwnerSafe (node, next, &window->messageListHead, list) {
-        /* 从链表中删除 */
-        ListDel(&node->list);
-        /* 释放消息节点 */
-        kfree(node);
+    switch (type) {
+    case KGC_MSG_MOUSE_MOTION:
+        return KGC_MSG_PRIO_MOTION;
+    case KGC_MSG_QUIT:
+        return KGC_MSG_PRIO_QUIT;
+    default:
+        break;
     }
+    return KGC_MSG_PRIO_INPUT;
 }
 
-PUBLIC void KGC_AddMessageNode(KGC_MessageNode_t *node, KGC_Window_t *window)
+/**
+ * KGC_PostMessage - 往窗口的消息队列放入一个消息
+ * @window: 窗口
+ * @message: 消息
+ * 
+ * 在输入事件中调用，不能睡眠，队列满了就丢掉消息
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int KGC_PostMessage(KGC_Window_t *window, KGC_Message_t *message)
 {
-    SpinLock(&window->messageLock);
-    /* 如果消息数量超过最大数量，那么就删除掉队列中的第一个消息 */
-    ListAddTail(&node->list, &window->messageListHead);
-    SpinUnlock(&window->messageLock);
+    return MsgQueueSend(window->msgQueue, message, sizeof(KGC_Message_t),
+        KGC_MessagePriority(message->type), MQ_NONBLOCK, NULL);
 }
 
 /**
- * KGC_RecvMessage - 获取一个消息
+ * KGC_ReceiveMessage - 从当前任务的窗口获取一个消息
  * @message: 消息
+ * @flags: 消息队列操作的标志
  * 
  * 成功返回0，失败返回-1
  */
-PUBLIC int KGC_RecvMessage(KGC_Message_t *message)
+PRIVATE int KGC_ReceiveMessage(KGC_Message_t *message, int flags)
 {
-    /* 从窗口的消息队列种获取一个消息 */
-    
-    /* 获取指针并检测 */
     Task_t *cur = CurrentTask();
-    if (!cur->window) 
-        return -1;
     KGC_Window_t *window = cur->window;
     if (!window)
         return -1;
 
-    SpinLock(&window->messageLock);
-    
-    /* 没有消息 */
-    if (ListEmpty(&window->messageListHead)) {
-        SpinUnlock(&window->messageLock);
+    if (MsgQueueReceive(window->msgQueue, message, sizeof(KGC_Message_t),
+            NULL, flags, NULL) < 0)
         return -1;
-    }
-    //printk("[receive]");
-    
-    /* 获取一个消息 */
-    KGC_MessageNode_t *node = ListOwner(window->messageListHead.next, KGC_MessageNode_t, list);
-    /* 从链表删除 */
-    ListDel(&node->list);
-    
-    SpinUnlock(&window->messageLock);
-        
-    *message = node->message;
 
-    kfree(node);
-    //printk("[receive]");
+    /* 收到消息的是交互任务，提升优先级让它尽快响应 */
+    ScheduleBoost(cur);
     return 0;
 }
 
+/**
+ * KGC_RecvMessage - 获取一个消息
+ * @message: 消息
+ * 
+ * 没有消息就返回，成功返回0，失败返回-1
+ */
+PUBLIC int KGC_RecvMessage(KGC_Message_t *message)
+{
+    return KGC_ReceiveMessage(message, MQ_NONBLOCK);
+}
+
+/**
+ * KGC_WaitMessage - 等待一个消息
+ * @message: 消息
+ * 
+ * 没有消息就在窗口的消息队列上睡眠，直到有消息或者收到信号
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int KGC_WaitMessage(KGC_Message_t *message)
+{
+    return KGC_ReceiveMessage(message, 0);
+}
+
 /**
  * KGC_SetMessage - 放置一个消息
  * @message: 消息
@@ -129,6 +141,8 @@ PUBLIC int SysKGC_Message(int operate, KGC_Message_t *message)
         return KGC_SendMessage(message);
     } else if (operate == KGC_MSG_RECV) {
         return KGC_RecvMessage(message);
+    } else if (operate == KGC_MSG_WAIT) {
+        return KGC_WaitMessage(message);
     }
     return -1;
 }
@@ -11,6 +11,7 @@
 #include <book/debug.h>
 #include <book/kgc.h>
 #include <book/task.h>
+#include <book/msgqueue.h>
 #include <video/video.h>
 #include <lib/string.h>
 #include <kgc/draw.h>
@@ -83,15 +84,16 @@ PUBLIC KGC_Window_t *KGC_WindowCreate(
     
     window->container = NULL;
 
+    /* 消息队列 */
+    window->msgQueue = CreateMsgQueue(KGC_MESSAGE_QUEUE_LEN, sizeof(KGC_Message_t));
+    if (window->msgQueue == NULL) {
+        kfree(window);
+        return NULL;
+    }
+
     /* 绑定任务，创建者 */
     window->task = CurrentTask();
     CurrentTask()->window = window;
-    
-    /* 消息队列 */
-    INIT_LIST_HEAD(&window->messageListHead);
-
-    /* 消息锁 */
-    SpinLockInit(&window->messageLock);
 
     return window;
 }
@@ -217,7 +219,7 @@ PUBLIC int KGC_WindowDestroy(KGC_Window_t *window)
         return -1;
 
     /* 释放消息队列 */
-    KGC_FreeMessageList(window);
+    FreeMsgQueue(window->msgQueue);
     
     /* 释放窗口对象 */
     kfree(window);
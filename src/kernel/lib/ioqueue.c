@@ -8,7 +8,9 @@
 #include <book/ioqueue.h>
 #include <book/mmu.h>
 #include <book/debug.h>
+#include <book/schedule.h>
 #include <lib/string.h>
+#include <lib/math.h>
 
 /**
  * CreateIoQueue - 动态创建一个io队列
@@ -47,144 +49,408 @@ PUBLIC int IoQueueInit(struct IoQueue *ioQueue,
 	
 	/* 现在还没有数据，所以是0 */
 	ioQueue->size = 0;
+	ioQueue->putHeld = ioQueue->getHeld = 0;
+	ioQueue->putCopying = ioQueue->getCopying = 0;
 	
-	/* 还没有生产者和消费者 */
-	ioQueue->producer = ioQueue->consumer = NULL;
+	/* 还没有等待的生产者和消费者 */
+	WaitQueueInit(&ioQueue->producers, NULL);
+	WaitQueueInit(&ioQueue->consumers, NULL);
+
+	/* 默认只等待空位置或者数据 */
+	ioQueue->interrupted = NULL;
 	return 0;
 }
 
+/**
+ * IoQueueInterrupted - 使用者是否要求停止等待
+ * @ioQueue: io队列
+ */
+PRIVATE INLINE int IoQueueInterrupted(struct IoQueue *ioQueue)
+{
+	return ioQueue->interrupted != NULL && ioQueue->interrupted(ioQueue);
+}
+
+
+/**
+ * IoQueueWakeUpConsumer - 唤醒一个等待数据的消费者
+ * @ioQueue: io队列
+ */
+PRIVATE void IoQueueWakeUpConsumer(struct IoQueue *ioQueue)
+{
+	struct WaitQueue *waiter;
+
+	unsigned long flags = InterruptSave();
+
+	if (WaitQueueActive(&ioQueue->consumers)) {
+		waiter = ListFirstOwner(&ioQueue->consumers.waitList, struct WaitQueue, waitList);
+
+		/* 等待输入的任务是交互任务，提升优先级让它尽快响应 */
+		if (waiter->task->status == TASK_BLOCKED)
+			ScheduleBoost(waiter->task);
+		WaitQueueWakeUp(&ioQueue->consumers);
+	}
+
+	InterruptRestore(flags);
+}
 
-PRIVATE void IoQueueWait(struct Task **waiter)
+/**
+ * IoQueueWakeUpProducer - 唤醒一个等待空位置的生产者
+ * @ioQueue: io队列
+ */
+PRIVATE INLINE void IoQueueWakeUpProducer(struct IoQueue *ioQueue)
 {
-	ASSERT(*waiter == NULL && waiter != NULL);
-	*waiter = CurrentTask();
-	TaskBlock(TASK_BLOCKED);
+	if (WaitQueueActive(&ioQueue->producers))
+		WaitQueueWakeUp(&ioQueue->producers);
 }
 
-PRIVATE void IoQueueWakeUp(struct Task **waiter)
+/**
+ * IoQueueAdvance - 计算缓冲区中前进后的位置
+ * @ioQueue: io队列
+ * @pos: 缓冲区中开始的位置
+ * @bytes: 字节数
+ * 
+ * 到达缓冲区末尾就从开头继续
+ */
+PRIVATE unsigned char *IoQueueAdvance(struct IoQueue *ioQueue,
+    unsigned char *pos, unsigned int bytes)
 {
-	ASSERT(*waiter != NULL);
-	TaskUnblock(*waiter);
-	*waiter = NULL;
+	unsigned int offset = pos - ioQueue->buf + bytes;
+
+	if (offset >= ioQueue->buflen)
+		offset -= ioQueue->buflen;
+	return ioQueue->buf + offset;
 }
 
 /**
- * IoQueuePut - 往io队列中放入一个数据
+ * IoQueueCopyTo - 把数据复制到缓冲区
  * @ioQueue: io队列
+ * @to: 缓冲区中开始的位置
  * @data: 数据
+ * @bytes: 字节数
+ * 
+ * 到达缓冲区末尾就从开头继续复制
  */
-PUBLIC void IoQueuePut(struct IoQueue *ioQueue, unsigned long data)
+PRIVATE void IoQueueCopyTo(struct IoQueue *ioQueue,
+    unsigned char *to, const unsigned char *data, unsigned int bytes)
 {
-	/*如果队列已经满了，就不能放入数据*/
-	while (IoQueueFull(ioQueue)) {
-		/* 获取锁 */
-		SyncLock(&ioQueue->lock);
+	unsigned char *end = ioQueue->buf + ioQueue->buflen;
+	unsigned int first = MIN(bytes, end - to);
 
-		/* 进入等待队列 */
-		IoQueueWait(&ioQueue->producer);
-		/* 释放锁 */
-		SyncUnlock(&ioQueue->lock);
-	}
-    unsigned char *p = (unsigned char *)&data;
-	switch (ioQueue->factor)
-    {
-    case IQ_FACTOR_8:
-        *ioQueue->head++ = *p++;
-        break;
-    case IQ_FACTOR_16:
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        break;
-    case IQ_FACTOR_32:
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        
-        break;
-    case IQ_FACTOR_64:
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        *ioQueue->head++ = *p++;
-        break;
-    default:
-        break;
-    }
-
-	ioQueue->size++;	//数据数量增加
-	//修复越界
-	if(ioQueue->head >= ioQueue->buf + ioQueue->buflen){
-		ioQueue->head = ioQueue->buf;
+	memcpy(to, data, first);
+	if (bytes > first)
+		memcpy(ioQueue->buf, data + first, bytes - first);
+}
+
+/**
+ * IoQueueCopyFrom - 从缓冲区复制数据
+ * @ioQueue: io队列
+ * @from: 缓冲区中开始的位置
+ * @data: 保存数据的地址
+ * @bytes: 字节数
+ * 
+ * 到达缓冲区末尾就从开头继续复制
+ */
+PRIVATE void IoQueueCopyFrom(struct IoQueue *ioQueue,
+    unsigned char *from, unsigned char *data, unsigned int bytes)
+{
+	unsigned char *end = ioQueue->buf + ioQueue->buflen;
+	unsigned int first = MIN(bytes, end - from);
+
+	memcpy(data, from, first);
+	if (bytes > first)
+		memcpy(data + first, ioQueue->buf, bytes - first);
+}
+
+/**
+ * IoQueueDoPut - 往io队列中放入多个单元
+ * @ioQueue: io队列
+ * @data: 数据
+ * @count: 单元数
+ * @flags: 标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待
+ * 
+ * 不带IQ_NONBLOCK时会放完所有数据，有空位置就放入一批，然后唤醒一次消费者
+ * 返回放入的单元数，一个都没有放入返回-1
+ */
+PRIVATE int IoQueueDoPut(struct IoQueue *ioQueue, const void *data,
+    unsigned int count, int flags, unsigned long *ticks)
+{
+	const unsigned char *p = (const unsigned char *)data;
+	unsigned int done = 0, need, len;
+	unsigned char *to;
+	unsigned long eflags;
+	int published;
+
+	if (!count)
+		return 0;
+
+	need = 1;
+	if (flags & IQ_ALL) {
+		/* 永远也放不下 */
+		if (count > IO_QUEUE_CAPACITY(ioQueue))
+			return -1;
+		need = count;
 	}
 
-	/* 唤醒消费者*/
-	if(ioQueue->consumer != NULL){
-		IoQueueWakeUp(&ioQueue->consumer);
+	while (done < count) {
+		/* 中断里面也会放入数据，预留空间时要关闭中断 */
+		eflags = InterruptSave();
+		if (IO_QUEUE_FREE(ioQueue) < need) {
+			InterruptRestore(eflags);
+			if (flags & IQ_NONBLOCK)
+				break;
+			if (ticks) {
+				WAIT_EVENT_TIMEOUT(&ioQueue->producers, IO_QUEUE_FREE(ioQueue) >= need ||
+					IoQueueInterrupted(ioQueue), *ticks);
+			} else {
+				WAIT_EVENT(&ioQueue->producers, IO_QUEUE_FREE(ioQueue) >= need ||
+					IoQueueInterrupted(ioQueue));
+			}
+			/* 超时或者被使用者打断，空间被别的生产者抢先占用就继续等待 */
+			if (IO_QUEUE_FREE(ioQueue) < need &&
+				((ticks && !*ticks) || IoQueueInterrupted(ioQueue)))
+				break;
+			continue;
+		}
+
+		len = MIN(count - done, IO_QUEUE_FREE(ioQueue));
+		to = ioQueue->head;
+		ioQueue->head = IoQueueAdvance(ioQueue, to, len * ioQueue->factor);
+		ioQueue->putHeld += len;
+		ioQueue->putCopying++;
+		InterruptRestore(eflags);
+
+		/* 数据可能在用户空间，复制时可能缺页睡眠 */
+		IoQueueCopyTo(ioQueue, to, p + done * ioQueue->factor,
+			len * ioQueue->factor);
+
+		/* 最后一个完成复制的生产者发布所有预留的单元 */
+		eflags = InterruptSave();
+		published = 0;
+		if (!--ioQueue->putCopying) {
+			ioQueue->size += ioQueue->putHeld;
+			ioQueue->putHeld = 0;
+			published = 1;
+		}
+		InterruptRestore(eflags);
+
+		done += len;
+
+		/* 一批数据只唤醒一次消费者 */
+		if (published)
+			IoQueueWakeUpConsumer(ioQueue);
 	}
+
+	/* 还有空位置，让下一个生产者继续放入 */
+	if (IO_QUEUE_FREE(ioQueue))
+		IoQueueWakeUpProducer(ioQueue);
+
+	return done ? done : -1;
 }
 
 /**
- * IoQueueGet - 从io队列中获取一个数据
+ * IoQueueDoGet - 从io队列中取出多个单元
  * @ioQueue: io队列
+ * @data: 保存数据的地址
+ * @count: 最多取出的单元数
+ * @flags: 标志
+ * @ticks: 最多等待的ticks数，为NULL表示一直等待
+ * 
+ * 等到有数据（带IQ_ALL时等到有count个单元）后一次取出能取出的所有单元
+ * 返回取出的单元数，一个都没有取出返回-1
  */
-PUBLIC unsigned long IoQueueGet(struct IoQueue *ioQueue)
+PRIVATE int IoQueueDoGet(struct IoQueue *ioQueue, void *data,
+    unsigned int count, int flags, unsigned long *ticks)
 {
-	/*如果队列时空的，就一直等待，知道有数据产生*/
-	while (IoQueueEmpty(ioQueue)) {
-		/* 获取锁 */
-		SyncLock(&ioQueue->lock);
-		/* 消费者进入等待状态 */
-		IoQueueWait(&ioQueue->consumer);
-		/* 释放锁 */
-		SyncUnlock(&ioQueue->lock);
+	unsigned int need, len;
+	unsigned char *from;
+	unsigned long eflags;
+	int released;
+
+	if (!count)
+		return 0;
+
+	need = 1;
+	if (flags & IQ_ALL) {
+		if (count > IO_QUEUE_CAPACITY(ioQueue))
+			return -1;
+		need = count;
 	}
-    unsigned long data;
-    unsigned char *p = (unsigned char *)&data;
-	switch (ioQueue->factor)
-    {
-    case IQ_FACTOR_8:
-        *p++ = *ioQueue->tail++;
-        break;
-    case IQ_FACTOR_16:
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        break;
-    case IQ_FACTOR_32:
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        break;
-    case IQ_FACTOR_64:
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        *p++ = *ioQueue->tail++;
-        break;
-    default:
-        break;
-    }
-
-	//数据数量减少
-	ioQueue->size--;
-
-	/* 如果到达了最后面，就跳到最前面，形成一个环 */
-	if(ioQueue->tail >= ioQueue->buf + ioQueue->buflen){
-		ioQueue->tail = ioQueue->buf;
+
+	while (1) {
+		eflags = InterruptSave();
+		if (ioQueue->size >= need)
+			break;
+		InterruptRestore(eflags);
+
+		if (flags & IQ_NONBLOCK)
+			return -1;
+		if (ticks) {
+			WAIT_EVENT_TIMEOUT(&ioQueue->consumers, ioQueue->size >= need ||
+				IoQueueInterrupted(ioQueue), *ticks);
+		} else {
+			WAIT_EVENT(&ioQueue->consumers, ioQueue->size >= need ||
+				IoQueueInterrupted(ioQueue));
+		}
+		/* 超时或者被使用者打断，数据被别的消费者抢先取走就继续等待 */
+		if (ioQueue->size < need &&
+			((ticks && !*ticks) || IoQueueInterrupted(ioQueue)))
+			return -1;
 	}
 
-	/* 如果有生产者，就唤醒生产者 */
-	if(ioQueue->producer != NULL){
-		IoQueueWakeUp(&ioQueue->producer);
+	/* 预留要取出的单元，其它消费者从后面继续取 */
+	len = MIN(count, ioQueue->size);
+	from = ioQueue->tail;
+	ioQueue->tail = IoQueueAdvance(ioQueue, from, len * ioQueue->factor);
+	ioQueue->size -= len;
+	ioQueue->getHeld += len;
+	ioQueue->getCopying++;
+	InterruptRestore(eflags);
+
+	/* 缓冲区可能在用户空间，复制时可能缺页睡眠 */
+	IoQueueCopyFrom(ioQueue, from, (unsigned char *)data, len * ioQueue->factor);
+
+	/* 最后一个完成复制的消费者把所有预留的单元还给生产者 */
+	eflags = InterruptSave();
+	released = 0;
+	if (!--ioQueue->getCopying) {
+		ioQueue->getHeld = 0;
+		released = 1;
 	}
+	InterruptRestore(eflags);
+
+	/* 一批数据只唤醒一次生产者 */
+	if (released)
+		IoQueueWakeUpProducer(ioQueue);
+
+	/* 还有数据，让下一个消费者继续取出 */
+	if (ioQueue->size)
+		IoQueueWakeUpConsumer(ioQueue);
+	return len;
+}
+
+/**
+ * IoQueuePutMany - 往io队列中放入多个单元
+ * @ioQueue: io队列
+ * @data: 数据
+ * @count: 单元数
+ * @flags: IQ_NONBLOCK只放入当前能放下的单元，IQ_ALL要一次放入全部单元
+ * 
+ * 返回放入的单元数，一个都没有放入返回-1
+ */
+PUBLIC int IoQueuePutMany(struct IoQueue *ioQueue, const void *data,
+    unsigned int count, int flags)
+{
+	return IoQueueDoPut(ioQueue, data, count, flags, NULL);
+}
+
+/**
+ * IoQueueGetMany - 从io队列中取出多个单元
+ * @ioQueue: io队列
+ * @data: 保存数据的地址
+ * @count: 最多取出的单元数
+ * @flags: IQ_NONBLOCK队列为空时不等待，IQ_ALL要等到有count个单元
+ * 
+ * 返回取出的单元数，一个都没有取出返回-1
+ */
+PUBLIC int IoQueueGetMany(struct IoQueue *ioQueue, void *data,
+    unsigned int count, int flags)
+{
+	return IoQueueDoGet(ioQueue, data, count, flags, NULL);
+}
+
+/**
+ * IoQueuePutTimeout - 往io队列中放入多个单元，最多等待ticks
+ * @ioQueue: io队列
+ * @data: 数据
+ * @count: 单元数
+ * @flags: 标志
+ * @ticks: 最多等待的ticks数
+ * 
+ * 超时的时候返回已经放入的单元数，一个都没有放入返回-1
+ */
+PUBLIC int IoQueuePutTimeout(struct IoQueue *ioQueue, const void *data,
+    unsigned int count, int flags, unsigned long ticks)
+{
+	return IoQueueDoPut(ioQueue, data, count, flags, &ticks);
+}
+
+/**
+ * IoQueueGetTimeout - 从io队列中取出多个单元，最多等待ticks
+ * @ioQueue: io队列
+ * @data: 保存数据的地址
+ * @count: 最多取出的单元数
+ * @flags: 标志
+ * @ticks: 最多等待的ticks数
+ * 
+ * 超时返回-1
+ */
+PUBLIC int IoQueueGetTimeout(struct IoQueue *ioQueue, void *data,
+    unsigned int count, int flags, unsigned long ticks)
+{
+	return IoQueueDoGet(ioQueue, data, count, flags, &ticks);
+}
+
+/**
+ * IoQueuePeek - 查看队列最前面的单元，不取出
+ * @ioQueue: io队列
+ * @data: 保存数据的地址，需要是内核缓冲区
+ * @count: 最多查看的单元数
+ * 
+ * 在关闭中断的时候复制，不会睡眠，返回复制的单元数，队列为空返回0
+ */
+PUBLIC int IoQueuePeek(struct IoQueue *ioQueue, void *data, unsigned int count)
+{
+	unsigned long eflags = InterruptSave();
+	unsigned int len = MIN(count, ioQueue->size);
+
+	IoQueueCopyFrom(ioQueue, ioQueue->tail, (unsigned char *)data,
+		len * ioQueue->factor);
+
+	InterruptRestore(eflags);
+	return len;
+}
+
+/**
+ * IoQueueWakeUpAll - 唤醒所有的生产者和消费者
+ * @ioQueue: io队列
+ * 
+ * interrupted检测的条件变化后调用，让等待者重新检测
+ */
+PUBLIC void IoQueueWakeUpAll(struct IoQueue *ioQueue)
+{
+	WaitQueueWakeUpAll(&ioQueue->producers);
+	WaitQueueWakeUpAll(&ioQueue->consumers);
+}
+
+/**
+ * IoQueuePut - 往io队列中放入一个数据
+ * @ioQueue: io队列
+ * @data: 数据
+ * 
+ * 队列满了就睡眠到有空位置
+ */
+PUBLIC void IoQueuePut(struct IoQueue *ioQueue, unsigned long data)
+{
+	/* 单元可能比data大，高位补0 */
+	unsigned char unit[IQ_FACTOR_64] = {0};
+
+	memcpy(unit, &data, MIN(ioQueue->factor, sizeof(data)));
+	IoQueueDoPut(ioQueue, unit, 1, 0, NULL);
+}
+
+/**
+ * IoQueueGet - 从io队列中获取一个数据
+ * @ioQueue: io队列
+ * 
+ * 队列为空就睡眠到有数据，单元比unsigned long大时只返回低位
+ */
+PUBLIC unsigned long IoQueueGet(struct IoQueue *ioQueue)
+{
+	unsigned char unit[IQ_FACTOR_64];
+	unsigned long data = 0;
+
+	IoQueueDoGet(ioQueue, unit, 1, 0, NULL);
+	memcpy(&data, unit, MIN(ioQueue->factor, sizeof(data)));
 	return data;
 }
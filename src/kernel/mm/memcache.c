@@ -12,6 +12,7 @@
 #include <lib/string.h>
 #include <lib/math.h>
 #include <lib/const.h>
+#include <lib/vsprintf.h>
 
 
 /*
@@ -68,6 +69,23 @@ PRIVATE struct CacheSize cacheSizes[] = {
 /* 最开始的groupcache */
 struct MemCache memCacheTable[MAX_MEM_CACHE_NR];
 
+/*
+ * 大小索引表：通过对象大小直接查到cacheSizes中的下标，不需要遍历。
+ * 4KB以内的按32字节为粒度索引，更大的按4KB为粒度索引。
+ */
+#define SMALL_SIZE_SHIFT    5
+#define SMALL_SIZE_MAX      4096
+#define LARGE_SIZE_SHIFT    12
+
+PRIVATE unsigned char smallSizeIndex[SMALL_SIZE_MAX >> SMALL_SIZE_SHIFT];
+PRIVATE unsigned char largeSizeIndex[MAX_MEM_CACHE_SIZE >> LARGE_SIZE_SHIFT];
+
+/* 所有cache组成的链表，包括kmalloc的cache和命名的cache */
+PRIVATE LIST_HEAD(memCacheListHead);
+
+/* 向上对齐，align必须是2的幂 */
+#define MEM_ALIGN_UP(x, align) (((x) + (align) - 1) & ~((align) - 1))
+
 
 PUBLIC void DumpMemCache(struct MemCache *cache)
 {
@@ -88,43 +106,93 @@ PUBLIC void DumpMemGroup(struct MemGroup *group)
 }
 
 
-PRIVATE INIT int MemCacheInit(struct MemCache *cache,
+/**
+ * MemCacheInit - 初始化一个cache
+ * @cache: 要初始化的cache
+ * @name: cache的名字
+ * @size: 对象的大小
+ * @align: 对象的对齐，必须是2的幂，0表示按字对齐
+ * @flags: cache的标志
+ * @ctor: 对象的构造函数，可以为NULL
+ * 
+ * 成功返回0，失败返回-1
+ */
+PRIVATE int MemCacheInit(struct MemCache *cache,
 	char *name, 
 	size_t size, 
-	flags_t flags)
+	size_t align,
+	flags_t flags,
+	void (*ctor)(void *))
 {
 	if (!size)
 		return -1;
+	
+	/* 对象至少要按字对齐 */
+	if (align < sizeof(long))
+		align = sizeof(long);
+	if (align & (align - 1))
+		return -1;
+
 	// 初始化链表
 	INIT_LIST_HEAD(&cache->fullGroups);
 	INIT_LIST_HEAD(&cache->partialGroups);
 	INIT_LIST_HEAD(&cache->freeGroups);
 
+	// 对象的大小，按照对齐的要求排列
+	cache->rawSize = size;
+	cache->objectSize = MEM_ALIGN_UP(size, align);
+	cache->objectOffset = 0;
+	size = cache->objectSize;
+
 	/* 根据size来选择不同的储存方式，以节约内存 */
 	if (size < 1024) { // 如果是小于1024，那么就放到单个页中。
-		/* 地址和8字节对齐，因为在结构体后面存放位图，位图是8字节为单位的 */
-		unsigned int groupSize = ALIGN_WITH(SIZEOF_MEM_GROUP, 8);
-
-		/* 如果是32字节为准，那么，就位图就只需要16字节即可 */
-		unsigned int leftSize = PAGE_SIZE - groupSize - 16;
-
+		/* 每个对象需要占用size字节，以及位图中的1位 */
+		unsigned int number = ((PAGE_SIZE - SIZEOF_MEM_GROUP) * 8) / (size * 8 + 1);
+		unsigned int offset = PAGE_SIZE;
+
+		/* 位图位于group后面，以8字节为单位，对象按照对齐的要求放在位图后面 */
+		while (number > 0) {
+			offset = MEM_ALIGN_UP(SIZEOF_MEM_GROUP + 
+				MEM_ALIGN_UP(DIV_ROUND_UP(number, 8), 8), align);
+			if (offset + number * size <= PAGE_SIZE)
+				break;
+			number--;
+		}
+		
 		// 对象数量
-		cache->objectNumber = leftSize / size;;
+		cache->objectNumber = number;
+		cache->objectOffset = offset;
 	} else if (size <= 128 * 1024) {  // 如果是小于128kb，就放到1MB以内
 		cache->objectNumber = (1 * MB) / size;
 	} else if (size <= 4 * 1024 * 1024) { // 如果是小于4MB，就放到4MB以内
 		cache->objectNumber = (4 * MB) / size;
+	} else {
+		cache->objectNumber = 0;
 	}
-
-	// 对象的大小
-	cache->objectSize = size;
+	
+	if (!cache->objectNumber)
+		return -1;
 
 	// 设定cache的标志
 	cache->flags = flags;
+	cache->ctor = ctor;
 	
 	// 设置名字
 	memset(cache->name, 0, MEM_CACHE_NAME_LEN);
-	strcpy(cache->name, name);
+	strncpy(cache->name, name, MEM_CACHE_NAME_LEN - 1);
+
+	/* 弹匣只缓存有限的字节数，大对象不使用弹匣 */
+	cache->magazine.count = 0;
+	cache->magazine.limit = MIN(MEM_MAGAZINE_SIZE, MEM_MAGAZINE_BYTES / size);
+	
+	cache->allocs = cache->allocHits = 0;
+	cache->frees = cache->freeHits = 0;
+	cache->refills = cache->flushes = cache->grows = 0;
+
+	/* 添加到cache链表 */
+	unsigned long irqFlags = InterruptSave();
+	ListAddTail(&cache->list, &memCacheListHead);
+	InterruptRestore(irqFlags);
 
 	//DumpMemCache(cache);
 	return 0;
@@ -153,13 +221,10 @@ PRIVATE int MemCacheFreePages(void *address)
 	return 0;
 }
 
-PRIVATE INIT int MemGroupInit(struct MemCache *cache,
+PRIVATE int MemGroupInit(struct MemCache *cache,
 	struct MemGroup *group,
 	flags_t flags)
 {
-	// 把group添加到free链表
-	ListAdd(&group->list, &cache->freeGroups);
-
 	// 位图位于group结构后面
 	unsigned char *map = (unsigned char *)(group+1);
 
@@ -170,10 +235,11 @@ PRIVATE INIT int MemGroupInit(struct MemCache *cache,
 	BitmapInit(&group->map);
 
 	struct MemNode *node; 
+	int i;
 
 	/* 根据缓冲中记录的对象大小进行不同的设定 */
 	if (cache->objectSize < 1024) {
-		group->objects = map + 16;
+		group->objects = (unsigned char *)group + cache->objectOffset;
 
 		/* 转换成节点，并标记 */
 		node = Page2MemNode(Vir2Phy(group));
@@ -186,7 +252,6 @@ PRIVATE INIT int MemGroupInit(struct MemCache *cache,
 			printk(PART_ERROR "alloc page for mem objects failed\n");
 			return -1;
 		}
-		int i;
 		for (i = 0; i < pages; i++) {
 			node = Page2MemNode(Vir2Phy(group->objects + i * PAGE_SIZE));
 			CHECK_MEM_NODE(node);
@@ -194,10 +259,21 @@ PRIVATE INIT int MemGroupInit(struct MemCache *cache,
 		}
 	}
 
+	/* 构造函数只在对象创建时调用一次，释放的对象需要保持构造后的状态 */
+	if (cache->ctor) {
+		for (i = 0; i < cache->objectNumber; i++)
+			cache->ctor(group->objects + i * cache->objectSize);
+	}
+
 	group->usingCount = 0;
 	group->freeCount = cache->objectNumber;
 	group->flags =  flags;
 
+	// 把group添加到free链表
+	unsigned long irqFlags = InterruptSave();
+	ListAdd(&group->list, &cache->freeGroups);
+	InterruptRestore(irqFlags);
+
 	//DumpMemGroup(group);
 	return 0;
 }
@@ -224,6 +300,8 @@ PRIVATE int CreateMemGroup(struct MemCache *cache, flags_t flags)
 		goto ToFreeGroup;
 	}
 	
+	cache->grows++;
+
 	// 创建成功
 	return 0;
 
@@ -244,10 +322,14 @@ PRIVATE int MakeMemCaches()
 
 	//printk(PART_TIP "memCacheTable addr %x size %d\n", memCache, sizeof(struct MemCache));
 
+	char name[MEM_CACHE_NAME_LEN];
+
 	// 如果没有遇到大小为0的cache，就会把cache初始化
 	while (cacheSize->cacheSize) {
+		sprintf(name, "kmalloc-%d", cacheSize->cacheSize);
+
 		/* 初始化缓存信息 */
-		if (MemCacheInit(memCache, "mem cache", cacheSize->cacheSize, 0)) {
+		if (MemCacheInit(memCache, name, cacheSize->cacheSize, 0, 0, NULL)) {
 			printk(PART_ERROR "create mem cache failed!\n");
 			return -1;
 		}
@@ -265,40 +347,89 @@ PRIVATE int MakeMemCaches()
 	return 0;
 }
 
+/**
+ * SizeIndexSearch - 查找能容纳size的第一个cache的下标
+ * @size: 对象大小
+ */
+PRIVATE INIT unsigned char SizeIndexSearch(size_t size)
+{
+	unsigned char index = 0;
+
+	while (cacheSizes[index + 1].cacheSize && cacheSizes[index].cacheSize < size)
+		index++;
+	return index;
+}
+
+/**
+ * MakeSizeIndex - 建立大小索引表
+ */
+PRIVATE INIT void MakeSizeIndex()
+{
+	int i;
+	for (i = 0; i < sizeof(smallSizeIndex); i++)
+		smallSizeIndex[i] = SizeIndexSearch((i + 1) << SMALL_SIZE_SHIFT);
+	
+	for (i = 0; i < sizeof(largeSizeIndex); i++)
+		largeSizeIndex[i] = SizeIndexSearch((i + 1) << LARGE_SIZE_SHIFT);
+}
+
+/**
+ * SizeToMemCache - 获取对象大小对应的cache
+ * @size: 对象大小，不能超过MAX_MEM_CACHE_SIZE
+ */
+PRIVATE INLINE struct MemCache *SizeToMemCache(size_t size)
+{
+	if (!size)
+		size = 1;
+	if (size <= SMALL_SIZE_MAX)
+		return cacheSizes[smallSizeIndex[(size - 1) >> SMALL_SIZE_SHIFT]].memCache;
+	return cacheSizes[largeSizeIndex[(size - 1) >> LARGE_SIZE_SHIFT]].memCache;
+}
+
 /*
- * __groupAllocObjcet - 在group中分配一个对象
+ * __MemGroupAllocObjects - 在group中分配多个对象
  * @cache: 对象所在的cache
  * @group: 对象所在的group
+ * @objects: 储存对象的数组
+ * @count: 最多分配多少个对象
  * 
- * 在当前cache中分配一个对象
+ * 只扫描一遍位图，跳过已经满了的字节，返回分配到的对象数量
  */
-PRIVATE INLINE void *__MemGroupAllocObjcet(struct MemCache *cache, struct MemGroup *group)
+PRIVATE int __MemGroupAllocObjects(struct MemCache *cache, struct MemGroup *group,
+	void **objects, int count)
 {
-	void *object;
-
-	// 做一些标志的设定
-
-	
-	// 从位图中获取一个空闲的对象
-	int idx = BitmapScan(&group->map, 1);
-	
-	// 分配失败
-	if (idx == -1) {
-		/* 没有可用对象了 */
-		printk(PART_TIP "bitmap scan failed!\n");
-		
-		return NULL;
+	unsigned char *bits = group->map.bits;
+	int idxByte, idxBit, idx;
+	int got = 0;
+
+	/* 不能超过group中的空闲对象数 */
+	if (count > group->freeCount)
+		count = group->freeCount;
+
+	for (idxByte = 0; idxByte < group->map.btmpBytesLen && got < count; idxByte++) {
+		// 这个字节的对象都被使用了
+		if (bits[idxByte] == 0xff)
+			continue;
+
+		for (idxBit = 0; idxBit < 8 && got < count; idxBit++) {
+			if (bits[idxByte] & (BITMAP_MASK << idxBit))
+				continue;
+			
+			idx = idxByte * 8 + idxBit;
+			if (idx >= cache->objectNumber)
+				break;
+
+			// 设定为已经使用
+			bits[idxByte] |= (BITMAP_MASK << idxBit);
+
+			// 获取object的位置
+			objects[got++] = group->objects + idx * cache->objectSize;
+		}
 	}
-		
-	// 设定为已经使用
-	BitmapSet(&group->map, idx, 1);
 
-	// 获取object的位置
-	object = group->objects + idx * cache->objectSize;
-	
 	// 改变group的使用情况
-	group->usingCount++;
-	group->freeCount--;
+	group->usingCount += got;
+	group->freeCount -= got;
 	
 	// 判断group是否已经使用完了
 	if (group->freeCount == 0) {
@@ -308,125 +439,65 @@ PRIVATE INLINE void *__MemGroupAllocObjcet(struct MemCache *cache, struct MemGro
 		ListAddTail(&group->list, &cache->fullGroups);
 	}
 
-	return object;
+	return got;
 }
 
 /*
- * groupAllocObjcet - 在group中分配一个对象
+ * GroupAllocObjects - 在group中分配多个对象
  * @cache: 对象所在的cache
- * @flags: 分配需要的标志
+ * @objects: 储存对象的数组
+ * @count: 最多分配多少个对象
  * 
- * 在当前cache中分配一个对象
+ * 至少分配一个对象，返回分配到的对象数量，失败返回0
  */
-PRIVATE void *GroupAllocObjcet(struct MemCache *cache)
+PRIVATE int GroupAllocObjects(struct MemCache *cache, void **objects, int count)
 {
-	void *object;
 	struct MemGroup *group;
 
 	// 存在空闲的就分配并且返回
-	struct List *partialList, *node;
-
-	// 检测分配环境
+	struct List *partialList, *freeList, *node;
 
 	unsigned long flags;
+	int got = 0;
 
 ToRetryAllocObject:
 	// 要关闭中断，并保存寄存器环境
 	flags = InterruptSave();
 
 	partialList = &cache->partialGroups;
-
-	// 指向partial中的第一个group
-	node = partialList->next;
-
-	//printk(PART_TIP "cache size %x\n", cache->objectSize);
-
-	// 如果partial是空的
-	if (ListEmpty(partialList)) {
-		//printk(PART_TIP "partialList empty\n");
-
-		struct List *freeList;
-		freeList = &cache->freeGroups;
-		// 如果free是空的
-		if (ListEmpty(freeList)) {
-			//printk(PART_TIP "free empty\n");
-
-			// 需要创建一个新的group
-			goto ToCreateNewgroup;
+	freeList = &cache->freeGroups;
+
+	while (got < count) {
+		// 如果partial是空的
+		if (ListEmpty(partialList)) {
+			// 如果free也是空的，就结束
+			if (ListEmpty(freeList))
+				break;
+			
+			// 把free中的第一个组移动到partial中去
+			node = freeList->next;
+			ListDel(node);
+			ListAddTail(node, partialList);
 		}
-		// 指向第一个组
-		node = freeList->next;
-
-		// 把node从free list中删除
-		ListDel(node);
-
-		// 把node添加到partial中去
-		ListAddTail(node, partialList);
 
+		/* 现在partial中的第一个组一定有空闲对象 */
+		group = ListOwner(partialList->next, struct MemGroup, list);
+		got += __MemGroupAllocObjects(cache, group, objects + got, count - got);
 	}
 
-	//printk("kmalloc: found a node.\n");
-	/* 现在node是partial中的一个节点 */
-	group = ListOwner(node, struct MemGroup, list);
-	//printk(PART_TIP "group %x cache size %x\n", group, cache->objectSize);
-	object = __MemGroupAllocObjcet(cache, group);
-
 	// 要恢复中断状态
 	InterruptRestore(flags);
 
-	return object;
+	if (got)
+		return got;
 
-ToCreateNewgroup:
 	// 没有group，添加一个新的group
-
-	// 恢复中断状况
-	// 要恢复中断状态
-	InterruptRestore(flags);
-
-	//printk("kmalloc: need a new group.\n");
-	// 添加新的group
 	if (CreateMemGroup(cache, 0))
-		return NULL;	// 如果创建一个group失败就返回
+		return 0;	// 如果创建一个group失败就返回
 
 	goto ToRetryAllocObject;
-	return NULL;
-}
-
-/*
- * kmalloc - 分配一个对象
- * @size: 对象的大小
- * @flags: 分配需要的flags
- * 
- * 分配一个size大小的内存，用flags
- */
-PUBLIC void *kmalloc(size_t size, unsigned int flags)
-{
-	// 如果越界了就返回空
-	if (size > MAX_MEM_CACHE_SIZE) {
-		printk(PART_WARRING "kmalloc size %d too big!", size);
-		return NULL;
-	}
-		
-	// 判断是否有标志
-	/*if (!flags) 
-		return NULL;*/
-
-	struct CacheSize *cacheSize = cacheSizes;
-
-	while (cacheSize->cacheSize) {
-		// 如果找到一个大于等于当前大小的cache，就跳出循环
-		if (cacheSize->cacheSize >= size)
-			break;
-		
-		// 指向下一个大小描述
-		cacheSize++;
-	}
-	
-	//printk(PART_TIP "des %x cache %x size %x\n", sizeDes, sizeDes->cachePtr, sizeDes->cachePtr->objectSize);
-	return GroupAllocObjcet(cacheSize->memCache);
 }
 
-
 /*
  * __GroupFreeObject - 释放一个group对象
  * @cache: 对象所在的cache
@@ -497,26 +568,128 @@ PRIVATE void __GroupFreeObject(struct MemCache *cache, void *object)
 	}
 }
 
-/*
- * GroupFreeObject - 释放一个group对象
+/**
+ * __MemMagazineFlush - 把弹匣底部的对象还给group
+ * @cache: 弹匣所在的cache
+ * @count: 归还的对象数量
+ * 
+ * 弹匣底部的对象是最早放入的，最不可能还在CPU缓存中。
+ * 调用者需要关闭中断。
+ */
+PRIVATE void __MemMagazineFlush(struct MemCache *cache, unsigned int count)
+{
+	struct MemMagazine *magazine = &cache->magazine;
+	unsigned int i;
+
+	if (count > magazine->count)
+		count = magazine->count;
+	
+	for (i = 0; i < count; i++)
+		__GroupFreeObject(cache, magazine->objects[i]);
+	
+	/* 把剩下的对象移动到弹匣底部 */
+	magazine->count -= count;
+	for (i = 0; i < magazine->count; i++)
+		magazine->objects[i] = magazine->objects[i + count];
+}
+
+/**
+ * MemCacheFreeObject - 释放一个对象到cache中
  * @cache: 对象所在的cache
  * @object: 对象的指针
  * 
- * 释放group对象，而不是group，group用destory
+ * 优先放入弹匣，弹匣满了就先把一半的对象还给group
  */
-PRIVATE void GroupFreeObject(struct MemCache *cache, void *object)
+PRIVATE void MemCacheFreeObject(struct MemCache *cache, void *object)
 {
-	// 检测环境
+	struct MemMagazine *magazine = &cache->magazine;
 
 	// 关闭中断
 	unsigned long flags = InterruptSave();
+	cache->frees++;
 
-	__GroupFreeObject(cache, object);
+	if (!magazine->limit) {
+		/* 不使用弹匣，直接还给group */
+		__GroupFreeObject(cache, object);
+	} else {
+		if (magazine->count < magazine->limit) {
+			cache->freeHits++;
+		} else {
+			__MemMagazineFlush(cache, magazine->limit / 2);
+			cache->flushes++;
+		}
+		magazine->objects[magazine->count++] = object;
+	}
 
 	// 打开中断
 	InterruptRestore(flags);
 }
 
+/**
+ * MemCacheAlloc - 从cache中分配一个对象
+ * @cache: 对象所在的cache
+ * 
+ * 优先从弹匣中分配，弹匣空了就从group中批量装填。
+ * 对象不会被清零，有构造函数的cache返回构造后的对象。
+ */
+PUBLIC void *MemCacheAlloc(struct MemCache *cache)
+{
+	struct MemMagazine *magazine = &cache->magazine;
+	void *objects[MEM_MAGAZINE_SIZE];
+	void *object;
+	int count, i;
+
+	unsigned long flags = InterruptSave();
+	cache->allocs++;
+
+	if (magazine->count) {
+		object = magazine->objects[--magazine->count];
+		cache->allocHits++;
+		InterruptRestore(flags);
+		return object;
+	}
+	InterruptRestore(flags);
+
+	/* 弹匣空了，一次装填半个弹匣 */
+	count = GroupAllocObjects(cache, objects, MAX(magazine->limit / 2, 1));
+	if (!count)
+		return NULL;
+	
+	flags = InterruptSave();
+	if (magazine->limit)
+		cache->refills++;
+	
+	/* 第一个对象返回给调用者，其余的放入弹匣 */
+	for (i = 1; i < count; i++) {
+		/* 中断中可能已经放入了对象，放不下就还给group */
+		if (magazine->count < magazine->limit)
+			magazine->objects[magazine->count++] = objects[i];
+		else
+			__GroupFreeObject(cache, objects[i]);
+	}
+	InterruptRestore(flags);
+
+	return objects[0];
+}
+
+/*
+ * kmalloc - 分配一个对象
+ * @size: 对象的大小
+ * @flags: 分配需要的flags
+ * 
+ * 分配一个size大小的内存，用flags
+ */
+PUBLIC void *kmalloc(size_t size, unsigned int flags)
+{
+	// 如果越界了就返回空
+	if (size > MAX_MEM_CACHE_SIZE) {
+		printk(PART_WARRING "kmalloc size %d too big!", size);
+		return NULL;
+	}
+	
+	return MemCacheAlloc(SizeToMemCache(size));
+}
+
 
 /*
  * kfree - 释放一个对象占用的内存
@@ -536,12 +709,65 @@ PUBLIC void kfree(void *objcet)
 	// 转换成group cache
 	cache = MEM_NODE_GET_CACHE(node);
 
-	//DumpMemCache(cache);
-	//printk(PART_TIP "get object group cache %x\n", cache);
-
 	// 调用核心函数
-	GroupFreeObject(cache, (void *)objcet);
+	MemCacheFreeObject(cache, (void *)objcet);
+}
+
+/**
+ * MemCacheFree - 释放一个对象到cache中
+ * @cache: 对象所在的cache
+ * @object: 对象的指针
+ * 
+ * 有构造函数的cache，释放的对象需要恢复到构造后的状态
+ */
+PUBLIC void MemCacheFree(struct MemCache *cache, void *object)
+{
+	if (!object)
+		return;
+	
+	struct MemNode *node = Page2MemNode(Vir2Phy(object));
+
+	CHECK_MEM_NODE(node);
 	
+	if (MEM_NODE_GET_CACHE(node) != cache) {
+		printk(PART_ERROR "MemCacheFree: object %x not belong to cache %s!\n",
+			object, cache->name);
+		return;
+	}
+
+	MemCacheFreeObject(cache, object);
+}
+
+/**
+ * CreateMemCache - 创建一个命名的对象cache
+ * @name: cache的名字
+ * @size: 对象的大小，按照实际大小分配，不会向上取2的幂
+ * @align: 对象的对齐，必须是2的幂，0表示按字对齐
+ * @flags: cache的标志
+ * @ctor: 对象的构造函数，在group创建时对每个对象调用一次，可以为NULL
+ * 
+ * 成功返回cache，失败返回NULL
+ */
+PUBLIC struct MemCache *CreateMemCache(char *name, size_t size, size_t align,
+	flags_t flags, void (*ctor)(void *))
+{
+	if (name == NULL || !size || size > MAX_MEM_CACHE_SIZE) {
+		printk(PART_ERROR "CreateMemCache: bad arguments!\n");
+		return NULL;
+	}
+
+	struct MemCache *cache = kmalloc(sizeof(struct MemCache), GFP_KERNEL);
+	if (cache == NULL) {
+		printk(PART_ERROR "CreateMemCache: kmalloc for cache %s failed!\n", name);
+		return NULL;
+	}
+
+	if (MemCacheInit(cache, name, size, align, flags, ctor)) {
+		printk(PART_ERROR "CreateMemCache: init cache %s failed!\n", name);
+		kfree(cache);
+		return NULL;
+	}
+	return cache;
 }
 
 
@@ -604,6 +830,10 @@ PRIVATE int MemCacheShrink(struct MemCache *cache)
 
 	// 用自旋锁来保护结构
 	unsigned long flags = InterruptSave();
+	
+	/* 先把弹匣中的对象都还给group，group才可能变成空闲的 */
+	__MemMagazineFlush(cache, cache->magazine.count);
+
 	// 收缩内存
 	ret = __MemCacheShrink(cache);
 
@@ -614,6 +844,36 @@ PRIVATE int MemCacheShrink(struct MemCache *cache)
 	return ret * cache->objectNumber * cache->objectSize;
 }
 
+/**
+ * DestroyMemCache - 销毁一个命名的cache
+ * @cache: 要销毁的cache
+ * 
+ * cache中的对象必须都已经释放了，成功返回0，失败返回-1
+ */
+PUBLIC int DestroyMemCache(struct MemCache *cache)
+{
+	if (cache == NULL)
+		return -1;
+
+	unsigned long flags = InterruptSave();
+	
+	__MemMagazineFlush(cache, cache->magazine.count);
+
+	if (!ListEmpty(&cache->fullGroups) || !ListEmpty(&cache->partialGroups)) {
+		InterruptRestore(flags);
+		printk(PART_ERROR "DestroyMemCache: cache %s still has objects in use!\n", cache->name);
+		return -1;
+	}
+
+	__MemCacheShrink(cache);
+	ListDel(&cache->list);
+	
+	InterruptRestore(flags);
+
+	kfree(cache);
+	return 0;
+}
+
 /**
  * SlabCacheAllShrink - 对所有的cache都进行收缩
  */
@@ -622,23 +882,94 @@ PUBLIC int kmshrink()
 	// 释放了的大小
 	size_t size = 0;
 
-	// 指向cache的指针
-	struct CacheSize *cacheSize = &cacheSizes[0];
+	struct MemCache *cache;
 
 	// 对每一个cache都进行收缩
-	while (cacheSize->cacheSize) {
+	ListForEachOwner(cache, &memCacheListHead, list) {
 		// 收缩大小
-		size += MemCacheShrink(cacheSize->memCache);
-		// 指向下一个cache大小描述
-		cacheSize++;
+		size += MemCacheShrink(cache);
 	}
 
 	return size;
 }
 
+/**
+ * SysCacheScan - 扫描内存缓存的状态
+ * @cs: 储存状态的结构
+ * @idx: 要扫描的缓存的索引，扫描后指向下一个
+ * 
+ * 成功返回0，到达末尾返回-1
+ */
+PUBLIC int SysCacheScan(cachescan_status_t *cs, unsigned int *idx)
+{
+	if (cs == NULL || idx == NULL)
+		return -1;
+	
+	struct MemCache *cache;
+	struct MemGroup *group;
+	unsigned long groups = 0, inuse = 0, groupBytes;
+	unsigned int n = 0;
+
+	unsigned long flags = InterruptSave();
+	
+	/* 找到第idx个cache */
+	ListForEachOwner(cache, &memCacheListHead, list) {
+		if (n == *idx)
+			break;
+		n++;
+	}
+	
+	/* 已经到达末尾了 */
+	if (&cache->list == &memCacheListHead) {
+		InterruptRestore(flags);
+		return -1;
+	}
+
+	ListForEachOwner(group, &cache->fullGroups, list) {
+		groups++;
+		inuse += group->usingCount;
+	}
+	ListForEachOwner(group, &cache->partialGroups, list) {
+		groups++;
+		inuse += group->usingCount;
+	}
+	ListForEachOwner(group, &cache->freeGroups, list) {
+		groups++;
+	}
+
+	/* 弹匣中的对象没有被使用 */
+	inuse -= cache->magazine.count;
+
+	/* 每个group占用的内存，大对象的group还要加上对象所在的页 */
+	groupBytes = PAGE_SIZE;
+	if (cache->objectSize >= 1024)
+		groupBytes += DIV_ROUND_UP(cache->objectNumber * cache->objectSize, PAGE_SIZE) * PAGE_SIZE;
+
+	memset(cs->cs_name, 0, sizeof(cs->cs_name));
+	strncpy(cs->cs_name, cache->name, sizeof(cs->cs_name) - 1);
+	cs->cs_objsize  = cache->rawSize;
+	cs->cs_objnum   = cache->objectNumber;
+	cs->cs_groups   = groups;
+	cs->cs_inuse    = inuse;
+	cs->cs_wasted   = groups * groupBytes - inuse * cache->rawSize;
+	cs->cs_magazine = cache->magazine.count;
+	cs->cs_allocs   = cache->allocs;
+	cs->cs_hits     = cache->allocHits;
+	cs->cs_frees    = cache->frees;
+	cs->cs_refills  = cache->refills;
+	cs->cs_flushes  = cache->flushes;
+	cs->cs_grows    = cache->grows;
+
+	InterruptRestore(flags);
+
+	*idx = *idx + 1;
+	return 0;
+}
+
 PUBLIC int InitMemCaches()
 {
 	MakeMemCaches();
+	MakeSizeIndex();
 
 	/*
 	char *a = kmalloc2(32, 0);
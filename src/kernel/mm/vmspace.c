@@ -12,6 +12,8 @@
 #include <book/mmu.h>
 #include <book/vmspace.h>
 #include <book/task.h>
+#include <book/fs.h>
+#include <book/shm.h>
 #include <lib/string.h>
 #include <lib/math.h>
 
@@ -64,12 +66,14 @@ PUBLIC int MergeVMSpace(struct VMSpace* prev, struct VMSpace* space, struct VMSp
     /* 如果两者之间是连着的，prev的结束和space的开始相等 */
     if (prev != NULL && prev->end == space->start) {
         /* 其他属性页一样 */
-        if (prev->pageProt == space->pageProt && prev->flags == space->flags) {
+        if (prev->pageProt == space->pageProt && prev->flags == space->flags &&
+            prev->fileMap == NULL && space->fileMap == NULL &&
+            prev->shm == NULL && space->shm == NULL) {
             // 把space从链表删除
             prev->end = space->end;
             prev->next = next;
             // 释放这个空间
-            kfree(space);
+            FreeVMSpace(space);
             // 空间指向prev
             space = prev;
             merged = 1;
@@ -78,12 +82,14 @@ PUBLIC int MergeVMSpace(struct VMSpace* prev, struct VMSpace* space, struct VMSp
     
     /* 合并space和p */
     if (next != NULL && space->end == next->start) {
-        if (space->pageProt == next->pageProt && space->flags == next->flags) {
+        if (space->pageProt == next->pageProt && space->flags == next->flags &&
+            space->fileMap == NULL && next->fileMap == NULL &&
+            space->shm == NULL && next->shm == NULL) {
             // 把p从链表中删除
             space->end = next->end;
             space->next = next->next;
             // 释放这个空间
-            kfree(next);
+            FreeVMSpace(next);
             merged = 1;
         }
     }
@@ -147,7 +153,7 @@ PUBLIC void RemoveVMSpace(struct MemoryManager *mm, struct VMSpace *space, struc
         mm->spaceMap = space->next;
     }
     /* 现在可以正确得移除space了，因为已经把它从链表移除 */
-    kfree(space);
+    FreeVMSpace(space);
 }
 
 /**
@@ -178,9 +184,9 @@ PUBLIC struct VMSpace *FindVMSpace(struct MemoryManager *mm, address_t addr)
  * 查找第一个满足 addr < space->end, 并且不是NULL的空间，
  * 并且把space的前一个空间保存到prev
  */
-PUBLIC struct VMSpace *FindVMSpacePrev(struct MemoryManager *mm, address_t addr, struct VMSpace *prev)
+PUBLIC struct VMSpace *FindVMSpacePrev(struct MemoryManager *mm, address_t addr, struct VMSpace **prev)
 {
-    prev = NULL;
+    *prev = NULL;
     struct VMSpace* space = mm->spaceMap;
     while (space != NULL) {
         /* 如果地址比查询的空间的结束地址小既 [addr, space->end] */
@@ -188,7 +194,7 @@ PUBLIC struct VMSpace *FindVMSpacePrev(struct MemoryManager *mm, address_t addr,
             return space;
         
         /* 保存空间的前一个空间 */
-        prev = space;
+        *prev = space;
         space = space->next;
     }
     return NULL;
@@ -221,10 +227,12 @@ PUBLIC struct VMSpace *FindVMSpaceIntersection(struct MemoryManager *mm,
  * @len: 长度
  * @prot: 页保护
  * @flags: 空间的标志
+ * @shm: 映射的共享内存对象，匿名映射为NULL
  * 
  * 做地址映射，进程才可以读写空间
  */
-PUBLIC int32 DoMmap(struct MemoryManager *mm, address_t addr, uint32_t len, uint32_t prot, uint32_t flags)
+PUBLIC int32 DoMmap(struct MemoryManager *mm, address_t addr, uint32_t len,
+        uint32_t prot, uint32_t flags, struct ShmObject *shm)
 {
     //PART_START("DoMap");
     // printk(PART_TIP "DoMmap: %x, %x, %x, %x\n", addr, len, prot, flags);
@@ -275,9 +283,9 @@ PUBLIC int32 DoMmap(struct MemoryManager *mm, address_t addr, uint32_t len, uint
     }
     
     /* 从slab中分配一块内存来当做VMSpace结构 */
-    struct VMSpace *space = (struct VMSpace *)kmalloc(sizeof(struct VMSpace), GFP_KERNEL);
+    struct VMSpace *space = AllocVMSpace();
     if (!space) {
-        printk(PART_ERROR "DoMmap: kmalloc for space failed!\n");
+        printk(PART_ERROR "DoMmap: alloc space failed!\n");
         return -1;    
     }
         
@@ -287,6 +295,13 @@ PUBLIC int32 DoMmap(struct MemoryManager *mm, address_t addr, uint32_t len, uint
     space->flags = flags;
     space->pageProt = prot;
 
+    /* 空间持有对象的一个引用，页故障时链接对象的物理页 */
+    if (shm != NULL) {
+        ShmGet(shm);
+        space->shm = shm;
+        space->shmStart = addr;
+    }
+
     /* 插入空间到链表中，并且尝试合并 */
     if (InsertVMSpace(mm, space)) {
         printk(PART_ERROR "DoMmap: InsertVMSpace failed!\n");
@@ -326,7 +341,7 @@ PUBLIC int DoMunmap(struct MemoryManager *mm, uint32 addr, uint32 len)
         
     /* 找到addr < space->end 的空间 */
     struct VMSpace* prev = NULL;
-    struct VMSpace* space = FindVMSpacePrev(mm, addr, prev);
+    struct VMSpace* space = FindVMSpacePrev(mm, addr, &prev);
     /* 没找到空间就返回 */
     if (!space) {      
         printk(PART_ERROR "DoMunmap: not found the space!\n");
@@ -347,15 +362,29 @@ PUBLIC int DoMunmap(struct MemoryManager *mm, uint32 addr, uint32 len)
     /* 分配一个新的空间，有可能要unmap的空间会分成2个空间，例如：
     [start, addr, addr+len, end] => [start, addr], [addr+len, end]
      */
-    struct VMSpace* spaceNew = (struct VMSpace*)kmalloc(sizeof(struct VMSpace), GFP_KERNEL);
+    struct VMSpace* spaceNew = AllocVMSpace();
     if (!spaceNew) {        
-        printk(PART_ERROR "DoMunmap: kmalloc for spaceNew failed!\n");
+        printk(PART_ERROR "DoMunmap: alloc spaceNew failed!\n");
         return -1;
     }
 
     /* 把新空间链接到链表 */
     spaceNew->start = addr+len;
     spaceNew->end = space->end;
+    spaceNew->pageProt = space->pageProt;
+    spaceNew->flags = space->flags;
+    
+    /* 后一部分继续使用同一个文件映射，文件数据的地址不变 */
+    if (space->fileMap != NULL) {
+        SetVMSpaceFile(spaceNew, space->fileMap, space->fileStart,
+            space->fileOffset, space->fileSize);
+    }
+    /* 共享内存对象的页在空间中的位置不变 */
+    if (space->shm != NULL) {
+        ShmGet(space->shm);
+        spaceNew->shm = space->shm;
+        spaceNew->shmStart = space->shmStart;
+    }
     space->end = addr;
     spaceNew->next = space->next;
     space->next = spaceNew;
@@ -371,9 +400,9 @@ PUBLIC int DoMunmap(struct MemoryManager *mm, uint32 addr, uint32 len)
         RemoveVMSpace(mm, spaceNew, space);
     }
 
-    /* 需要释放物理页 */
-    //UnmapPageRange(addr, len);
-   return 0;
+    /* 释放物理页，共享的页只会减少引用计数 */
+    UnmapPages(addr, len);
+    return 0;
 }
 
 /**
@@ -386,7 +415,7 @@ PUBLIC int DoMunmap(struct MemoryManager *mm, uint32 addr, uint32 len)
 PUBLIC void *SysMmap(uint32_t addr, uint32_t len, uint32_t prot, uint32_t flags)
 {
     struct Task *current = CurrentTask();
-    return (void *)DoMmap(current->mm, addr, len, prot, flags);
+    return (void *)DoMmap(current->mm, addr, len, prot, flags, NULL);
 }
 
 /**
@@ -408,6 +437,8 @@ PUBLIC int SysMunmap(uint32_t addr, uint32_t len)
 PUBLIC void InitMemoryManager(struct MemoryManager *mm)
 {
     mm->spaceMap = NULL;
+    AtomicSet(&mm->users, 1);
+    AtomicSet(&mm->count, 1);
 }
 
 /** 
@@ -458,7 +489,7 @@ PUBLIC void ReleaseVMSpace(struct MemoryManager *mm, unsigned int flags)
             UnmapPagesFragment(cur->start, cur->end - cur->start);
 
             /* 释放虚拟空间 */
-            kfree(cur);
+            FreeVMSpace(cur);
         }
     }
     /* 释放完后把空间映射置空 */
@@ -502,8 +533,11 @@ PUBLIC void ExitVMSpace(struct MemoryManager *mm)
         }
         printk("task %s release space: start %x end %x\n", CurrentTask()->name, cur->start, cur->end);
 #endif
+        /* 释放物理页，fork后共享的页只会减少引用计数 */
+        UnmapPagesFragment(cur->start, cur->end - cur->start);
+
         /* 释放虚拟空间 */
-        kfree(cur);        
+        FreeVMSpace(cur);        
     }
     /* 释放完后把空间映射置空 */
     mm->spaceMap = NULL;
@@ -556,7 +590,7 @@ PRIVATE unsigned int DoBrk(struct MemoryManager *mm, unsigned int addr, unsigned
     }
 
     /* 创建一个space，用来映射新的地址 */
-    space = kmalloc(sizeof(struct VMSpace), GFP_KERNEL);
+    space = AllocVMSpace();
     if (space == NULL)
         return -1;
     
@@ -661,11 +695,108 @@ ToEnd:
     return ret;
 }
 
+/* 虚拟空间的对象缓存 */
+PRIVATE struct MemCache *vmSpaceCache;
+
+/**
+ * AllocVMSpace - 分配一个虚拟空间结构
+ * 
+ * 成功返回空间，失败返回NULL
+ */
+PUBLIC struct VMSpace *AllocVMSpace()
+{
+    struct VMSpace *space = MemCacheAlloc(vmSpaceCache);
+    if (space != NULL) {
+        space->fileMap = NULL;
+        space->shm = NULL;
+    }
+    return space;
+}
+
+/**
+ * FreeVMSpace - 释放一个虚拟空间结构
+ * @space: 要释放的空间
+ * 
+ * 如果有文件映射或者共享内存对象，就释放空间对它的引用
+ */
+PUBLIC void FreeVMSpace(struct VMSpace *space)
+{
+    if (space->fileMap != NULL)
+        FileMapPut(space->fileMap);
+    if (space->shm != NULL)
+        ShmPut(space->shm);
+    MemCacheFree(vmSpaceCache, space);
+}
+
+/**
+ * SetVMSpaceFile - 设置空间的文件映射
+ * @space: 空间
+ * @map: 文件映射
+ * @start: 文件数据在空间中的起始地址
+ * @offset: 文件数据的偏移
+ * @size: 文件数据的大小
+ * 
+ * 空间会持有映射的一个引用，页故障时再从文件读取数据
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int SetVMSpaceFile(struct VMSpace *space, struct FileMap *map,
+        address_t start, unsigned int offset, unsigned int size)
+{
+    if (space->fileMap != NULL) {
+        printk(PART_ERROR "SetVMSpaceFile: space [%x-%x] had file map!\n", 
+            space->start, space->end);
+        return -1;
+    }
+    FileMapGet(map);
+    space->fileMap = map;
+    space->fileStart = start;
+    space->fileOffset = offset;
+    space->fileSize = size;
+    return 0;
+}
+
+/**
+ * FillVMSpacePage - 从文件映射填充一个页
+ * @space: 有文件映射的空间
+ * @addr: 已经映射了物理页的页地址
+ * 
+ * 页中文件数据以外的部分填0，bss就是在这里按需清零的
+ * 成功返回0，失败返回-1
+ */
+PUBLIC int FillVMSpacePage(struct VMSpace *space, address_t addr)
+{
+    address_t start = space->fileStart;
+    address_t end = space->fileStart + space->fileSize;
+    
+    memset((void *)addr, 0, PAGE_SIZE);
+    
+    /* 计算页和文件数据的交集 */
+    if (start < addr)
+        start = addr;
+    if (end > addr + PAGE_SIZE)
+        end = addr + PAGE_SIZE;
+    
+    /* 页中全是bss */
+    if (start >= end)
+        return 0;
+    
+    if (FileMapRead(space->fileMap, space->fileOffset + (start - space->fileStart),
+            (void *)start, end - start) != end - start) {
+        printk(PART_ERROR "FillVMSpacePage: read page %x failed!\n", addr);
+        return -1;
+    }
+    return 0;
+}
+
 /**
  * InitVMSpace - 初始化虚拟空间
  */
 PUBLIC void InitVMSpace()
 {
+    vmSpaceCache = CreateMemCache("vmspace", sizeof(struct VMSpace), 0, 0, NULL);
+    if (vmSpaceCache == NULL)
+        Panic("create vmspace cache failed!\n");
+
     // 注册页故障处理中断
     InterruptRegisterHandler(0x0e, DoPageFault);
 
@@ -37,19 +37,21 @@ PRIVATE int ReadFileFrom(int fd, void *buffer, uint32_t offset, uint32_t size)
 
 /**
  * SegmentLoad - 加载段
- * @fd: 文件描述符
- * @offset: 
+ * @map: 文件映射
+ * @offset: 段在文件中的偏移
  * @fileSize: 段大小
+ * @memSize: 段在内存中的大小
  * @vaddr: 虚拟地址
  * 
- * 加载一个段到内存
+ * 只建立段的虚拟空间并记录文件映射，不读取数据，
+ * 访问到页时才在页故障中从文件读取，bss部分也在那时清零
  */
 PRIVATE int 
-SegmentLoad(int  fd, uint32_t offset, uint32_t fileSize, uint32_t memSize, uint32_t vaddr)
+SegmentLoad(struct FileMap *map, uint32_t offset, uint32_t fileSize, uint32_t memSize, uint32_t vaddr)
 {
     /*
-    printk(PART_TIP "SegmentLoad:fd %d off %x size %x mem %x vaddr %x\n",
-        fd, offset, fileSize, memSize, vaddr);
+    printk(PART_TIP "SegmentLoad:off %x size %x mem %x vaddr %x\n",
+        offset, fileSize, memSize, vaddr);
     */
     /* 获取虚拟地址的页对齐地址 */
     uint32_t vaddrFirstPage = vaddr & PAGE_ADDR_MASK;
@@ -71,19 +73,6 @@ SegmentLoad(int  fd, uint32_t offset, uint32_t fileSize, uint32_t memSize, uint3
         occupyPages = 1;
     }
 
-    /* 虚拟地址和物理地址进行映射 */
-    if (MapPagesMaybeMapped(vaddrFirstPage, occupyPages, PAGE_US_U | PAGE_RW_W)) {
-        printk(PART_ERROR "SegmentLoad: MapPagesMaybeMapped failed!\n");
-        return -1;
-    }
-    
-    /* 映射内存空间 */
-    /*if (MapPages(vaddrFirstPage, occupyPages * PAGE_SIZE, PAGE_US_U | PAGE_RW_W)) {
-        return -1;
-    }*/
-
-    //printk(PART_TIP "addr %x link done!\n", vaddrFirstPage);
-    
     /* 映射虚拟空间 */  
     int32 ret = (int32)SysMmap(vaddrFirstPage, occupyPages*PAGE_SIZE, 
             PROT_READ | PROT_WRITE | PROT_EXEC, MAP_FIXED);
@@ -93,14 +82,12 @@ SegmentLoad(int  fd, uint32_t offset, uint32_t fileSize, uint32_t memSize, uint3
     }
     //printk("task %s VMSpace: addr %x page %d\n",CurrentTask()->name, vaddrFirstPage, occupyPages);
     
-    /* 读取数据到内存中 */
-    if (ReadFileFrom(fd, (void *)vaddr, offset, fileSize)) {
-        //printk("read failed!\n");
+    /* 记录文件映射，页故障时再读取数据 */
+    struct VMSpace *space = FindVMSpace(CurrentTask()->mm, vaddrFirstPage);
+    if (space == NULL || SetVMSpaceFile(space, map, vaddr, offset, fileSize)) {
+        printk(PART_ERROR "SegmentLoad: set file map failed!\n");
         return -1;
     }
-
-    //memcpy(vaddr, iobuf, fileSize);
-
     return 0;
 }
 
@@ -111,6 +98,14 @@ SegmentLoad(int  fd, uint32_t offset, uint32_t fileSize, uint32_t memSize, uint3
 PRIVATE int LoadElfBinary(struct MemoryManager *mm, struct Elf32_Ehdr *elfHeader, int fd)
 {
     struct Elf32_Phdr progHeader;
+    int ret = 0;
+
+    /* 段的空间会持有映射的引用，在这里创建的引用加载完后释放 */
+    struct FileMap *map = FileMapCreate(fd);
+    if (map == NULL) {
+        printk(PART_ERROR "LoadElfBinary: create file map failed!\n");
+        return -1;
+    }
     /* 获取程序头起始偏移 */
     Elf32_Off progHeaderOffset = elfHeader->e_phoff;
     Elf32_Half progHeaderSize = elfHeader->e_phentsize;
@@ -124,8 +119,8 @@ PRIVATE int LoadElfBinary(struct MemoryManager *mm, struct Elf32_Ehdr *elfHeader
 
         /* 读取程序头 */
         if (ReadFileFrom(fd, (void *)&progHeader, progHeaderOffset, progHeaderSize)) {
-            
-            return -1;
+            ret = -1;
+            break;
         }
         /*printk(PART_TIP "read prog header off %x vaddr %x filesz %x memsz %x\n", 
             progHeader.p_offset, progHeader.p_vaddr, progHeader.p_filesz, progHeader.p_memsz);
@@ -135,23 +130,14 @@ PRIVATE int LoadElfBinary(struct MemoryManager *mm, struct Elf32_Ehdr *elfHeader
             //printk(PART_TIP "prog at %x type LOAD \n", &progHeader);
             
             /* 由于bss段不占用文件大小，但是要占用内存，
-            所以这个地方我们加载的时候就加载成memsz，
-            运行的时候访问未初始化的全局变量时才可以正确
+            所以这个地方我们映射的时候就映射成memsz，
             filesz用于读取磁盘上的数据，而memsz用于内存中的扩展，
-            因此filesz<=memsz
+            因此filesz<=memsz，多出来的部分在页故障时置0
              */
-            if (SegmentLoad(fd, progHeader.p_offset, 
+            if (SegmentLoad(map, progHeader.p_offset, 
                     progHeader.p_filesz, progHeader.p_memsz, progHeader.p_vaddr)) {
-                return -1;
-            }
-            
-            /* 如果内存占用大于文件占用，就要把内存中多余的部分置0 */
-            if (progHeader.p_memsz > progHeader.p_filesz) {
-                memset((void *)(progHeader.p_vaddr + progHeader.p_filesz), 0,
-                    progHeader.p_memsz - progHeader.p_filesz);
-                /*printk("memsz(%x) > filesz(%x)\n", 
-                    progHeader.p_memsz, progHeader.p_filesz);
-                */
+                ret = -1;
+                break;
             }
             
             /* 设置段的起始和结束 */
@@ -168,7 +154,8 @@ PRIVATE int LoadElfBinary(struct MemoryManager *mm, struct Elf32_Ehdr *elfHeader
         progHeaderOffset += progHeaderSize;
         progIdx++;
     }
-    return 0;
+    FileMapPut(map);
+    return ret;
 }
 
 PRIVATE int InitUserHeap(struct Task *current)
@@ -187,10 +174,9 @@ PRIVATE int InitUserStack(struct Task *task, struct TrapFrame *frame,
         char **argv, int argc)
 {
     /* 设置栈空间 */
-    struct VMSpace *space = (struct VMSpace *)\
-            kmalloc(sizeof(struct VMSpace), GFP_KERNEL);
+    struct VMSpace *space = AllocVMSpace();
     if (!space) {
-        printk(PART_ERROR "SysExecv: kmalloc for stack space failed!\n");
+        printk(PART_ERROR "SysExecv: alloc stack space failed!\n");
         return -1; 
     }
     space->end = USER_STACK_TOP;
@@ -316,7 +302,7 @@ ToFreePage:
     FreePages(paddr);
 ToFreeSpace:
     // 释放虚拟空间
-    kfree(space);
+    FreeVMSpace(space);
     
     return -1;
 }
@@ -438,6 +424,12 @@ PUBLIC int SysExecv(const char *path, const char *argv[])
         }
     }*/
     
+    /* 其它线程还在使用地址空间，不能替换 */
+    if (AtomicGet(&CurrentTask()->mm->users) > 1) {
+        printk(PART_ERROR "exec: task has other threads!\n");
+        return -1;
+    }
+
     /* 1.读取文件 */
 
     /* 检测是否可执行 */
@@ -618,7 +610,7 @@ ToEnd:
     /* 不修改标准输入，输出，错误 */
     /*unsigned char idx = 3;
     while (idx < MAX_OPEN_FILES_IN_PROC) {
-        current->fdTable[idx] = -1;
+        current->files->fdTable[idx] = -1;
         idx++;
     }*/
 
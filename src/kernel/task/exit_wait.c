@@ -66,14 +66,16 @@ PRIVATE void AdopeChildren(struct Task *cur)
  */
 PRIVATE void ReleaseZombie(struct Task *task)
 {
-    /* 回收页目录 */
-    if (task->pgdir)
-        kfree(task->pgdir);
-    /* 回收MM */
+    /* 回收页目录和MM，线程共享的由最后一个回收 */
     FreeTaskMemory(task);
 
-    /* 从全局队列中删除 */
-    ListDel(&task->globalList);
+    /* 回收信号行为，僵尸还可能收到信号，所以不在退出时回收 */
+    AtomicDec(&task->signals->count);
+    if (!AtomicGet(&task->signals->count))
+        kfree(task->signals);
+
+    /* 从全局队列中删除，宽限期后释放任务结构 */
+    TaskGloablListDel(task);
 }
 
 PRIVATE void CancelEverything(struct Task *task)
@@ -109,7 +111,7 @@ PUBLIC void ThreadExit(struct Task *thread)
 
     /* 如果在就绪队列中，就从就绪队列中删除 */
     if (IsTaskInPriorityQueue(thread)) {
-        ListDelInit(&thread->list);
+        TaskPriorityQueueDel(thread);
     }
     
     InterruptRestore(flags);
@@ -146,11 +148,18 @@ PUBLIC void SysExit(int status)
     /* 3.取消绑定的数据 */
     CancelEverything(current);
     
-    /* 5.释放文件资源 */
-    BOFS_ReleaseTaskFiles(current);
+    /* 5.释放文件资源，共享文件描述符表的最后一个任务才关闭文件 */
+    AtomicDec(&current->files->count);
+    if (!AtomicGet(&current->files->count)) {
+        BOFS_ReleaseTaskFiles(current);
+        kfree(current->files);
+    }
+    current->files = NULL;
     
-    /* 4.释放自己占用的内存资源 */
-    ExitVMSpace(current->mm);
+    /* 4.释放自己占用的内存资源，其它线程还在使用就保留 */
+    AtomicDec(&current->mm->users);
+    if (!AtomicGet(&current->mm->users))
+        ExitVMSpace(current->mm);
     
     /* 恢复之前的状态 */
     InterruptRestore(flags);
@@ -168,6 +177,18 @@ PUBLIC void SysExit(int status)
  * 返回子进程的pid
  */
 PUBLIC pid_t SysWait(int *status)
+{
+    return SysWaitPid(-1, status);
+}
+
+/**
+ * SysWaitPid - 等待指定的子进程
+ * @pid: 子进程的pid，-1表示任意一个子进程（不包括线程）
+ * @status: 保存子进程的退出状态的地址
+ * 
+ * 用来等待线程结束，返回子进程的pid，没有这个子进程返回-1
+ */
+PUBLIC pid_t SysWaitPid(pid_t pid, int *status)
 {
     struct Task *current = CurrentTask();
     //printk(PART_TIP "task name %s wait now!\n", current->name);
@@ -201,6 +222,12 @@ ToRepeat:
         if (child->parentPid != current->pid) {
             continue;
         }
+        /* 不是要等待的子进程 */
+        if (pid != -1 && child->pid != pid)
+            continue;
+        /* 共享地址空间的线程由pthread_join按pid等待，不能被任意等待回收 */
+        if (pid == -1 && child->mm != NULL && child->mm == current->mm)
+            continue;
 
         /* 如果子进程的父进程是当前进程，就找到一个子进程 */
         found = true;
@@ -9,7 +9,10 @@
 #include <book/arch.h>
 #include <book/debug.h>
 #include <book/task.h>
+#include <book/smp.h>
 #include <book/fs.h>
+#include <book/vmspace.h>
+#include <book/shm.h>
 #include <lib/string.h>
 #include <fs/bofs/file.h>
 
@@ -24,34 +27,137 @@ PRIVATE int CopyStructAndKstack(struct Task *childTask, struct Task *parentTask)
     /* 单独修改内容 */
     childTask->pid = ForkPid();
     childTask->elapsedTicks = 0;
+    childTask->waitTicks = 0;
+    childTask->voluntarySwitches = childTask->involuntarySwitches = 0;
     childTask->status = TASK_READY;
+    /* 子进程不继承父进程的动态优先级 */
+    childTask->priority = childTask->staticPriority;
     childTask->ticks = childTask->timeslice;
     childTask->parentPid = parentTask->pid;
     /* 重新设置链表，在这里不使用ListDel，那样会删除父进程在队列中的情况
     所以这里就直接把队列指针设为NULL，后面会添加到链表中*/
     childTask->list.next = childTask->list.prev = NULL;
     childTask->globalList.next = childTask->globalList.prev = NULL;
+    childTask->pidList.next = childTask->pidList.prev = NULL;
+    childTask->rcuReadDepth = 0;
     
     /* 复制名字，在后面追加fork表明是一个fork的进程，用于测试 */
     //strcat(childTask->name, "_fork");
     return 0;
 }
 
+/**
+ * UnsharePte - 撤销fork对父进程一个页表项的共享
+ * @space: 页所在的空间
+ * @pte: 父进程的页表项
+ * 
+ * 减少物理页的引用计数。可写空间中的页只剩父进程在使用时恢复写属性，
+ * 和之后写时复制的结果一样，需要在父进程的页目录中调用
+ */
+PRIVATE void UnsharePte(struct VMSpace *space, pte_t *pte)
+{
+    unsigned int paddr = *pte & PAGE_ADDR_MASK;
+    struct MemNode *node = Page2MemNode(paddr);
+
+    FreePages(paddr);
+    if (space->shm == NULL && (space->pageProt & PROT_WRITE) && node->reference == 1)
+        *pte |= PAGE_RW_W;
+}
+
+/**
+ * UndoCopyPageTable - 撤销已经复制的页表
+ * @childTask: 子进程
+ * @parentTask: 父进程
+ * @stopSpace: 撤销到这个空间为止，为NULL时撤销所有空间
+ * @stopVaddr: 在stopSpace中撤销到这个地址为止
+ * @buf: 中转页表项的缓冲区
+ * 
+ * 清除子进程中已经链接的页表项，撤销它们对物理页的共享，
+ * 最后释放子进程的页表，和CopyPageTable一样每个页表切换2次页目录
+ */
+PRIVATE void UndoCopyPageTable(struct Task *childTask, struct Task *parentTask,
+        struct VMSpace *stopSpace, uint32_t stopVaddr, pte_t *buf)
+{
+    struct VMSpace *space = parentTask->mm->spaceMap;
+    uint32_t progVaddr, end, spaceEnd;
+    pde_t *pde;
+    pte_t *pte;
+    int i, count;
+
+    while (space != NULL) {
+        spaceEnd = (space == stopSpace) ? stopVaddr : space->end;
+        progVaddr = space->start;
+        while (progVaddr < spaceEnd) {
+            end = (progVaddr & 0xffc00000) + PAGE_SIZE * PAGE_ENTRY_NR;
+            if (end > spaceEnd)
+                end = spaceEnd;
+            count = (end - progVaddr) / PAGE_SIZE;
+
+            /* 1.取出并清除子进程的页表项 */
+            PageDirActive(childTask);
+            if (*PageGetPde(progVaddr) & PAGE_P_1) {
+                pte = PageGetPte(progVaddr);
+                for (i = 0; i < count; i++) {
+                    buf[i] = pte[i];
+                    pte[i] = 0;
+                }
+            } else {
+                memset(buf, 0, count * sizeof(pte_t));
+            }
+
+            /* 2.在父进程中撤销这些页的共享 */
+            PageDirActive(parentTask);
+            pte = PageGetPte(progVaddr);
+            for (i = 0; i < count; i++) {
+                if (buf[i] & PAGE_P_1)
+                    UnsharePte(space, &pte[i]);
+            }
+            progVaddr = end;
+        }
+        if (space == stopSpace)
+            break;
+        space = space->next;
+    }
+
+    /* 3.页表项都已经清除，释放子进程用户空间的页表 */
+    PageDirActive(childTask);
+    for (progVaddr = 0; progVaddr < PAGE_OFFSET; progVaddr += PAGE_SIZE * PAGE_ENTRY_NR) {
+        pde = PageGetPde(progVaddr);
+        if (*pde & PAGE_P_1) {
+            FreePages(*pde & PAGE_ADDR_MASK);
+            *pde = 0;
+        }
+    }
+    PageDirActive(parentTask);
+}
+
+/**
+ * CopyPageTable - 复制页表
+ * @childTask: 子进程
+ * @parentTask: 父进程
+ * 
+ * 写时复制：不复制页的数据，父子进程共享同一个物理页，
+ * 并且都把页设置成只读，增加物理页的引用计数。谁先写这个页，
+ * 谁就在页故障中复制一份自己的页。
+ * 共享内存的页不做写时复制，父子进程继续写同一个物理页。
+ * 每次处理一个页表覆盖的范围，只需要切换2次页目录。
+ * 失败时撤销已经做的共享，子进程不会留下任何用户页表
+ */
 PRIVATE int CopyPageTable(struct Task *childTask, struct Task *parentTask)
 {
-    
-    /* 开始内存的复制 */
-    void *buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
+    /* 用来在父子进程之间中转一个页表的页表项 */
+    pte_t *buf = kmalloc(PAGE_SIZE, GFP_KERNEL);
     if (!buf) {
-        printk(PART_ERROR "CopyPageTable: kmalloc buf for data transform failed!\n");
+        printk(PART_ERROR "CopyPageTable: kmalloc buf for pte transform failed!\n");
         return -1;
     }
         
     /* 获取父目录的虚拟空间 */
     struct VMSpace *space = parentTask->mm->spaceMap;
     
-    uint32_t progVaddr = 0;
-    uint32_t paddr;
+    uint32_t progVaddr, end;
+    pte_t *pte;
+    int i, j, count;
     
     /* 当空间不为空时就一直获取 */
     while (space != NULL) {
@@ -60,40 +166,98 @@ PRIVATE int CopyPageTable(struct Task *childTask, struct Task *parentTask)
         // printk(PART_TIP "the space %x start %x end %x\n", space, space->start, space->end);
         /* 在空间中进行复制 */
         while (progVaddr < space->end) {
-            /* 1.将进程空间中的数据复制到内核空间，切换页表后，
-            还能访问到父进程中的数据 */
-            memcpy(buf, (void *)progVaddr, PAGE_SIZE);
+            /* 本次处理到这个页表的末尾，或者是空间的末尾 */
+            end = (progVaddr & 0xffc00000) + PAGE_SIZE * PAGE_ENTRY_NR;
+            if (end > space->end)
+                end = space->end;
+            
+            /* 父进程没有这个页表，就没有需要共享的页 */
+            if (!(*PageGetPde(progVaddr) & PAGE_P_1)) {
+                progVaddr = end;
+                continue;
+            }
+            
+            /* 1.在父进程中把页改成只读，并增加物理页的引用 */
+            pte = PageGetPte(progVaddr);
+            count = (end - progVaddr) / PAGE_SIZE;
+            for (i = 0; i < count; i++) {
+                if (pte[i] & PAGE_P_1) {
+                    if (SharePages(pte[i] & PAGE_ADDR_MASK)) {
+                        printk(PART_ERROR "CopyPageTable: share page %x failed!\n", 
+                            pte[i] & PAGE_ADDR_MASK);
+                        /* 撤销这个页表中已经共享的页 */
+                        for (j = 0; j < i; j++) {
+                            if (pte[j] & PAGE_P_1)
+                                UnsharePte(space, &pte[j]);
+                        }
+                        goto ToUndo;
+                    }
+                    if (space->shm == NULL)
+                        pte[i] &= ~PAGE_RW_W;
+                }
+                buf[i] = pte[i];
+            }
 
-            /* 2.切换进程空间 */
+            /* 2.切换到子进程空间，链接到相同的物理页
+            切换页目录会刷新TLB，所以父进程修改后的页表项也会生效 */
             PageDirActive(childTask);
 
-            /* 3.映射虚拟地址 */
-            // 分配一个物理页
-            paddr = AllocPage();
-            if (!paddr) {
-                printk(PART_ERROR "CopyPageTable: GetFreePage for vaddr failed!\n");
+            for (i = 0; i < count; i++) {
+                if (!(buf[i] & PAGE_P_1))
+                    continue;
+                
+                if (PageTableAdd(progVaddr + i * PAGE_SIZE, buf[i] & PAGE_ADDR_MASK,
+                        buf[i] & (PAGE_US_U | PAGE_RW_W))) {
+                    printk(PART_ERROR "CopyPageTable: PageTableAdd for vaddr failed!\n");
         
-                /* 激活父进程并返回 */
-                PageDirActive(parentTask);
-                return -1;
+                    /* 子进程还没有链接的页在父进程中撤销，已经链接的由下面撤销 */
+                    PageDirActive(parentTask);
+                    pte = PageGetPte(progVaddr);
+                    for (j = i; j < count; j++) {
+                        if (buf[j] & PAGE_P_1)
+                            UnsharePte(space, &pte[j]);
+                    }
+                    progVaddr = end;
+                    goto ToUndo;
+                }
             }
-            // 页链接，从动态内存中分配一个页并且页保护是 用户，可写
-            PageTableAdd(progVaddr, paddr, PAGE_US_U | PAGE_RW_W);
-
-            /* 4.从内核复制数据到进程 */
-            memcpy((void *)progVaddr, buf, PAGE_SIZE);
 
-            /* 5.恢复父进程内存空间 */
+            /* 3.恢复父进程内存空间 */
             PageDirActive(parentTask);
-            // printk(PART_TIP "copy at virtual address %x\n", progVaddr);
-            /* 指向下一个页 */
-            progVaddr += PAGE_SIZE;
+            
+            /* 指向下一个页表的范围 */
+            progVaddr = end;
         }
         /* 指向下一个空间 */
         space = space->next;
     }
     kfree(buf);
     return 0; 
+
+ToUndo:
+    /* 撤销之前的页表和本次页表中子进程已经链接的页 */
+    UndoCopyPageTable(childTask, parentTask, space, progVaddr, buf);
+    kfree(buf);
+    return -1;
+}
+
+/**
+ * FreeChildVMSpace - 释放复制给子进程的空间
+ * @childTask: 子任务
+ * 
+ * fork失败时使用，空间里的页表已经撤销，只释放空间和它们对文件映射、
+ * 共享内存的引用
+ */
+PRIVATE void FreeChildVMSpace(struct Task *childTask)
+{
+    struct VMSpace *space = childTask->mm->spaceMap, *next;
+
+    while (space != NULL) {
+        next = space->next;
+        FreeVMSpace(space);
+        space = next;
+    }
+    childTask->mm->spaceMap = NULL;
 }
 
 PRIVATE int CopyVMSpace(struct Task *childTask, struct Task *parentTask)
@@ -104,15 +268,21 @@ PRIVATE int CopyVMSpace(struct Task *childTask, struct Task *parentTask)
     struct VMSpace *p = parentTask->mm->spaceMap;
     while (p != NULL) {
         /* 分配一个空间 */
-        struct VMSpace *space = (struct VMSpace *)kmalloc(
-                sizeof(struct VMSpace), GFP_KERNEL);
+        struct VMSpace *space = AllocVMSpace();
         if (space == NULL) {
-            printk(PART_ERROR "CopyVMSpace: kmalloc for space failed!\n");
+            printk(PART_ERROR "CopyVMSpace: alloc space failed!\n");
+            FreeChildVMSpace(childTask);
             return -1;
         }
             
         /* 复制空间信息 */
         *space = *p;
+        /* 和父任务共享文件映射 */
+        if (space->fileMap != NULL)
+            FileMapGet(space->fileMap);
+        /* 和父任务共享共享内存对象 */
+        if (space->shm != NULL)
+            ShmGet(space->shm);
         /* 把下一个空间置空，后面加入链表 */
         space->next = NULL;
 
@@ -211,21 +381,141 @@ PRIVATE int BuildChildStack(struct Task *childTask)
 
 PRIVATE int CopyPageTableAndVMSpace(struct Task *childTask, struct Task *parentTask)
 {
-    /* 复制页表内容，因为所有的东西都在里面 */
-    if (CopyPageTable(childTask, parentTask))
+    /* 复制VMSpace，先复制空间，失败时还没有共享任何页 */
+    if (CopyVMSpace(childTask, parentTask))
         return -1;
     
-    /* 复制VMSpace */
-    if (CopyVMSpace(childTask, parentTask))
+    /* 复制页表内容，因为所有的东西都在里面，失败时已经撤销了共享 */
+    if (CopyPageTable(childTask, parentTask)) {
+        FreeChildVMSpace(childTask);
         return -1;
+    }
     
+    /* 父进程的页变成了只读，和它共享地址空间的线程也要看到 */
+    SmpFlushTlbOthers(parentTask->mm);
     return 0;
 }
 
+/**
+ * CopyMemory - 复制或者共享地址空间
+ * @childTask: 子任务
+ * @parentTask: 父任务
+ * @cloneFlags: clone的标志
+ * 
+ * 失败时已经释放了子任务的内存管理器，不会留下任何引用
+ */
+PRIVATE int CopyMemory(struct Task *childTask, struct Task *parentTask,
+        unsigned long cloneFlags)
+{
+    /* 线程直接使用父任务的页目录和内存管理器 */
+    if (cloneFlags & CLONE_VM) {
+        AtomicInc(&parentTask->mm->users);
+        AtomicInc(&parentTask->mm->count);
+        return 0;
+    }
+
+    /* 初始化任务的内存管理器 */
+    AllocTaskMemory(childTask);
+    
+    childTask->pgdir = CreatePageDir();
+    if (childTask->pgdir == NULL) {
+        printk(PART_ERROR "CopyMemory: CreatePageDir failed!\n");
+        FreeTaskMemory(childTask);
+        return -1;
+    }
+    /* 复制页表和虚拟内存空间 */
+    if (CopyPageTableAndVMSpace(childTask, parentTask)) {
+        FreeTaskMemory(childTask);
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * CopyFiles - 复制或者共享文件描述符表
+ * @childTask: 子任务
+ * @parentTask: 父任务
+ * @cloneFlags: clone的标志
+ */
+PRIVATE void CopyFiles(struct Task *childTask, struct Task *parentTask,
+        unsigned long cloneFlags)
+{
+    /* 共享的表里的文件已经有引用了，不用再增加 */
+    if (cloneFlags & CLONE_FILES) {
+        AtomicInc(&parentTask->files->count);
+        return;
+    }
+
+    AllocTaskFiles(childTask);
+    memcpy(childTask->files->fdTable, parentTask->files->fdTable,
+        sizeof(childTask->files->fdTable));
+
+    /* 更新打开节点文件 */
+    BOFS_UpdateInodeOpenCounts(childTask);
+}
+
+/**
+ * CopySignals - 复制或者共享信号行为
+ * @childTask: 子任务
+ * @parentTask: 父任务
+ * @cloneFlags: clone的标志
+ */
+PRIVATE void CopySignals(struct Task *childTask, struct Task *parentTask,
+        unsigned long cloneFlags)
+{
+    if (cloneFlags & CLONE_SIGHAND) {
+        AtomicInc(&parentTask->signals->count);
+        return;
+    }
+
+    AllocTaskSignals(childTask);
+    memcpy(childTask->signals->action, parentTask->signals->action,
+        sizeof(childTask->signals->action));
+    memcpy(childTask->signals->sender, parentTask->signals->sender,
+        sizeof(childTask->signals->sender));
+    SpinLockInit(&childTask->signals->signalLock);
+}
+
+/**
+ * PutFiles - 撤销CopyFiles
+ * @childTask: 子任务
+ * 
+ * 共享的表只减少引用，复制的表撤销对文件的引用后释放
+ */
+PRIVATE void PutFiles(struct Task *childTask)
+{
+    AtomicDec(&childTask->files->count);
+    if (!AtomicGet(&childTask->files->count)) {
+        BOFS_PutInodeOpenCounts(childTask);
+        kfree(childTask->files);
+    }
+    childTask->files = NULL;
+}
+
+/**
+ * PutSignals - 撤销CopySignals
+ * @childTask: 子任务
+ */
+PRIVATE void PutSignals(struct Task *childTask)
+{
+    AtomicDec(&childTask->signals->count);
+    if (!AtomicGet(&childTask->signals->count))
+        kfree(childTask->signals);
+    childTask->signals = NULL;
+}
+
 /**
  * CopyTask - 拷贝父进程的资源给子进程
+ * @childTask: 子任务
+ * @parentTask: 父任务
+ * @cloneFlags: clone的标志，fork时为0
+ * @stack: 子任务的用户栈，为NULL时和父任务使用相同的栈地址
+ * 
+ * 可能失败的地址空间放在最后复制，失败时按相反的顺序撤销
+ * 已经获取的文件和信号行为，子任务不会留下任何引用
  */
-PRIVATE int CopyTask(struct Task *childTask, struct Task *parentTask)
+PRIVATE int CopyTask(struct Task *childTask, struct Task *parentTask,
+        unsigned long cloneFlags, void *stack)
 {
     /* 1.复制任务结构体和内核栈道子进程 */
     if (CopyStructAndKstack(childTask, parentTask))
@@ -236,17 +526,13 @@ PRIVATE int CopyTask(struct Task *childTask, struct Task *parentTask)
             parentTask->name, parentTask, childTask->name, childTask);
      */
 
-    /* 2.初始化任务的内存管理器 */
-    AllocTaskMemory(childTask);
-    
-    childTask->pgdir = CreatePageDir();
-    if (childTask->pgdir == NULL) {
-        printk(PART_ERROR "CopyTask: CreatePageDir failed!\n");
-        return -1;
-    }
-    /* 3.复制页表和虚拟内存空间 */
-    if (CopyPageTableAndVMSpace(childTask, parentTask))
-        return -1;
+    /* 2.复制或者共享文件和信号行为 */
+    CopyFiles(childTask, parentTask, cloneFlags);
+    CopySignals(childTask, parentTask, cloneFlags);
+
+    /* 3.复制或者共享地址空间 */
+    if (CopyMemory(childTask, parentTask, cloneFlags))
+        goto ToPutSignals;
     // printk(PART_TIP "CopyPageTableAndVMSpace\n");
 
     /* 4.构建线程栈和修改返回值 */
@@ -254,20 +540,29 @@ PRIVATE int CopyTask(struct Task *childTask, struct Task *parentTask)
     //Spin("BuildChildStack");
     // printk(PART_TIP "BuildChildStack\n");
 
-    /* 更新打开节点文件 */
-    BOFS_UpdateInodeOpenCounts(childTask);
-
+    /* 线程从自己的栈上开始运行 */
+    if (stack != NULL) {
+        struct TrapFrame *frame = (struct TrapFrame *)(
+            (uint32_t)childTask + TASK_KSTACK_SIZE - sizeof(struct TrapFrame));
+        frame->esp = (uint32_t)stack;
+    }
     return 0;
+
+ToPutSignals:
+    PutSignals(childTask);
+    PutFiles(childTask);
+    return -1;
 }
 
 /**
- * SysFork - fork系统调用
+ * DoFork - 创建子任务
+ * @cloneFlags: clone的标志
+ * @stack: 子任务的用户栈
  * 
  * 如果失败，应该回滚回收之前分配的内存
- * 创建一个和自己一样的进程
  * 返回-1则失败，返回0表示子进程自己，返回>0表示父进程
  */
-PUBLIC pid_t SysFork()
+PRIVATE pid_t DoFork(unsigned long cloneFlags, void *stack)
 {
     /* 保存之前状态并关闭中断 */
     unsigned long flags = InterruptSave();
@@ -277,7 +572,8 @@ PUBLIC pid_t SysFork()
     /* 为子进程分配空间 */
     struct Task *childTask = kmalloc(TASK_KSTACK_SIZE, GFP_KERNEL);
     if (childTask == NULL) {
-        printk(PART_ERROR "SysFork: kmalloc for child task failed!\n");
+        printk(PART_ERROR "DoFork: kmalloc for child task failed!\n");
+        InterruptRestore(flags);
         return -1;
     }
         
@@ -285,12 +581,18 @@ PUBLIC pid_t SysFork()
     ASSERT(parentTask->pgdir != NULL);
     
     /* 复制进程 */
-    if (CopyTask(childTask, parentTask)) {
-        printk(PART_ERROR "SysFork: copy task failed!\n");
+    if (CopyTask(childTask, parentTask, cloneFlags, stack)) {
+        printk(PART_ERROR "DoFork: copy task failed!\n");
         kfree(childTask);
+        InterruptRestore(flags);
         return -1;
     }
     
+    /* 子进程从InterruptExit返回用户态时会释放大内核锁 */
+    childTask->lockDepth = 1;
+    /* 放到负载最轻的处理器上运行 */
+    childTask->cpu = ScheduleSelectCpu();
+
     /* 把子进程添加到就绪队列和全局链表 */
     TaskGloablListAdd(childTask);
     
@@ -308,4 +610,42 @@ PUBLIC pid_t SysFork()
     //printk("fork return!\n");
     /* 返回子进程的pid */
     return childTask->pid;
+}
+
+/**
+ * SysFork - fork系统调用
+ * 
+ * 创建一个和自己一样的进程
+ * 返回-1则失败，返回0表示子进程自己，返回>0表示父进程
+ */
+PUBLIC pid_t SysFork()
+{
+    return DoFork(0, NULL);
+}
+
+/**
+ * SysClone - clone系统调用
+ * @flags: 和父任务共享的资源
+ * @stack: 子任务的用户栈，为NULL时使用和父任务相同的栈地址
+ * 
+ * 用CLONE_THREAD_FLAGS创建和父任务共享地址空间、文件和信号行为的线程，
+ * 线程必须有自己的栈。返回值和fork一样
+ */
+PUBLIC pid_t SysClone(unsigned long flags, void *stack)
+{
+    if (flags & ~CLONE_THREAD_FLAGS)
+        return -1;
+
+    /* 信号处理函数在用户空间中，只能和共享地址空间的任务共享 */
+    if ((flags & CLONE_SIGHAND) && !(flags & CLONE_VM))
+        return -1;
+
+    /* 共享地址空间时用同一个栈会互相破坏 */
+    if ((flags & CLONE_VM) && stack == NULL)
+        return -1;
+
+    if (stack != NULL && (unsigned long)stack > USER_VM_SIZE)
+        return -1;
+
+    return DoFork(flags, stack);
 }
\ No newline at end of file
@@ -0,0 +1,156 @@
+/*
+ * file:		kernel/task/lockstat.c
+ * auther:	    Jason Hu
+ * time:		2020/3/11
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/lockstat.h>
+#include <clock/clocksource.h>
+#include <lib/string.h>
+#include <lib/math.h>
+
+#ifdef CONFIG_LOCK_STAT
+
+/* 所有用过的锁类 */
+PRIVATE LIST_HEAD(lockClassList);
+
+/**
+ * LockClassRegister - 第一次使用时注册锁类
+ * @lockClass: 锁类
+ *
+ * 需要关闭中断后调用
+ */
+PRIVATE INLINE void LockClassRegister(struct LockClass *lockClass)
+{
+    if (lockClass->list.next == NULL)
+        ListAddTail(&lockClass->list, &lockClassList);
+}
+
+/**
+ * LockStatWaitStart - 开始等待锁
+ *
+ * 返回开始等待的时间，获取锁后传给LockStatContended
+ */
+PUBLIC unsigned long long LockStatWaitStart()
+{
+    return ClockSourceNow();
+}
+
+/**
+ * LockStatContended - 记录一次竞争
+ * @lockClass: 锁类
+ * @waitStart: 开始等待的时间
+ */
+PUBLIC void LockStatContended(struct LockClass *lockClass, unsigned long long waitStart)
+{
+    unsigned long long wait = ClockSourceNow() - waitStart;
+
+    unsigned long flags = InterruptSave();
+
+    LockClassRegister(lockClass);
+    lockClass->contentions++;
+    lockClass->waitTime += wait;
+    if (wait > lockClass->waitMax)
+        lockClass->waitMax = wait;
+
+    InterruptRestore(flags);
+}
+
+/**
+ * LockStatAcquired - 记录一次获取
+ * @lockClass: 锁类
+ *
+ * 返回获取的时间，释放时传给LockStatReleased
+ */
+PUBLIC unsigned long long LockStatAcquired(struct LockClass *lockClass)
+{
+    unsigned long flags = InterruptSave();
+
+    LockClassRegister(lockClass);
+    lockClass->acquisitions++;
+
+    InterruptRestore(flags);
+    return ClockSourceNow();
+}
+
+/**
+ * LockStatReleased - 记录一次释放
+ * @lockClass: 锁类
+ * @acquireTime: 获取的时间
+ */
+PUBLIC void LockStatReleased(struct LockClass *lockClass, unsigned long long acquireTime)
+{
+    unsigned long long hold = ClockSourceNow() - acquireTime;
+
+    unsigned long flags = InterruptSave();
+
+    lockClass->holdTime += hold;
+    if (hold > lockClass->holdMax)
+        lockClass->holdMax = hold;
+
+    InterruptRestore(flags);
+}
+
+/**
+ * LockStatUsec - 把纳秒转换成微秒
+ * @ns: 纳秒数
+ */
+PRIVATE unsigned long LockStatUsec(unsigned long long ns)
+{
+    DivU64(&ns, 1000);
+    return (unsigned long)ns;
+}
+
+#endif  /* CONFIG_LOCK_STAT */
+
+/**
+ * SysLockScan - 扫描锁类的竞争统计
+ * @ls: 储存状态的结构
+ * @idx: 要扫描的锁类的索引，扫描后指向下一个
+ *
+ * 成功返回0，到达末尾或者没有配置锁统计返回-1
+ */
+PUBLIC int SysLockScan(lockscan_status_t *ls, unsigned int *idx)
+{
+#ifdef CONFIG_LOCK_STAT
+    struct LockClass *lockClass;
+    unsigned int n = 0;
+
+    if (ls == NULL || idx == NULL)
+        return -1;
+
+    unsigned long flags = InterruptSave();
+
+    /* 找到第idx个锁类 */
+    ListForEachOwner(lockClass, &lockClassList, list) {
+        if (n == *idx)
+            break;
+        n++;
+    }
+
+    /* 已经到达末尾了 */
+    if (&lockClass->list == &lockClassList) {
+        InterruptRestore(flags);
+        return -1;
+    }
+
+    memset(ls->ls_name, 0, sizeof(ls->ls_name));
+    strncpy(ls->ls_name, lockClass->name, sizeof(ls->ls_name) - 1);
+    ls->ls_acquisitions = lockClass->acquisitions;
+    ls->ls_contentions  = lockClass->contentions;
+    ls->ls_waittime     = LockStatUsec(lockClass->waitTime);
+    ls->ls_waitmax      = LockStatUsec(lockClass->waitMax);
+    ls->ls_holdtime     = LockStatUsec(lockClass->holdTime);
+    ls->ls_holdmax      = LockStatUsec(lockClass->holdMax);
+
+    InterruptRestore(flags);
+
+    (*idx)++;
+    return 0;
+#else
+    return -1;
+#endif  /* CONFIG_LOCK_STAT */
+}
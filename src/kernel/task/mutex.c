@@ -11,123 +11,132 @@
 #include <book/task.h>
 #include <book/schedule.h>
 #include <book/waitqueue.h>
+#include <book/smp.h>
+#include <book/lockstat.h>
+#include <book/rcu.h>
 
 /**
- * MutexInit - 初始化自旋锁
+ * __MutexInit - 初始化互斥锁
  * @lock: 锁对象
+ * @lockClass: 锁类
  */
-PUBLIC void MutexInit(struct Mutex *lock)
+PUBLIC void __MutexInit(struct Mutex *lock, struct LockClass *lockClass)
 {
-    /* 默认是1，表示没有空闲 */
+    /* 默认是1，表示没有上锁 */
     AtomicSet(&lock->count, 1);
 
-    /* 初始化维护count变量的自旋锁 */
-    SpinLockInit(&lock->countLock);
-    
-    /* 初始化维护等待队列的自旋锁 */
+    /* 初始化维护count和等待队列的自旋锁 */
     SpinLockInit(&lock->waitLock);
 
     /* 初始化等待队列 */
-    INIT_LIST_HEAD(&lock->waitList);
+    WaitQueueInit(&lock->waitQueue, NULL);
 
     /* 清除锁的持有者 */
     MUTEX_CLEAR_OWNER(lock);
+
+    lock->lockClass = lockClass;
+    lock->acquireTime = 0;
 }
 
 PUBLIC void DumpMutex(struct Mutex *lock)
 {
     printk(PART_TIP "----Mutext----\n");
-    printk(PART_TIP "self:%x count:%d \n", lock, AtomicGet(&lock->count));
+    printk(PART_TIP "self:%x count:%d owner:%x class:%s\n", lock, AtomicGet(&lock->count),
+        lock->owner, lock->lockClass ? lock->lockClass->name : "none");
 }
 
 /**
- * __MutexLock - 自旋锁加锁
+ * MutexOwnerRunning - 检测锁的持有者是否正在其它处理器上运行
  * @lock: 锁对象
  */
-PUBLIC int __MutexLock(struct Mutex *lock)
+PRIVATE int MutexOwnerRunning(struct Mutex *lock)
 {
-    /*
-    获取锁把count从1变成0
-    */
-    
-    /* 先把锁值减1，如果不为负，就说明获取成功，就直接返回 */
+    struct Task *owner = lock->owner;
 
-    /* 通过关闭中断保证dec 和 get两步操作是原子的 */
-    unsigned long flags = SpinLockIrqSave(&lock->countLock);
+    if (owner == NULL || cpuOnlineNr < 2)
+        return 0;
 
-    AtomicDec(&lock->count);
-    if (AtomicGet(&lock->count) >= 0) {
-        /* 恢复之前的中断状态 */
-        SpinUnlockIrqSave(&lock->countLock, flags);    
-        return 0;     /* 获取成功，返回 */ 
-    }
-    /* 恢复之前的中断状态 */
-    SpinUnlockIrqSave(&lock->countLock, flags);    
+    return owner->cpu != CurrentCpuId() && cpus[owner->cpu].current == owner;
+}
 
-    /* 锁已经被其它任务获取了，自己需要等待锁被释放 */
-    
-    /* 获取当前的任务 */
-    struct Task *current =  CurrentTask();
+/**
+ * MutexSpin - 持有者正在运行时自旋等待
+ * @lock: 锁对象
+ *
+ * 持有者运行在内核中就需要大内核锁，所以每次自旋都让出大内核锁，
+ * 让它能够执行到释放锁。获得了锁返回1，否则返回0
+ */
+PRIVATE int MutexSpin(struct Mutex *lock)
+{
+    int spin, locked = 0;
 
-    /* 等待队列 */
-    struct WaitQueue waiter;
+    /* 持有者可能在自旋期间退出，读临界区保证它的任务结构不会被释放 */
+    RcuReadLock();
 
-    /* 对该锁上的等待队列加自旋锁，防止多个CPU的情况。 */
-    SpinLock(&lock->waitLock);
+    for (spin = 0; spin < MUTEX_SPIN_COUNT; spin++) {
+        if (!MutexOwnerRunning(lock))
+            break;
 
-    /* 加入等待队列,FIFO */
-    ListAddTail(&waiter.waitList, &lock->waitList);
-    waiter.task = current;
+        KernelLockRelax();
 
-    int oldValue;
-   
-    /* 如果还是没有获得锁，循环获取锁 */
-    do {
-        /* 用原子操作赋值，lock->count=-1, 保证该操作在一个cpu上是原子的 */
-        oldValue = ATOMIC_XCHG(&lock->count, -1);
-        //printk("\nold value:%d\n", oldValue);
+        if (MutexTryLock(lock)) {
+            locked = 1;
+            break;
+        }
+    }
 
-        /* 如果lock->count之前的值为1，说明是可以获取锁的 */
-        if (oldValue == 1)
-            break;      /* 获得了锁，跳出循环 */
+    RcuReadUnlock();
+    return locked;
+}
 
-        /* 如果是可以接受信号的，就去处理收到的信号，并退出循环 */
+/**
+ * __MutexLock - 互斥锁加锁
+ * @lock: 锁对象
+ *
+ * 获取失败时先自适应自旋，然后在等待队列上睡眠，直到被释放锁的任务唤醒
+ */
+PRIVATE void __MutexLock(struct Mutex *lock)
+{
+    /* 快速路径：锁是空闲的，直接获取 */
+    if (MutexTryLock(lock))
+        return;
 
-        /* 设置成阻塞状态 */
-        SET_TASK_STATUS(current, TASK_BLOCKED);
+    unsigned long long waitStart = LockStatWaitStart();
 
-        /* 如果还不能获取所，则将自旋锁解除，当从schedule返回时再次获取自旋锁，
-        重复如上操作。*/
-        SpinUnlock(&lock->waitLock);
+    /* 持有者正在运行，它很快就会释放锁 */
+    if (MutexSpin(lock))
+        goto Contended;
 
-        /* 让出cpu执行，既不是休眠等待唤醒，也不是直接循环等待，介于2者之间。耗时：Spinlock < Mutex < Semaphore */
-        Schedule();
+    /* 锁已经被其它任务获取了，自己需要睡眠等待锁被释放 */
+    struct WaitQueue waiter;
+    WaitQueueInit(&waiter, CurrentTask());
 
-        /* 对该锁上的等待队列加自旋锁，防止多个CPU的情况。 */
-        SpinLock(&lock->waitLock);
+    unsigned long flags = SpinLockIrqSave(&lock->waitLock);
 
-        //printk("wakeup %s\n", current->name);
-    } while (1);
+    /* 把count设置成-1，表示有等待者，之前的值为1说明获得了锁 */
+    while (ATOMIC_XCHG(&lock->count, -1) != 1) {
+        WaitQueuePrepare(&lock->waitQueue, &waiter);
 
-    /* 获取了锁 */
+        /* 中断仍然是关闭的，释放锁的任务会在调度后才能唤醒自己 */
+        SpinUnlock(&lock->waitLock);
+        Schedule();
+        SpinLock(&lock->waitLock);
+    }
 
-    /* 将任务从等待队列中移除 */
-    ListDel(&waiter.waitList);
-    waiter.task = NULL;
+    /* 获取了锁，将自己从等待队列中移除 */
+    WaitQueueFinish(&lock->waitQueue, &waiter);
 
-    /* 如果等待队列为空将lock->count置为0，就是说只有当前任务获得了锁 */
-    if (ListEmpty(&lock->waitList)) {
+    /* 如果没有其它等待者，把lock->count置为0，释放时就不用唤醒 */
+    if (!WaitQueueActive(&lock->waitQueue))
         AtomicSet(&lock->count, 0);
-    }
 
-    /* 解锁等待队列自旋锁。 */
-    SpinUnlock(&lock->waitLock);
-    return 0;
+    SpinUnlockIrqSave(&lock->waitLock, flags);
+Contended:
+    LockStatContended(lock->lockClass, waitStart);
 }
 
-
 /**
- * MutexLock - 自旋锁加锁
+ * MutexLock - 互斥锁加锁
  * @lock: 锁对象
  */
 PUBLIC void MutexLock(struct Mutex *lock)
@@ -139,73 +148,33 @@ PUBLIC void MutexLock(struct Mutex *lock)
 
     /* 设置锁的持有者为当前任务 */
     MUTEX_SET_OWNER(lock);
-}
 
-/**
- * __MutexUnlock - 自旋锁解锁
- * @lock: 锁对象
- */
-PUBLIC int __MutexUnlock(struct Mutex *lock)
-{
-    /* 对引用计数器实行加1操作，如果加后小于等于0，
-    说明该等待队列上还有任务需要获取锁 */
-
-    /* 通过关闭中断保证inc 和 get两步操作是原子的 */
-    unsigned long flags = SpinLockIrqSave(&lock->countLock);
-
-    AtomicInc(&lock->count);
-    if (AtomicGet(&lock->count) == 1) {
-        /* 恢复之前的中断状态 */
-        SpinUnlockIrqSave(&lock->countLock ,flags);
-        return 0;     /* 没有任务请求了，返回 */ 
-    }
-    /* 恢复之前的中断状态 */
-    SpinUnlockIrqSave(&lock->countLock, flags);    
-
-    /* 现在count != 0, 等待队列上还有任务要请求 */
-
-    /* 对该锁上的等待队列加自旋锁，防止多个CPU的情况。 */
-    SpinLock(&lock->waitLock);
-
-    /* 修复计数器的值，解锁的时候，只能允许计数器的值为1 */
-    if (AtomicGet(&lock->count) > 1) {
-        AtomicSet(&lock->count, 1);
-    }
-    
-    /* 先看看等待队列是不是为空了，如果已经为空，
-    不需要做任何处理，否则将该等待队列上面的队首进程唤醒 */
-    if (!ListEmpty(&lock->waitList)) {
-        /* 获取第一个等待者 */
-        struct WaitQueue *waiter = ListFirstOwner(&lock->waitList, struct WaitQueue, waitList);
-
-        /* 唤醒任务 */
-        TaskWakeUp(waiter->task);
-    }
-
-    /* 解锁等待队列自旋锁。 */
-    SpinUnlock(&lock->waitLock);
-
-    return 0;
+    lock->acquireTime = LockStatAcquired(lock->lockClass);
 }
 
 /**
- * MutexUnlock - 自旋锁解锁
+ * MutexUnlock - 互斥锁解锁
  * @lock: 锁对象
  */
 PUBLIC void MutexUnlock(struct Mutex *lock)
 {
-    /*
-    释放锁把count从0变成1
-    */
-    __MutexUnlock(lock);
+    LockStatReleased(lock->lockClass, lock->acquireTime);
 
     /* 清空互斥锁owner(此处不需要加自旋锁，不存在读写冲突问题，
     没有获取到锁的任务不会读写owner，没有获取到互斥的任务更不会释放互斥锁) */
     MUTEX_CLEAR_OWNER(lock);
+
+    unsigned long flags = SpinLockIrqSave(&lock->waitLock);
+
+    /* 释放锁把count变成1，之前小于0说明有等待者，唤醒最早等待的一个 */
+    if (ATOMIC_XCHG(&lock->count, 1) < 0)
+        WaitQueueWakeUp(&lock->waitQueue);
+
+    SpinUnlockIrqSave(&lock->waitLock, flags);
 }
 
 /**
- * MutexTryLock - 尝试自旋锁加锁
+ * MutexTryLock - 尝试互斥锁加锁
  * @lock: 锁对象
  * 
  * 非阻塞式获取锁
@@ -214,13 +183,18 @@ PUBLIC void MutexUnlock(struct Mutex *lock)
  */
 PUBLIC int MutexTryLock(struct Mutex *lock)
 {
-    /* 先把锁值减1，如果不为负，就说明获取成功 */
-    AtomicDec(&lock->count);
-    if (AtomicGet(&lock->count) >= 0)
-        return 1;     /* 获取成功，返回1 */ 
-    
-    /* 锁已经被其它任务获取了，自己不用等待锁被释放，返回0 */
-    return 0;
+    int locked = 0;
+
+    unsigned long flags = SpinLockIrqSave(&lock->waitLock);
+
+    /* 只有没上锁的时候才能获取，把count从1变成0 */
+    if (AtomicGet(&lock->count) == 1) {
+        AtomicSet(&lock->count, 0);
+        locked = 1;
+    }
+
+    SpinUnlockIrqSave(&lock->waitLock, flags);
+    return locked;
 }
 
 /**
@@ -238,4 +212,4 @@ PUBLIC int MutexIsLocked(struct Mutex *lock)
     }
     /* 没有被占用 */
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,273 @@
+/*
+ * file:		kernel/task/rcu.c
+ * auther:	    Jason Hu
+ * time:		2020/3/12
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/rcu.h>
+#include <book/smp.h>
+#include <book/interrupt.h>
+#include <book/waitqueue.h>
+
+/* 每个处理器的RCU状态 */
+struct RcuCpu {
+    struct RcuHead *nextList;       /* 还没有分配宽限期的回调 */
+    struct RcuHead **nextTail;
+    struct RcuHead *curList;        /* 等待batch结束的回调 */
+    long batch;                     /* curList等待的宽限期 */
+    long quiescBatch;               /* 正在检测静止状态的宽限期 */
+    char qsPending;                 /* 需要为当前宽限期报告静止状态 */
+    char passedQuiesc;              /* 宽限期开始后经过了静止状态 */
+};
+
+/* 全局的宽限期状态，在关闭中断并持有大内核锁时修改 */
+struct RcuControl {
+    long cur;                       /* 当前宽限期的编号 */
+    long completed;                 /* 已经结束的宽限期的编号 */
+    char nextPending;               /* 当前宽限期结束后需要马上开始下一个 */
+    unsigned long cpuMask;          /* 还没有报告静止状态的处理器 */
+};
+
+PRIVATE struct RcuCpu rcuCpus[NR_CPUS];
+PRIVATE struct RcuControl rcuControl;
+
+/* 宽限期a在b之前 */
+#define RcuBatchBefore(a, b)    ((long)((a) - (b)) < 0)
+
+/**
+ * RcuStartBatch - 开始一个新的宽限期
+ *
+ * 正在运行idle的处理器上没有读者，不用等待它们，这样停止了时钟节拍的
+ * 空闲处理器不会拖住宽限期
+ */
+PRIVATE void RcuStartBatch()
+{
+    int i;
+    int self = CurrentCpuId();
+
+    rcuControl.nextPending = 0;
+    rcuControl.cur++;
+    rcuControl.cpuMask = 0;
+
+    for (i = 0; i < NR_CPUS; i++) {
+        if (!cpus[i].online)
+            continue;
+        /* 当前处理器可能是在读临界区中被中断的 */
+        if (i == self || cpus[i].current != cpus[i].idle)
+            rcuControl.cpuMask |= 1UL << i;
+    }
+}
+
+/**
+ * RcuCheckQuiescent - 检测并报告处理器的静止状态
+ * @cpu: 处理器
+ */
+PRIVATE void RcuCheckQuiescent(int cpu)
+{
+    struct RcuCpu *rc = &rcuCpus[cpu];
+
+    /* 新的宽限期开始了，从现在开始检测静止状态 */
+    if (rc->quiescBatch != rcuControl.cur) {
+        rc->quiescBatch = rcuControl.cur;
+        rc->qsPending = (rcuControl.cpuMask & (1UL << cpu)) != 0;
+        rc->passedQuiesc = 0;
+        return;
+    }
+
+    if (!rc->qsPending || !rc->passedQuiesc)
+        return;
+
+    rc->qsPending = 0;
+    rcuControl.cpuMask &= ~(1UL << cpu);
+
+    /* 最后一个报告的处理器结束宽限期 */
+    if (!rcuControl.cpuMask) {
+        rcuControl.completed = rcuControl.cur;
+        if (rcuControl.nextPending)
+            RcuStartBatch();
+    }
+}
+
+/**
+ * RcuPending - 处理器是否有RCU的工作要做
+ * @cpu: 处理器
+ */
+PRIVATE int RcuPending(int cpu)
+{
+    struct RcuCpu *rc = &rcuCpus[cpu];
+
+    /* 等待的宽限期已经结束 */
+    if (rc->curList && !RcuBatchBefore(rcuControl.completed, rc->batch))
+        return 1;
+    /* 有新的回调需要分配宽限期 */
+    if (!rc->curList && rc->nextList)
+        return 1;
+    /* 开始了新的宽限期 */
+    if (rc->quiescBatch != rcuControl.cur)
+        return 1;
+    /* 可以报告静止状态 */
+    if (rc->qsPending && rc->passedQuiesc)
+        return 1;
+    return 0;
+}
+
+/**
+ * RcuSoftirqHandler - RCU软中断处理
+ * @action: 中断行为
+ *
+ * 推进宽限期，并调用宽限期已经结束的回调
+ */
+PRIVATE void RcuSoftirqHandler(struct SoftirqAction *action)
+{
+    int cpu = CurrentCpuId();
+    struct RcuCpu *rc = &rcuCpus[cpu];
+    struct RcuHead *list = NULL, *next;
+
+    unsigned long flags = InterruptSave();
+
+    /* 1.取出宽限期已经结束的回调 */
+    if (rc->curList && !RcuBatchBefore(rcuControl.completed, rc->batch)) {
+        list = rc->curList;
+        rc->curList = NULL;
+    }
+
+    /* 2.给新的回调分配下一个宽限期 */
+    if (!rc->curList && rc->nextList) {
+        rc->curList = rc->nextList;
+        rc->nextList = NULL;
+        rc->nextTail = &rc->nextList;
+
+        rc->batch = rcuControl.cur + 1;
+        if (rcuControl.completed == rcuControl.cur)
+            RcuStartBatch();
+        else
+            rcuControl.nextPending = 1;
+    }
+
+    /* 3.报告静止状态 */
+    RcuCheckQuiescent(cpu);
+
+    InterruptRestore(flags);
+
+    /* 4.调用回调，回调里面可以释放内存 */
+    while (list) {
+        next = list->next;
+        list->func(list);
+        list = next;
+    }
+}
+
+/**
+ * CallRcu - 在宽限期后调用回调
+ * @head: 嵌入在对象中的回调结构
+ * @func: 回调函数
+ *
+ * 写者把对象从读者能看到的地方摘下后调用，在回调里面释放对象
+ */
+PUBLIC void CallRcu(struct RcuHead *head, void (*func)(struct RcuHead *))
+{
+    head->func = func;
+    head->next = NULL;
+
+    unsigned long flags = InterruptSave();
+
+    struct RcuCpu *rc = &rcuCpus[CurrentCpuId()];
+    *rc->nextTail = head;
+    rc->nextTail = &head->next;
+
+    InterruptRestore(flags);
+}
+
+/* 同步等待宽限期 */
+struct RcuSynchronize {
+    struct RcuHead head;
+    volatile char done;
+};
+
+/**
+ * RcuWakeMe - 宽限期结束，唤醒等待者
+ * @head: 回调结构
+ */
+PRIVATE void RcuWakeMe(struct RcuHead *head)
+{
+    struct RcuSynchronize *sync = container_of(head, struct RcuSynchronize, head);
+
+    sync->done = 1;
+    WaitQueueWakeUpAll(AddressWaitQueue(sync));
+}
+
+/**
+ * SynchronizeRcu - 等待一个宽限期结束
+ *
+ * 返回后，调用前就开始的读者都已经退出，会睡眠，不能在读临界区中调用
+ */
+PUBLIC void SynchronizeRcu()
+{
+    struct RcuSynchronize sync;
+
+    sync.done = 0;
+    CallRcu(&sync.head, RcuWakeMe);
+
+    WAIT_EVENT(AddressWaitQueue(&sync), sync.done);
+}
+
+/**
+ * RcuNoteContextSwitch - 记录处理器经过了静止状态
+ * @cpu: 处理器
+ *
+ * 任务切换和空闲循环的时候调用，这时候当前任务不在读临界区中
+ */
+PUBLIC void RcuNoteContextSwitch(int cpu)
+{
+    rcuCpus[cpu].passedQuiesc = 1;
+}
+
+/**
+ * RcuCheckCallbacks - 时钟节拍中检测RCU的工作
+ * @cpu: 处理器
+ */
+PUBLIC void RcuCheckCallbacks(int cpu)
+{
+    if (RcuPending(cpu))
+        ActiveSoftirq(RCU_SOFTIRQ);
+}
+
+/**
+ * RcuNeedsCpu - 处理器是否需要时钟节拍推进RCU
+ * @cpu: 处理器
+ *
+ * 有回调或者还没有报告静止状态的处理器空闲时不能停止时钟节拍
+ */
+PUBLIC int RcuNeedsCpu(int cpu)
+{
+    struct RcuCpu *rc = &rcuCpus[cpu];
+
+    return rc->curList || rc->nextList || rc->qsPending ||
+        (rcuControl.cpuMask & (1UL << cpu));
+}
+
+/**
+ * InitRcu - 初始化RCU
+ */
+PUBLIC void InitRcu()
+{
+    int i;
+    struct RcuCpu *rc;
+
+    rcuControl.cur = rcuControl.completed = 0;
+    rcuControl.nextPending = 0;
+    rcuControl.cpuMask = 0;
+
+    for (i = 0; i < NR_CPUS; i++) {
+        rc = &rcuCpus[i];
+        rc->nextList = rc->curList = NULL;
+        rc->nextTail = &rc->nextList;
+        rc->batch = rc->quiescBatch = rcuControl.completed;
+        rc->qsPending = rc->passedQuiesc = 0;
+    }
+
+    BuildSoftirq(RCU_SOFTIRQ, RcuSoftirqHandler);
+}
@@ -11,13 +11,10 @@
 #include <book/task.h>
 #include <book/list.h>
 #include <book/interrupt.h>
+#include <book/smp.h>
+#include <book/bitops.h>
 #include <lib/string.h>
 
-/* 导入主idle线程 */
-EXTERN Task_t *taskIdle;
-
-EXTERN struct List taskPriorityQueue[MAX_PRIORITY_NR];
-
 /** 
  * SwitchTo - 任务切换的核心
  * @prev: 当前任务
@@ -26,64 +23,157 @@ EXTERN struct List taskPriorityQueue[MAX_PRIORITY_NR];
  * 切换任务时保存当前环境，再选择新任务的环境去执行
  */
 EXTERN void SwitchTo(struct Task *prev, struct Task *next);
+
+/**
+ * IsDynamicPriority - 任务是否使用动态优先级
+ * @task: 任务
+ * 
+ * 内核线程和idle任务的优先级保持不变
+ */
+PRIVATE INLINE int IsDynamicPriority(Task_t *task)
+{
+    return task->staticPriority >= TASK_PRIORITY_USER &&
+        task->staticPriority < TASK_PRIORITY_IDLE;
+}
+
+/**
+ * ScheduleTimeslice - 计算任务的时间片
+ * @task: 任务
+ * 
+ * 优先级被降低得越多，时间片越长，减少计算任务之间的切换
+ */
+PRIVATE uint32_t ScheduleTimeslice(Task_t *task)
+{
+    if (task->priority <= task->staticPriority)
+        return task->timeslice;
+    return task->timeslice + (task->priority - task->staticPriority) * SCHED_SLICE_STEP;
+}
+
+/**
+ * SchedulePenalty - 降低用完时间片的任务的优先级
+ * @task: 任务
+ * 
+ * 任务不能在就绪队列中
+ */
+PRIVATE void SchedulePenalty(Task_t *task)
+{
+    if (!IsDynamicPriority(task))
+        return;
+
+    if (task->priority < task->staticPriority + SCHED_MAX_PENALTY &&
+        task->priority < TASK_PRIORITY_IDLE - 1)
+        task->priority++;
+}
+
+/**
+ * ScheduleBoost - 提升交互任务的优先级
+ * @task: 任务
+ * 
+ * 任务等到输入后调用，任务不能在就绪队列中。
+ * 提升后如果又用完了时间片，会逐级降回来
+ */
+PUBLIC void ScheduleBoost(Task_t *task)
+{
+    if (!IsDynamicPriority(task))
+        return;
+    
+    unsigned long flags = InterruptSave();
+    
+    ASSERT(!IsTaskInPriorityQueue(task));
+    if (task->priority > task->staticPriority - SCHED_MAX_BONUS)
+        task->priority--;
+
+    InterruptRestore(flags);
+}
+
 /**
  * ScheduleInsertQueue - 插入到就绪队列
  * @task: 任务
  * 
- * 如果是运行的时候，表明任务还没执行完，所以会变成就绪状态，回到队列末尾
+ * 如果是运行的时候，表明任务还没执行完，所以会变成就绪状态。
+ * 时间片用完的任务降低优先级，回到队列末尾；时间片没有用完
+ * 就是被更高优先级的任务抢占了，回到队列头部，保留剩余的时间片。
  * 如果是其它状态，表明任务现在不再运行，就不插入就绪队列。
  */
 PRIVATE int ScheduleInsertQueue(Task_t *task)
 {    
     /* 1.把自己加入就绪队列 */
     if (task->status == TASK_RUNNING) {
-        /* 时间片到了，加入就绪队列 */
-        TaskPriorityQueueAddTail(task);
-        // 更新信息
-        task->ticks = task->timeslice;
+        task->involuntarySwitches++;
         task->status = TASK_READY;
+        
+        if (task->ticks <= 0) {
+            /* 时间片到了，加入就绪队列 */
+            SchedulePenalty(task);
+            task->ticks = ScheduleTimeslice(task);
+            TaskPriorityQueueAddTail(task);
+        } else {
+            TaskPriorityQueueAddHead(task);
+        }
         return 0;
     } else {
         /* 如果是需要某些事件后才能继续运行，不用加入队列，当前线程不在就绪队列中。*/        
-        
+        task->voluntarySwitches++;
         return -1;
     }
 }
 
 /**
  * ScheduleTryWakeupIdle - 尝试唤醒idle任务
+ * @cpu: 当前处理器
  * 
  * 只有当没有进程可以运行的时候才唤醒它
  */
-PRIVATE void ScheduleTryWakeupIdle()
+PRIVATE void ScheduleTryWakeupIdle(struct Cpu *cpu)
 {
     // 队列为空，那么就尝试唤醒idle
     if (IsAllPriorityQueueEmpty()) {
-        // 唤醒mian(idle)
-        TaskUnblock(taskIdle);
+        // 唤醒当前处理器的idle
+        TaskUnblock(cpu->idle);
     }
 }
 
 /**
  * SchedulePickTask - 挑选一个任务来执行
+ * @cpu: 当前处理器
  * 
+ * 如果自己只剩下idle任务，就先尝试从其它处理器拉取一个任务
  */
-PRIVATE Task_t *SchedulePickTask()
+PRIVATE Task_t *SchedulePickTask(struct Cpu *cpu)
 {
-    /* 一定能够找到一个任务，因为最后的是idle任务 */
     Task_t *task;
     int i;
-    for (i = 0; i < MAX_PRIORITY_NR; i++) {
-        /* 如果有任务，才获取 */
-        if (!ListEmpty(&taskPriorityQueue[i])) {
-            task = ListFirstOwner(&taskPriorityQueue[i], Task_t, list);
-            ListDel(&task->list);
-            break;
-        }
+
+    if (!cpu->nrReady) {
+        task = ScheduleIdleBalance(cpu);
+        if (task)
+            return task;
     }
+
+    /* 一定能够找到一个任务，因为最后的是idle任务 */
+    i = FindFirstSet(cpu->readyBitmap);
+    ASSERT(i >= 0);
+    
+    task = ListFirstOwner(&cpu->priorityQueue[i], Task_t, list);
+    TaskPriorityQueueDel(task);
     return task;
 }
 
+/**
+ * ScheduleNeedPreempt - 检查是否需要抢占当前任务
+ * @cpu: 当前处理器
+ * 
+ * 就绪队列中有比当前任务优先级更高的任务时返回1
+ */
+PUBLIC int ScheduleNeedPreempt(struct Cpu *cpu)
+{
+    int i = FindFirstSet(cpu->readyBitmap);
+    
+    if (i < 0)
+        return 0;
+    return (uint32_t)i < cpu->current->priority;
+}
+
 /**
  * Schedule - 任务调度
  * 
@@ -99,15 +189,28 @@ PUBLIC void Schedule()
     /* 需要关闭中断,保护队列操作 */
     unsigned long flags = InterruptSave();
 
+    struct Cpu *cpu = CurrentCpu();
     Task_t *current = CurrentTask();
+
+    /* 读临界区中不能调度，调度点是静止状态 */
+    ASSERT(!current->rcuReadDepth);
+    RcuNoteContextSwitch(cpu->id);
+
     /* 1.插入到就绪队列 */
     ScheduleInsertQueue(current);
 
     /* 尝试唤醒idle任务 */
-    ScheduleTryWakeupIdle();
+    ScheduleTryWakeupIdle(cpu);
     
     /* 2.从就绪队列中获取一个任务 */
-    Task_t *next = SchedulePickTask();
+    Task_t *next = SchedulePickTask(cpu);
+    cpu->current = next;
+    if (next != current)
+        cpu->switches++;
+
+    /* 还是自己运行，让等待大内核锁的处理器有机会进入内核 */
+    if (next == current)
+        KernelLockRelax();
 
     InterruptRestore(flags);
 
@@ -131,15 +234,28 @@ PUBLIC void Schedule()
  */
 PUBLIC void ScheduleInClock()
 {
+    struct Cpu *cpu = CurrentCpu();
     Task_t *current = CurrentTask();
+
+    /* 读临界区中不能调度，调度点是静止状态 */
+    ASSERT(!current->rcuReadDepth);
+    RcuNoteContextSwitch(cpu->id);
+
     /* 1.插入到就绪队列 */
     ScheduleInsertQueue(current);
 
     /* 尝试唤醒idle任务 */
-    ScheduleTryWakeupIdle();
+    ScheduleTryWakeupIdle(cpu);
     
     /* 2.从就绪队列中获取一个任务 */
-    Task_t *next = SchedulePickTask();
+    Task_t *next = SchedulePickTask(cpu);
+    cpu->current = next;
+    if (next != current)
+        cpu->switches++;
+
+    /* 还是自己运行，让等待大内核锁的处理器有机会进入内核 */
+    if (next == current)
+        KernelLockRelax();
 
     /* 3.激活任务的内存环境 */
     TaskActivate(next);
@@ -12,6 +12,9 @@
 #include <book/timer.h>
 #include <lib/string.h>
 #include <clock/clock.h>
+#include <clock/clockevent.h>
+#include <clock/clocksource.h>
+#include <lib/math.h>
 
 /**
  * TaskWakeup - 唤醒任务
@@ -89,12 +92,57 @@ PUBLIC uint32_t TaskSleep(uint32_t ticks)
     /* 现在进程不能运行，因为它不再readyList中，只有定时器唤醒后才可以
     当定时器把它唤醒之后，他就会在这里执行
      */
-    //RemoveTimer(&timer);
+    /* 被提前唤醒时定时器还在时间轮中，定时器在栈上，必须移除 */
+    RemoveTimer(&timer);
 
     current->sleepTimer = NULL; /* 取消休眠定时器 */
     
-    // printk("@@@sleep wake up ticks %d\n", timer.expires);
-    return timer.expires;
+    /* 返回剩余的ticks数 */
+    return TimerRemaining(&timer);
+}
+
+/**
+ * TaskHrTimeout - 高精度休眠到期，唤醒任务
+ * @data: 休眠的任务
+ */
+PRIVATE void TaskHrTimeout(unsigned long data)
+{
+    TaskWakeUp((struct Task *)data);
+}
+
+/**
+ * TaskUSleep - 任务休眠（微秒为单位）
+ * @usec: 休眠的微秒数
+ * 
+ * 处理器支持高精度定时器时用它来唤醒，精度可以小于1个时钟节拍，
+ * 不支持时换算成ticks，用普通的定时器休眠
+ */
+PUBLIC void TaskUSleep(uint32_t usec)
+{
+    struct Task *current = CurrentTask();
+    struct HrTimer timer;
+
+    if (!usec)
+        return;
+
+    /* 保存状态并关闭中断 */
+    unsigned long flags = InterruptSave();
+
+    HrTimerInit(&timer, TaskHrTimeout, (unsigned long)current);
+    if (HrTimerStart(&timer, ClockSourceNow() + (unsigned long long)usec * NSEC_PER_USEC)) {
+        InterruptRestore(flags);
+        TaskSleep(DIV_ROUND_UP(usec, USEC_PER_SEC / HZ));
+        return;
+    }
+
+    /* 关闭中断时阻塞，避免定时器在调度前就到期 */
+    current->status = TASK_BLOCKED;
+    Schedule();
+
+    /* 被提前唤醒时定时器还在链表中，定时器在栈上，必须取消 */
+    HrTimerCancel(&timer);
+
+    InterruptRestore(flags);
 }
 
 /**
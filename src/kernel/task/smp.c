@@ -0,0 +1,350 @@
+/*
+ * file:		kernel/task/smp.c
+ * auther:	    Jason Hu
+ * time:		2020/3/2
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/smp.h>
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/task.h>
+#include <book/list.h>
+#include <book/bitops.h>
+#include <lib/string.h>
+
+/* 所有的处理器 */
+PUBLIC struct Cpu cpus[NR_CPUS];
+
+/* 已经运行的处理器数量 */
+PUBLIC int cpuOnlineNr;
+
+/* 大内核锁，使用排队自旋锁，保证处理器按照申请的顺序获得锁 */
+PRIVATE volatile unsigned int kernelLockNext;   /* 下一个申请者的票号 */
+PRIVATE volatile unsigned int kernelLockOwner;  /* 当前持有锁的票号 */
+
+/**
+ * KernelLockAcquire - 获取大内核锁
+ *
+ * 取一个票号，然后等待轮到自己
+ */
+PRIVATE void KernelLockAcquire()
+{
+    unsigned int ticket = 1;
+
+    __asm__ __volatile__ ("lock; xaddl %0, %1"
+        : "+r" (ticket), "+m" (kernelLockNext) : : "memory");
+
+    /* 等待的时候关闭了中断，持有锁的处理器可能在等待我们刷新TLB */
+    while (kernelLockOwner != ticket) {
+        SmpTlbFlushPoll();
+        __asm__ __volatile__ ("pause" : : : "memory");
+    }
+}
+
+/**
+ * KernelLockRelease - 释放大内核锁
+ */
+PRIVATE void KernelLockRelease()
+{
+    Barrier();
+    kernelLockOwner++;
+}
+
+/**
+ * KernelLock - 进入内核，获取大内核锁
+ *
+ * 在中断、异常和系统调用的入口调用，可以嵌套，
+ * 只有最外层才真正获取锁
+ */
+PUBLIC void KernelLock()
+{
+    unsigned long flags = InterruptSave();
+
+    if (CurrentTask()->lockDepth++ == 0)
+        KernelLockAcquire();
+
+    InterruptRestore(flags);
+}
+
+/**
+ * KernelUnlock - 离开内核，释放大内核锁
+ *
+ * 在返回用户态或者idle任务中调用，只有最外层才真正释放锁
+ */
+PUBLIC void KernelUnlock()
+{
+    unsigned long flags = InterruptSave();
+
+    if (--CurrentTask()->lockDepth == 0)
+        KernelLockRelease();
+
+    InterruptRestore(flags);
+}
+
+/**
+ * KernelLockRelax - 暂时让出大内核锁
+ *
+ * 调度后还是自己运行时调用，如果有其它处理器在等待锁，
+ * 由于是排队锁，它会先获得锁，然后自己再排队获取
+ */
+PUBLIC void KernelLockRelax()
+{
+    unsigned long flags = InterruptSave();
+
+    /* 没有其它处理器等待，就不用让出 */
+    if (kernelLockNext - kernelLockOwner > 1) {
+        KernelLockRelease();
+        KernelLockAcquire();
+    }
+    InterruptRestore(flags);
+}
+
+/**
+ * CpuLoad - 获取处理器的负载
+ * @cpu: 处理器
+ *
+ * 负载就是就绪的任务数加上正在运行的任务（idle不算）
+ */
+PRIVATE unsigned int CpuLoad(struct Cpu *cpu)
+{
+    return cpu->nrReady + (cpu->current != cpu->idle);
+}
+
+/**
+ * ScheduleSelectCpu - 为新任务选择一个处理器
+ *
+ * 选择负载最轻的处理器，负载相同时优先选择当前处理器
+ */
+PUBLIC int ScheduleSelectCpu()
+{
+    struct Cpu *best = CurrentCpu();
+    struct Cpu *cpu;
+    int i;
+
+    for (i = 0; i < NR_CPUS; i++) {
+        cpu = &cpus[i];
+        if (!cpu->online)
+            continue;
+        if (CpuLoad(cpu) < CpuLoad(best))
+            best = cpu;
+    }
+    return best->id;
+}
+
+/**
+ * FindBusiestCpu - 找到负载最重的处理器
+ * @self: 当前处理器，不参与比较
+ *
+ * 只有就绪队列中有任务可以迁移的处理器才会被选中
+ */
+PRIVATE struct Cpu *FindBusiestCpu(struct Cpu *self)
+{
+    struct Cpu *busiest = NULL;
+    struct Cpu *cpu;
+    int i;
+
+    for (i = 0; i < NR_CPUS; i++) {
+        cpu = &cpus[i];
+        if (!cpu->online || cpu == self || !cpu->nrReady)
+            continue;
+        if (busiest == NULL || CpuLoad(cpu) > CpuLoad(busiest))
+            busiest = cpu;
+    }
+    return busiest;
+}
+
+/**
+ * StealTask - 从其它处理器的就绪队列中迁移一个任务
+ * @from: 任务所在的处理器
+ * @to: 迁移到的处理器
+ *
+ * 从优先级最高的队列末尾取任务，它在原来的处理器上最晚运行。
+ * 返回的任务已经不在任何就绪队列中
+ */
+PRIVATE Task_t *StealTask(struct Cpu *from, struct Cpu *to)
+{
+    unsigned int bitmap = from->readyBitmap;
+    Task_t *task;
+    int i;
+
+    /* 只查找不为空的队列 */
+    while ((i = FindFirstSet(bitmap)) >= 0) {
+        bitmap &= ~(1 << i);
+        ListForEachOwnerReverse(task, &from->priorityQueue[i], list) {
+            /* idle任务只能在自己的处理器上运行 */
+            if (task == from->idle)
+                continue;
+
+            TaskPriorityQueueDel(task);
+            task->cpu = to->id;
+            to->migrations++;
+            return task;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * ScheduleIdleBalance - 空闲时的负载均衡
+ * @cpu: 当前处理器
+ *
+ * 当前处理器只剩下idle任务时，从最忙的处理器上拉取一个任务来运行
+ */
+PUBLIC Task_t *ScheduleIdleBalance(struct Cpu *cpu)
+{
+    struct Cpu *busiest;
+
+    if (cpuOnlineNr < 2)
+        return NULL;
+
+    busiest = FindBusiestCpu(cpu);
+    if (busiest == NULL)
+        return NULL;
+
+    return StealTask(busiest, cpu);
+}
+
+/**
+ * ScheduleBalance - 周期性的负载均衡
+ *
+ * 在调度软中断中调用，每隔一段时间检查一次，
+ * 如果最忙的处理器比自己多2个以上的任务，就拉取一个过来
+ */
+PUBLIC void ScheduleBalance()
+{
+    struct Cpu *cpu = CurrentCpu();
+    struct Cpu *busiest;
+    Task_t *task;
+
+    if (cpuOnlineNr < 2)
+        return;
+
+    if (cpu->balanceTicks > 0) {
+        cpu->balanceTicks--;
+        return;
+    }
+    cpu->balanceTicks = SCHED_BALANCE_TICKS;
+
+    unsigned long flags = InterruptSave();
+
+    busiest = FindBusiestCpu(cpu);
+    if (busiest && CpuLoad(busiest) >= CpuLoad(cpu) + 2) {
+        task = StealTask(busiest, cpu);
+        if (task)
+            TaskPriorityQueueAddTail(task);
+    }
+
+    InterruptRestore(flags);
+}
+
+/**
+ * SmpReschedule - 通知其它处理器进行调度
+ * @cpu: 处理器编号
+ */
+PUBLIC void SmpReschedule(int cpu)
+{
+    if (!cpus[cpu].online)
+        return;
+
+    cpus[cpu].needResched = 1;
+    ArchSendReschedule(cpu);
+}
+
+/**
+ * SmpTlbFlushPoll - 处理其它处理器的TLB刷新请求
+ *
+ * 在刷新TLB中断和等待大内核锁的时候调用
+ */
+PUBLIC void SmpTlbFlushPoll()
+{
+    struct Cpu *cpu = CurrentCpu();
+
+    if (cpu->tlbFlushPending) {
+        ArchFlushTlb();
+        cpu->tlbFlushPending = 0;
+    }
+}
+
+/**
+ * SmpFlushTlbOthers - 让其它处理器刷新地址空间的TLB
+ * @mm: 修改了页表的地址空间
+ *
+ * 线程共享页表，一个处理器上取消映射或者降低权限后，正在运行同一个
+ * 地址空间的其它处理器还可能使用旧的TLB项，需要等它们刷新完才能释放
+ * 物理页。调用者持有大内核锁，所以同一时刻只有一个处理器在发送
+ */
+PUBLIC void SmpFlushTlbOthers(struct MemoryManager *mm)
+{
+    int i, self, sent = 0;
+
+    if (mm == NULL || cpuOnlineNr <= 1 || AtomicGet(&mm->users) <= 1)
+        return;
+
+    self = CurrentCpuId();
+    for (i = 0; i < NR_CPUS; i++) {
+        if (i == self || !cpus[i].online || cpus[i].current->mm != mm)
+            continue;
+        cpus[i].tlbFlushPending = 1;
+        ArchSendTlbFlush(i);
+        sent = 1;
+    }
+
+    if (!sent)
+        return;
+
+    for (i = 0; i < NR_CPUS; i++) {
+        while (cpus[i].tlbFlushPending)
+            __asm__ __volatile__ ("pause" : : : "memory");
+    }
+}
+
+/**
+ * SmpApStart - 应用处理器进入调度
+ * @cpu: 处理器编号
+ *
+ * 应用处理器完成平台初始化后调用，此时运行在自己的idle任务中，
+ * 等待时钟中断或者调度中断来调度其它任务
+ */
+PUBLIC void SmpApStart(int cpu)
+{
+    /* idle线程 */
+    TaskIdleLoop();
+}
+
+/**
+ * InitSmp - 初始化对称多处理
+ *
+ * 探测所有的处理器，为每个应用处理器创建idle任务，然后启动它们
+ */
+PUBLIC void InitSmp()
+{
+    Task_t *idle;
+    int nr, i;
+
+    /* 探测处理器并初始化中断控制器 */
+    nr = ArchInitSmp();
+    if (nr > NR_CPUS) {
+        printk(PART_WARRING "smp: %d cpus found, only %d supported\n", nr, NR_CPUS);
+        nr = NR_CPUS;
+    }
+
+    for (i = 1; i < nr; i++) {
+        idle = CreateIdleTask(i);
+        if (idle == NULL) {
+            printk(PART_ERROR "smp: create idle task for cpu %d failed!\n", i);
+            break;
+        }
+
+        /* 应用处理器运行在idle任务的内核栈上 */
+        if (ArchStartCpu(i, (unsigned long)idle + TASK_KSTACK_SIZE)) {
+            printk(PART_WARRING "smp: cpu %d not responding\n", i);
+            continue;
+        }
+
+        cpus[i].online = 1;
+        cpuOnlineNr++;
+    }
+
+    printk(PART_TIP "smp: %d cpus online\n", cpuOnlineNr);
+}
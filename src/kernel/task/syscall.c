@@ -14,8 +14,15 @@
 #include <book/kgc.h>
 #include <book/mmu.h>
 #include <book/power.h>
+#include <book/memcache.h>
+#include <book/lockstat.h>
+#include <book/futex.h>
+#include <book/shm.h>
+#include <book/msgqueue.h>
 #include <clock/clock.h>
+#include <clock/clocksource.h>
 #include <char/console/console.h>
+#include <block/blk-buffer.h>
 #include <kgc/window/message.h>
 
 /* 空系统调用，用来占位 */
@@ -84,6 +91,21 @@ syscall_t syscallTable[MAX_SYSCALL_NR] = {
     SysRedirect,            /* 55 */
     SysReboot,              /* 56 */
     SysGetVersion,          /* 57 */
+    SysCacheScan,           /* 58 */
+    SysBufferStat,          /* 59 */
+    SysUSleep,              /* 60 */
+    SysClockGetTime,        /* 61 */
+    SysLockScan,            /* 62 */
+    SysFutex,               /* 63 */
+    SysClone,               /* 64 */
+    SysWaitPid,             /* 65 */
+    SysShmOpen,             /* 66 */
+    SysShmMap,              /* 67 */
+    SysShmUnlink,           /* 68 */
+    SysMqOpen,              /* 69 */
+    SysMqUnlink,            /* 70 */
+    SysMqSend,              /* 71 */
+    SysMqReceive,           /* 72 */
 };
 
 /**
@@ -14,6 +14,11 @@
 #include <book/semaphore.h>
 #include <book/mutex.h>
 #include <book/spinlock.h>
+#include <book/interrupt.h>
+#include <book/futex.h>
+#include <book/smp.h>
+#include <clock/clock.h>
+#include <clock/clockevent.h>
 #include <lib/string.h>
 
 /**
@@ -32,10 +37,16 @@ PRIVATE pid_t nextPid;
 // 全局队列链表，用来查找所有存在的任务
 PUBLIC LIST_HEAD(taskGlobalList);
 
-/* 优先级队列链表 */
-PROTECT struct List taskPriorityQueue[MAX_PRIORITY_NR];
+/* pid哈希表的大小，必须是2的幂 */
+#define PID_HASH_SIZE   64
 
-/* idle任务 */
+#define PID_HASH(pid)   ((unsigned long)(pid) & (PID_HASH_SIZE - 1))
+
+/* 按pid查找任务的哈希表，读者使用RCU，写者持有taskListLock */
+PRIVATE struct List pidHashTable[PID_HASH_SIZE];
+PRIVATE SPIN_LOCK_INIT(taskListLock);
+
+/* idle任务，引导处理器的主线程 */
 PUBLIC Task_t *taskIdle;
 /**
  * KernelThread - 执行内核线程
@@ -130,18 +141,17 @@ PUBLIC void InitSignalInTask(struct Task *task)
     task->signalLeft = 0;
     task->signalCatched = 0;
 
-    SpinLockInit(&task->signals.signalLock);
+    SpinLockInit(&task->signals->signalLock);
     int i;
     for (i = 0; i < MAX_SIGNAL_NR; i++) {
         /* SIGCHLD信号设置成忽略信号 */
-        task->signals.action[i].handler = SIG_DFL;
+        task->signals->action[i].handler = SIG_DFL;
         /*if (i == SIGCHLD) {
-            task->signals.action[i - 1].handler = SIG_IGN;
+            task->signals->action[i - 1].handler = SIG_IGN;
         }*/
-        task->signals.action[i].flags = 0;
-        task->signals.sender[i] = -1;
+        task->signals->action[i].flags = 0;
+        task->signals->sender[i] = -1;
     }
-    AtomicSet(&task->signals.count, 0);
     
     /* 清空信号集 */
     sigemptyset(&task->signalBlocked);
@@ -171,10 +181,15 @@ PRIVATE void TaskInit(struct Task *thread, char *name, int priority)
         priority = MAX_PRIORITY_NR - 1;
 
     thread->priority = priority;
+    thread->staticPriority = priority;
     thread->timeslice = 3;  /* 时间片大小默认值 */
     thread->ticks = thread->timeslice;
     
     thread->elapsedTicks = 0;
+
+    /* 新任务从调度中切换过来，开始运行时已经持有大内核锁 */
+    thread->cpu = 0;
+    thread->lockDepth = 1;
     
     /* 线程没有页目录表和虚拟内存管理 */
     thread->pgdir = NULL;
@@ -194,14 +209,11 @@ PRIVATE void TaskInit(struct Task *thread, char *name, int priority)
 
     thread->stackMagic = TASK_STACK_MAGIC;
 
-    /* 其余的文件描述符全部设置为-1 */
-    unsigned char idx = 0;
-    while (idx < MAX_OPEN_FILES_IN_PROC) {
-        thread->fdTable[idx] = -1;      /* 设置为-1表示未使用 */
-        idx++;
-    }
+    /* 文件描述符表 */
+    AllocTaskFiles(thread);
     
     /* 信号相关 */
+    AllocTaskSignals(thread);
     InitSignalInTask(thread);
 
     /* 设置闹钟 */
@@ -217,22 +229,21 @@ PRIVATE void TaskInit(struct Task *thread, char *name, int priority)
 }
 
 /**
- * AllocTaskMemory - 初始化任务的内存管理
- * @task: 任务
+ * FindTaskByPid - 通过pid查找任务
+ * @pid: 进程id
+ *
+ * 不加锁，在pid哈希表中查找，调用者需要在RcuReadLock和RcuReadUnlock之间
+ * 查找并使用返回的任务。任务结构在宽限期后才会释放，所以返回的任务在调用者
+ * 退出读临界区之前都是有效的，读临界区中不能睡眠
  */
 PUBLIC struct Task *FindTaskByPid(pid_t pid)
 {
     struct Task *task;
-    /* 关闭中断 */
-    unsigned long old = InterruptSave();
 
-    ListForEachOwner(task, &taskGlobalList, globalList) {
-        if (task->pid == pid) {
-            InterruptRestore(old);
+    ListForEachOwnerRcu(task, &pidHashTable[PID_HASH(pid)], pidList) {
+        if (task->pid == pid)
             return task;
-        }
     }
-    InterruptRestore(old);
     return NULL;
 }
 
@@ -250,16 +261,90 @@ PUBLIC void AllocTaskMemory(struct Task *task)
 }
 
 /**
- * TaskMemoryInit - 初始化任务的内存管理
+ * FreeTaskMemory - 释放任务的内存管理
  * @task: 任务
+ *
+ * 线程共享内存管理器和页目录，最后一个引用的任务才释放
  */
 PUBLIC void FreeTaskMemory(struct Task *task)
 {
-    if (task->mm)
-        kfree(task->mm);
+    if (!task->mm)
+        return;
+
+    AtomicDec(&task->mm->count);
+    if (AtomicGet(&task->mm->count))
+        return;
+
+    if (task->pgdir)
+        kfree(task->pgdir);
+    kfree(task->mm);
+}
+
+/**
+ * AllocTaskFiles - 分配任务的文件描述符表
+ * @task: 任务
+ */
+PUBLIC void AllocTaskFiles(struct Task *task)
+{
+    int i;
+
+    task->files = (struct FileTable *)kmalloc(sizeof(struct FileTable), GFP_KERNEL);
+    if (!task->files)
+        Panic(PART_ERROR "kmalloc for task files failed!\n");
+
+    AtomicSet(&task->files->count, 1);
+    /* 全部设置为-1表示未使用 */
+    for (i = 0; i < MAX_OPEN_FILES_IN_PROC; i++)
+        task->files->fdTable[i] = -1;
+}
+
+/**
+ * AllocTaskSignals - 分配任务的信号行为
+ * @task: 任务
+ *
+ * 只分配，由InitSignalInTask初始化
+ */
+PUBLIC void AllocTaskSignals(struct Task *task)
+{
+    task->signals = (Signal_t *)kmalloc(sizeof(Signal_t), GFP_KERNEL);
+    if (!task->signals)
+        Panic(PART_ERROR "kmalloc for task signals failed!\n");
+
+    AtomicSet(&task->signals->count, 1);
 }
 
 
+/**
+ * TaskEnqueued - 任务加入就绪队列后的处理
+ * @cpu: 就绪队列所在的处理器
+ * @task: 任务
+ * 
+ * 记录就绪任务数和进入队列的时间，如果任务的优先级比处理器上
+ * 正在运行的任务高，就通知处理器进行抢占
+ */
+PRIVATE void TaskEnqueued(struct Cpu *cpu, struct Task *task)
+{
+    cpu->readyBitmap |= 1 << task->priority;
+
+    /* idle任务不算负载 */
+    if (task == cpu->idle)
+        return;
+    
+    cpu->nrReady++;
+    task->readyStamp = systicks;
+
+    if (cpu->current == NULL || task->priority >= cpu->current->priority)
+        return;
+    
+    if (cpu == CurrentCpu()) {
+        /* 在下一次中断返回时检查抢占 */
+        cpu->needResched = 1;
+        ActiveSoftirq(RESCHED_SOFTIRQ);
+    } else {
+        SmpReschedule(cpu->id);
+    }
+}
+
 /**
  * TaskPriorityQueueAddTail - 把任务添加到特权级队列末尾
  * @task: 任务
@@ -267,10 +352,12 @@ PUBLIC void FreeTaskMemory(struct Task *task)
  */
 PUBLIC void TaskPriorityQueueAddTail(struct Task *task)
 {
-    /* 添加到相应的优先级队列 */
-    ASSERT(!ListFind(&task->list, &taskPriorityQueue[task->priority]));
+    struct Cpu *cpu = &cpus[task->cpu];
+    /* 添加到任务所在处理器的优先级队列 */
+    ASSERT(!ListFind(&task->list, &cpu->priorityQueue[task->priority]));
     // 添加到就绪队列
-    ListAddTail(&task->list, &taskPriorityQueue[task->priority]);
+    ListAddTail(&task->list, &cpu->priorityQueue[task->priority]);
+    TaskEnqueued(cpu, task);
 }
 
 /**
@@ -280,10 +367,33 @@ PUBLIC void TaskPriorityQueueAddTail(struct Task *task)
  */
 PUBLIC void TaskPriorityQueueAddHead(struct Task *task)
 {
-    /* 添加到相应的优先级队列 */
-    ASSERT(!ListFind(&task->list, &taskPriorityQueue[task->priority]));
+    struct Cpu *cpu = &cpus[task->cpu];
+    /* 添加到任务所在处理器的优先级队列 */
+    ASSERT(!ListFind(&task->list, &cpu->priorityQueue[task->priority]));
     // 添加到就绪队列
-    ListAdd(&task->list, &taskPriorityQueue[task->priority]);
+    ListAdd(&task->list, &cpu->priorityQueue[task->priority]);
+    TaskEnqueued(cpu, task);
+}
+
+/**
+ * TaskPriorityQueueDel - 把任务从特权级队列中删除
+ * @task: 任务
+ * 
+ */
+PUBLIC void TaskPriorityQueueDel(struct Task *task)
+{
+    struct Cpu *cpu = &cpus[task->cpu];
+
+    ListDelInit(&task->list);
+
+    /* 队列空了就清除位图中对应的位 */
+    if (ListEmpty(&cpu->priorityQueue[task->priority]))
+        cpu->readyBitmap &= ~(1 << task->priority);
+    
+    if (task != cpu->idle) {
+        cpu->nrReady--;
+        task->waitTicks += systicks - task->readyStamp;
+    }
 }
 
 /**
@@ -294,9 +404,43 @@ PUBLIC void TaskGloablListAdd(struct Task *task)
 {
     // 保证不存在于链表中
     ASSERT(!ListFind(&task->globalList, &taskGlobalList));
+
+    unsigned long flags = SpinLockIrqSave(&taskListLock);
+    
     // 添加到全局队列
     ListAddTail(&task->globalList, &taskGlobalList);
+    // 添加到pid哈希表，初始化完成后才能被读者看到
+    ListAddTailRcu(&task->pidList, &pidHashTable[PID_HASH(task->pid)]);
+
+    SpinUnlockIrqSave(&taskListLock, flags);
+}
+
+/**
+ * TaskFreeRcu - 宽限期后释放任务结构
+ * @head: 任务的回调结构
+ */
+PRIVATE void TaskFreeRcu(struct RcuHead *head)
+{
+    kfree(container_of(head, struct Task, rcuHead));
+}
+
+/**
+ * TaskGloablListDel - 把任务从全局队列删除，并释放任务结构
+ * @task: 任务
+ *
+ * 可能还有读者在查找的时候拿到了这个任务，所以等到宽限期之后才释放，
+ * 这时候任务也已经在自己的处理器上切换出去了
+ */
+PUBLIC void TaskGloablListDel(struct Task *task)
+{
+    unsigned long flags = SpinLockIrqSave(&taskListLock);
     
+    ListDel(&task->globalList);
+    ListDelRcu(&task->pidList);
+
+    SpinUnlockIrqSave(&taskListLock, flags);
+
+    CallRcu(&task->rcuHead, TaskFreeRcu);
 }
 
 /**
@@ -305,28 +449,18 @@ PUBLIC void TaskGloablListAdd(struct Task *task)
  */
 PUBLIC int IsTaskInPriorityQueue(struct Task *task)
 {
-    int i;
-    for (i = 0; i < MAX_PRIORITY_NR; i++) {
-        if (ListFind(&task->list, &taskPriorityQueue[i])) {
-            return 1;
-        }
-    }
-    return 0;
+    struct Cpu *cpu = &cpus[task->cpu];
+    /* 任务只会在和自己的优先级对应的队列中 */
+    return ListFind(&task->list, &cpu->priorityQueue[task->priority]);
 }
 
 
 /**
- * IsAllPriorityQueueEmpty - 判断优先级队列是否为空
+ * IsAllPriorityQueueEmpty - 判断当前处理器的优先级队列是否为空
  */
 PUBLIC int IsAllPriorityQueueEmpty()
 {
-    int i;
-    for (i = 0; i < MAX_PRIORITY_NR; i++) {
-        if (!ListEmpty(&taskPriorityQueue[i])) {
-            return 0;
-        }
-    }
-    return 1;
+    return !CurrentCpu()->readyBitmap;
 }
 
 /**
@@ -356,6 +490,9 @@ PUBLIC struct Task *ThreadStart(char *name, int priority, ThreadFunc func, void
     /* 操作链表时关闭中断，结束后恢复之前状态 */
     unsigned long flags = InterruptSave();
 
+    /* 放到负载最轻的处理器上运行 */
+    thread->cpu = ScheduleSelectCpu();
+
     TaskGloablListAdd(thread);
     TaskPriorityQueueAddTail(thread);
     
@@ -405,6 +542,42 @@ PRIVATE void MakeMainThread()
     taskIdle->status = TASK_RUNNING;
 
     TaskGloablListAdd(taskIdle);
+
+    /* 主线程是引导处理器的idle任务 */
+    cpus[0].idle = taskIdle;
+    cpus[0].current = taskIdle;
+
+    /* 从现在开始执行流需要持有大内核锁 */
+    taskIdle->lockDepth = 0;
+    KernelLock();
+}
+
+/**
+ * CreateIdleTask - 为应用处理器创建idle任务
+ * @cpu: 处理器编号
+ * 
+ * idle任务的内核栈就是应用处理器启动时的栈，启动后直接运行在idle任务中
+ */
+PUBLIC struct Task *CreateIdleTask(int cpu)
+{
+    struct Task *idle = (struct Task *) kmalloc(TASK_KSTACK_SIZE, GFP_KERNEL);
+    if (!idle)
+        return NULL;
+    
+    TaskInit(idle, "idle", TASK_PRIORITY_IDLE);
+    
+    idle->cpu = cpu;
+    idle->status = TASK_RUNNING;
+    /* 处理器进入内核时才获取大内核锁 */
+    idle->lockDepth = 0;
+
+    unsigned long flags = InterruptSave();
+    TaskGloablListAdd(idle);
+    InterruptRestore(flags);
+
+    cpus[cpu].idle = idle;
+    cpus[cpu].current = idle;
+    return idle;
 }
 
 /**
@@ -574,6 +747,9 @@ PUBLIC struct Task *InitFirstProcess(char **argv, char *name)
     /* 操作链表时关闭中断，结束后恢复之前状态 */
     unsigned long flags = InterruptSave();
 
+    /* 放到负载最轻的处理器上运行 */
+    thread->cpu = ScheduleSelectCpu();
+
     /* 添加到队尾 */
     TaskGloablListAdd(thread);
     TaskPriorityQueueAddTail(thread);
@@ -623,11 +799,15 @@ PUBLIC uint32_t SysGetPid()
  */
 PUBLIC int SysSetPgid(pid_t pid, pid_t pgid)
 {
+    RcuReadLock();
     struct Task *task = FindTaskByPid(pid);
-    if (task == NULL) 
+    if (task == NULL) {
+        RcuReadUnlock();
         return -1;
+    }
 
     task->groupPid = pgid;
+    RcuReadUnlock();
 
     return 0;
 }
@@ -640,11 +820,15 @@ PUBLIC int SysSetPgid(pid_t pid, pid_t pgid)
  */
 PUBLIC pid_t SysGetPgid(pid_t pid)
 {
+    pid_t pgid = -1;
+
+    RcuReadLock();
     struct Task *task = FindTaskByPid(pid);
-    if (task == NULL) 
-        return -1;
+    if (task != NULL) 
+        pgid = task->groupPid;
+    RcuReadUnlock();
 
-    return task->groupPid;
+    return pgid;
 }
 
 /**
@@ -779,7 +963,8 @@ PUBLIC void DumpTask(struct Task *task)
 {
     printk(PART_TIP "----Task----\n");
     printk(PART_TIP "name:%s pid:%d parent pid:%d status:%d\n", task->name, task->pid, task->parentPid, task->status);
-    printk(PART_TIP "pgdir:%x priority:%d ticks:%d elapsed ticks:%d\n", task->pgdir, task->priority, task->ticks, task->elapsedTicks);
+    printk(PART_TIP "pgdir:%x priority:%d/%d ticks:%d elapsed ticks:%d\n", task->pgdir, task->priority, task->staticPriority, task->ticks, task->elapsedTicks);
+    printk(PART_TIP "wait ticks:%d switches voluntary:%d involuntary:%d\n", task->waitTicks, task->voluntarySwitches, task->involuntarySwitches);
     printk(PART_TIP "exit code:%d mm:%x stack mageic:%d\n", task->exitStatus, task->mm, task->stackMagic);
 }
 
@@ -817,22 +1002,38 @@ PUBLIC void SystemPause()
 {
     /* 设置特权级为最低，变成阻塞，当没有其它任务运行时，就会唤醒它 */
     taskIdle->status = TASK_BLOCKED;
-    taskIdle->priority = TASK_PRIORITY_IDLE;
+    taskIdle->priority = taskIdle->staticPriority = TASK_PRIORITY_IDLE;
     /* 然后设置成最低特权级 */
     TaskPriorityQueueAddHead(taskIdle);
     /* 调度到其它任务，直到又重新被调度 */
     Schedule();
 
+    /* idle在用户态之外运行，释放大内核锁，让其它处理器进入内核 */
+    KernelUnlock();
+
     /* idle线程 */
-	while (1) {
-		/* 进程默认处于阻塞状态，如果被唤醒就会执行后面的操作，
-		知道再次被阻塞 */
-		
-        /* 打开中断 */
-		EnableInterrupt();
-		/* 执行cpu停机 */
-		CpuHlt();
+	TaskIdleLoop();
+}
 
+/**
+ * TaskIdleLoop - idle任务的循环
+ * 
+ * 进程默认处于阻塞状态，如果被唤醒就会执行后面的操作，知道再次被阻塞。
+ * 停机前把时钟事件推迟到需要处理的时候，不用每个节拍都醒来
+ */
+PUBLIC void TaskIdleLoop()
+{
+	while (1) {
+        /* 关闭中断，避免设置时钟事件和停机之间错过中断 */
+        DisableInterrupt();
+        KernelLock();
+        /* 空闲循环是静止状态 */
+        RcuNoteContextSwitch(CurrentCpuId());
+        ClockEventIdleEnter();
+        KernelUnlock();
+
+        /* 打开中断并执行cpu停机 */
+		CpuStiHlt();
 	};
 }
 /**
@@ -841,11 +1042,35 @@ PUBLIC void SystemPause()
 PUBLIC void InitTasks()
 {
 
-    /* 初始化特权队列 */
-    int i;
-    for (i = 0; i < MAX_PRIORITY_NR; i++) {
-        INIT_LIST_HEAD(&taskPriorityQueue[i]);
+    /* 初始化每个处理器的特权队列 */
+    int i, j;
+    for (i = 0; i < NR_CPUS; i++) {
+        cpus[i].id = i;
+        cpus[i].online = 0;
+        cpus[i].needResched = 0;
+        cpus[i].idle = cpus[i].current = NULL;
+        cpus[i].nrReady = 0;
+        cpus[i].balanceTicks = SCHED_BALANCE_TICKS;
+        cpus[i].migrations = 0;
+        cpus[i].switches = 0;
+        cpus[i].readyBitmap = 0;
+        for (j = 0; j < MAX_PRIORITY_NR; j++) {
+            INIT_LIST_HEAD(&cpus[i].priorityQueue[j]);
+        }
     }
+    /* 引导处理器已经在运行 */
+    cpus[0].online = 1;
+    cpuOnlineNr = 1;
+
+    /* 初始化地址等待表 */
+    InitWaitQueueTable();
+
+    /* 初始化pid哈希表 */
+    for (i = 0; i < PID_HASH_SIZE; i++)
+        INIT_LIST_HEAD(&pidHashTable[i]);
+    
+    InitRcu();
+    InitFutex();
 
     /* 跳过init进程的pid = 0，后面执行init的时候会把它的pid设置为0*/
     nextPid = 1;
@@ -0,0 +1,41 @@
+/*
+ * file:		kernel/task/waitqueue.c
+ * auther:	    Jason Hu
+ * time:		2020/3/11
+ * copyright:	(C) 2018-2020 by Book OS developers. All rights reserved.
+ */
+
+#include <book/arch.h>
+#include <book/debug.h>
+#include <book/waitqueue.h>
+
+/* 地址等待表的大小，必须是2的幂 */
+#define WAIT_TABLE_SIZE     64
+
+#define WAIT_TABLE_HASH(addr) \
+    ((((unsigned long)(addr) >> 4) ^ ((unsigned long)(addr) >> 10)) & (WAIT_TABLE_SIZE - 1))
+
+/* 以对象地址为键的等待队列表，缓冲区、页这类数量很多的对象
+不需要每个都带一个等待队列，共用同一个哈希桶的等待者被唤醒后自己检测条件 */
+PRIVATE struct WaitQueue waitTable[WAIT_TABLE_SIZE];
+
+/**
+ * AddressWaitQueue - 获取对象地址对应的等待队列
+ * @addr: 对象的地址
+ *
+ * 唤醒的时候需要唤醒全部等待者，因为可能有其它对象的等待者
+ */
+PUBLIC struct WaitQueue *AddressWaitQueue(void *addr)
+{
+    return &waitTable[WAIT_TABLE_HASH(addr)];
+}
+
+/**
+ * InitWaitQueueTable - 初始化地址等待表
+ */
+PUBLIC void InitWaitQueueTable()
+{
+    int i;
+    for (i = 0; i < WAIT_TABLE_SIZE; i++)
+        WaitQueueInit(&waitTable[i], NULL);
+}
@@ -13,31 +13,55 @@
 
 /**
  * UpdateAlarmSystem - 更新闹钟系统
+ * @ticks: 距离上次更新经过的ticks数
  * 
- * 由于闹钟的基本单位是秒，所以更新也是1s执行一次
- * 
+ * 由于闹钟的基本单位是秒，所以每过HZ个ticks减少1秒。
+ * 空闲时不会每个tick都更新，所以一次可能经过多个ticks
  */
-PUBLIC void UpdateAlarmSystem()
+PUBLIC void UpdateAlarmSystem(unsigned long ticks)
 {
     struct Task *task;
+    unsigned long elapsed;
+
     ListForEachOwner(task, &taskGlobalList, globalList) {
-        if (task->alarm) {
-            task->alarmTicks--;
-            if (!task->alarmTicks) {
-                //printk("a");
-                task->alarmSeconds--;
+        if (!task->alarm)
+            continue;
 
-                /* alarmTicks和时钟相关 */
-                task->alarmTicks = HZ; 
-                /* 如果时间结束，那么就发送SIGALRM信号 */
-                if (!task->alarmSeconds) {
-                    //printk("alarm! %d\n", task->pid);
-                    ForceSignal(SIGALRM, task->pid);
-                    task->alarm = 0;
-                }
+        elapsed = ticks;
+        while (task->alarm && elapsed >= task->alarmTicks) {
+            elapsed -= task->alarmTicks;
+            //printk("a");
+            task->alarmSeconds--;
+
+            /* alarmTicks和时钟相关 */
+            task->alarmTicks = HZ; 
+            /* 如果时间结束，那么就发送SIGALRM信号 */
+            if (!task->alarmSeconds) {
+                //printk("alarm! %d\n", task->pid);
+                ForceSignal(SIGALRM, task->pid);
+                task->alarm = 0;
             }
         }
+        if (task->alarm)
+            task->alarmTicks -= elapsed;
+    }
+}
+
+/**
+ * AlarmNextExpiry - 获取距离下一次闹钟更新的ticks数
+ * @limit: 最大的ticks数
+ * 
+ * 空闲时用它决定最多可以推迟多久再更新闹钟
+ */
+PUBLIC unsigned long AlarmNextExpiry(unsigned long limit)
+{
+    struct Task *task;
+
+    ListForEachOwner(task, &taskGlobalList, globalList) {
+        if (task->alarm && task->alarmTicks < limit)
+            limit = task->alarmTicks;
     }
+    return limit;
 }
 
 /**
@@ -6,17 +6,46 @@
  */
 
 #include <lib/stddef.h>
+#include <lib/math.h>
 #include <book/arch.h>
 #include <book/debug.h>
 #include <book/timer.h>
 #include <book/schedule.h>
 #include <book/task.h>
 #include <clock/clock.h>
+#include <clock/clockevent.h>
 
 //#define TIMER_TEST
+//#define TIMER_STRESS_TEST
 
-/* 定时器链表 */
-PUBLIC struct List timerList;
+/*
+分级时间轮：定时器按照到期的systicks放到不同级别的槽中。
+第1级有256个槽，每个槽对应1个tick；后面4级每级64个槽，
+每个槽对应的时间是上一级的整个轮。第1级转完一圈时，把第2级
+对应槽中的定时器重新分配到第1级，依此类推。
+这样添加、删除定时器都是O(1)，每个tick也只需要处理一个槽。
+*/
+#define TVR_BITS    8
+#define TVN_BITS    6
+#define TVR_SIZE    (1 << TVR_BITS)
+#define TVN_SIZE    (1 << TVN_BITS)
+#define TVR_MASK    (TVR_SIZE - 1)
+#define TVN_MASK    (TVN_SIZE - 1)
+
+/* 第n级（从0开始，不包括第1级）轮中，当前ticks对应的槽 */
+#define TVN_INDEX(ticks, n) \
+        (((ticks) >> (TVR_BITS + (n) * TVN_BITS)) & TVN_MASK)
+
+struct TimerWheel {
+    unsigned long timerTicks;       /* 下一个要处理的tick */
+    struct List tv1[TVR_SIZE];
+    struct List tv2[TVN_SIZE];
+    struct List tv3[TVN_SIZE];
+    struct List tv4[TVN_SIZE];
+    struct List tv5[TVN_SIZE];
+};
+
+PRIVATE struct TimerWheel timerWheel;
 
 /**
  * TimerInit - 初始化一个定时器
@@ -24,6 +53,8 @@ PUBLIC struct List timerList;
  * @expires: 时间（ticks为单位）
  * @data: 传递的参数
  * @function: 要执行的函数
+ *
+ * expires是相对时间，添加定时器的时候才换算成到期时的systicks
  */
 PUBLIC void TimerInit(struct Timer *timer, uint64_t expires, uint32_t data,
         void (*function)(uint32_t))
@@ -36,41 +67,98 @@ PUBLIC void TimerInit(struct Timer *timer, uint64_t expires, uint32_t data,
     timer->lastExpires = expires;
 	timer->data = data;
 	timer->function = function;
-	
+
     timer->state = TIMER_IDLE;
 
     timer->next = NULL;
 }
 
+/**
+ * TimerWheelAdd - 把定时器放到时间轮中
+ * @timer: 定时器
+ *
+ * 根据到期时间离当前的距离选择所在的级别
+ */
+PRIVATE void TimerWheelAdd(struct Timer *timer)
+{
+    unsigned long expires = timer->expires;
+    unsigned long idx = expires - timerWheel.timerTicks;
+    struct List *vec;
+
+    if ((long)idx < 0) {
+        /* 已经过期了，在下一个tick处理 */
+        vec = timerWheel.tv1 + (timerWheel.timerTicks & TVR_MASK);
+    } else if (idx < TVR_SIZE) {
+        vec = timerWheel.tv1 + (expires & TVR_MASK);
+    } else if (idx < 1 << (TVR_BITS + TVN_BITS)) {
+        vec = timerWheel.tv2 + TVN_INDEX(expires, 0);
+    } else if (idx < 1 << (TVR_BITS + 2 * TVN_BITS)) {
+        vec = timerWheel.tv3 + TVN_INDEX(expires, 1);
+    } else if (idx < 1 << (TVR_BITS + 3 * TVN_BITS)) {
+        vec = timerWheel.tv4 + TVN_INDEX(expires, 2);
+    } else {
+        vec = timerWheel.tv5 + TVN_INDEX(expires, 3);
+    }
+    ListAddTail(&timer->list, vec);
+}
+
+/**
+ * TimerWheelTakeSlot - 把一个槽中的定时器全部取下来
+ * @slot: 槽
+ * @head: 保存取下的定时器的链表头
+ */
+PRIVATE void TimerWheelTakeSlot(struct List *slot, struct List *head)
+{
+    if (ListEmpty(slot))
+        INIT_LIST_HEAD(head);
+    else
+        ListReplaceInit(slot, head);
+}
+
+/**
+ * TimerWheelCascade - 把高一级轮中的一个槽重新分配到低级的轮中
+ * @tv: 高一级的轮
+ * @index: 槽的位置
+ *
+ * 返回槽的位置，为0时说明这一级也转完了一圈，需要继续处理更高一级
+ */
+PRIVATE int TimerWheelCascade(struct List *tv, int index)
+{
+    struct Timer *timer, *next;
+    struct List head;
+
+    /* 先把整个槽取下来，再逐个重新放回时间轮 */
+    TimerWheelTakeSlot(&tv[index], &head);
+
+    ListForEachOwnerSafe(timer, next, &head, list) {
+        TimerWheelAdd(timer);
+    }
+    return index;
+}
+
 PUBLIC void DoTimerHandler(struct Timer *timer)
 {
     /* 执行完后应该把定时器从链表中删除，以后不再执行 */
-    RemoveTimer(timer);
+    ListDelInit(&timer->list);
+    /* 使用过后就变成无效的了，处理函数里面可以重新添加定时器 */
+    timer->state = TIMER_INVALID;
     timer->function(timer->data);
 }
 
 /**
  * TimerUpdate - 定时器更新
  * @timer: 要更新的定时器
- * 
+ *
  * 如果定时器到期了，就执行定时器里面的函数，并传递参数过去
  * 不然就直接返回
  */
 PUBLIC bool TimerUpdate(struct Timer *timer)
 {
-    /* 运行中才更新 */
-    if (timer->state == TIMER_RUNNING) {
-        
-        /* 减少计数 */
-        --timer->expires;
-
-        /* 定时器到期就执行函数 */
-        if (timer->expires == 0){
-            DoTimerHandler(timer);
-            /* 使用过后就变成无效的了 */
-            timer->state = TIMER_INVALID;
-            return true;
-        }
+    /* 运行中并且到期了才执行 */
+    if (timer->state == TIMER_RUNNING &&
+        (long)(systicks - timer->expires) >= 0) {
+        DoTimerHandler(timer);
+        return true;
     }
 	return false;
 }
@@ -78,7 +166,7 @@ PUBLIC bool TimerUpdate(struct Timer *timer)
 /**
  * AddTimer - 添加一个定时器
  * @timer: 定时器
- * 
+ *
  * 添加定时器的时候，可能执行到一半就发生时钟中断
  * 所以要先关闭中断，避免获取定时器出错
  */
@@ -86,14 +174,17 @@ PUBLIC void AddTimer(struct Timer *timer)
 {
 	/* 保存状态并关闭中断 */
     unsigned long flags = InterruptSave();
-    
-	/* 保证定时器不在队列里面 */
-	ASSERT(!ListFind(&timer->list, &timerList));
+
+	/* 保证定时器不在时间轮里面 */
+	ASSERT(ListEmpty(&timer->list));
 
     timer->state = TIMER_RUNNING;
+    /* 从现在开始计时 */
+    timer->expires = systicks + timer->lastExpires;
 
-	/* 添加到队列 */
-	ListAddTail(&timer->list, &timerList);
+	/* 添加到时间轮 */
+	TimerWheelAdd(timer);
+    ClockEventTimerAdded(timer->expires);
 
 	/* 恢复之前的中断状态 */
 	InterruptRestore(flags);
@@ -102,32 +193,42 @@ PUBLIC void AddTimer(struct Timer *timer)
 /**
  * RemoveTimer - 移除一个定时器
  * @timer: 定时器
+ *
+ * 定时器已经到期或者已经被移除时什么也不做
  */
 PUBLIC void RemoveTimer(struct Timer *timer)
 {
 	/* 保存状态并关闭中断 */
     unsigned long flags = InterruptSave();
-    
-	/* 保证定时器在队列里面 */
-	ASSERT(ListFind(&timer->list, &timerList));
-	/* 从队列中删除 */
-	ListDelInit(&timer->list);
 
-	/* 恢复之前的中断状态 */
-	InterruptRestore(flags);
+    /* 从时间轮中删除 */
+    ListDelInit(&timer->list);
+
+    if (timer->state == TIMER_RUNNING)
+        timer->state = TIMER_IDLE;
+
+    /* 恢复之前的中断状态 */
+    InterruptRestore(flags);
 }
 
 /**
  * StopTimer - 停止一个定时器
  * @timer: 定时器
+ *
+ * 从时间轮中取下来，并记录剩余的ticks数
  */
 PUBLIC void StopTimer(struct Timer *timer)
 {
 	/* 保存状态并关闭中断 */
     unsigned long flags = InterruptSave();
-    
-    /* 设置成停止状态 */
-    timer->state = TIMER_STOP;
+
+    if (timer->state == TIMER_RUNNING) {
+        ListDelInit(&timer->list);
+        timer->expires = TimerRemaining(timer);
+
+        /* 设置成停止状态 */
+        timer->state = TIMER_STOP;
+    }
 
 	/* 恢复之前的中断状态 */
 	InterruptRestore(flags);
@@ -141,10 +242,15 @@ PUBLIC void ResumeTimer(struct Timer *timer)
 {
 	/* 保存状态并关闭中断 */
     unsigned long flags = InterruptSave();
-    
-    /* 设置成停止状态 */
-    timer->state = TIMER_RUNNING;
-    
+
+    if (timer->state == TIMER_STOP) {
+        /* 从剩余的ticks继续计时 */
+        timer->expires += systicks;
+        timer->state = TIMER_RUNNING;
+        TimerWheelAdd(timer);
+        ClockEventTimerAdded(timer->expires);
+    }
+
 	/* 恢复之前的中断状态 */
 	InterruptRestore(flags);
 }
@@ -159,17 +265,104 @@ PUBLIC void CancelTimer(struct Timer *timer)
 
 }
 
+/**
+ * TimerRemaining - 获取定时器剩余的ticks数
+ * @timer: 定时器
+ *
+ * 已经到期的定时器返回0
+ */
+PUBLIC unsigned long TimerRemaining(struct Timer *timer)
+{
+    long left;
+
+    if (timer->state == TIMER_STOP)
+        return timer->expires;
+
+    left = timer->expires - systicks;
+    return left > 0 ? left : 0;
+}
+
+/**
+ * TimerNextExpiry - 获取下一个需要处理定时器的时刻
+ * @limit: 最多向后查找的ticks数
+ *
+ * 空闲的处理器用它决定可以推迟多久再产生时钟中断。
+ * 只查找第1级轮，遇到需要级联的时刻也返回，级联后再重新计算。
+ * 返回对应的systicks，limit内都没有定时器就返回systicks + limit
+ */
+PUBLIC unsigned long TimerNextExpiry(unsigned long limit)
+{
+    unsigned long flags = InterruptSave();
+    unsigned long ticks = timerWheel.timerTicks;
+    unsigned long end = systicks + limit;
+
+    /* 还有没有处理的tick */
+    if ((long)(systicks - ticks) >= 0) {
+        InterruptRestore(flags);
+        return systicks;
+    }
+
+    while ((long)(end - ticks) > 0) {
+        if (!(ticks & TVR_MASK) || !ListEmpty(&timerWheel.tv1[ticks & TVR_MASK]))
+            break;
+        ticks++;
+    }
+
+    InterruptRestore(flags);
+    return (long)(end - ticks) > 0 ? ticks : end;
+}
+
+#ifdef TIMER_STRESS_TEST
+/* 定时器处理耗费的时钟周期 */
+PRIVATE unsigned long long timerCycles, timerCyclesMax;
+PRIVATE unsigned int timerUpdates;
+#endif  /* TIMER_STRESS_TEST */
+
 /**
  * UpdateTimerSystem - 更新定时器系统
+ *
+ * 软中断可能推迟执行，所以要处理到当前的systicks为止
  */
 PUBLIC void UpdateTimerSystem()
 {
     unsigned long flags = InterruptSave();
-	struct Timer *timer, *next;
-	/* 因为有可能会在更新后把定时器删除，所以这里要用安全 */
-	ListForEachOwnerSafe(timer, next, &timerList, list) {
-		TimerUpdate(timer);
-	}
+	struct Timer *timer;
+    struct List head;
+    int index;
+
+#ifdef TIMER_STRESS_TEST
+    unsigned long long start = X86Rdtsc();
+#endif  /* TIMER_STRESS_TEST */
+
+    while ((long)(systicks - timerWheel.timerTicks) >= 0) {
+        index = timerWheel.timerTicks & TVR_MASK;
+
+        /* 第1级转完一圈，从高一级取下一个槽 */
+        if (!index &&
+            !TimerWheelCascade(timerWheel.tv2, TVN_INDEX(timerWheel.timerTicks, 0)) &&
+            !TimerWheelCascade(timerWheel.tv3, TVN_INDEX(timerWheel.timerTicks, 1)) &&
+            !TimerWheelCascade(timerWheel.tv4, TVN_INDEX(timerWheel.timerTicks, 2)))
+            TimerWheelCascade(timerWheel.tv5, TVN_INDEX(timerWheel.timerTicks, 3));
+
+        timerWheel.timerTicks++;
+
+        /* 把到期的槽取下来，处理函数里面添加的定时器不会影响遍历 */
+        TimerWheelTakeSlot(&timerWheel.tv1[index], &head);
+
+        while (!ListEmpty(&head)) {
+            timer = ListFirstOwner(&head, struct Timer, list);
+            DoTimerHandler(timer);
+        }
+    }
+
+#ifdef TIMER_STRESS_TEST
+    unsigned long long cycles = X86Rdtsc() - start;
+    timerCycles += cycles;
+    if (cycles > timerCyclesMax)
+        timerCyclesMax = cycles;
+    timerUpdates++;
+#endif  /* TIMER_STRESS_TEST */
+
     InterruptRestore(flags);
 }
 
@@ -180,13 +373,75 @@ PRIVATE void TimerTest(uint32_t data)
 }
 #endif  /* TIMER_TEST */
 
+#ifdef TIMER_STRESS_TEST
+/* 休眠线程的数量 */
+#define TIMER_STRESS_THREADS    2000
+
+/* 每个线程休眠的次数 */
+#define TIMER_STRESS_ROUNDS     20
+
+PRIVATE void TimerStressSleeper(void *arg)
+{
+    unsigned int seed = (unsigned int)arg;
+    int i;
+
+    for (i = 0; i < TIMER_STRESS_ROUNDS; i++) {
+        /* 伪随机的休眠时间，分散到时间轮的各个级别 */
+        seed = seed * 1103515245 + 12345;
+        TaskSleep(1 + (seed >> 16) % (HZ * 4));
+    }
+    ThreadExit(CurrentTask());
+}
+
+/**
+ * TimerStressTest - 定时器压力测试
+ *
+ * 创建大量反复休眠的线程，然后每秒报告一次定时器处理的耗时
+ */
+PRIVATE void TimerStressTest(void *arg)
+{
+    int i;
+
+    for (i = 0; i < TIMER_STRESS_THREADS; i++) {
+        if (ThreadStart("sleeper", TASK_PRIORITY_USER, TimerStressSleeper, (void *)i) == NULL) {
+            printk(PART_WARRING "timer stress: only %d threads started\n", i);
+            break;
+        }
+    }
+
+    while (1) {
+        TaskSleep(HZ);
+
+        unsigned long flags = InterruptSave();
+        /* 内核没有64位除法 */
+        if (timerUpdates)
+            DivU64(&timerCycles, timerUpdates);
+        printk(PART_TIP "timer stress: %d updates, avg %d cycles, max %d cycles\n",
+            timerUpdates, (uint32_t)timerCycles, (uint32_t)timerCyclesMax);
+        timerCycles = timerCyclesMax = 0;
+        timerUpdates = 0;
+        InterruptRestore(flags);
+    }
+}
+#endif  /* TIMER_STRESS_TEST */
+
 /**
  * InitTimer - 初始化定时器
  */
 PUBLIC void InitTimer()
 {
-	/* 初始化定时器链表头 */
-	INIT_LIST_HEAD(&timerList);
+    int i;
+
+	/* 初始化时间轮的所有槽 */
+    for (i = 0; i < TVR_SIZE; i++)
+        INIT_LIST_HEAD(&timerWheel.tv1[i]);
+    for (i = 0; i < TVN_SIZE; i++) {
+        INIT_LIST_HEAD(&timerWheel.tv2[i]);
+        INIT_LIST_HEAD(&timerWheel.tv3[i]);
+        INIT_LIST_HEAD(&timerWheel.tv4[i]);
+        INIT_LIST_HEAD(&timerWheel.tv5[i]);
+    }
+    timerWheel.timerTicks = systicks;
 
 	/*
 	struct Timer *timer = kmalloc(sizeof(struct Timer), GFP_KERNEL);
@@ -195,4 +450,8 @@ PUBLIC void InitTimer()
 	}
 	TimerInit(timer, 200, 10, TimerTest);
 	AddTimer(timer);*/
-}
\ No newline at end of file
+
+#ifdef TIMER_STRESS_TEST
+    ThreadStart("timerstress", TASK_PRIORITY_RT, TimerStressTest, NULL);
+#endif  /* TIMER_STRESS_TEST */
+}